@@ -17,6 +17,7 @@
   */
 
 /* Includes ------------------------------------------------------------------*/
+#include <string.h>
 #include "main.h"
 #include "Bootloader.h"
 #include "openbl_core.h"
@@ -24,6 +25,7 @@
 #include "openbl_mem.h"
 #include "openbl_usart_cmd.h"
 #include "iwdg_interface.h"
+#include "crc_interface.h"
 #include "ram_interface.h"
 #include "flash_interface.h"
 #include "systemmemory_interface.h"
@@ -39,9 +41,15 @@
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
+#define OPENBL_IMAGE_CACHE_REG(Index)     ((&RTC->BKP0R)[OPENBL_IMAGE_CACHE_BKP + (Index)])
+/* The backup registers are only used while the RTC is clocked, the application owns its configuration */
+#define OPENBL_IMAGE_CACHE_READY()        (READ_BIT(RCC->BDCR, RCC_BDCR_RTCEN) != 0U)
+
 /* Private variables ---------------------------------------------------------*/
 static OPENBL_HandleTypeDef USART_Handle;
 static OPENBL_HandleTypeDef IWDG_Handle;
+static OPENBL_HandleTypeDef CRC_Handle;
+static uint32_t OpenBootloader_VectorTable[OPENBL_VECTORS_NUMBER] __ALIGNED(512);  /* RAM copy of the vector table */
 extern UART_HandleTypeDef huart2;
 
 
@@ -64,6 +72,15 @@ static OPENBL_OpsTypeDef IWDG_Ops =
   NULL
 };
 
+static OPENBL_OpsTypeDef CRC_Ops =
+{
+  OPENBL_CRC_Configuration,
+  NULL,
+  NULL,
+  NULL,
+  NULL
+};
+
 /* External variables --------------------------------------------------------*/
 extern OPENBL_MemoryTypeDef FLASH_Descriptor;
 extern OPENBL_MemoryTypeDef RAM_Descriptor;
@@ -76,6 +93,11 @@ extern OPENBL_MemoryTypeDef ICP3_Descriptor;
 
 
 /* Private function prototypes -----------------------------------------------*/
+static void OpenBootloader_RelocateVectorTable(void);
+#if (OPENBL_IMAGE_HEADER == 1U)
+static ErrorStatus OpenBootloader_ValidateImage(const OPENBL_ImageHeaderTypeDef *pHeader);
+#endif /* (OPENBL_IMAGE_HEADER == 1U) */
+
 /* Private functions ---------------------------------------------------------*/
 
 /**
@@ -85,6 +107,9 @@ extern OPENBL_MemoryTypeDef ICP3_Descriptor;
   */
 void OpenBootloader_Init(void)
 {
+  /* The interrupts running during FLASH operations must not fetch their vector from FLASH */
+  OpenBootloader_RelocateVectorTable();
+
   /* Register USART interfaces */
   USART_Handle.p_Ops = &USART_Ops;
   USART_Handle.p_Cmd = OPENBL_USART_GetCommandsList();
@@ -97,6 +122,12 @@ void OpenBootloader_Init(void)
 
   OPENBL_RegisterInterface(&IWDG_Handle);
 
+  /* Register CRC interfaces */
+  CRC_Handle.p_Ops = &CRC_Ops;
+  CRC_Handle.p_Cmd = NULL;
+
+  OPENBL_RegisterInterface(&CRC_Handle);
+
   /* Initialise interfaces */
   OPENBL_Init();
 
@@ -167,12 +198,33 @@ void OpenBootloader_ProtocolDetection(void)
   if (interface_detected == 1U)
   {
     OPENBL_CommandProcess();
+
+    /* A background erase paused for this command continues until the next one arrives */
+    OPENBL_FLASH_ResumeErase();
   }
 }
 
+/**
+  * @brief  This function is used to start the user application if one is installed.
+  *         It is called right after reset, before HAL_Init(), on the reset clock.
+  *         With OPENBL_IMAGE_HEADER the image must carry a valid header, see OpenBootloader_ValidateImage().
+  * @param  None.
+  * @retval None.
+  */
 void OpenBootloader_CheckforUserProgram(void)
 {
   Function_Pointer appStart;
+#if (OPENBL_IMAGE_HEADER == 1U)
+  const OPENBL_ImageHeaderTypeDef *header = (const OPENBL_ImageHeaderTypeDef *)USERPROG_START_ADDRESS;
+
+  if (OpenBootloader_ValidateImage(header) == SUCCESS)
+  {
+    appStart = (Function_Pointer) header->EntryPoint;   // reset handler of the application given by the header
+    SCB->VTOR = USERPROG_START_ADDRESS + OPENBL_IMAGE_HEADER_SIZE;   // the vector table of the application follows the header
+    Common_SetMsp(header->StackPointer);   // setup the initial stack pointer given by the header
+    appStart();   // call the application's reset handler
+  }
+#else
   uint32_t *userProgStart = (uint32_t*)USERPROG_START_ADDRESS;  // point _vectable to the start of the application at 0x08004000
 
   if (userProgStart[0] != 0xFFFFFFFF)  // if there is data in sector 1 we assume a program is present
@@ -182,7 +234,118 @@ void OpenBootloader_CheckforUserProgram(void)
     Common_SetMsp(userProgStart[0]);   // setup the initial stack pointer using the RAM address contained at the start of the vector table
     appStart();   // call the application's reset handler
   }
+#endif /* (OPENBL_IMAGE_HEADER == 1U) */
+}
+
+/**
+  * @brief  This function is used to forget the cached validation of the application image.
+  *         It is called before any FLASH write or erase, the next boot computes the image CRC again.
+  *         Nothing validates the image again before the next reset, so only the first call of the
+  *         session clears the registers, the following ones return at once.
+  * @param  None.
+  * @retval None.
+  */
+void OpenBootloader_InvalidateImageCache(void)
+{
+#if (OPENBL_IMAGE_HEADER == 1U)
+  static FlagStatus invalidated = RESET;
+
+  if ((invalidated == RESET) && OPENBL_IMAGE_CACHE_READY())
+  {
+    invalidated = SET;
+
+    __HAL_RCC_PWR_CLK_ENABLE();
+    SET_BIT(PWR->CR, PWR_CR_DBP);
+
+    OPENBL_IMAGE_CACHE_REG(0U) = 0U;
+    OPENBL_IMAGE_CACHE_REG(1U) = 0U;
+    OPENBL_IMAGE_CACHE_REG(2U) = 0U;
+
+    CLEAR_BIT(PWR->CR, PWR_CR_DBP);
+    __HAL_RCC_PWR_CLK_DISABLE();
+  }
+#endif /* (OPENBL_IMAGE_HEADER == 1U) */
+}
+
+/**
+  * @brief  This function is used to move the vector table to RAM.
+  *         A FLASH erase or program stalls every FLASH access: with the table in RAM, an interrupt whose
+  *         handler also runs from RAM, as the busy byte timer, is served while the FLASH is busy.
+  * @param  None.
+  * @retval None.
+  */
+static void OpenBootloader_RelocateVectorTable(void)
+{
+  memcpy(OpenBootloader_VectorTable, (void *)SCB->VTOR, sizeof(OpenBootloader_VectorTable));
+  SCB->VTOR = (uint32_t)OpenBootloader_VectorTable;
+  __DSB();
+}
+
+#if (OPENBL_IMAGE_HEADER == 1U)
+/**
+  * @brief  This function is used to check the header and the CRC of the application image.
+  *         The CRC is computed with the CRC unit over the header fields following the Crc field and the
+  *         Length bytes of the image. A valid result is cached in RTC backup registers keyed by the
+  *         version, CRC and length of the header: the registers survive system resets, so a reset with
+  *         an unchanged image only checks the header. The cache is lost with the backup domain supply,
+  *         it is not used while the RTC clock is disabled and a cleared or inconsistent cache is a miss.
+  * @param  pHeader Pointer to the image header.
+  * @retval Returns SUCCESS if the image can be started else ERROR.
+  */
+static ErrorStatus OpenBootloader_ValidateImage(const OPENBL_ImageHeaderTypeDef *pHeader)
+{
+  ErrorStatus status = ERROR;
+  uint32_t image = USERPROG_START_ADDRESS + OPENBL_IMAGE_HEADER_SIZE;
+  uint32_t tag;
+  uint32_t crc;
+
+  /* The header is checked on every boot, only the CRC computation is skipped by the cache */
+  if ((pHeader->Magic == OPENBL_IMAGE_MAGIC)
+      && (pHeader->Length != 0U) && (pHeader->Length <= (FLASH_END_ADDRESS - image))
+      && (pHeader->StackPointer > RAM_START_ADDRESS) && (pHeader->StackPointer <= RAM_END_ADDRESS)
+      && (pHeader->EntryPoint >= image) && (pHeader->EntryPoint < (image + pHeader->Length)))
+  {
+    tag = OPENBL_IMAGE_CACHE_TAG ^ pHeader->Version ^ pHeader->Crc ^ pHeader->Length;
+
+    /* After a backup domain reset the registers read as zero, a zero tag is never cached */
+    if (OPENBL_IMAGE_CACHE_READY() && (tag != 0U)
+        && (OPENBL_IMAGE_CACHE_REG(0U) == pHeader->Version) && (OPENBL_IMAGE_CACHE_REG(1U) == pHeader->Crc)
+        && (OPENBL_IMAGE_CACHE_REG(2U) == tag))
+    {
+      status = SUCCESS;
+    }
+    else
+    {
+      __HAL_RCC_CRC_CLK_ENABLE();
+
+      OPENBL_CRC_Reset();
+      (void)OPENBL_CRC_Accumulate((uint8_t *)&pHeader->Length, sizeof(OPENBL_ImageHeaderTypeDef) - (2U * sizeof(uint32_t)));
+      crc = OPENBL_CRC_Accumulate((uint8_t *)image, pHeader->Length);
+
+      __HAL_RCC_CRC_CLK_DISABLE();
+
+      if (crc == pHeader->Crc)
+      {
+        status = SUCCESS;
+      }
+
+      if ((status == SUCCESS) && OPENBL_IMAGE_CACHE_READY() && (tag != 0U))
+      {
+        __HAL_RCC_PWR_CLK_ENABLE();
+        SET_BIT(PWR->CR, PWR_CR_DBP);
+
+        OPENBL_IMAGE_CACHE_REG(0U) = pHeader->Version;
+        OPENBL_IMAGE_CACHE_REG(1U) = pHeader->Crc;
+        OPENBL_IMAGE_CACHE_REG(2U) = tag;
+
+        CLEAR_BIT(PWR->CR, PWR_CR_DBP);
+        __HAL_RCC_PWR_CLK_DISABLE();
+      }
+    }
+  }
 
+  return status;
 }
+#endif /* (OPENBL_IMAGE_HEADER == 1U) */
 
 
@@ -21,7 +21,20 @@
 #define APP_OPENBOOTLOADER_H
 
 /* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
 /* Exported types ------------------------------------------------------------*/
+/* Header stored at USERPROG_START_ADDRESS, the application itself starts OPENBL_IMAGE_HEADER_SIZE bytes later */
+typedef struct
+{
+  uint32_t Magic;             /* OPENBL_IMAGE_MAGIC */
+  uint32_t Crc;               /* CRC32 (as OPENBL_CRC_Calculate()) of the fields below followed by the Length bytes of the image */
+  uint32_t Length;            /* Number of bytes of the image */
+  uint32_t Version;           /* Version of the application, keys the cached validation */
+  uint32_t StackPointer;      /* Initial main stack pointer */
+  uint32_t EntryPoint;        /* Address of the reset handler of the application */
+} OPENBL_ImageHeaderTypeDef;
+
 /* Exported constants --------------------------------------------------------*/
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
@@ -30,6 +43,7 @@ void OpenBootloader_DeInit(void);
 void OpenBootloader_ProtocolDetection(void);
 
 void OpenBootloader_CheckforUserProgram(void);
+void OpenBootloader_InvalidateImageCache(void);
 
 #endif /* APP_OPENBOOTLOADER_H */
 
@@ -92,12 +92,6 @@ void Common_StartPostProcessing(uint32_t Address)
   }
 }
 
-void OPENBL_WriteDoubleWord(uint32_t Address, uint64_t word)
-{
-    HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, (Address ), word & 0xFFFFFFFF);
-    HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, (Address + 4), word >> 32);
-}
-
 void OPENBL_WriteWord(uint32_t Address, uint32_t word)
 {
     HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, (Address ), word);
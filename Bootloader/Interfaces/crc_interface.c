@@ -0,0 +1,103 @@
+/**
+  ******************************************************************************
+  * @file    crc_interface.c
+  * @author  MCD Application Team
+  * @brief   Contains CRC HW configuration
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2019-2021 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "platform.h"
+#include "stm32f4xx_ll_crc.h"
+#include "crc_interface.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+/* Private functions ---------------------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  This function is used to enable the CRC calculation unit.
+  *         The F4 unit is fixed to the CRC-32 polynomial 0x04C11DB7, initial value 0xFFFFFFFF,
+  *         no reflection and no final XOR (CRC-32/MPEG-2) and processes 32-bit words only.
+  * @retval None.
+  */
+void OPENBL_CRC_Configuration(void)
+{
+  __HAL_RCC_CRC_CLK_ENABLE();
+
+  LL_CRC_ResetCRCCalculationUnit(CRC);
+}
+
+/**
+  * @brief  This function is used to restart a CRC calculation from the initial value.
+  * @retval None.
+  */
+void OPENBL_CRC_Reset(void)
+{
+  LL_CRC_ResetCRCCalculationUnit(CRC);
+}
+
+/**
+  * @brief  This function is used to add a block of bytes to the running CRC calculation.
+  *         Bytes are fed as little-endian 32-bit words, the way they are laid out in memory.
+  *         A trailing partial word is padded with 0xFF, so all but the last block of a
+  *         calculation must have a length multiple of 4.
+  * @param  pData Pointer to the data.
+  * @param  Length The number of bytes.
+  * @retval Returns the CRC of all the data fed since the last reset.
+  */
+uint32_t OPENBL_CRC_Accumulate(uint8_t *pData, uint32_t Length)
+{
+  uint32_t word;
+  uint32_t index;
+
+  while (Length >= 4U)
+  {
+    LL_CRC_FeedData32(CRC, __UNALIGNED_UINT32_READ(pData));
+
+    pData  += 4U;
+    Length -= 4U;
+  }
+
+  if (Length != 0U)
+  {
+    word = 0xFFFFFFFFU;
+
+    for (index = 0U; index < Length; index++)
+    {
+      word &= ~((uint32_t)0xFFU << (index * 8U));
+      word |= (uint32_t)pData[index] << (index * 8U);
+    }
+
+    LL_CRC_FeedData32(CRC, word);
+  }
+
+  return LL_CRC_ReadData32(CRC);
+}
+
+/**
+  * @brief  This function is used to calculate the CRC of a block of bytes.
+  * @param  pData Pointer to the data.
+  * @param  Length The number of bytes.
+  * @retval Returns the CRC value.
+  */
+uint32_t OPENBL_CRC_Calculate(uint8_t *pData, uint32_t Length)
+{
+  OPENBL_CRC_Reset();
+
+  return OPENBL_CRC_Accumulate(pData, Length);
+}
@@ -0,0 +1,43 @@
+/**
+  ******************************************************************************
+  * @file    crc_interface.h
+  * @author  MCD Application Team
+  * @brief   Header for crc_interface.c module
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2019-2021 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef CRC_INTERFACE_H
+#define CRC_INTERFACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions ------------------------------------------------------- */
+void OPENBL_CRC_Configuration(void);
+void OPENBL_CRC_Reset(void);
+uint32_t OPENBL_CRC_Accumulate(uint8_t *pData, uint32_t Length);
+uint32_t OPENBL_CRC_Calculate(uint8_t *pData, uint32_t Length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRC_INTERFACE_H */
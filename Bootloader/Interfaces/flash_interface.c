@@ -29,17 +29,39 @@
 /* Private macro -------------------------------------------------------------*/
 FLASH_TypeDef * flash = (FLASH_TypeDef *)FLASH_R_BASE ;
 /* Private variables ---------------------------------------------------------*/
-uint32_t Flash_BusyState = FLASH_BUSY_STATE_DISABLED;
-FLASH_ProcessTypeDef FlashProcess = {.Lock = HAL_UNLOCKED, \
-                                     .ErrorCode = HAL_FLASH_ERROR_NONE, \
-                                     .ProcedureOnGoing = 0U, \
-                                     .Address = 0U, \
-                                     .Bank = FLASH_BANK_1, \
-                                     .Sector = 0U, \
-                                     .NbSectorsToErase = 0U
-                                    };
+volatile uint32_t Flash_BusyState = FLASH_BUSY_STATE_DISABLED;  /* Busy bytes are sent to the host while enabled */
+
+/* Background sector erase state machine, walked by the FLASH interrupt */
+static volatile uint32_t FlashErasePending = 0U;  /* Bit n set while sector n waits for or is under erase */
+static volatile uint32_t FlashEraseSector  = 0U;  /* Sector currently under erase */
+static volatile uint32_t FlashEraseActive  = 0U;  /* 1 while a sector erase is running */
+static volatile uint32_t FlashEraseHold    = 0U;  /* 1 while the thread drives the erase or programs, the interrupt starts no erase */
+static volatile uint32_t FlashEraseError   = 0U;  /* 1 once an erase failed, cleared when reported */
+static volatile uint32_t FlashEraseErrors  = 0U;  /* Number of sector erases that failed since reset */
+static volatile uint32_t FlashEraseFailed  = 0U;  /* Bit n set while sector n is left unerased by a failed erase */
+
+static uint32_t FlashProgrammedWords = 0U;    /* Number of words programmed since reset */
+static uint32_t FlashSkippedWords    = 0U;    /* Number of erased value words not programmed since reset */
+static FunctionalState FlashAutoErase = DISABLE; /* Erase sectors on their first write */
+static uint32_t FlashAutoErasedSectors = 0U;     /* Bit n set once sector n has been handled by the auto erase */
+
+/* Size of each FLASH sector, the sectors are contiguous from FLASH_START_ADDRESS */
+static const uint32_t a_FlashSectorsSize[FLASH_SECTORS_NUMBER] =
+{
+  0x4000U, 0x4000U, 0x4000U, 0x4000U, 0x10000U, 0x20000U, 0x20000U, 0x20000U
+};
 
 /* Private function prototypes -----------------------------------------------*/
+#if (OPENBL_FLASH_PROGRAM_HAL == 1U)
+static ErrorStatus OPENBL_FLASH_ProgramHal(uint32_t Address, uint8_t *pData, uint32_t DataLength);
+#else
+static __RAM_FUNC uint32_t OPENBL_FLASH_Program(uint32_t Address, uint8_t *pData, uint32_t DataLength);
+#endif /* (OPENBL_FLASH_PROGRAM_HAL == 1U) */
+static void OPENBL_FLASH_AutoErase(uint32_t Address, uint32_t DataLength);
+static void OPENBL_FLASH_EraseNext(uint32_t Wait);
+static __RAM_FUNC void OPENBL_FLASH_StartErase(uint32_t Control, uint32_t Wait);
+static ErrorStatus OPENBL_FLASH_WaitForSectors(uint32_t SectorsMask);
+static uint32_t OPENBL_FLASH_GetSectorsMask(uint32_t Address, uint32_t DataLength);
 static ErrorStatus OPENBL_FLASH_EnableWriteProtection(uint8_t *ListOfPages, uint32_t Length);
 static ErrorStatus OPENBL_FLASH_DisableWriteProtection(void);
 static void writeOB(FLASH_OBProgramInitTypeDef *flash_ob);
@@ -57,7 +79,8 @@ OPENBL_MemoryTypeDef FLASH_Descriptor =
   OPENBL_FLASH_SetWriteProtection,
   OPENBL_FLASH_JumpToAddress,
   NULL,
-  OPENBL_FLASH_Erase
+  OPENBL_FLASH_Erase,
+  OPENBL_FLASH_BlankCheck
 };
 
 /* Exported functions --------------------------------------------------------*/
@@ -96,6 +119,11 @@ void OPENBL_FLASH_OB_Unlock(void)
   */
 uint8_t OPENBL_FLASH_Read(uint32_t Address)
 {
+  if (FlashErasePending != 0U)
+  {
+    (void)OPENBL_FLASH_WaitForErase();
+  }
+
   return (*(uint8_t *)(Address));
 }
 
@@ -104,31 +132,53 @@ uint8_t OPENBL_FLASH_Read(uint32_t Address)
   * @param  Address The address where that data will be written.
   * @param  Data The data to be written.
   * @param  DataLength The length of the data to be written.
-  * @retval None.
+  * @retval Returns ERROR if the FLASH reported a programming error or the erase of a target sector
+  *         failed else SUCCESS.
   */
-void OPENBL_FLASH_Write(uint32_t Address, uint8_t *pData, uint32_t DataLength)
+ErrorStatus OPENBL_FLASH_Write(uint32_t Address, uint8_t *pData, uint32_t DataLength)
 {
-  uint32_t index  = 0U;
-  uint32_t length = DataLength;
-  uint64_t CurrentWord = 0;
+  ErrorStatus status = SUCCESS;
+
+  OpenBootloader_InvalidateImageCache();
 
-  if (length & 7U)
+  if (FlashAutoErase == ENABLE)
   {
-    length = (length & 0xFFFFFFF8U) + 4U;
+    OPENBL_FLASH_AutoErase(Address, DataLength);
   }
 
-  /* Unlock the flash memory for write operation */
-  OPENBL_FLASH_Unlock();
-  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+  /* The target sectors must be erased, the background erase stays held while programming */
+  if (OPENBL_FLASH_WaitForSectors(OPENBL_FLASH_GetSectorsMask(Address, DataLength)) != SUCCESS)
+  {
+    status = ERROR;
+  }
+  else
+  {
+    /* Unlock the flash memory for write operation */
+    OPENBL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+
+#if (OPENBL_FLASH_PROGRAM_HAL == 1U)
+    status = OPENBL_FLASH_ProgramHal(Address, pData, DataLength);
+#else
+    if (OPENBL_FLASH_Program(Address, pData, DataLength) != 0U)
+    {
+      status = ERROR;
+    }
+#endif /* (OPENBL_FLASH_PROGRAM_HAL == 1U) */
 
-  for (index = 0U; index < length; (index += 8U))
-  { 
-    CurrentWord = (uint64_t)(*((uint64_t *)((uint32_t)pData + index)));
-    OPENBL_WriteDoubleWord(Address + index, CurrentWord);
+    /* Lock the Flash to disable the flash control register access */
+    OPENBL_FLASH_Lock();
   }
 
-  /* Lock the Flash to disable the flash control register access */
-  OPENBL_FLASH_Lock();
+  /* Erase the next pending sector while the host sends the following data */
+  FlashEraseHold = 0U;
+
+  if (FlashErasePending != 0U)
+  {
+    OPENBL_FLASH_EraseNext(0U);
+  }
+
+  return status;
 }
 
 /**
@@ -228,17 +278,31 @@ ErrorStatus OPENBL_FLASH_SetWriteProtection(FunctionalState State, uint8_t *pLis
   */
 ErrorStatus OPENBL_FLASH_MassErase(uint8_t *p_Data, uint32_t DataLength)
 {
-  OPENBL_FLASH_Unlock();
   ErrorStatus status = SUCCESS;
-  uint32_t error = 0;
-  FLASH_EraseInitTypeDef flash_er;
+
+  OpenBootloader_InvalidateImageCache();
+
+  (void)OPENBL_FLASH_WaitForErase();
+  OPENBL_FLASH_Unlock();
   __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
 
-  flash_er.TypeErase = FLASH_TYPEERASE_MASSERASE;
-  flash_er.Banks = FLASH_BANK_1;
-  flash_er.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+  /* Wait from RAM so the busy bytes are still sent, the tick interrupt runs from FLASH */
+  HAL_SuspendTick();
+  OPENBL_FLASH_StartErase(FLASH_PSIZE_WORD | FLASH_CR_MER, 1U);
+  HAL_ResumeTick();
+
+  CLEAR_BIT(FLASH->CR, FLASH_CR_MER);
+  FLASH_FlushCaches();
+
+  if ((FLASH->SR & FLASH_ERASE_ERRORS) != 0U)
+  {
+    status = ERROR;
+  }
+  else
+  {
+    FlashEraseFailed = 0U;
+  }
 
-  status = HAL_FLASHEx_Erase(&flash_er, &error); 
   OPENBL_FLASH_Lock();
   return status;
 
@@ -246,37 +310,756 @@ ErrorStatus OPENBL_FLASH_MassErase(uint8_t *p_Data, uint32_t DataLength)
 
 /**
   * @brief  This function is used to erase the specified FLASH pages.
+  *         The sectors to erase are queued and erased one after the other by the FLASH interrupt, the
+  *         function returns once the first erase is started unless OPENBL_BACKGROUND_ERASE is 0.
+  *         A failure of the previous background erase does not fail this request: it is counted by
+  *         OPENBL_FLASH_GetEraseErrors() and its sectors are refused to the writes until erased again.
+  *         Nothing is erased when one sector of the list does not exist or holds the bootloader.
   * @param  *p_Data Pointer to the buffer that contains erase operation options.
   * @param  DataLength Size of the Data buffer.
   * @retval An ErrorStatus enumeration value:
-  *          - SUCCESS: Erase operation done
+  *          - SUCCESS: Erase operation started
   *          - ERROR:   Erase operation failed or the value of one parameter is not OK
   */
 ErrorStatus OPENBL_FLASH_Erase(uint8_t *p_Data, uint32_t DataLength)
 {
-  OPENBL_FLASH_Unlock();
+  ErrorStatus status = SUCCESS;
+  ErrorStatus list_status = SUCCESS;
+  uint32_t nr_of_sectors;
+  uint32_t sector;
+  uint32_t address;
+  uint32_t size;
+  uint32_t index;
+  uint32_t pending = 0U;
+
+  /* Complete the previous erase request first, its failure belongs to it */
+  (void)OPENBL_FLASH_WaitForErase();
+
+  /* The buffer holds the number of sectors then each sector number, 2 bytes LSB first */
+  nr_of_sectors = (uint32_t)p_Data[0] | ((uint32_t)p_Data[1] << 8);
+
+  if (((nr_of_sectors + 1U) * 2U) > DataLength)
+  {
+    list_status = ERROR;
+  }
+  else
+  {
+    /* The whole list is checked first, nothing is erased if one sector is invalid or protected */
+    for (index = 1U; index <= nr_of_sectors; index++)
+    {
+      sector = (uint32_t)p_Data[index * 2U] | ((uint32_t)p_Data[(index * 2U) + 1U] << 8);
+
+      if ((OPENBL_FLASH_GetSectorInfo(sector, &address, &size) != SUCCESS) || (address < USERPROG_START_ADDRESS))
+      {
+        list_status = ERROR;
+      }
+    }
+  }
+
+  if (list_status != SUCCESS)
+  {
+    status = ERROR;
+  }
+  else
+  {
+    for (index = 1U; index <= nr_of_sectors; index++)
+    {
+      sector = (uint32_t)p_Data[index * 2U] | ((uint32_t)p_Data[(index * 2U) + 1U] << 8);
+      (void)OPENBL_FLASH_GetSectorInfo(sector, &address, &size);
+
+      /* A sector left unerased by a failed erase is writable again once erased or found blank */
+      FlashEraseFailed &= ~(1UL << sector);
+
+      /* Already erased sectors are skipped, saving their erase time */
+      if (OPENBL_FLASH_BlankCheck(address, size) != SUCCESS)
+      {
+        pending |= (1UL << sector);
+      }
+    }
+  }
+
+  if (pending != 0U)
+  {
+    OpenBootloader_InvalidateImageCache();
+
+    FlashErasePending = pending;
+
+    HAL_NVIC_EnableIRQ(FLASH_IRQn);
+    OPENBL_FLASH_EraseNext(0U);
+
+#if (OPENBL_BACKGROUND_ERASE == 0U)
+    if (OPENBL_FLASH_WaitForErase() != SUCCESS)
+    {
+      status = ERROR;
+    }
+#endif /* (OPENBL_BACKGROUND_ERASE == 0U) */
+  }
+
+  return status;
+}
+
+/**
+  * @brief  This function is used to erase the application region only, the bootloader sectors are kept.
+  *         The sectors from USERPROG_START_ADDRESS up to the one holding the last byte of the application
+  *         are erased through OPENBL_FLASH_Erase(), so the blank ones are skipped. Without a size the
+  *         end of the application is the highest non-blank sector.
+  * @param  Size The application size in bytes from USERPROG_START_ADDRESS, 0 to find it by scanning.
+  * @retval An ErrorStatus enumeration value:
+  *          - SUCCESS: Erase operation started or nothing to erase
+  *          - ERROR:   Erase operation failed or the size does not fit in the FLASH
+  */
+ErrorStatus OPENBL_FLASH_EraseApplication(uint32_t Size)
+{
+  ErrorStatus status = SUCCESS;
+  uint8_t list[2U + (FLASH_SECTORS_NUMBER * 2U)];
+  uint32_t first_sector;
+  uint32_t end_sector;
+  uint32_t address;
+  uint32_t size;
+  uint32_t index;
+
+  (void)OPENBL_FLASH_GetSectorFromAddress(USERPROG_START_ADDRESS, &first_sector);
+
+  if (Size == 0U)
+  {
+    /* Find the sector above the highest one holding data, first_sector if all of them are blank */
+    for (end_sector = FLASH_SECTORS_NUMBER; end_sector > first_sector; end_sector--)
+    {
+      (void)OPENBL_FLASH_GetSectorInfo(end_sector - 1U, &address, &size);
+
+      if (OPENBL_FLASH_BlankCheck(address, size) != SUCCESS)
+      {
+        break;
+      }
+    }
+  }
+  else if (((USERPROG_START_ADDRESS + Size - 1U) < USERPROG_START_ADDRESS)
+           || (OPENBL_FLASH_GetSectorFromAddress(USERPROG_START_ADDRESS + Size - 1U, &end_sector) != SUCCESS))
+  {
+    status = ERROR;
+  }
+  else
+  {
+    end_sector++;
+  }
+
+  if ((status == SUCCESS) && (end_sector > first_sector))
+  {
+    /* Same list format as the Erase Memory command: number of sectors then sectors, 2 bytes LSB first */
+    list[0] = (uint8_t)(end_sector - first_sector);
+    list[1] = 0U;
+
+    for (index = 0U; index < (end_sector - first_sector); index++)
+    {
+      list[2U + (index * 2U)] = (uint8_t)(first_sector + index);
+      list[3U + (index * 2U)] = 0U;
+    }
+
+    status = OPENBL_FLASH_Erase(list, sizeof(list));
+  }
+
+  return status;
+}
+
+/**
+  * @brief  This function is used to wait for the end of the background sector erase.
+  * @retval Returns ERROR if a sector erase failed since the last call else SUCCESS.
+  */
+ErrorStatus OPENBL_FLASH_WaitForErase(void)
+{
+  ErrorStatus status = SUCCESS;
+
+  (void)OPENBL_FLASH_WaitForSectors(0xFFFFFFFFU);
+  FlashEraseHold = 0U;
+
+  if (FlashEraseError != 0U)
+  {
+    FlashEraseError = 0U;
+    status          = ERROR;
+  }
+
+  return status;
+}
+
+/**
+  * @brief  This function handles the FLASH end of operation and error interrupts of the background erase.
+  *         The erased sector is removed from the pending list and the next one is started, unless
+  *         a write is being programmed or OPENBL_FLASH_EraseYieldCallback() asks to let the command
+  *         loop run first, the FLASH is then locked until the erase resumes. An error aborts the
+  *         remaining sectors.
+  * @retval None.
+  */
+void OPENBL_FLASH_IRQHandler(void)
+{
+  if ((FLASH->SR & FLASH_ERASE_ERRORS) != 0U)
+  {
+    /* The failed sector and the remaining ones stay unerased, the writes to them are refused */
+    FlashEraseError   = 1U;
+    FlashEraseErrors++;
+    FlashEraseFailed |= FlashErasePending;
+    FlashErasePending = 0U;
+  }
+  else if ((FLASH->SR & FLASH_SR_EOP) != 0U)
+  {
+    FlashErasePending &= ~(1UL << FlashEraseSector);
+  }
+  else
+  {
+    /* Nothing to do */
+  }
+
   __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+  CLEAR_BIT(FLASH->CR, (FLASH_CR_SER | FLASH_CR_SNB | FLASH_CR_EOPIE | FLASH_CR_ERRIE));
+
+  /* Drop the cached content of the erased sector */
+  FLASH_FlushCaches();
+  FlashEraseActive = 0U;
+
+  if ((FlashErasePending == 0U)
+      || ((FlashEraseHold == 0U) && (OPENBL_FLASH_EraseYieldCallback() == RESET)))
+  {
+    OPENBL_FLASH_EraseNext(0U);
+  }
+  else
+  {
+    /* Paused, OPENBL_FLASH_ResumeErase() or the next FLASH operation starts the remaining sectors */
+    OPENBL_FLASH_Lock();
+  }
+}
+
+/**
+  * @brief  This function is used to resume a background erase paused to let the command loop run.
+  *         It is called from the main loop after each command, the FLASH stays locked while paused.
+  * @retval None.
+  */
+void OPENBL_FLASH_ResumeErase(void)
+{
+  /* No interrupt is expected while no erase is running, the state cannot change under this test */
+  if ((FlashErasePending != 0U) && (FlashEraseActive == 0U) && (FlashEraseHold == 0U))
+  {
+    OPENBL_FLASH_EraseNext(0U);
+  }
+}
+
+/**
+  * @brief  This function is used to enable the busy state, busy bytes are then sent periodically to the host.
+  *         It is used around FLASH operations lasting longer than the host timeout before an answer.
+  * @retval None.
+  */
+void OPENBL_Enable_BusyState_Flag(void)
+{
+  Flash_BusyState = FLASH_BUSY_STATE_ENABLED;
+}
+
+/**
+  * @brief  This function is used to disable the busy state, no busy byte is sent anymore.
+  * @retval None.
+  */
+void OPENBL_Disable_BusyState_Flag(void)
+{
+  Flash_BusyState = FLASH_BUSY_STATE_DISABLED;
+}
+
+/**
+  * @brief  Called by the FLASH interrupt before it starts the next sector erase.
+  *         The CPU cannot fetch from the single FLASH bank while a sector is erased, so the command
+  *         loop only runs between two erases. This function can be implemented by the interface
+  *         receiving the data to get the CPU back while the host is waiting for an answer.
+  * @retval SET to let the command loop run before the next erase, RESET to start it immediately.
+  */
+__weak FlagStatus OPENBL_FLASH_EraseYieldCallback(void)
+{
+  return RESET;
+}
+
+/**
+  * @brief  This function is used to check if a FLASH range is erased.
+  *         The range is scanned with word reads, unaligned head and tail bytes are checked one by one.
+  * @param  Address The first address of the range.
+  * @param  Length The number of bytes of the range.
+  * @retval Returns SUCCESS if all the bytes are 0xFF else ERROR.
+  */
+ErrorStatus OPENBL_FLASH_BlankCheck(uint32_t Address, uint32_t Length)
+{
   ErrorStatus status = SUCCESS;
-  uint32_t error = 0;
-  FLASH_EraseInitTypeDef flash_er;
-  uint8_t nr_of_sectors = *(p_Data);
-  uint8_t start_sector = *(p_Data);
+  uint32_t end = Address + Length;
+
+  if (FlashErasePending != 0U)
+  {
+    (void)OPENBL_FLASH_WaitForErase();
+  }
 
+  while (((Address & 3U) != 0U) && (Address < end))
+  {
+    if (*(uint8_t *)Address != 0xFFU)
+    {
+      status = ERROR;
+      break;
+    }
 
-  flash_er.TypeErase = FLASH_TYPEERASE_SECTORS;
-  flash_er.Banks = FLASH_BANK_1;
-  flash_er.NbSectors = nr_of_sectors;
-  flash_er.Sector = start_sector;
-  flash_er.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+    Address++;
+  }
+
+  while ((status == SUCCESS) && ((end - Address) >= 4U))
+  {
+    if (*(uint32_t *)Address != 0xFFFFFFFFU)
+    {
+      status = ERROR;
+      break;
+    }
+
+    Address += 4U;
+  }
+
+  while ((status == SUCCESS) && (Address < end))
+  {
+    if (*(uint8_t *)Address != 0xFFU)
+    {
+      status = ERROR;
+      break;
+    }
+
+    Address++;
+  }
+
+  return status;
+}
+
+/**
+  * @brief  This function is used to get the number of FLASH sectors.
+  * @retval Returns the number of sectors.
+  */
+uint32_t OPENBL_FLASH_GetSectorsNumber(void)
+{
+  return FLASH_SECTORS_NUMBER;
+}
+
+/**
+  * @brief  This function is used to get the start address and the size of a FLASH sector.
+  * @param  Sector The sector number.
+  * @param  pAddress Pointer to the start address of the sector.
+  * @param  pSize Pointer to the size of the sector in bytes.
+  * @retval Returns ERROR if the sector does not exist else SUCCESS.
+  */
+ErrorStatus OPENBL_FLASH_GetSectorInfo(uint32_t Sector, uint32_t *pAddress, uint32_t *pSize)
+{
+  ErrorStatus status = ERROR;
+  uint32_t address = FLASH_START_ADDRESS;
+  uint32_t index;
+
+  if (Sector < FLASH_SECTORS_NUMBER)
+  {
+    for (index = 0U; index < Sector; index++)
+    {
+      address += a_FlashSectorsSize[index];
+    }
+
+    *pAddress = address;
+    *pSize    = a_FlashSectorsSize[Sector];
+    status    = SUCCESS;
+  }
+
+  return status;
+}
+
+/**
+  * @brief  This function is used to enable or disable the auto erase write mode.
+  *         When enabled, the first write touching a user sector erases it unless it is already blank,
+  *         so the host can stream an image without a separate erase phase. Enabling it again starts
+  *         a new session in which every sector will be erased again on its first write.
+  * @param  State ENABLE or DISABLE.
+  * @retval None.
+  */
+void OPENBL_FLASH_SetAutoErase(FunctionalState State)
+{
+  FlashAutoErase         = State;
+  FlashAutoErasedSectors = 0U;
+}
+
+/**
+  * @brief  This function is used to get the FLASH write statistics.
+  * @param  pProgrammedWords Pointer to the number of words programmed since reset.
+  * @param  pSkippedWords Pointer to the number of erased value words skipped since reset.
+  * @retval None.
+  */
+void OPENBL_FLASH_GetWriteStatistics(uint32_t *pProgrammedWords, uint32_t *pSkippedWords)
+{
+  *pProgrammedWords = FlashProgrammedWords;
+  *pSkippedWords    = FlashSkippedWords;
+}
+
+/**
+  * @brief  This function is used to get the number of failed sector erases.
+  *         A background erase is answered once started, its failure is only known later: it is counted
+  *         here, for the Get Statistics command, and its sectors are refused to the writes.
+  * @retval Returns the number of sector erases that failed since reset.
+  */
+uint32_t OPENBL_FLASH_GetEraseErrors(void)
+{
+  return FlashEraseErrors;
+}
+
+/**
+  * @brief  This function is used to get the FLASH sector containing a given address.
+  * @param  Address The address.
+  * @param  pSector Pointer to the sector number.
+  * @retval Returns ERROR if the address is outside of the FLASH else SUCCESS.
+  */
+ErrorStatus OPENBL_FLASH_GetSectorFromAddress(uint32_t Address, uint32_t *pSector)
+{
+  ErrorStatus status = ERROR;
+  uint32_t end = FLASH_START_ADDRESS;
+  uint32_t sector;
+
+  if (Address >= FLASH_START_ADDRESS)
+  {
+    for (sector = 0U; sector < FLASH_SECTORS_NUMBER; sector++)
+    {
+      end += a_FlashSectorsSize[sector];
+
+      if (Address < end)
+      {
+        *pSector = sector;
+        status   = SUCCESS;
+        break;
+      }
+    }
+  }
 
-  status = HAL_FLASHEx_Erase(&flash_er, &error); 
-  OPENBL_FLASH_Lock();
   return status;
 }
 
+/**
+  * @brief  This function is used to erase one FLASH sector and wait for the end of the erase.
+  *         The sectors holding the bootloader, below USERPROG_START_ADDRESS, are never erased.
+  * @param  Sector The sector number.
+  * @retval Returns SUCCESS if the sector has been erased else ERROR.
+  */
+ErrorStatus OPENBL_FLASH_EraseSector(uint32_t Sector)
+{
+  ErrorStatus status = ERROR;
+  uint32_t address;
+  uint32_t size;
+
+  if ((OPENBL_FLASH_GetSectorInfo(Sector, &address, &size) == SUCCESS) && (address >= USERPROG_START_ADDRESS))
+  {
+    OpenBootloader_InvalidateImageCache();
+
+    /* Errors of a previous background erase are not reported for this sector */
+    (void)OPENBL_FLASH_WaitForErase();
+
+    FlashEraseFailed &= ~(1UL << Sector);
+    FlashErasePending = (1UL << Sector);
+    HAL_NVIC_EnableIRQ(FLASH_IRQn);
+
+    status = OPENBL_FLASH_WaitForErase();
+  }
+
+  return status;
+}
 
 /* Private functions ---------------------------------------------------------*/
 
+/**
+  * @brief  This function is used to start the erase of the lowest pending sector.
+  *         When no sector is pending anymore the background erase ends and the FLASH is locked.
+  *         It is called from the FLASH interrupt or from the thread while no erase is running.
+  * @param  Wait 1 to wait from RAM for the end of the erase, 0 to return once it is started.
+  * @retval None.
+  */
+static void OPENBL_FLASH_EraseNext(uint32_t Wait)
+{
+  uint32_t sector;
+  uint32_t control;
+
+  if (FlashErasePending == 0U)
+  {
+    OPENBL_FLASH_Lock();
+  }
+  else
+  {
+    sector  = __CLZ(__RBIT(FlashErasePending));
+    control = FLASH_PSIZE_WORD | FLASH_CR_SER | (sector << FLASH_CR_SNB_Pos);
+
+    OPENBL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+    SET_BIT(FLASH->CR, (FLASH_CR_EOPIE | FLASH_CR_ERRIE));
+
+    FlashEraseSector = sector;
+    FlashEraseActive = 1U;
+
+    if (Wait != 0U)
+    {
+      /* The tick interrupt runs from FLASH, it would stall the CPU until the end of the erase */
+      HAL_SuspendTick();
+      OPENBL_FLASH_StartErase(control, 1U);
+      HAL_ResumeTick();
+    }
+    else
+    {
+      OPENBL_FLASH_StartErase(control, 0U);
+    }
+  }
+}
+
+/**
+  * @brief  This function is used to wait until none of the given sectors is pending erase.
+  *         The background erase is held and the remaining sectors are erased from here, waiting
+  *         from RAM so the busy bytes are still sent. It returns with the background erase held.
+  * @param  SectorsMask Bit n set to wait for sector n.
+  * @retval Returns ERROR if one of the sectors was left unerased by a failed erase else SUCCESS.
+  */
+static ErrorStatus OPENBL_FLASH_WaitForSectors(uint32_t SectorsMask)
+{
+  FlashEraseHold = 1U;
+
+  /* An erase started by the FLASH interrupt completes first */
+  while (FlashEraseActive != 0U)
+  {
+  }
+
+  while ((FlashErasePending & SectorsMask) != 0U)
+  {
+    OPENBL_FLASH_EraseNext(1U);
+  }
+
+  return ((FlashEraseFailed & SectorsMask) != 0U) ? ERROR : SUCCESS;
+}
+
+/**
+  * @brief  This function is used to start a FLASH erase operation.
+  *         It runs from RAM so that, while waiting, the interrupts whose vector and handler are in RAM
+  *         are still served although the FLASH cannot be read. The FLASH must be unlocked by the caller.
+  * @param  Control The PSIZE, SER, SNB and MER bits of the operation.
+  * @param  Wait 1 to return at the end of the operation, 0 to return once it is started.
+  * @retval None.
+  */
+static __RAM_FUNC void OPENBL_FLASH_StartErase(uint32_t Control, uint32_t Wait)
+{
+  MODIFY_REG(FLASH->CR, (FLASH_CR_PSIZE | FLASH_CR_SER | FLASH_CR_SNB | FLASH_CR_MER), Control);
+  SET_BIT(FLASH->CR, FLASH_CR_STRT);
+
+  if (Wait != 0U)
+  {
+    while ((FLASH->SR & FLASH_SR_BSY) != 0U)
+    {
+    }
+  }
+}
+
+/**
+  * @brief  This function is used to get the sectors touched by a FLASH range.
+  * @param  Address The first address of the range.
+  * @param  DataLength The number of bytes of the range.
+  * @retval Returns a mask with bit n set for each sector n of the range, all bits if the range is not in FLASH.
+  */
+static uint32_t OPENBL_FLASH_GetSectorsMask(uint32_t Address, uint32_t DataLength)
+{
+  uint32_t mask = 0xFFFFFFFFU;
+  uint32_t sector;
+  uint32_t last_sector;
+
+  if ((DataLength != 0U)
+      && (OPENBL_FLASH_GetSectorFromAddress(Address, &sector) == SUCCESS)
+      && (OPENBL_FLASH_GetSectorFromAddress(Address + DataLength - 1U, &last_sector) == SUCCESS))
+  {
+    mask = 0U;
+
+    for (; sector <= last_sector; sector++)
+    {
+      mask |= (1UL << sector);
+    }
+  }
+
+  return mask;
+}
+
+/**
+  * @brief  This function is used to erase the user sectors touched by a write for the first time.
+  * @param  Address The address where the data will be written.
+  * @param  DataLength The length of the data to be written.
+  * @retval None.
+  */
+static void OPENBL_FLASH_AutoErase(uint32_t Address, uint32_t DataLength)
+{
+  uint32_t sector;
+  uint32_t last_sector;
+  uint32_t address;
+  uint32_t size;
+
+  if ((DataLength != 0U)
+      && (OPENBL_FLASH_GetSectorFromAddress(Address, &sector) == SUCCESS)
+      && (OPENBL_FLASH_GetSectorFromAddress(Address + DataLength - 1U, &last_sector) == SUCCESS))
+  {
+    for (; sector <= last_sector; sector++)
+    {
+      if ((FlashAutoErasedSectors & (1UL << sector)) == 0U)
+      {
+        (void)OPENBL_FLASH_GetSectorInfo(sector, &address, &size);
+
+        /* The bootloader sectors are never erased, they are only marked as handled */
+        if ((address >= USERPROG_START_ADDRESS) && (OPENBL_FLASH_BlankCheck(address, size) != SUCCESS))
+        {
+          (void)OPENBL_FLASH_EraseSector(sector);
+        }
+
+        FlashAutoErasedSectors |= (1UL << sector);
+      }
+    }
+  }
+}
+
+#if (OPENBL_FLASH_PROGRAM_HAL == 0U)
+/**
+  * @brief  This function is used to program a buffer in FLASH through the FLASH registers.
+  *         It runs from RAM so the CPU keeps executing while the FLASH is busy, the FLASH must be
+  *         unlocked and its error flags cleared by the caller. Leading bytes up to the first word
+  *         boundary are programmed by byte, then the data is programmed by word with a trailing
+  *         partial word padded with 0xFF. The errors are only checked once at the end.
+  *         With OPENBL_SKIP_ERASED_WORDS, words equal to 0xFFFFFFFF are skipped: programming the erased
+  *         value cannot change any bit, so the result is the same without the programming time.
+  * @param  Address The address where the data will be written.
+  * @param  pData Pointer to the data to be written, no alignment is required.
+  * @param  DataLength The length of the data to be written.
+  * @retval Returns the FLASH error flags, 0 if the programming succeeded.
+  */
+static __RAM_FUNC uint32_t OPENBL_FLASH_Program(uint32_t Address, uint8_t *pData, uint32_t DataLength)
+{
+  uint32_t word;
+  uint32_t index;
+
+  while ((FLASH->SR & FLASH_SR_BSY) != 0U)
+  {
+  }
+
+  /* Byte programming up to the first word boundary */
+  MODIFY_REG(FLASH->CR, FLASH_CR_PSIZE, 0U);
+  SET_BIT(FLASH->CR, FLASH_CR_PG);
+
+  while (((Address & 3U) != 0U) && (DataLength != 0U))
+  {
+    *(__IO uint8_t *)Address = *pData;
+
+    while ((FLASH->SR & FLASH_SR_BSY) != 0U)
+    {
+    }
+
+    Address++;
+    pData++;
+    DataLength--;
+  }
+
+  /* Word programming for the remaining data */
+  MODIFY_REG(FLASH->CR, FLASH_CR_PSIZE, FLASH_PSIZE_WORD);
+
+  while (DataLength != 0U)
+  {
+    if (DataLength >= 4U)
+    {
+      word        = __UNALIGNED_UINT32_READ(pData);
+      pData      += 4U;
+      DataLength -= 4U;
+    }
+    else
+    {
+      word = 0xFFFFFFFFU;
+
+      for (index = 0U; index < DataLength; index++)
+      {
+        word &= ~((uint32_t)0xFFU << (index * 8U));
+        word |= (uint32_t)pData[index] << (index * 8U);
+      }
+
+      DataLength = 0U;
+    }
+
+#if (OPENBL_SKIP_ERASED_WORDS == 1U)
+    if (word == 0xFFFFFFFFU)
+    {
+      FlashSkippedWords++;
+      Address += 4U;
+      continue;
+    }
+#endif /* (OPENBL_SKIP_ERASED_WORDS == 1U) */
+
+    *(__IO uint32_t *)Address = word;
+    Address += 4U;
+    FlashProgrammedWords++;
+
+    while ((FLASH->SR & FLASH_SR_BSY) != 0U)
+    {
+    }
+  }
+
+  CLEAR_BIT(FLASH->CR, FLASH_CR_PG);
+
+  return (FLASH->SR & FLASH_PROGRAM_ERRORS);
+}
+#endif /* (OPENBL_FLASH_PROGRAM_HAL == 0U) */
+
+#if (OPENBL_FLASH_PROGRAM_HAL == 1U)
+/**
+  * @brief  This function is used to program a buffer in FLASH through HAL_FLASH_Program().
+  *         It is the write path OPENBL_FLASH_Program() replaced, one HAL call per word running from FLASH,
+  *         kept to compare both with the OPENBL_PROFILING cycle counts of the memory writes. The data is
+  *         split as OPENBL_FLASH_Program() does, erased words are programmed too.
+  * @param  Address The address where the data will be written.
+  * @param  pData Pointer to the data to be written, no alignment is required.
+  * @param  DataLength The length of the data to be written.
+  * @retval Returns ERROR at the first failed HAL call else SUCCESS.
+  */
+static ErrorStatus OPENBL_FLASH_ProgramHal(uint32_t Address, uint8_t *pData, uint32_t DataLength)
+{
+  ErrorStatus status = SUCCESS;
+  uint32_t word;
+  uint32_t index;
+
+  while (((Address & 3U) != 0U) && (DataLength != 0U) && (status == SUCCESS))
+  {
+    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_BYTE, Address, *pData) != HAL_OK)
+    {
+      status = ERROR;
+    }
+
+    Address++;
+    pData++;
+    DataLength--;
+  }
+
+  while ((DataLength != 0U) && (status == SUCCESS))
+  {
+    if (DataLength >= 4U)
+    {
+      word        = __UNALIGNED_UINT32_READ(pData);
+      pData      += 4U;
+      DataLength -= 4U;
+    }
+    else
+    {
+      word = 0xFFFFFFFFU;
+
+      for (index = 0U; index < DataLength; index++)
+      {
+        word &= ~((uint32_t)0xFFU << (index * 8U));
+        word |= (uint32_t)pData[index] << (index * 8U);
+      }
+
+      DataLength = 0U;
+    }
+
+    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, Address, word) != HAL_OK)
+    {
+      status = ERROR;
+    }
+
+    Address += 4U;
+    FlashProgrammedWords++;
+  }
+
+  return status;
+}
+#endif /* (OPENBL_FLASH_PROGRAM_HAL == 1U) */
+
 /**
   * @brief  This function is used to enable write protection of the specified FLASH areas.
   * @param  ListOfPages Contains the list of pages to be protected.
@@ -292,6 +1075,8 @@ static ErrorStatus OPENBL_FLASH_EnableWriteProtection(uint8_t *pListOfPages, uin
   ErrorStatus status       = SUCCESS;
   FLASH_OBProgramInitTypeDef flash_ob;
 
+  (void)OPENBL_FLASH_WaitForErase();
+
   /* Unlock the FLASH registers & Option Bytes registers access */
   OPENBL_FLASH_OB_Unlock();
 
@@ -366,6 +1151,7 @@ static ErrorStatus OPENBL_FLASH_DisableWriteProtection(void)
 
 static void writeOB(FLASH_OBProgramInitTypeDef *flash_ob)
 {
+  (void)OPENBL_FLASH_WaitForErase();
   OPENBL_FLASH_Unlock();
   HAL_FLASH_OB_Unlock();
   /* set the Option bytes configuration */
@@ -32,22 +32,38 @@ extern "C" {
 #define FLASH_BUSY_STATE_ENABLED       ((uint32_t)0xAAAA0000)
 #define FLASH_BUSY_STATE_DISABLED      ((uint32_t)0x0000DDDD)
 #define PROGRAM_TIMEOUT                ((uint32_t)0x00FFFFFF)
+#define FLASH_SECTORS_NUMBER           8U   /* 4 x 16 KB, 1 x 64 KB and 3 x 128 KB sectors */
 
 /* Exported macro ------------------------------------------------------------*/
 #define FLASH_FLAG_ALL_ERRORS (FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR| FLASH_FLAG_PGAERR | \
                                FLASH_FLAG_PGPERR| FLASH_FLAG_PGSERR | FLASH_FLAG_RDERR )
+#define FLASH_PROGRAM_ERRORS  (FLASH_SR_SOP | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR)
+#define FLASH_ERASE_ERRORS    FLASH_PROGRAM_ERRORS  /* A sector erase reports the same error flags */
 /* Exported functions ------------------------------------------------------- */
 void OPENBL_FLASH_JumpToAddress(uint32_t Address);
 void OPENBL_FLASH_Lock(void);
 void OPENBL_FLASH_OB_Unlock(void);
 uint8_t OPENBL_FLASH_Read(uint32_t Address);
 void OPENBL_FLASH_SetReadOutProtectionLevel(uint32_t Level);
-void OPENBL_FLASH_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength);
+ErrorStatus OPENBL_FLASH_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength);
 void OPENBL_FLASH_Unlock(void);
 ErrorStatus OPENBL_FLASH_MassErase(uint8_t *p_Data, uint32_t DataLength);
 ErrorStatus OPENBL_FLASH_Erase(uint8_t *p_Data, uint32_t DataLength);
+ErrorStatus OPENBL_FLASH_BlankCheck(uint32_t Address, uint32_t Length);
 ErrorStatus OPENBL_FLASH_SetWriteProtection(FunctionalState State, uint8_t *ListOfPages, uint32_t Length);
 uint32_t OPENBL_FLASH_GetReadOutProtectionLevel(void);
+uint32_t OPENBL_FLASH_GetSectorsNumber(void);
+ErrorStatus OPENBL_FLASH_GetSectorInfo(uint32_t Sector, uint32_t *pAddress, uint32_t *pSize);
+void OPENBL_FLASH_SetAutoErase(FunctionalState State);
+void OPENBL_FLASH_GetWriteStatistics(uint32_t *pProgrammedWords, uint32_t *pSkippedWords);
+uint32_t OPENBL_FLASH_GetEraseErrors(void);
+ErrorStatus OPENBL_FLASH_GetSectorFromAddress(uint32_t Address, uint32_t *pSector);
+ErrorStatus OPENBL_FLASH_EraseSector(uint32_t Sector);
+ErrorStatus OPENBL_FLASH_EraseApplication(uint32_t Size);
+ErrorStatus OPENBL_FLASH_WaitForErase(void);
+void OPENBL_FLASH_ResumeErase(void);
+void OPENBL_FLASH_IRQHandler(void);
+FlagStatus OPENBL_FLASH_EraseYieldCallback(void);
 void OPENBL_Enable_BusyState_Flag(void);
 void OPENBL_Disable_BusyState_Flag(void);
 
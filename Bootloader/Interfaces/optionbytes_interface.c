@@ -42,6 +42,7 @@ OPENBL_MemoryTypeDef OB_Descriptor =
   NULL,
   NULL,
   NULL,
+  NULL,
   NULL
 };
 
@@ -78,9 +79,9 @@ void BL_FLASH_WriteOptKeys(void)
   * @param  Address The address where that data will be written.
   * @param  Data The data to be written.
   * @param  DataLength The length of the data to be written.
-  * @retval None.
+  * @retval Returns ERROR if the option bytes could not be loaded else SUCCESS.
   */
-void OPENBL_OB_Write(uint32_t Address, uint8_t *pData, uint32_t length)
+ErrorStatus OPENBL_OB_Write(uint32_t Address, uint8_t *pData, uint32_t length)
 {
   /* The actual data send by the CubeProgrammer is somethink like this
     0x ef aa 10 55 ef aa 10 55 7f 3f 00 c0 ff 3f 00 c0
@@ -95,6 +96,7 @@ void OPENBL_OB_Write(uint32_t Address, uint8_t *pData, uint32_t length)
 
   */
   __IO uint8_t *pOBBase;
+  ErrorStatus status = SUCCESS;
   uint16_t dataLength = length / 8; // length is in bytes, STM cube programmer always sends 6t4 bit doublewords
   /* Unlock the FLASH & Option Bytes Registers access */
   HAL_FLASH_OB_Unlock();
@@ -113,6 +115,12 @@ void OPENBL_OB_Write(uint32_t Address, uint8_t *pData, uint32_t length)
    }
 #endif
 
-  HAL_FLASH_OB_Launch();
+  if (HAL_FLASH_OB_Launch() != HAL_OK)
+  {
+    status = ERROR;
+  }
+
   HAL_FLASH_OB_Lock();
+
+  return status;
 }
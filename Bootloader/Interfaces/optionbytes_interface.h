@@ -30,7 +30,7 @@ extern "C" {
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 uint8_t OPENBL_OB_Read(uint32_t Address);
-void OPENBL_OB_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength);
+ErrorStatus OPENBL_OB_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength);
 void OPENBL_OB_Launch(void);
 
 #ifdef __cplusplus
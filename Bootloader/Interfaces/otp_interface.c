@@ -42,6 +42,7 @@ OPENBL_MemoryTypeDef OTP_Descriptor =
   NULL,
   NULL,
   NULL,
+  NULL,
   NULL
 };
 
@@ -62,14 +63,16 @@ uint8_t OPENBL_OTP_Read(uint32_t Address)
   * @param  Address The address where that data will be written.
   * @param  Data The data to be written.
   * @param  DataLength The length of the data to be written.
-  * @retval None.
+  * @retval Returns ERROR, writing the OTP is not supported yet.
   */
-void OPENBL_OTP_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength)
+ErrorStatus OPENBL_OTP_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength)
 {
   // TODO
   (void) Address;
   (void) Data;
   (void) DataLength;
+
+  return ERROR;
 }
 
 /* Private functions ---------------------------------------------------------*/
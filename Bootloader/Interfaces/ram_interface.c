@@ -42,6 +42,7 @@ OPENBL_MemoryTypeDef RAM_Descriptor =
   NULL,
   OPENBL_RAM_JumpToAddress,
   NULL,
+  NULL,
   NULL
 };
 
@@ -62,22 +63,28 @@ uint8_t OPENBL_RAM_Read(uint32_t Address)
   * @param  Address The address where that data will be written.
   * @param  pData The data to be written.
   * @param  DataLength The length of the data to be written.
-  * @retval None.
+  *         Exactly DataLength bytes are written, a write may end at the last byte of the RAM.
+  * @retval Returns SUCCESS, a RAM write cannot fail.
   */
-void OPENBL_RAM_Write(uint32_t Address, uint8_t *pData, uint32_t DataLength)
+ErrorStatus OPENBL_RAM_Write(uint32_t Address, uint8_t *pData, uint32_t DataLength)
 {
-  uint32_t index          = 0U;
-  uint32_t aligned_length = DataLength;
+  uint32_t index = 0U;
 
-  if (aligned_length & 0x3)
+  /* Whole words when the destination is aligned, the remaining bytes one by one */
+  if ((Address & 0x3U) == 0U)
   {
-    aligned_length = (aligned_length & 0xFCU) + 4U;
+    for (; (index + 4U) <= DataLength; index += 4U)
+    {
+      *(__IO uint32_t *)(Address + index) = *(__IO uint32_t *)(pData + index);
+    }
   }
 
-  for (index = 0U; index < aligned_length; index += 4U)
+  for (; index < DataLength; index++)
   {
-    *(__IO uint32_t *)(Address + index) = *(__IO uint32_t *)(pData + index);
+    *(__IO uint8_t *)(Address + index) = pData[index];
   }
+
+  return SUCCESS;
 }
 
 /**
@@ -41,6 +41,7 @@ OPENBL_MemoryTypeDef ICP1_Descriptor =
   NULL,
   NULL,
   NULL,
+  NULL,
   NULL
 };
 
@@ -56,6 +57,7 @@ OPENBL_MemoryTypeDef ICP2_Descriptor =
   NULL,
   NULL,
   NULL,
+  NULL,
   NULL
 };
 
@@ -71,6 +73,7 @@ OPENBL_MemoryTypeDef ICP3_Descriptor =
   NULL,
   NULL,
   NULL,
+  NULL,
   NULL
 };
 
@@ -17,21 +17,42 @@
   */
 
 /* Includes ------------------------------------------------------------------*/
+#include <string.h>
 #include "platform.h"
 #include "interfaces_conf.h"
 #include "openbl_core.h"
 #include "openbl_usart_cmd.h"
 #include "usart_interface.h"
 #include "iwdg_interface.h"
+#include "flash_interface.h"
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 static uint8_t UsartDetected = 0U;
+static uint8_t UsartRxRing[USARTx_RX_RING_SIZE];    /* Circular buffer filled by the RX DMA stream */
+static volatile uint32_t UsartTxActive = 0U;       /* Set while the main loop sends, the busy timer leaves the USART alone */
+static uint32_t UsartRxTail = 0U;                   /* Index of the next byte to be read from the ring */
+static uint8_t UsartOpcode = ERROR_COMMAND;         /* Opcode of the command being processed */
+static OPENBL_USART_LinkStatisticsTypeDef UsartStatistics;          /* Reception errors since reset */
+static uint32_t UsartNacks[OPENBL_COMMANDS_NUMBER];                 /* NACK sent by each command since reset */
 UART_HandleTypeDef huart2;
 /* Exported variables --------------------------------------------------------*/
+/* External variables --------------------------------------------------------*/
+extern volatile uint32_t Flash_BusyState;
+
 /* Private function prototypes -----------------------------------------------*/
 static void OPENBL_USART_Init(void);
+static void OPENBL_USART_DMA_Init(void);
+static void OPENBL_USART_DMA_StartRx(void);
+static void OPENBL_USART_CheckErrors(void);
+static ErrorStatus OPENBL_USART_ComputeBrr(uint32_t BaudRate, uint32_t *pBrr, uint32_t *pOverSampling);
+static void OPENBL_USART_AutoBaud_Start(void);
+static void OPENBL_USART_AutoBaud_Stop(void);
+static uint32_t OPENBL_USART_AutoBaud_GetTimerClock(void);
+static uint32_t OPENBL_USART_AutoBaud_ComputeBaudRate(uint32_t Ticks, uint32_t TimerClock);
+static ErrorStatus OPENBL_USART_AutoBaud_Measure(uint32_t *pBaudRate);
+static void OPENBL_USART_Busy_Init(void);
 
 /* Private functions ---------------------------------------------------------*/
 
@@ -42,7 +63,7 @@ static void OPENBL_USART_Init(void);
 static void OPENBL_USART_Init(void)
 {
   huart2.Instance = USART2;
-  huart2.Init.BaudRate = 115200;
+  huart2.Init.BaudRate = USARTx_BAUDRATE;
   huart2.Init.WordLength = UART_WORDLENGTH_9B;
   huart2.Init.StopBits = UART_STOPBITS_1;
   huart2.Init.Parity = UART_PARITY_EVEN;
@@ -55,6 +76,321 @@ static void OPENBL_USART_Init(void)
   }
 }
 
+/**
+ * @brief  This function is used to start the reception of the USART in to the circular DMA buffer.
+ *         Once started, received bytes land in UsartRxRing without any CPU intervention.
+ * @retval None.
+ */
+static void OPENBL_USART_DMA_Init(void)
+{
+  USARTx_DMA_CLK_ENABLE();
+
+  OPENBL_USART_DMA_StartRx();
+
+  /* The TX stream is configured once, each transfer only sets the buffer address and length */
+  LL_DMA_DisableStream(USARTx_DMA, USARTx_TX_DMA_STREAM);
+
+  while (LL_DMA_IsEnabledStream(USARTx_DMA, USARTx_TX_DMA_STREAM) != 0U)
+  {
+  }
+
+  LL_DMA_SetChannelSelection(USARTx_DMA, USARTx_TX_DMA_STREAM, USARTx_TX_DMA_CHANNEL);
+  LL_DMA_ConfigTransfer(USARTx_DMA, USARTx_TX_DMA_STREAM,
+                        LL_DMA_DIRECTION_MEMORY_TO_PERIPH | LL_DMA_MODE_NORMAL |
+                        LL_DMA_PERIPH_NOINCREMENT | LL_DMA_MEMORY_INCREMENT |
+                        LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE | LL_DMA_PRIORITY_HIGH);
+  LL_DMA_DisableFifoMode(USARTx_DMA, USARTx_TX_DMA_STREAM);
+  LL_DMA_SetPeriphAddress(USARTx_DMA, USARTx_TX_DMA_STREAM, LL_USART_DMA_GetRegAddr(USARTx));
+
+  LL_USART_EnableDMAReq_TX(USARTx);
+
+  /* The reception errors are counted by the USART interrupt, see OPENBL_USART_IRQHandler() */
+  LL_USART_EnableIT_ERROR(USARTx);
+  LL_USART_EnableIT_PE(USARTx);
+
+  HAL_NVIC_SetPriority(USARTx_IRQn, 1U, 0U);
+  HAL_NVIC_EnableIRQ(USARTx_IRQn);
+}
+
+/**
+ * @brief  This function is used to (re)start the RX DMA stream on an empty ring.
+ * @retval None.
+ */
+static void OPENBL_USART_DMA_StartRx(void)
+{
+  LL_DMA_DisableStream(USARTx_DMA, USARTx_RX_DMA_STREAM);
+
+  while (LL_DMA_IsEnabledStream(USARTx_DMA, USARTx_RX_DMA_STREAM) != 0U)
+  {
+  }
+
+  LL_DMA_SetChannelSelection(USARTx_DMA, USARTx_RX_DMA_STREAM, USARTx_RX_DMA_CHANNEL);
+  LL_DMA_ConfigTransfer(USARTx_DMA, USARTx_RX_DMA_STREAM,
+                        LL_DMA_DIRECTION_PERIPH_TO_MEMORY | LL_DMA_MODE_CIRCULAR |
+                        LL_DMA_PERIPH_NOINCREMENT | LL_DMA_MEMORY_INCREMENT |
+                        LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE | LL_DMA_PRIORITY_VERYHIGH);
+  LL_DMA_DisableFifoMode(USARTx_DMA, USARTx_RX_DMA_STREAM);
+  LL_DMA_ConfigAddresses(USARTx_DMA, USARTx_RX_DMA_STREAM, LL_USART_DMA_GetRegAddr(USARTx),
+                         (uint32_t)UsartRxRing, LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+  LL_DMA_SetDataLength(USARTx_DMA, USARTx_RX_DMA_STREAM, USARTx_RX_RING_SIZE);
+
+  USARTx_RX_DMA_CLEAR_FLAGS();
+  UsartRxTail = 0U;
+
+  LL_DMA_EnableStream(USARTx_DMA, USARTx_RX_DMA_STREAM);
+  LL_USART_EnableDMAReq_RX(USARTx);
+}
+
+/**
+ * @brief  This function is used to get the number of received bytes not yet read from the ring.
+ * @retval Returns the number of pending bytes.
+ */
+uint32_t OPENBL_USART_GetRxCount(void)
+{
+  uint32_t head;
+
+  /* The DMA counts down from the ring size, the write index is the number of bytes already transferred */
+  head = USARTx_RX_RING_SIZE - LL_DMA_GetDataLength(USARTx_DMA, USARTx_RX_DMA_STREAM);
+
+  return (head - UsartRxTail) & (USARTx_RX_RING_SIZE - 1U);
+}
+
+/**
+ * @brief  This function is used to unmask the USART error interrupt and restart the RX DMA stream.
+ *         The error interrupt is masked by OPENBL_USART_IRQHandler() until the RX DMA stream has read the
+ *         data register, which clears the error flags: it is unmasked once they read as cleared.
+ *         A DMA transfer error disables the RX stream, it is restarted on an empty ring.
+ *         The data register is never read by the CPU, so no received byte can be taken from the ring.
+ * @retval None.
+ */
+static void OPENBL_USART_CheckErrors(void)
+{
+  if ((NVIC_GetEnableIRQ(USARTx_IRQn) == 0U)
+      && ((READ_REG(USARTx->SR) & (USART_SR_ORE | USART_SR_FE | USART_SR_NE | USART_SR_PE)) == 0U))
+  {
+    NVIC_ClearPendingIRQ(USARTx_IRQn);
+    NVIC_EnableIRQ(USARTx_IRQn);
+  }
+
+  if (LL_DMA_IsEnabledStream(USARTx_DMA, USARTx_RX_DMA_STREAM) == 0U)
+  {
+    UsartStatistics.DmaRestarts++;
+
+    OPENBL_USART_DMA_StartRx();
+  }
+}
+
+/**
+ * @brief  This function is used to compute the BRR register value for a given baudrate from the actual PCLK1.
+ *         Oversampling by 16 is used whenever possible, oversampling by 8 is used above PCLK1 / 16.
+ * @param  BaudRate The requested baudrate.
+ * @param  pBrr Pointer to the computed BRR value.
+ * @param  pOverSampling Pointer to the oversampling mode to be used with the BRR value.
+ * @retval Returns ERROR if the baudrate cannot be reached within USARTx_BAUDRATE_TOLERANCE else SUCCESS.
+ */
+static ErrorStatus OPENBL_USART_ComputeBrr(uint32_t BaudRate, uint32_t *pBrr, uint32_t *pOverSampling)
+{
+  ErrorStatus status = SUCCESS;
+  uint32_t pclk;
+  uint32_t divider;
+  uint32_t actual;
+  uint32_t deviation;
+
+  pclk = HAL_RCC_GetPCLK1Freq();
+
+  if (BaudRate == 0U)
+  {
+    status = ERROR;
+  }
+  else
+  {
+    /* Divider expressed in 1/16 (OVER16) or 1/8 (OVER8) of the USARTDIV value, rounded to the nearest */
+    divider = (pclk + (BaudRate / 2U)) / BaudRate;
+
+    if ((divider >= 16U) && (divider <= 0xFFFFU))
+    {
+      *pOverSampling = LL_USART_OVERSAMPLING_16;
+      *pBrr          = divider;
+    }
+    else if ((divider >= 8U) && (divider < 16U))
+    {
+      *pOverSampling = LL_USART_OVERSAMPLING_8;
+      *pBrr          = ((divider >> 3U) << 4U) | (divider & 0x7U);
+    }
+    else
+    {
+      status = ERROR;
+    }
+
+    if (status == SUCCESS)
+    {
+      actual    = pclk / divider;
+      deviation = (actual > BaudRate) ? (actual - BaudRate) : (BaudRate - actual);
+
+      if ((deviation * 100U) > (BaudRate * USARTx_BAUDRATE_TOLERANCE))
+      {
+        status = ERROR;
+      }
+    }
+  }
+
+  return status;
+}
+
+/**
+ * @brief  This function is used to route the RX pin to the timer input capture and to arm the capture.
+ *         Falling edges are captured on a free running 32-bit counter clocked at the timer kernel clock.
+ * @retval None.
+ */
+static void OPENBL_USART_AutoBaud_Start(void)
+{
+  USARTx_AUTOBAUD_TIM_CLK_ENABLE();
+
+  LL_TIM_DisableCounter(USARTx_AUTOBAUD_TIM);
+  LL_TIM_SetPrescaler(USARTx_AUTOBAUD_TIM, 0U);
+  LL_TIM_SetAutoReload(USARTx_AUTOBAUD_TIM, 0xFFFFFFFFU);
+  LL_TIM_SetCounterMode(USARTx_AUTOBAUD_TIM, LL_TIM_COUNTERMODE_UP);
+
+  LL_TIM_IC_Config(USARTx_AUTOBAUD_TIM, USARTx_AUTOBAUD_TIM_CHANNEL,
+                   LL_TIM_ACTIVEINPUT_DIRECTTI | LL_TIM_ICPSC_DIV1 | LL_TIM_IC_FILTER_FDIV1 |
+                   LL_TIM_IC_POLARITY_FALLING);
+  LL_TIM_CC_EnableChannel(USARTx_AUTOBAUD_TIM, USARTx_AUTOBAUD_TIM_CHANNEL);
+
+  LL_TIM_GenerateEvent_UPDATE(USARTx_AUTOBAUD_TIM);
+  USARTx_AUTOBAUD_CLEAR_FLAGS();
+  LL_TIM_EnableCounter(USARTx_AUTOBAUD_TIM);
+
+  LL_GPIO_SetAFPin_0_7(USARTx_RX_GPIO_PORT, USARTx_RX_PIN, USARTx_RX_AUTOBAUD_AF);
+}
+
+/**
+ * @brief  This function is used to give the RX pin back to the USART and to release the timer.
+ * @retval None.
+ */
+static void OPENBL_USART_AutoBaud_Stop(void)
+{
+  LL_GPIO_SetAFPin_0_7(USARTx_RX_GPIO_PORT, USARTx_RX_PIN, USARTx_RX_AF);
+
+  LL_TIM_DisableCounter(USARTx_AUTOBAUD_TIM);
+  LL_TIM_CC_DisableChannel(USARTx_AUTOBAUD_TIM, USARTx_AUTOBAUD_TIM_CHANNEL);
+  USARTx_AUTOBAUD_TIM_CLK_DISABLE();
+}
+
+/**
+ * @brief  This function is used to get the kernel clock of the timer used for the baudrate measurement.
+ *         APB1 timers run at twice PCLK1 as soon as the APB1 prescaler is not 1.
+ * @retval Returns the timer clock frequency in Hz.
+ */
+static uint32_t OPENBL_USART_AutoBaud_GetTimerClock(void)
+{
+  uint32_t clock;
+
+  clock = HAL_RCC_GetPCLK1Freq();
+
+  if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_HCLK_DIV1)
+  {
+    clock *= 2U;
+  }
+
+  return clock;
+}
+
+/**
+ * @brief  This function is used to convert the measured duration of the sync byte into a baudrate.
+ *         For 0x7F sent LSB first the start bit and the MSB are the only low bits, so the two falling
+ *         edges of the frame are exactly 8 bit times apart, with or without a parity bit.
+ * @param  Ticks Number of timer ticks between the two falling edges.
+ * @param  TimerClock The timer clock frequency in Hz.
+ * @retval Returns the baudrate rounded to the nearest integer, 0 if Ticks is 0.
+ */
+static uint32_t OPENBL_USART_AutoBaud_ComputeBaudRate(uint32_t Ticks, uint32_t TimerClock)
+{
+  uint32_t baudrate = 0U;
+
+  if (Ticks != 0U)
+  {
+    baudrate = (uint32_t)((((uint64_t)TimerClock * 8U) + (Ticks / 2U)) / Ticks);
+  }
+
+  return baudrate;
+}
+
+/**
+ * @brief  This function is used to measure the baudrate of the sync byte if its start bit has been captured.
+ *         On success the function returns at the end of the frame with the RX pin given back to the USART.
+ * @param  pBaudRate Pointer to the measured baudrate.
+ * @retval Returns SUCCESS if a sync byte has been measured else ERROR.
+ */
+static ErrorStatus OPENBL_USART_AutoBaud_Measure(uint32_t *pBaudRate)
+{
+  ErrorStatus status = ERROR;
+  uint32_t tickstart;
+  uint32_t first_edge;
+  uint32_t ticks = 0U;
+
+  if (USARTx_AUTOBAUD_IS_CAPTURED() != 0U)
+  {
+    /* Start bit of the sync byte */
+    first_edge = USARTx_AUTOBAUD_GET_CAPTURE();
+    tickstart  = HAL_GetTick();
+
+    /* Falling edge of the MSB */
+    while ((HAL_GetTick() - tickstart) <= USARTx_AUTOBAUD_TIMEOUT)
+    {
+      if (USARTx_AUTOBAUD_IS_CAPTURED() != 0U)
+      {
+        ticks  = USARTx_AUTOBAUD_GET_CAPTURE() - first_edge;
+        status = SUCCESS;
+        break;
+      }
+    }
+
+    if (status == SUCCESS)
+    {
+      *pBaudRate = OPENBL_USART_AutoBaud_ComputeBaudRate(ticks, OPENBL_USART_AutoBaud_GetTimerClock());
+
+      /* Let the MSB, the parity bit and the stop bit go by before giving the line back to the USART */
+      first_edge += ticks;
+      ticks       = (ticks * 3U) / 8U;
+
+      while ((LL_TIM_GetCounter(USARTx_AUTOBAUD_TIM) - first_edge) < ticks)
+      {
+      }
+
+      OPENBL_USART_AutoBaud_Stop();
+    }
+    else
+    {
+      USARTx_AUTOBAUD_CLEAR_FLAGS();
+    }
+  }
+
+  return status;
+}
+
+/**
+ * @brief  This function is used to start the timer sending the busy bytes.
+ *         The timer interrupt handler runs from RAM and its vector is in the RAM copy of the vector table
+ *         made by OpenBootloader_Init(): the busy bytes keep going out while a FLASH operation stalls the FLASH.
+ * @retval None.
+ */
+static void OPENBL_USART_Busy_Init(void)
+{
+  USARTx_BUSY_TIM_CLK_ENABLE();
+
+  /* The busy timer is on APB1 as the autobaud timer, it counts at 10 kHz */
+  LL_TIM_DisableCounter(USARTx_BUSY_TIM);
+  LL_TIM_SetPrescaler(USARTx_BUSY_TIM, (OPENBL_USART_AutoBaud_GetTimerClock() / 10000U) - 1U);
+  LL_TIM_SetAutoReload(USARTx_BUSY_TIM, (USARTx_BUSY_PERIOD * 10U) - 1U);
+  LL_TIM_GenerateEvent_UPDATE(USARTx_BUSY_TIM);
+  LL_TIM_ClearFlag_UPDATE(USARTx_BUSY_TIM);
+  LL_TIM_EnableIT_UPDATE(USARTx_BUSY_TIM);
+  LL_TIM_EnableCounter(USARTx_BUSY_TIM);
+
+  HAL_NVIC_SetPriority(USARTx_BUSY_TIM_IRQn, 0U, 0U);
+  HAL_NVIC_EnableIRQ(USARTx_BUSY_TIM_IRQn);
+}
+
 /* Exported functions --------------------------------------------------------*/
 
 /**
@@ -76,6 +412,9 @@ void OPENBL_USART_Configuration(void)
   HAL_GPIO_Init(USARTx_TX_GPIO_PORT, &GPIO_InitStruct); 
 */
   OPENBL_USART_Init();
+  OPENBL_USART_DMA_Init();
+  OPENBL_USART_AutoBaud_Start();
+  OPENBL_USART_Busy_Init();
 }
 
 /**
@@ -84,27 +423,41 @@ void OPENBL_USART_Configuration(void)
  */
 void OPENBL_USART_DeInit(void)
 {
+  HAL_NVIC_DisableIRQ(USARTx_IRQn);
+
+  HAL_NVIC_DisableIRQ(USARTx_BUSY_TIM_IRQn);
+  LL_TIM_DisableCounter(USARTx_BUSY_TIM);
+  USARTx_BUSY_TIM_CLK_DISABLE();
 }
 
 /**
  * @brief  This function is used to detect if there is any activity on USART protocol.
+ *         The baudrate is measured on the sync byte and the USART is configured accordingly
+ *         before the host is acknowledged.
  * @retval Returns 1 if interface is detected else 0.
  */
 uint8_t OPENBL_USART_ProtocolDetection(void)
 {
-  if (LL_USART_IsActiveFlag_RXNE(USARTx))
-  {
-    OPENBL_USART_ReadByte();   
-    
-    /* Aknowledge the host */
-    OPENBL_USART_SendByte(ACK_BYTE);
+  uint32_t baudrate;
 
-    UsartDetected = 1;
-  }
-  else
+  UsartDetected = 0;
+
+  if (OPENBL_USART_AutoBaud_Measure(&baudrate) == SUCCESS)
   {
-    UsartDetected = 0;
+    if (OPENBL_USART_SetBaudRate(baudrate) == SUCCESS)
+    {
+      /* Aknowledge the host */
+      OPENBL_USART_SendByte(ACK_BYTE);
+
+      UsartDetected = 1;
+    }
+    else
+    {
+      /* Out of range or glitch, wait for the next sync byte */
+      OPENBL_USART_AutoBaud_Start();
+    }
   }
+
   return UsartDetected;
 }
 
@@ -122,7 +475,18 @@ uint8_t OPENBL_USART_GetCommandOpcode(void)
   if ((command_opc ^ OPENBL_USART_ReadByte()) != 0xFFU)
   {
     command_opc = ERROR_COMMAND;
+
+    UsartStatistics.OpcodeErrors++;
   }
+#if (OPENBL_PIPELINED_WRITE == 1U)
+  else if (OPENBL_USART_TakeWriteError() == SET)
+  {
+    /* An acknowledged flash write failed, the command following it is refused whatever it is */
+    command_opc = ERROR_COMMAND;
+  }
+#endif /* (OPENBL_PIPELINED_WRITE == 1U) */
+
+  UsartOpcode = command_opc;
 
   return command_opc;
 
@@ -135,12 +499,62 @@ uint8_t OPENBL_USART_GetCommandOpcode(void)
   */
 uint8_t OPENBL_USART_ReadByte(void)
 {
-  while (!LL_USART_IsActiveFlag_RXNE(USARTx))
+  uint8_t data;
+
+  while (OPENBL_USART_GetRxCount() == 0U)
   {
     OPENBL_IWDG_Refresh();
+    OPENBL_USART_CheckErrors();
   }
 
-  return LL_USART_ReceiveData8(USARTx);
+  data        = UsartRxRing[UsartRxTail];
+  UsartRxTail = (UsartRxTail + 1U) & (USARTx_RX_RING_SIZE - 1U);
+
+  return data;
+}
+
+/**
+  * @brief  This function is used to read a block of bytes from USART pipe.
+  * @param  pData Pointer to the buffer where the read bytes are stored.
+  * @param  Length The number of bytes to be read.
+  * @retval None.
+  */
+void OPENBL_USART_ReadBuffer(uint8_t *pData, uint32_t Length)
+{
+  uint32_t count;
+  uint32_t chunk;
+
+  while (Length != 0U)
+  {
+    count = OPENBL_USART_GetRxCount();
+
+    if (count == 0U)
+    {
+      OPENBL_IWDG_Refresh();
+      OPENBL_USART_CheckErrors();
+    }
+    else
+    {
+      if (count > Length)
+      {
+        count = Length;
+      }
+
+      /* Copy up to the end of the ring, the remaining bytes are handled by the next iteration */
+      chunk = USARTx_RX_RING_SIZE - UsartRxTail;
+
+      if (chunk > count)
+      {
+        chunk = count;
+      }
+
+      memcpy(pData, &UsartRxRing[UsartRxTail], chunk);
+
+      UsartRxTail = (UsartRxTail + chunk) & (USARTx_RX_RING_SIZE - 1U);
+      pData      += chunk;
+      Length     -= chunk;
+    }
+  }
 }
 
 /**
@@ -150,13 +564,247 @@ uint8_t OPENBL_USART_ReadByte(void)
   */
 void OPENBL_USART_SendByte(uint8_t Byte)
 {
+  /* The busy timer interrupt writes the data register too, it is kept out until the byte is written */
+  UsartTxActive = 1U;
+
+  /* Only wait for the data register to be free, the previous byte may still be shifted out */
+  while (!LL_USART_IsActiveFlag_TXE(USARTx))
+  {
+  }
+
   LL_USART_TransmitData8(USARTx, (Byte & 0xFFU));
 
+  UsartTxActive = 0U;
+}
+
+/**
+  * @brief  This function is used to send a NACK, it is counted for the command being processed.
+  * @retval None.
+  */
+void OPENBL_USART_SendNack(void)
+{
+  UsartNacks[UsartOpcode]++;
+
+  OPENBL_USART_SendByte(NACK_BYTE);
+}
+
+/**
+  * @brief  This function is used to send a block of bytes through USART pipe using the TX DMA stream.
+  *         The function returns once the last byte has been handed to the USART, so the buffer can be reused.
+  * @param  pData Pointer to the bytes to be sent.
+  * @param  Length The number of bytes to be sent.
+  * @retval None.
+  */
+void OPENBL_USART_SendBuffer(uint8_t *pData, uint32_t Length)
+{
+  uint32_t chunk;
+
+  /* No busy byte may be interleaved with the bytes written by the TX DMA stream */
+  UsartTxActive = 1U;
+
+  while (Length != 0U)
+  {
+    /* The DMA transfer counter is limited to 16 bits */
+    chunk = (Length > 0xFFFFU) ? 0xFFFFU : Length;
+
+    USARTx_TX_DMA_CLEAR_FLAGS();
+    LL_USART_ClearFlag_TC(USARTx);
+
+    LL_DMA_SetMemoryAddress(USARTx_DMA, USARTx_TX_DMA_STREAM, (uint32_t)pData);
+    LL_DMA_SetDataLength(USARTx_DMA, USARTx_TX_DMA_STREAM, chunk);
+    LL_DMA_EnableStream(USARTx_DMA, USARTx_TX_DMA_STREAM);
+
+    /* The stream is disabled by hardware at the end of a normal mode transfer */
+    while (LL_DMA_IsEnabledStream(USARTx_DMA, USARTx_TX_DMA_STREAM) != 0U)
+    {
+      OPENBL_IWDG_Refresh();
+    }
+
+    pData  += chunk;
+    Length -= chunk;
+  }
+
+  UsartTxActive = 0U;
+}
+
+/**
+  * @brief  This function is used to wait until the last byte has left the USART shift register.
+  *         It must be called before any operation that resets the device or changes the USART configuration.
+  * @retval None.
+  */
+void OPENBL_USART_WaitTransmitComplete(void)
+{
   while (!LL_USART_IsActiveFlag_TC(USARTx))
   {
   }
 }
 
+/**
+  * @brief  This function is used to read one byte from USART pipe with a timeout.
+  * @param  pByte Pointer to the read byte.
+  * @param  Timeout The maximum time to wait in milliseconds.
+  * @retval Returns SUCCESS if a byte has been read else ERROR.
+  */
+ErrorStatus OPENBL_USART_ReadByteTimeout(uint8_t *pByte, uint32_t Timeout)
+{
+  ErrorStatus status = SUCCESS;
+  uint32_t tickstart;
+
+  tickstart = HAL_GetTick();
+
+  while (OPENBL_USART_GetRxCount() == 0U)
+  {
+    OPENBL_IWDG_Refresh();
+    OPENBL_USART_CheckErrors();
+
+    if ((HAL_GetTick() - tickstart) > Timeout)
+    {
+      status = ERROR;
+      break;
+    }
+  }
+
+  if (status == SUCCESS)
+  {
+    *pByte = OPENBL_USART_ReadByte();
+  }
+
+  return status;
+}
+
+/**
+  * @brief  This function is used to check if a given baudrate can be configured.
+  * @param  BaudRate The baudrate to be checked.
+  * @retval Returns SUCCESS if the baudrate is supported else ERROR.
+  */
+ErrorStatus OPENBL_USART_CheckBaudRate(uint32_t BaudRate)
+{
+  uint32_t brr;
+  uint32_t oversampling;
+
+  return OPENBL_USART_ComputeBrr(BaudRate, &brr, &oversampling);
+}
+
+/**
+  * @brief  This function is used to change the USART baudrate.
+  *         Pending transmission is completed first and any byte received before the switch is discarded.
+  * @param  BaudRate The new baudrate.
+  * @retval Returns SUCCESS if the baudrate has been changed else ERROR.
+  */
+ErrorStatus OPENBL_USART_SetBaudRate(uint32_t BaudRate)
+{
+  ErrorStatus status;
+  uint32_t brr;
+  uint32_t oversampling;
+
+  status = OPENBL_USART_ComputeBrr(BaudRate, &brr, &oversampling);
+
+  if (status == SUCCESS)
+  {
+    OPENBL_USART_WaitTransmitComplete();
+
+    /* OVER8 can only be changed while the USART is disabled */
+    LL_USART_Disable(USARTx);
+    LL_USART_SetOverSampling(USARTx, oversampling);
+    WRITE_REG(USARTx->BRR, brr);
+    LL_USART_Enable(USARTx);
+
+    huart2.Init.BaudRate     = BaudRate;
+    huart2.Init.OverSampling = oversampling;
+
+    /* Drop what has been received while switching */
+    UsartRxTail = USARTx_RX_RING_SIZE - LL_DMA_GetDataLength(USARTx_DMA, USARTx_RX_DMA_STREAM);
+    UsartRxTail &= (USARTx_RX_RING_SIZE - 1U);
+  }
+
+  return status;
+}
+
+/**
+  * @brief  This function is used to get the current USART baudrate.
+  * @retval Returns the baudrate.
+  */
+uint32_t OPENBL_USART_GetBaudRate(void)
+{
+  return huart2.Init.BaudRate;
+}
+
+/**
+  * @brief  This function is used to get the USART reception errors counted since reset.
+  * @param  pStatistics Pointer to the structure receiving the counters.
+  * @retval None.
+  */
+void OPENBL_USART_GetLinkStatistics(OPENBL_USART_LinkStatisticsTypeDef *pStatistics)
+{
+  *pStatistics = UsartStatistics;
+}
+
+/**
+  * @brief  This function is used to get the number of NACK sent by a command since reset.
+  * @param  Opcode The command opcode.
+  * @retval Returns the number of NACK.
+  */
+uint32_t OPENBL_USART_GetNackCount(uint8_t Opcode)
+{
+  return UsartNacks[Opcode];
+}
+
+/**
+  * @brief  This function handles the busy timer interrupt, a busy byte is sent while the busy state is enabled.
+  *         It runs from RAM and only uses register accesses, nothing is read from FLASH.
+  *         No busy byte is written while OPENBL_USART_SendByte() or OPENBL_USART_SendBuffer() is sending:
+  *         the interrupt cannot be preempted by them, so a busy byte either is written before they check
+  *         TXE or is skipped.
+  * @retval None.
+  */
+__RAM_FUNC void OPENBL_USART_Busy_IRQHandler(void)
+{
+  WRITE_REG(USARTx_BUSY_TIM->SR, ~TIM_SR_UIF);
+
+  if ((Flash_BusyState == FLASH_BUSY_STATE_ENABLED) && (UsartTxActive == 0U)
+      && ((USARTx->SR & USART_SR_TXE) != 0U))
+  {
+    WRITE_REG(USARTx->DR, BUSY_BYTE);
+  }
+}
+
+/**
+  * @brief  This function handles the USART error interrupts, the reception errors are counted.
+  *         Reading SR is the first half of the flag clear sequence, the second half is the next read of
+  *         the data register by the RX DMA stream. Until then the flags stay set,
+  *         so the interrupt is masked in the NVIC, not in the USART registers also written by the main
+  *         loop, and unmasked by OPENBL_USART_CheckErrors(). An error on a byte received meanwhile is
+  *         not counted separately.
+  *         It runs from RAM and only uses register accesses, nothing is read from FLASH.
+  * @retval None.
+  */
+__RAM_FUNC void OPENBL_USART_IRQHandler(void)
+{
+  uint32_t status = READ_REG(USARTx->SR);
+
+  if ((status & USART_SR_ORE) != 0U)
+  {
+    UsartStatistics.OverrunErrors++;
+  }
+
+  if ((status & USART_SR_FE) != 0U)
+  {
+    UsartStatistics.FramingErrors++;
+  }
+
+  if ((status & USART_SR_NE) != 0U)
+  {
+    UsartStatistics.NoiseErrors++;
+  }
+
+  if ((status & USART_SR_PE) != 0U)
+  {
+    UsartStatistics.ParityErrors++;
+  }
+
+  WRITE_REG(NVIC->ICER[((uint32_t)USARTx_IRQn) >> 5U], 1UL << (((uint32_t)USARTx_IRQn) & 0x1FU));
+}
+
 /**
  * @brief  This function is used to process and execute the special commands.
  *         The user must define the special commands routine here.
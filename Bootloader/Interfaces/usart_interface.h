@@ -29,7 +29,19 @@ extern "C" {
 #include "openbl_core.h"
 
 /* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  uint32_t OverrunErrors;     /* Bytes lost because the previous one was still in the data register */
+  uint32_t FramingErrors;     /* Bytes received without a valid stop bit */
+  uint32_t NoiseErrors;       /* Bytes received with noise detected on the line */
+  uint32_t ParityErrors;      /* Bytes received with a wrong parity bit */
+  uint32_t DmaRestarts;       /* RX DMA stream restarted after a transfer error */
+  uint32_t OpcodeErrors;      /* Command opcodes not followed by their complement */
+} OPENBL_USART_LinkStatisticsTypeDef;
+
 /* Exported constants --------------------------------------------------------*/
+#define OPENBL_USART_SYNC_BYTE            0x7FU             /* Synchronization byte sent by the host */
+
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 void OPENBL_USART_Configuration(void);
@@ -38,7 +50,20 @@ uint8_t OPENBL_USART_ProtocolDetection(void);
 
 uint8_t OPENBL_USART_GetCommandOpcode(void);
 uint8_t OPENBL_USART_ReadByte(void);
+ErrorStatus OPENBL_USART_ReadByteTimeout(uint8_t *pByte, uint32_t Timeout);
+void OPENBL_USART_ReadBuffer(uint8_t *pData, uint32_t Length);
+uint32_t OPENBL_USART_GetRxCount(void);
 void OPENBL_USART_SendByte(uint8_t Byte);
+void OPENBL_USART_SendNack(void);
+void OPENBL_USART_SendBuffer(uint8_t *pData, uint32_t Length);
+void OPENBL_USART_WaitTransmitComplete(void);
+ErrorStatus OPENBL_USART_CheckBaudRate(uint32_t BaudRate);
+ErrorStatus OPENBL_USART_SetBaudRate(uint32_t BaudRate);
+uint32_t OPENBL_USART_GetBaudRate(void);
+void OPENBL_USART_GetLinkStatistics(OPENBL_USART_LinkStatisticsTypeDef *pStatistics);
+uint32_t OPENBL_USART_GetNackCount(uint8_t Opcode);
+void OPENBL_USART_Busy_IRQHandler(void);
+void OPENBL_USART_IRQHandler(void);
 void OPENBL_USART_SpecialCommandProcess(OPENBL_SpecialCmdTypeDef *SpecialCmd);
 
 #ifdef __cplusplus
@@ -0,0 +1,113 @@
+/**
+  ******************************************************************************
+  * @file    openbl_delta.c
+  * @author  MCD Application Team
+  * @brief   Provides the patch interpreter used by the delta write command.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2019-2021 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "openbl_mem.h"
+#include "openbl_delta.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+/* Exported variables --------------------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  This function is used to rebuild a block of the new image from a patch.
+  *         The patch is a sequence of whole operations, multi-byte fields are MSB first:
+  *         - DELTA_OP_COPY copies bytes of the FLASH as it is when the patch is applied,
+  *           the source must lie in user FLASH, i.e. from USERPROG_START_ADDRESS.
+  *         - DELTA_OP_INSERT appends the literal bytes carried by the patch.
+  * @param  pPatch Pointer to the patch.
+  * @param  PatchLength The length of the patch.
+  * @param  pDst Pointer to the buffer receiving the rebuilt block.
+  * @param  DstCapacity The size of the destination buffer.
+  * @param  pDstLength Pointer to the number of rebuilt bytes.
+  * @retval Returns SUCCESS if the patch has been applied else ERROR.
+  */
+ErrorStatus OPENBL_DELTA_Apply(uint8_t *pPatch, uint32_t PatchLength, uint8_t *pDst, uint32_t DstCapacity,
+                               uint32_t *pDstLength)
+{
+  ErrorStatus status = SUCCESS;
+  uint32_t index     = 0U;
+  uint32_t length    = 0U;
+  uint32_t address;
+  uint32_t size;
+
+  while ((index < PatchLength) && (status == SUCCESS))
+  {
+    switch (pPatch[index])
+    {
+      case DELTA_OP_COPY:
+        if ((PatchLength - index) < 7U)
+        {
+          status = ERROR;
+          break;
+        }
+
+        address = ((uint32_t)pPatch[index + 1U] << 24) | ((uint32_t)pPatch[index + 2U] << 16)
+                  | ((uint32_t)pPatch[index + 3U] << 8) | (uint32_t)pPatch[index + 4U];
+        size    = (((uint32_t)pPatch[index + 5U] << 8) | (uint32_t)pPatch[index + 6U]) + 1U;
+
+        if ((size > (DstCapacity - length)) || (address < USERPROG_START_ADDRESS)
+            || (OPENBL_MEM_GetAddressArea(address) != FLASH_AREA) || (OPENBL_MEM_CheckRange(address, size) != SUCCESS))
+        {
+          status = ERROR;
+          break;
+        }
+
+        memcpy(&pDst[length], (uint8_t *)address, size);
+
+        length += size;
+        index  += 7U;
+        break;
+
+      case DELTA_OP_INSERT:
+        if ((PatchLength - index) < 3U)
+        {
+          status = ERROR;
+          break;
+        }
+
+        size   = (((uint32_t)pPatch[index + 1U] << 8) | (uint32_t)pPatch[index + 2U]) + 1U;
+        index += 3U;
+
+        if ((size > (PatchLength - index)) || (size > (DstCapacity - length)))
+        {
+          status = ERROR;
+          break;
+        }
+
+        memcpy(&pDst[length], &pPatch[index], size);
+
+        length += size;
+        index  += size;
+        break;
+
+      default:
+        status = ERROR;
+        break;
+    }
+  }
+
+  *pDstLength = length;
+
+  return status;
+}
@@ -0,0 +1,36 @@
+/**
+  ******************************************************************************
+  * @file    openbl_delta.h
+  * @author  MCD Application Team
+  * @brief   Header for openbl_delta.c module
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2019-2021 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef OPENBL_DELTA_H
+#define OPENBL_DELTA_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "openbootloader_conf.h"
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+#define DELTA_OP_COPY                     0x01U     /* Copy bytes from the installed image: address (4 bytes) and length - 1 (2 bytes) */
+#define DELTA_OP_INSERT                   0x02U     /* Insert literal bytes: length - 1 (2 bytes) followed by the bytes */
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions ------------------------------------------------------- */
+ErrorStatus OPENBL_DELTA_Apply(uint8_t *pPatch, uint32_t PatchLength, uint8_t *pDst, uint32_t DstCapacity,
+                               uint32_t *pDstLength);
+
+#endif /* OPENBL_DELTA_H */
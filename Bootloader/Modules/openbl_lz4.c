@@ -0,0 +1,156 @@
+/**
+  ******************************************************************************
+  * @file    openbl_lz4.c
+  * @author  MCD Application Team
+  * @brief   Provides the LZ4 block decoder used by the compressed write command.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2019-2021 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "openbl_lz4.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define LZ4_MIN_MATCH                     4U        /* Match length encoded by a 0 nibble */
+#define LZ4_LENGTH_EXTENDED               15U       /* Nibble value announcing extra length bytes */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+static ErrorStatus OPENBL_LZ4_ReadLength(uint8_t **ppSrc, uint8_t *pSrcEnd, uint32_t *pLength);
+
+/* Exported variables --------------------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  This function is used to decompress one LZ4 block (raw block format, no frame header).
+  *         Every access is bounds checked, a malformed block is rejected without writing
+  *         outside of the destination buffer. The window is limited to the block itself,
+  *         so each block must be compressed independently by the host.
+  * @param  pSrc Pointer to the compressed block.
+  * @param  SrcLength The length of the compressed block.
+  * @param  pDst Pointer to the destination buffer.
+  * @param  DstCapacity The size of the destination buffer.
+  * @param  pDstLength Pointer to the number of decompressed bytes.
+  * @retval Returns SUCCESS if the block has been decompressed else ERROR.
+  */
+ErrorStatus OPENBL_LZ4_DecompressBlock(uint8_t *pSrc, uint32_t SrcLength, uint8_t *pDst, uint32_t DstCapacity,
+                                       uint32_t *pDstLength)
+{
+  ErrorStatus status = SUCCESS;
+  uint8_t *p_src_end = pSrc + SrcLength;
+  uint8_t *p_dst     = pDst;
+  uint8_t *p_dst_end = pDst + DstCapacity;
+  uint8_t *p_match;
+  uint32_t length;
+  uint32_t offset;
+  uint8_t token;
+
+  while (status == SUCCESS)
+  {
+    if (pSrc >= p_src_end)
+    {
+      status = ERROR;
+      break;
+    }
+
+    token = *pSrc++;
+
+    /* Literals */
+    length = (uint32_t)token >> 4;
+    status = OPENBL_LZ4_ReadLength(&pSrc, p_src_end, &length);
+
+    if ((status != SUCCESS) || (length > (uint32_t)(p_src_end - pSrc)) || (length > (uint32_t)(p_dst_end - p_dst)))
+    {
+      status = ERROR;
+      break;
+    }
+
+    memcpy(p_dst, pSrc, length);
+    p_dst += length;
+    pSrc  += length;
+
+    /* The last sequence only holds literals */
+    if (pSrc == p_src_end)
+    {
+      break;
+    }
+
+    /* Match */
+    if ((p_src_end - pSrc) < 2)
+    {
+      status = ERROR;
+      break;
+    }
+
+    offset = (uint32_t)pSrc[0] | ((uint32_t)pSrc[1] << 8);
+    pSrc  += 2;
+
+    length = (uint32_t)token & 0x0FU;
+    status = OPENBL_LZ4_ReadLength(&pSrc, p_src_end, &length);
+    length += LZ4_MIN_MATCH;
+
+    if ((status != SUCCESS) || (offset == 0U) || (offset > (uint32_t)(p_dst - pDst))
+        || (length > (uint32_t)(p_dst_end - p_dst)))
+    {
+      status = ERROR;
+      break;
+    }
+
+    /* Byte copy as the match may overlap the bytes it produces */
+    p_match = p_dst - offset;
+
+    while (length != 0U)
+    {
+      *p_dst++ = *p_match++;
+      length--;
+    }
+  }
+
+  *pDstLength = (uint32_t)(p_dst - pDst);
+
+  return status;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  This function is used to read the extra bytes of a literal or match length.
+  * @param  ppSrc Pointer to the read pointer of the compressed block, advanced past the extra bytes.
+  * @param  pSrcEnd Pointer to the end of the compressed block.
+  * @param  pLength Pointer to the length, holding the token nibble on entry.
+  * @retval Returns ERROR if the block ends inside the length else SUCCESS.
+  */
+static ErrorStatus OPENBL_LZ4_ReadLength(uint8_t **ppSrc, uint8_t *pSrcEnd, uint32_t *pLength)
+{
+  ErrorStatus status = SUCCESS;
+  uint8_t byte;
+
+  if (*pLength == LZ4_LENGTH_EXTENDED)
+  {
+    do
+    {
+      if (*ppSrc >= pSrcEnd)
+      {
+        status = ERROR;
+        break;
+      }
+
+      byte      = *(*ppSrc)++;
+      *pLength += byte;
+    } while (byte == 0xFFU);
+  }
+
+  return status;
+}
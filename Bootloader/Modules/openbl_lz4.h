@@ -0,0 +1,33 @@
+/**
+  ******************************************************************************
+  * @file    openbl_lz4.h
+  * @author  MCD Application Team
+  * @brief   Header for openbl_lz4.c module
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2019-2021 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef OPENBL_LZ4_H
+#define OPENBL_LZ4_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "openbootloader_conf.h"
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions ------------------------------------------------------- */
+ErrorStatus OPENBL_LZ4_DecompressBlock(uint8_t *pSrc, uint32_t SrcLength, uint8_t *pDst, uint32_t DstCapacity,
+                                       uint32_t *pDstLength);
+
+#endif /* OPENBL_LZ4_H */
@@ -19,6 +19,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "openbl_mem.h"
 #include "openbl_core.h"
+#include "openbl_profile.h"
 
 #include "interfaces_conf.h"
 
@@ -55,6 +56,7 @@ ErrorStatus OPENBL_MEM_RegisterMemory(OPENBL_MemoryTypeDef *Memory)
     a_MemoriesTable[NumberOfMemories].JumpToAddress     = Memory->JumpToAddress;
     a_MemoriesTable[NumberOfMemories].MassErase         = Memory->MassErase;
     a_MemoriesTable[NumberOfMemories].Erase             = Memory->Erase;
+    a_MemoriesTable[NumberOfMemories].BlankCheck        = Memory->BlankCheck;
 
     NumberOfMemories++;
   }
@@ -123,6 +125,7 @@ uint32_t OPENBL_MEM_GetMemoryIndex(uint32_t Address)
 uint8_t OPENBL_MEM_Read(uint32_t Address, uint32_t MemoryIndex)
 {
   uint8_t value;
+  OPENBL_PROFILE_BEGIN(start);
 
   if (MemoryIndex < NumberOfMemories)
   {
@@ -140,6 +143,8 @@ uint8_t OPENBL_MEM_Read(uint32_t Address, uint32_t MemoryIndex)
     value = 0;
   }
 
+  OPENBL_PROFILE_END_MEM(OPENBL_PROFILE_MEM_READ, start);
+
   return value;
 }
 
@@ -148,11 +153,13 @@ uint8_t OPENBL_MEM_Read(uint32_t Address, uint32_t MemoryIndex)
   * @param  Address The address where that data will be written.
   * @param  Data The data to be written.
   * @param  DataLength The length of the data to be written.
-  * @retval None.
+  * @retval Returns ERROR if the memory cannot be written or the write failed else SUCCESS.
   */
-void OPENBL_MEM_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength)
+ErrorStatus OPENBL_MEM_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength)
 {
+  ErrorStatus status = ERROR;
   uint32_t index;
+  OPENBL_PROFILE_BEGIN(start);
 
   /* Get the memory index to know in which memory we will write */
   index = OPENBL_MEM_GetMemoryIndex(Address);
@@ -161,9 +168,13 @@ void OPENBL_MEM_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength)
   {
     if (a_MemoriesTable[index].Write != NULL)
     {
-      a_MemoriesTable[index].Write(Address, Data, DataLength);
+      status = a_MemoriesTable[index].Write(Address, Data, DataLength);
     }
   }
+
+  OPENBL_PROFILE_END_MEM(OPENBL_PROFILE_MEM_WRITE, start);
+
+  return status;
 }
 
 /**
@@ -175,6 +186,7 @@ void OPENBL_MEM_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength)
 void OPENBL_MEM_SetReadOutProtection(uint32_t Address, FunctionalState State)
 {
   uint32_t index;
+  OPENBL_PROFILE_BEGIN(start);
 
   /* Get the memory index to know in which memory we will write */
   index = OPENBL_MEM_GetMemoryIndex(Address);
@@ -193,6 +205,8 @@ void OPENBL_MEM_SetReadOutProtection(uint32_t Address, FunctionalState State)
       }
     }
   }
+
+  OPENBL_PROFILE_END_MEM(OPENBL_PROFILE_MEM_READOUT_PROTECT, start);
 }
 
 /**
@@ -211,6 +225,7 @@ ErrorStatus OPENBL_MEM_SetWriteProtection(FunctionalState State, uint32_t Addres
 {
   uint32_t index;
   ErrorStatus status = SUCCESS;
+  OPENBL_PROFILE_BEGIN(start);
 
   /* Get the memory index to know in which memory we will write */
   index = OPENBL_MEM_GetMemoryIndex(Address);
@@ -231,6 +246,8 @@ ErrorStatus OPENBL_MEM_SetWriteProtection(FunctionalState State, uint32_t Addres
     status = ERROR;
   }
 
+  OPENBL_PROFILE_END_MEM(OPENBL_PROFILE_MEM_WRITE_PROTECT, start);
+
   return status;
 }
 
@@ -268,6 +285,7 @@ ErrorStatus OPENBL_MEM_MassErase(uint32_t Address, uint8_t *p_Data, uint32_t Dat
 {
   uint32_t memory_index;
   ErrorStatus status;
+  OPENBL_PROFILE_BEGIN(start);
 
   /* Get the memory index to know from which memory interface we will used */
   memory_index = OPENBL_MEM_GetMemoryIndex(Address);
@@ -288,6 +306,8 @@ ErrorStatus OPENBL_MEM_MassErase(uint32_t Address, uint8_t *p_Data, uint32_t Dat
     status = ERROR;
   }
 
+  OPENBL_PROFILE_END_MEM(OPENBL_PROFILE_MEM_MASS_ERASE, start);
+
   return status;
 }
 
@@ -304,6 +324,7 @@ ErrorStatus OPENBL_MEM_Erase(uint32_t Address, uint8_t *p_Data, uint32_t DataLen
 {
   uint32_t memory_index;
   ErrorStatus status;
+  OPENBL_PROFILE_BEGIN(start);
 
   /* Get the memory index to know from which memory interface we will used */
   memory_index = OPENBL_MEM_GetMemoryIndex(Address);
@@ -324,6 +345,8 @@ ErrorStatus OPENBL_MEM_Erase(uint32_t Address, uint8_t *p_Data, uint32_t DataLen
     status = ERROR;
   }
 
+  OPENBL_PROFILE_END_MEM(OPENBL_PROFILE_MEM_ERASE, start);
+
   return status;
 }
 
@@ -340,7 +363,7 @@ uint8_t OPENBL_MEM_CheckJumpAddress(uint32_t Address)
   /* Get the memory index to know from which memory interface we will used */
   memory_index = OPENBL_MEM_GetMemoryIndex(Address);
 
-  if (a_MemoriesTable[memory_index].JumpToAddress != NULL)
+  if ((memory_index < NumberOfMemories) && (a_MemoriesTable[memory_index].JumpToAddress != NULL))
   {
     status = 1;
   }
@@ -351,3 +374,59 @@ uint8_t OPENBL_MEM_CheckJumpAddress(uint32_t Address)
 
   return status;
 }
+
+/**
+  * @brief  Check if a given address range lies entirely in one registered memory that can be read.
+  * @param  Address The first address of the range.
+  * @param  Length The number of bytes of the range.
+  * @retval Returns SUCCESS if the range is valid else ERROR.
+  */
+ErrorStatus OPENBL_MEM_CheckRange(uint32_t Address, uint32_t Length)
+{
+  uint32_t memory_index;
+  ErrorStatus status = ERROR;
+
+  /* Get the memory index to know from which memory interface we will used */
+  memory_index = OPENBL_MEM_GetMemoryIndex(Address);
+
+  if ((memory_index < NumberOfMemories) && (Length != 0U))
+  {
+    if ((a_MemoriesTable[memory_index].Read != NULL)
+        && (Length <= (a_MemoriesTable[memory_index].EndAddress - Address)))
+    {
+      status = SUCCESS;
+    }
+  }
+
+  return status;
+}
+
+/**
+  * @brief  This function is used to check if a memory range is erased.
+  * @param  Address The first address of the range.
+  * @param  Length The number of bytes of the range.
+  * @retval An ErrorStatus enumeration value:
+  *          - SUCCESS: The range is blank
+  *          - ERROR:   The range is not blank, invalid or the memory has no blank check
+  */
+ErrorStatus OPENBL_MEM_BlankCheck(uint32_t Address, uint32_t Length)
+{
+  uint32_t memory_index;
+  ErrorStatus status = ERROR;
+  OPENBL_PROFILE_BEGIN(start);
+
+  /* Get the memory index to know from which memory interface we will used */
+  memory_index = OPENBL_MEM_GetMemoryIndex(Address);
+
+  if (OPENBL_MEM_CheckRange(Address, Length) == SUCCESS)
+  {
+    if (a_MemoriesTable[memory_index].BlankCheck != NULL)
+    {
+      status = a_MemoriesTable[memory_index].BlankCheck(Address, Length);
+    }
+  }
+
+  OPENBL_PROFILE_END_MEM(OPENBL_PROFILE_MEM_BLANK_CHECK, start);
+
+  return status;
+}
@@ -31,12 +31,13 @@ typedef struct
   uint32_t Size;
   uint32_t Type;
   uint8_t (*Read)(uint32_t Address);
-  void (*Write)(uint32_t Address, uint8_t *Data, uint32_t DataLength);
+  ErrorStatus(*Write)(uint32_t Address, uint8_t *Data, uint32_t DataLength);
   void (*SetReadoutProtect)(uint32_t State);
   ErrorStatus(*SetWriteProtect)(FunctionalState State, uint8_t *Buffer, uint32_t Length);
   void (*JumpToAddress)(uint32_t Address);
   ErrorStatus(*MassErase)(uint8_t *p_Data, uint32_t DataLength);
   ErrorStatus(*Erase)(uint8_t *p_Data, uint32_t DataLength);
+  ErrorStatus(*BlankCheck)(uint32_t Address, uint32_t Length);
 } OPENBL_MemoryTypeDef;
 
 /* Exported constants --------------------------------------------------------*/
@@ -44,13 +45,15 @@ typedef struct
 /* Exported functions ------------------------------------------------------- */
 void OPENBL_MEM_JumpToAddress(uint32_t Address);
 void OPENBL_MEM_SetReadOutProtection(uint32_t Address, FunctionalState State);
-void OPENBL_MEM_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength);
 
 uint8_t OPENBL_MEM_Read(uint32_t Address, uint32_t MemoryIndex);
 uint32_t OPENBL_MEM_GetAddressArea(uint32_t Address);
 uint32_t OPENBL_MEM_GetMemoryIndex(uint32_t Address);
 uint8_t OPENBL_MEM_CheckJumpAddress(uint32_t Address);
 
+ErrorStatus OPENBL_MEM_CheckRange(uint32_t Address, uint32_t Length);
+ErrorStatus OPENBL_MEM_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength);
+ErrorStatus OPENBL_MEM_BlankCheck(uint32_t Address, uint32_t Length);
 ErrorStatus OPENBL_MEM_Erase(uint32_t Address, uint8_t *p_Data, uint32_t DataLength);
 ErrorStatus OPENBL_MEM_MassErase(uint32_t Address, uint8_t *p_Data, uint32_t DataLength);
 ErrorStatus OPENBL_MEM_RegisterMemory(OPENBL_MemoryTypeDef *Memory);
@@ -0,0 +1,134 @@
+/**
+  ******************************************************************************
+  * @file    openbl_profile.c
+  * @author  MCD Application Team
+  * @brief   Cycle counts of the commands and memory accesses, measured with the DWT
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2019-2021 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "openbl_profile.h"
+
+#if (OPENBL_PROFILING == 1U)
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static OPENBL_ProfileTypeDef Profile;
+
+/* Private function prototypes -----------------------------------------------*/
+static void OPENBL_PROFILE_Accumulate(OPENBL_ProfileEntryTypeDef *pEntry, uint32_t Cycles);
+
+/* Exported variables --------------------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  This function is used to clear the counters and start the DWT cycle counter.
+  *         The counter wraps after 2^32 cycles, a single call must be shorter than that.
+  * @retval None.
+  */
+void OPENBL_PROFILE_Init(void)
+{
+  memset(&Profile, 0, sizeof(Profile));
+  Profile.CoreClock = SystemCoreClock;
+
+  SET_BIT(CoreDebug->DEMCR, CoreDebug_DEMCR_TRCENA_Msk);
+  DWT->CYCCNT = 0U;
+  SET_BIT(DWT->CTRL, DWT_CTRL_CYCCNTENA_Msk);
+}
+
+/**
+  * @brief  This function is used to record the duration of a command.
+  *         The commands get a slot on their first call, calls beyond OPENBL_PROFILE_CMD_SLOTS
+  *         different opcodes are not recorded.
+  * @param  Opcode The command opcode.
+  * @param  Cycles The duration of the command in CPU cycles.
+  * @retval None.
+  */
+void OPENBL_PROFILE_RecordCommand(uint8_t Opcode, uint32_t Cycles)
+{
+  uint32_t slot;
+
+  for (slot = 0U; slot < Profile.CmdNumber; slot++)
+  {
+    if (Profile.CmdOpcode[slot] == Opcode)
+    {
+      break;
+    }
+  }
+
+  if (slot == Profile.CmdNumber)
+  {
+    if (slot < OPENBL_PROFILE_CMD_SLOTS)
+    {
+      Profile.CmdOpcode[slot] = Opcode;
+      Profile.CmdNumber++;
+    }
+  }
+
+  if (slot < OPENBL_PROFILE_CMD_SLOTS)
+  {
+    OPENBL_PROFILE_Accumulate(&Profile.Cmd[slot], Cycles);
+  }
+}
+
+/**
+  * @brief  This function is used to record the duration of a memory layer call.
+  * @param  Id The memory layer entry point.
+  * @param  Cycles The duration of the call in CPU cycles.
+  * @retval None.
+  */
+void OPENBL_PROFILE_RecordMemory(OPENBL_ProfileMemTypeDef Id, uint32_t Cycles)
+{
+  if (Id < OPENBL_PROFILE_MEM_NUMBER)
+  {
+    OPENBL_PROFILE_Accumulate(&Profile.Mem[Id], Cycles);
+  }
+}
+
+/**
+  * @brief  This function is used to get the recorded counters.
+  * @return Returns a pointer to the counters.
+  */
+const OPENBL_ProfileTypeDef *OPENBL_PROFILE_Get(void)
+{
+  return &Profile;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  This function is used to add one call to a counter.
+  * @param  pEntry The counter to update.
+  * @param  Cycles The duration of the call in CPU cycles.
+  * @retval None.
+  */
+static void OPENBL_PROFILE_Accumulate(OPENBL_ProfileEntryTypeDef *pEntry, uint32_t Cycles)
+{
+  if ((pEntry->Count == 0U) || (Cycles < pEntry->Min))
+  {
+    pEntry->Min = Cycles;
+  }
+
+  if (Cycles > pEntry->Max)
+  {
+    pEntry->Max = Cycles;
+  }
+
+  pEntry->Sum += Cycles;
+  pEntry->Count++;
+}
+
+#endif /* (OPENBL_PROFILING == 1U) */
@@ -0,0 +1,76 @@
+/**
+  ******************************************************************************
+  * @file    openbl_profile.h
+  * @author  MCD Application Team
+  * @brief   Header for openbl_profile.c module
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2019-2021 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef OPENBL_PROFILE_H
+#define OPENBL_PROFILE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "openbootloader_conf.h"
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum
+{
+  OPENBL_PROFILE_MEM_READ            = 0x0U,
+  OPENBL_PROFILE_MEM_WRITE           = 0x1U,
+  OPENBL_PROFILE_MEM_ERASE           = 0x2U,
+  OPENBL_PROFILE_MEM_MASS_ERASE      = 0x3U,
+  OPENBL_PROFILE_MEM_BLANK_CHECK     = 0x4U,
+  OPENBL_PROFILE_MEM_WRITE_PROTECT   = 0x5U,
+  OPENBL_PROFILE_MEM_READOUT_PROTECT = 0x6U,
+  OPENBL_PROFILE_MEM_NUMBER          = 0x7U
+} OPENBL_ProfileMemTypeDef;
+
+typedef struct
+{
+  uint32_t Count;                   /* Number of recorded calls */
+  uint32_t Min;                     /* Shortest call in CPU cycles */
+  uint32_t Max;                     /* Longest call in CPU cycles */
+  uint64_t Sum;                     /* Cycles of all the recorded calls */
+} OPENBL_ProfileEntryTypeDef;
+
+typedef struct
+{
+  uint32_t CoreClock;                                            /* Cycles per second of the counts */
+  uint32_t CmdNumber;                                            /* Number of used command slots */
+  uint8_t CmdOpcode[OPENBL_PROFILE_CMD_SLOTS];                   /* Opcode recorded in each command slot */
+  OPENBL_ProfileEntryTypeDef Cmd[OPENBL_PROFILE_CMD_SLOTS];      /* Command handlers, link wait included */
+  OPENBL_ProfileEntryTypeDef Mem[OPENBL_PROFILE_MEM_NUMBER];     /* Memory layer entry points */
+} OPENBL_ProfileTypeDef;
+
+/* Exported constants --------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+#if (OPENBL_PROFILING == 1U)
+#define OPENBL_PROFILE_BEGIN(Start)               uint32_t Start = DWT->CYCCNT
+#define OPENBL_PROFILE_END_CMD(Opcode, Start)     OPENBL_PROFILE_RecordCommand((Opcode), DWT->CYCCNT - (Start))
+#define OPENBL_PROFILE_END_MEM(Id, Start)         OPENBL_PROFILE_RecordMemory((Id), DWT->CYCCNT - (Start))
+#else
+#define OPENBL_PROFILE_BEGIN(Start)
+#define OPENBL_PROFILE_END_CMD(Opcode, Start)
+#define OPENBL_PROFILE_END_MEM(Id, Start)
+#endif /* (OPENBL_PROFILING == 1U) */
+
+/* Exported functions ------------------------------------------------------- */
+#if (OPENBL_PROFILING == 1U)
+void OPENBL_PROFILE_Init(void);
+void OPENBL_PROFILE_RecordCommand(uint8_t Opcode, uint32_t Cycles);
+void OPENBL_PROFILE_RecordMemory(OPENBL_ProfileMemTypeDef Id, uint32_t Cycles);
+const OPENBL_ProfileTypeDef *OPENBL_PROFILE_Get(void);
+#endif /* (OPENBL_PROFILING == 1U) */
+
+#endif /* OPENBL_PROFILE_H */
@@ -17,78 +17,166 @@
   */
 
 /* Includes ------------------------------------------------------------------*/
+#include <string.h>
 #include "openbl_mem.h"
+#include "openbl_lz4.h"
+#include "openbl_delta.h"
+#include "openbl_profile.h"
 #include "openbl_usart_cmd.h"
 
 #include "openbootloader_conf.h"
 #include "Bootloader.h"
 #include "usart_interface.h"
 #include "common_interface.h"
+#include "crc_interface.h"
+#include "flash_interface.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
-#define OPENBL_USART_COMMANDS_NB_MAX      13U       /* The maximum number of supported commands */
+#define OPENBL_USART_SPEED_TIMEOUT        1000U     /* Time in ms given to the host to resynchronize after a speed change */
+
+#define USART_RAM_BUFFER_SIZE             4096U     /* Size of USART buffer used to store received data from the host */
+#define USART_STAGE_BUFFER_SIZE           16384U    /* Size of the buffer receiving a decompressed or patched frame */
+
+#define USART_DELTA_ERASE_SECTOR          0x01U     /* Delta write option: erase the target sector before programming */
+
+#define USART_BLANK                       0x00U     /* Blank check answer: the range is erased */
+#define USART_NOT_BLANK                   0x01U     /* Blank check answer: the range holds data */
+
+#define USART_EXT_READ_CHUNK_SIZE         4096U     /* Number of bytes between two intermediate CRC of the extended read */
+#define USART_EXT_READ_CHUNK_CRC          0x01U     /* Extended read option: send the running CRC after each chunk */
+
+#define USART_PROFILE_COMMAND             0x00U     /* Get profile record of a command, the id is its opcode */
+#define USART_PROFILE_MEMORY              0x01U     /* Get profile record of a memory layer entry point */
+#define USART_PROFILE_WORDS               5U        /* Count, min, max, sum MSB and sum LSB of a record */
+
+/* Commands compiled only when the profiling is enabled */
+#if (OPENBL_PROFILING == 1U)
+#define OPENBL_USART_PROFILE_COMMANDS(X)                              \
+  X(CMD_GET_PROFILE,             OPENBL_USART_GetProfile)
+#else
+#define OPENBL_USART_PROFILE_COMMANDS(X)
+#endif /* (OPENBL_PROFILING == 1U) */
+
+/* Commands compiled only when the compressed or delta write is enabled */
+#if (OPENBL_LZ4_WRITE == 1U)
+#define OPENBL_USART_LZ4_COMMANDS(X)                                  \
+  X(CMD_COMPRESSED_WRITE_MEMORY, OPENBL_USART_CompressedWriteMemory)
+#else
+#define OPENBL_USART_LZ4_COMMANDS(X)
+#endif /* (OPENBL_LZ4_WRITE == 1U) */
+
+#if (OPENBL_DELTA_WRITE == 1U)
+#define OPENBL_USART_DELTA_COMMANDS(X)                                \
+  X(CMD_DELTA_WRITE_MEMORY,      OPENBL_USART_DeltaWriteMemory)
+#else
+#define OPENBL_USART_DELTA_COMMANDS(X)
+#endif /* (OPENBL_DELTA_WRITE == 1U) */
+
+/* Supported commands, in the order of the Get Command answer: X(Opcode, Handler).
+   Adding a command is one line here, the handlers table and the Get Command list are derived from it.
+   The special and extended special commands are not enabled yet. */
+#define OPENBL_USART_COMMANDS(X)                                      \
+  X(CMD_GET_COMMAND,             OPENBL_USART_GetCommand)             \
+  X(CMD_GET_VERSION,             OPENBL_USART_GetVersion)             \
+  X(CMD_GET_ID,                  OPENBL_USART_GetID)                  \
+  X(CMD_SPEED,                   OPENBL_USART_Speed)                  \
+  X(CMD_READ_MEMORY,             OPENBL_USART_ReadMemory)             \
+  X(CMD_GO,                      OPENBL_USART_Go)                     \
+  X(CMD_WRITE_MEMORY,            OPENBL_USART_WriteMemory)            \
+  X(CMD_EXT_ERASE_MEMORY,        OPENBL_USART_EraseMemory)            \
+  X(CMD_WRITE_PROTECT,           OPENBL_USART_WriteProtect)           \
+  X(CMD_WRITE_UNPROTECT,         OPENBL_USART_WriteUnprotect)         \
+  X(CMD_READ_PROTECT,            OPENBL_USART_ReadoutProtect)         \
+  X(CMD_READ_UNPROTECT,          OPENBL_USART_ReadoutUnprotect)       \
+  X(CMD_EXT_WRITE_MEMORY,        OPENBL_USART_ExtendedWriteMemory)    \
+  X(CMD_EXT_READ_MEMORY,         OPENBL_USART_ExtendedReadMemory)     \
+  X(CMD_CHECKSUM,                OPENBL_USART_Checksum)               \
+  X(CMD_SECTORS_CHECKSUM,        OPENBL_USART_SectorsChecksum)        \
+  OPENBL_USART_LZ4_COMMANDS(X)                                        \
+  OPENBL_USART_DELTA_COMMANDS(X)                                      \
+  X(CMD_BLANK_CHECK,             OPENBL_USART_BlankCheck)             \
+  X(CMD_GET_STATISTICS,          OPENBL_USART_GetStatistics)          \
+  OPENBL_USART_PROFILE_COMMANDS(X)
 
-#define USART_RAM_BUFFER_SIZE             1164U     /* Size of USART buffer used to store received data from the host */
-
-/* Private macro -------------------------------------------------------------*/
-/* Private variables ---------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
+#define OPENBL_USART_HANDLER(Opcode, Handler)   [(Opcode)] = (Handler),
+#define OPENBL_USART_OPCODE(Opcode, Handler)    (Opcode),
+
 /* Private variables ---------------------------------------------------------*/
-static uint8_t USART_RAM_Buf[USART_RAM_BUFFER_SIZE];    /* Buffer used to store received data from the host */
-static uint8_t a_OPENBL_USART_CommandsList[OPENBL_USART_COMMANDS_NB_MAX] = {0};
-static uint8_t UsartCommandsNumber = 0U;
+static uint8_t USART_RAM_Buf[USART_RAM_BUFFER_SIZE] __ALIGNED(4);    /* Buffer used to store received data from the host */
+#if (OPENBL_LZ4_WRITE == 1U) || (OPENBL_DELTA_WRITE == 1U)
+static uint8_t USART_Stage_Buf[USART_STAGE_BUFFER_SIZE] __ALIGNED(4);    /* Buffer used to rebuild a frame before writing it */
+#endif /* (OPENBL_LZ4_WRITE == 1U) || (OPENBL_DELTA_WRITE == 1U) */
+
+/* Command handlers indexed by opcode, stored in FLASH */
+static const OPENBL_CommandHandlerTypeDef a_OPENBL_USART_Handlers[OPENBL_COMMANDS_NUMBER] =
+{
+  OPENBL_USART_COMMANDS(OPENBL_USART_HANDLER)
+
+  /* The legacy erase opcode is served by the extended erase, it is not listed by Get Command */
+  [CMD_LEG_ERASE_MEMORY] = OPENBL_USART_EraseMemory
+};
+
+/* Opcodes returned by the Get Command command */
+static const uint8_t a_OPENBL_USART_CommandsList[] = { OPENBL_USART_COMMANDS(OPENBL_USART_OPCODE) };
+
+#if (OPENBL_PIPELINED_WRITE == 1U)
+static FlagStatus UsartWriteError = RESET;               /* Latched failure of an already acknowledged flash write */
+#endif /* (OPENBL_PIPELINED_WRITE == 1U) */
+
+static uint32_t UsartChecksumErrors = 0U;                /* Addresses and write frames received with a wrong checksum */
+static uint32_t UsartRetransmits = 0U;                   /* Write frames received again for the address of the previous one */
+static uint32_t UsartLastWriteAddress = 0xFFFFFFFFU;     /* Address of the previous write frame */
 
 /* Private function prototypes -----------------------------------------------*/
 static uint8_t OPENBL_USART_GetAddress(uint32_t *Address);
 static uint8_t OPENBL_USART_GetSpecialCmdOpCode(uint16_t *OpCode, OPENBL_SpecialCmdTypeTypeDef CmdType);
-static uint8_t OPENBL_USART_ConstructCommandsTable(OPENBL_CommandsTypeDef *pUsartCmd);
+static void OPENBL_USART_WriteReceivedData(uint32_t Address, uint8_t *pData, uint32_t DataLength);
+static void OPENBL_USART_SendWord(uint32_t Word);
+static void OPENBL_USART_CheckRetransmit(uint32_t Address);
+#if (OPENBL_PIPELINED_WRITE == 1U)
+static void OPENBL_USART_PipelinedWrite(uint32_t Address, uint8_t *pData, uint32_t DataLength);
+#endif /* (OPENBL_PIPELINED_WRITE == 1U) */
 
 /* Exported variables --------------------------------------------------------*/
 /* Exported functions---------------------------------------------------------*/
 
 /**
-  * @brief  This function is used to get a pointer to the structure that contains the available USART commands.
-  * @return Returns a pointer to the OPENBL_USART_Commands struct.
+  * @brief  This function is used to get the table of the USART command handlers.
+  * @return Returns a pointer to the OPENBL_COMMANDS_NUMBER handlers indexed by opcode.
+  */
+const OPENBL_CommandHandlerTypeDef *OPENBL_USART_GetCommandsList(void)
+{
+  return a_OPENBL_USART_Handlers;
+}
+
+#if (OPENBL_PIPELINED_WRITE == 1U)
+/**
+  * @brief  This function is used to take the failure of an already acknowledged flash write.
+  *         It is called for every received command: the command following the failure is refused,
+  *         whatever it is, so the host learns about it before sending anything else.
+  * @retval Returns SET once per failed write else RESET.
   */
-OPENBL_CommandsTypeDef *OPENBL_USART_GetCommandsList(void)
-{
-  static OPENBL_CommandsTypeDef OPENBL_USART_Commands =
-  {
-    OPENBL_USART_GetCommand,
-    OPENBL_USART_GetVersion,
-    OPENBL_USART_GetID,
-    OPENBL_USART_ReadMemory,
-    OPENBL_USART_WriteMemory,
-    OPENBL_USART_Go,
-    OPENBL_USART_ReadoutProtect,
-    OPENBL_USART_ReadoutUnprotect,
-    OPENBL_USART_EraseMemory,
-    OPENBL_USART_WriteProtect,
-    OPENBL_USART_WriteUnprotect,
-    NULL,
-    NULL,
-    NULL,
-    NULL,
-    NULL,
-    NULL,
-    NULL,
-    NULL, // OPENBL_USART_SpecialCommand, TODO check if this is valids
-    NULL  //OPENBL_USART_ExtendedSpecialCommand
-  };
-
-  OPENBL_USART_SetCommandsList(&OPENBL_USART_Commands);
-
-  return (&OPENBL_USART_Commands);
-}
-
-/**
-  * @brief  This function is used to set the list of USART supported commands.
-  * @return None.
+FlagStatus OPENBL_USART_TakeWriteError(void)
+{
+  FlagStatus error = UsartWriteError;
+
+  UsartWriteError = RESET;
+
+  return error;
+}
+#endif /* (OPENBL_PIPELINED_WRITE == 1U) */
+
+/**
+  * @brief  Called by the FLASH interrupt between two background sector erases, it overrides the
+  *         weak default of the FLASH interface. The RX DMA keeps filling the ring during an erase,
+  *         the next erase is delayed while received bytes wait so the pending command is processed first.
+  * @retval Returns SET if received bytes are waiting in the RX ring else RESET.
   */
-void OPENBL_USART_SetCommandsList(OPENBL_CommandsTypeDef *pUsartCmd)
+FlagStatus OPENBL_FLASH_EraseYieldCallback(void)
 {
-  UsartCommandsNumber = OPENBL_USART_ConstructCommandsTable(pUsartCmd);
+  return (OPENBL_USART_GetRxCount() != 0U) ? SET : RESET;
 }
 
 /**
@@ -97,25 +185,29 @@ void OPENBL_USART_SetCommandsList(OPENBL_CommandsTypeDef *pUsartCmd)
   */
 void OPENBL_USART_GetCommand(void)
 {
+  uint8_t response[sizeof(a_OPENBL_USART_CommandsList) + 4U];
   uint32_t counter;
+  uint32_t length = 0U;
 
-  /* Send Acknowledge byte to notify the host that the command is recognized */
-  OPENBL_USART_SendByte(ACK_BYTE);
+  /* Acknowledge byte to notify the host that the command is recognized */
+  response[length++] = ACK_BYTE;
 
-  /* Send the number of commands supported by the USART protocol */
-  OPENBL_USART_SendByte(UsartCommandsNumber);
+  /* Number of commands supported by the USART protocol */
+  response[length++] = (uint8_t)sizeof(a_OPENBL_USART_CommandsList);
 
-  /* Send USART protocol version */
-  OPENBL_USART_SendByte(OPENBL_USART_VERSION);
+  /* USART protocol version */
+  response[length++] = OPENBL_USART_VERSION;
 
-  /* Send the list of supported commands */
-  for (counter = 0U; counter < UsartCommandsNumber; counter++)
+  /* List of supported commands */
+  for (counter = 0U; counter < sizeof(a_OPENBL_USART_CommandsList); counter++)
   {
-    OPENBL_USART_SendByte(a_OPENBL_USART_CommandsList[counter]);
+    response[length++] = a_OPENBL_USART_CommandsList[counter];
   }
 
-  /* Send last Acknowledge synchronization byte */
-  OPENBL_USART_SendByte(ACK_BYTE);
+  /* Last Acknowledge synchronization byte */
+  response[length++] = ACK_BYTE;
+
+  OPENBL_USART_SendBuffer(response, length);
 }
 
 /**
@@ -124,17 +216,10 @@ void OPENBL_USART_GetCommand(void)
   */
 void OPENBL_USART_GetVersion(void)
 {
-  /* Send Acknowledge byte to notify the host that the command is recognized */
-  OPENBL_USART_SendByte(ACK_BYTE);
-
-  /* Send USART protocol version */
-  OPENBL_USART_SendByte(OPENBL_USART_VERSION);
+  /* Acknowledge byte, USART protocol version, two option bytes and last Acknowledge synchronization byte */
+  uint8_t response[5] = {ACK_BYTE, OPENBL_USART_VERSION, 0x00U, 0x00U, ACK_BYTE};
 
-  OPENBL_USART_SendByte(0x00);
-  OPENBL_USART_SendByte(0x00);
-
-  /* Send last Acknowledge synchronization byte */
-  OPENBL_USART_SendByte(ACK_BYTE);
+  OPENBL_USART_SendBuffer(response, sizeof(response));
 }
 
 /**
@@ -143,17 +228,20 @@ void OPENBL_USART_GetVersion(void)
   */
 void OPENBL_USART_GetID(void)
 {
-  /* Send Acknowledge byte to notify the host that the command is recognized */
-  OPENBL_USART_SendByte(ACK_BYTE);
+  uint8_t response[5];
 
-  OPENBL_USART_SendByte(0x01);
+  /* Acknowledge byte to notify the host that the command is recognized */
+  response[0] = ACK_BYTE;
+  response[1] = 0x01U;
 
-  /* Send the device ID starting by the MSB byte then the LSB byte */
-  OPENBL_USART_SendByte(DEVICE_ID_MSB);
-  OPENBL_USART_SendByte(DEVICE_ID_LSB);
+  /* Device ID starting by the MSB byte then the LSB byte */
+  response[2] = (uint8_t)(DEVICE_ID_MSB);
+  response[3] = (uint8_t)(DEVICE_ID_LSB);
 
-  /* Send last Acknowledge synchronization byte */
-  OPENBL_USART_SendByte(ACK_BYTE);
+  /* Last Acknowledge synchronization byte */
+  response[4] = ACK_BYTE;
+
+  OPENBL_USART_SendBuffer(response, sizeof(response));
 }
 
 /**
@@ -171,7 +259,7 @@ void OPENBL_USART_ReadMemory(void)
   /* Check memory protection then send adequate response */
   if (Common_GetProtectionStatus() != RESET)
   {
-    OPENBL_USART_SendByte(NACK_BYTE);
+    OPENBL_USART_SendNack();
   }
   else
   {
@@ -180,7 +268,7 @@ void OPENBL_USART_ReadMemory(void)
     /* Get the memory address */
     if (OPENBL_USART_GetAddress(&address) == NACK_BYTE)
     {
-      OPENBL_USART_SendByte(NACK_BYTE);
+      OPENBL_USART_SendNack();
     }
     else
     {
@@ -190,29 +278,572 @@ void OPENBL_USART_ReadMemory(void)
       data = OPENBL_USART_ReadByte();
       xor  = ~data;
 
-      /* Check data integrity */
-      if (OPENBL_USART_ReadByte() != xor)
+      /* Check data integrity, the whole range must be in the memory of the start address */
+      if ((OPENBL_USART_ReadByte() != xor) || (OPENBL_MEM_CheckRange(address, (uint32_t)data + 1U) != SUCCESS))
       {
-        OPENBL_USART_SendByte(NACK_BYTE);
+        OPENBL_USART_SendNack();
       }
       else
       {
-        OPENBL_USART_SendByte(ACK_BYTE);
+        /* Stage the acknowledge byte and the data (data + 1) in one buffer to send them in a single transfer */
+        USART_RAM_Buf[0] = ACK_BYTE;
 
         /* Get the memory index to know from which memory we will read */
         memory_index = OPENBL_MEM_GetMemoryIndex(address);
 
-        /* Read the data (data + 1) from the memory and send them to the host */
-        for (counter = ((uint32_t)data + 1U); counter != 0U; counter--)
+        for (counter = 1U; counter <= ((uint32_t)data + 1U); counter++)
         {
-          OPENBL_USART_SendByte(OPENBL_MEM_Read(address, memory_index));
+          USART_RAM_Buf[counter] = OPENBL_MEM_Read(address, memory_index);
           address++;
         }
+
+        OPENBL_USART_SendBuffer(USART_RAM_Buf, counter);
+      }
+    }
+  }
+}
+
+#if (OPENBL_LZ4_WRITE == 1U)
+/**
+ * @brief  This function is used to write a LZ4 compressed frame in to device memory.
+ *         After the address phase the host sends the compressed length minus one and the decompressed
+ *         length minus one, each on 2 bytes (MSB first), followed by the XOR of these 4 bytes. It then
+ *         sends one independent LZ4 block of up to USART_RAM_BUFFER_SIZE bytes and the CRC32 of the
+ *         decompressed data on 4 bytes (MSB first) as computed by OPENBL_CRC_Calculate().
+ *         A frame decompresses to at most USART_STAGE_BUFFER_SIZE bytes.
+ * @retval None.
+ */
+void OPENBL_USART_CompressedWriteMemory(void)
+{
+  uint32_t address;
+  uint32_t codesize;
+  uint32_t datasize;
+  uint32_t length;
+  uint32_t crc;
+  uint8_t data[5];
+
+  /* Check memory protection then send adequate response */
+  if (Common_GetProtectionStatus() != RESET)
+  {
+    OPENBL_USART_SendNack();
+  }
+  else
+  {
+    OPENBL_USART_SendByte(ACK_BYTE);
+
+    /* Get the memory address */
+    if (OPENBL_USART_GetAddress(&address) == NACK_BYTE)
+    {
+      OPENBL_USART_SendNack();
+    }
+    else
+    {
+      OPENBL_USART_SendByte(ACK_BYTE);
+
+      OPENBL_USART_CheckRetransmit(address);
+
+      /* Read the compressed and decompressed sizes and their checksum */
+      OPENBL_USART_ReadBuffer(data, 5U);
+
+      codesize = (((uint32_t)data[0] << 8) | (uint32_t)data[1]) + 1U;
+      datasize = (((uint32_t)data[2] << 8) | (uint32_t)data[3]) + 1U;
+
+      if (((data[0] ^ data[1] ^ data[2] ^ data[3]) != data[4])
+          || (codesize > USART_RAM_BUFFER_SIZE) || (datasize > USART_STAGE_BUFFER_SIZE))
+      {
+        OPENBL_USART_SendNack();
+      }
+      else
+      {
+        OPENBL_USART_ReadBuffer(USART_RAM_Buf, codesize);
+        OPENBL_USART_ReadBuffer(data, 4U);
+
+        crc = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+
+        /* Send NACK if the block is malformed or does not match the announced size and CRC */
+        if ((OPENBL_LZ4_DecompressBlock(USART_RAM_Buf, codesize, USART_Stage_Buf, datasize, &length) != SUCCESS)
+            || (length != datasize) || (OPENBL_CRC_Calculate(USART_Stage_Buf, datasize) != crc))
+        {
+          UsartChecksumErrors++;
+
+          OPENBL_USART_SendNack();
+        }
+        else
+        {
+          OPENBL_USART_WriteReceivedData(address, USART_Stage_Buf, datasize);
+        }
+      }
+    }
+  }
+}
+#endif /* (OPENBL_LZ4_WRITE == 1U) */
+
+#if (OPENBL_DELTA_WRITE == 1U)
+/**
+ * @brief  This function is used to rebuild a block of the new image from a patch against the installed one.
+ *         After the address phase the host sends the patch length minus one and the block length minus one,
+ *         each on 2 bytes (MSB first), an option byte and the XOR of these 5 bytes. It then sends the patch
+ *         (see OPENBL_DELTA_Apply()) of up to USART_RAM_BUFFER_SIZE bytes and the CRC32 of the rebuilt block
+ *         on 4 bytes (MSB first) as computed by OPENBL_CRC_Calculate().
+ *         The block, of up to USART_STAGE_BUFFER_SIZE bytes, must lie in one user FLASH sector. With the
+ *         USART_DELTA_ERASE_SECTOR option the block must be the whole sector: it is fully rebuilt in RAM before
+ *         the sector is erased, so it can copy from the old content of that same sector. Only the 16 KB sectors
+ *         can be patched in place this way, the option is refused for the larger ones, whose old content would
+ *         be lost for their next blocks. Blocks of sectors rewritten before read the FLASH as it is then.
+ * @retval None.
+ */
+void OPENBL_USART_DeltaWriteMemory(void)
+{
+  uint32_t address;
+  uint32_t patchsize;
+  uint32_t datasize;
+  uint32_t length;
+  uint32_t first_sector;
+  uint32_t last_sector;
+  uint32_t sector_address;
+  uint32_t sector_size;
+  uint32_t crc;
+  uint8_t data[6];
+
+  /* Check memory protection then send adequate response */
+  if (Common_GetProtectionStatus() != RESET)
+  {
+    OPENBL_USART_SendNack();
+  }
+  else
+  {
+    OPENBL_USART_SendByte(ACK_BYTE);
+
+    /* Get the memory address */
+    if (OPENBL_USART_GetAddress(&address) == NACK_BYTE)
+    {
+      OPENBL_USART_SendNack();
+    }
+    else
+    {
+      OPENBL_USART_SendByte(ACK_BYTE);
+
+      OPENBL_USART_CheckRetransmit(address);
+
+      /* Read the patch and block sizes, the options and their checksum */
+      OPENBL_USART_ReadBuffer(data, 6U);
+
+      patchsize = (((uint32_t)data[0] << 8) | (uint32_t)data[1]) + 1U;
+      datasize  = (((uint32_t)data[2] << 8) | (uint32_t)data[3]) + 1U;
+
+      if (((data[0] ^ data[1] ^ data[2] ^ data[3] ^ data[4]) != data[5])
+          || (patchsize > USART_RAM_BUFFER_SIZE) || (datasize > USART_STAGE_BUFFER_SIZE))
+      {
+        OPENBL_USART_SendNack();
+      }
+      else
+      {
+        OPENBL_USART_ReadBuffer(USART_RAM_Buf, patchsize);
+        OPENBL_USART_ReadBuffer(data, 4U);
+
+        crc = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+
+        /* The patch copies from the installed image, which must not be under erase */
+        (void)OPENBL_FLASH_WaitForErase();
+
+        /* The block must be in a single user FLASH sector */
+        if ((address < USERPROG_START_ADDRESS)
+            || (OPENBL_FLASH_GetSectorFromAddress(address, &first_sector) != SUCCESS)
+            || (OPENBL_FLASH_GetSectorFromAddress(address + datasize - 1U, &last_sector) != SUCCESS)
+            || (first_sector != last_sector))
+        {
+          OPENBL_USART_SendNack();
+        }
+        /* The erase loses the old content of the whole sector, the block must rebuild all of it */
+        else if (((data[4] & USART_DELTA_ERASE_SECTOR) != 0U)
+                 && ((OPENBL_FLASH_GetSectorInfo(first_sector, &sector_address, &sector_size) != SUCCESS)
+                     || (address != sector_address) || (datasize != sector_size)))
+        {
+          OPENBL_USART_SendNack();
+        }
+        /* The rebuilt block must match the announced size and CRC */
+        else if ((OPENBL_DELTA_Apply(USART_RAM_Buf, patchsize, USART_Stage_Buf, datasize, &length) != SUCCESS)
+                 || (length != datasize) || (OPENBL_CRC_Calculate(USART_Stage_Buf, datasize) != crc))
+        {
+          UsartChecksumErrors++;
+
+          OPENBL_USART_SendNack();
+        }
+        else if (((data[4] & USART_DELTA_ERASE_SECTOR) != 0U) && (OPENBL_FLASH_EraseSector(first_sector) != SUCCESS))
+        {
+          OPENBL_USART_SendNack();
+        }
+        else
+        {
+          OPENBL_USART_WriteReceivedData(address, USART_Stage_Buf, datasize);
+        }
+      }
+    }
+  }
+}
+#endif /* (OPENBL_DELTA_WRITE == 1U) */
+
+/**
+ * @brief  This function is used to read up to 64 KB of memory from the device in one command.
+ *         After the address phase the host sends the number of bytes minus one on 2 bytes (MSB first),
+ *         an option byte and the XOR of these 3 bytes. The device answers ACK, the data, then the
+ *         CRC32 of the data on 4 bytes (MSB first) as computed by OPENBL_CRC_Calculate().
+ *         With USART_EXT_READ_CHUNK_CRC set in the options, the running CRC is also sent after each
+ *         USART_EXT_READ_CHUNK_SIZE bytes so the host can locate a corrupted chunk.
+ *         The data is sent directly from the memory mapped region by the TX DMA.
+ * @retval None.
+ */
+void OPENBL_USART_ExtendedReadMemory(void)
+{
+  uint32_t address;
+  uint32_t length;
+  uint32_t chunk;
+  uint32_t crc = 0U;
+  uint8_t data[4];
+
+  /* Check memory protection then send adequate response */
+  if (Common_GetProtectionStatus() != RESET)
+  {
+    OPENBL_USART_SendNack();
+  }
+  else
+  {
+    OPENBL_USART_SendByte(ACK_BYTE);
+
+    /* Get the memory address */
+    if (OPENBL_USART_GetAddress(&address) == NACK_BYTE)
+    {
+      OPENBL_USART_SendNack();
+    }
+    else
+    {
+      OPENBL_USART_SendByte(ACK_BYTE);
+
+      /* Get the number of bytes to be sent and the options */
+      OPENBL_USART_ReadBuffer(data, 4U);
+
+      length = (((uint32_t)data[0] << 8) | (uint32_t)data[1]) + 1U;
+
+      /* Only memories read through their memory mapping can be streamed, system memory reads are not supported */
+      if (((data[0] ^ data[1] ^ data[2]) != data[3])
+          || (OPENBL_MEM_CheckRange(address, length) != SUCCESS)
+          || (OPENBL_MEM_GetAddressArea(address) == ICP_AREA))
+      {
+        OPENBL_USART_SendNack();
+      }
+      else
+      {
+        (void)OPENBL_FLASH_WaitForErase();
+        OPENBL_USART_SendByte(ACK_BYTE);
+
+        OPENBL_CRC_Reset();
+
+        while (length != 0U)
+        {
+          chunk = (length > USART_EXT_READ_CHUNK_SIZE) ? USART_EXT_READ_CHUNK_SIZE : length;
+
+          crc = OPENBL_CRC_Accumulate((uint8_t *)address, chunk);
+
+          OPENBL_USART_SendBuffer((uint8_t *)address, chunk);
+
+          address += chunk;
+          length  -= chunk;
+
+          /* The last running CRC is the CRC of the whole data, it is sent once below */
+          if (((data[2] & USART_EXT_READ_CHUNK_CRC) != 0U) && (length != 0U))
+          {
+            OPENBL_USART_SendWord(crc);
+          }
+        }
+
+        OPENBL_USART_SendWord(crc);
+      }
+    }
+  }
+}
+
+/**
+ * @brief  This function is used to compute the CRC32 of a memory range with the CRC unit.
+ *         After the address phase the host sends the number of bytes on 4 bytes (MSB first) followed
+ *         by their XOR. The device answers ACK then the CRC32 on 4 bytes (MSB first), computed the same
+ *         way as OPENBL_CRC_Calculate() so it matches the CRC of the extended read and write commands.
+ * @retval None.
+ */
+void OPENBL_USART_Checksum(void)
+{
+  uint32_t address;
+  uint32_t length;
+  uint32_t crc;
+  uint8_t data[5];
+
+  /* Check memory protection then send adequate response */
+  if (Common_GetProtectionStatus() != RESET)
+  {
+    OPENBL_USART_SendNack();
+  }
+  else
+  {
+    OPENBL_USART_SendByte(ACK_BYTE);
+
+    /* Get the memory address */
+    if (OPENBL_USART_GetAddress(&address) == NACK_BYTE)
+    {
+      OPENBL_USART_SendNack();
+    }
+    else
+    {
+      OPENBL_USART_SendByte(ACK_BYTE);
+
+      /* Get the number of bytes and its checksum */
+      OPENBL_USART_ReadBuffer(data, 5U);
+
+      length = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+
+      /* The range is read through its memory mapping, system memory is not supported */
+      if (((data[0] ^ data[1] ^ data[2] ^ data[3]) != data[4])
+          || (OPENBL_MEM_CheckRange(address, length) != SUCCESS)
+          || (OPENBL_MEM_GetAddressArea(address) == ICP_AREA))
+      {
+        OPENBL_USART_SendNack();
+      }
+      else
+      {
+        (void)OPENBL_FLASH_WaitForErase();
+        crc = OPENBL_CRC_Calculate((uint8_t *)address, length);
+
+        OPENBL_USART_SendByte(ACK_BYTE);
+        OPENBL_USART_SendWord(crc);
+      }
+    }
+  }
+}
+
+/**
+ * @brief  This function is used to get the CRC32 of every FLASH sector in a single response.
+ *         The device answers ACK, the number of sectors minus one, then the CRC32 of each sector
+ *         on 4 bytes (MSB first) from sector 0 upwards, computed as OPENBL_CRC_Calculate() does.
+ *         The host compares them with its image to skip the sectors that are already up to date.
+ * @retval None.
+ */
+void OPENBL_USART_SectorsChecksum(void)
+{
+  uint32_t sector;
+  uint32_t address;
+  uint32_t size;
+  uint32_t crc;
+  uint32_t counter;
+
+  /* Check memory protection then send adequate response */
+  if (Common_GetProtectionStatus() != RESET)
+  {
+    OPENBL_USART_SendNack();
+  }
+  else
+  {
+    USART_RAM_Buf[0] = ACK_BYTE;
+    USART_RAM_Buf[1] = (uint8_t)(OPENBL_FLASH_GetSectorsNumber() - 1U);
+    counter          = 2U;
+
+    (void)OPENBL_FLASH_WaitForErase();
+
+    for (sector = 0U; sector < OPENBL_FLASH_GetSectorsNumber(); sector++)
+    {
+      (void)OPENBL_FLASH_GetSectorInfo(sector, &address, &size);
+
+      crc = OPENBL_CRC_Calculate((uint8_t *)address, size);
+
+      USART_RAM_Buf[counter++] = (uint8_t)(crc >> 24);
+      USART_RAM_Buf[counter++] = (uint8_t)(crc >> 16);
+      USART_RAM_Buf[counter++] = (uint8_t)(crc >> 8);
+      USART_RAM_Buf[counter++] = (uint8_t)crc;
+    }
+
+    OPENBL_USART_SendBuffer(USART_RAM_Buf, counter);
+  }
+}
+
+/**
+ * @brief  This function is used to check if a memory range is erased.
+ *         After the address phase the host sends the number of bytes on 4 bytes (MSB first) followed
+ *         by their XOR. The device answers ACK then USART_BLANK or USART_NOT_BLANK, or NACK if the range
+ *         is invalid or not in FLASH.
+ * @retval None.
+ */
+void OPENBL_USART_BlankCheck(void)
+{
+  uint32_t address;
+  uint32_t length;
+  uint8_t data[5];
+
+  /* Check memory protection then send adequate response */
+  if (Common_GetProtectionStatus() != RESET)
+  {
+    OPENBL_USART_SendNack();
+  }
+  else
+  {
+    OPENBL_USART_SendByte(ACK_BYTE);
+
+    /* Get the memory address */
+    if (OPENBL_USART_GetAddress(&address) == NACK_BYTE)
+    {
+      OPENBL_USART_SendNack();
+    }
+    else
+    {
+      OPENBL_USART_SendByte(ACK_BYTE);
+
+      /* Get the number of bytes and its checksum */
+      OPENBL_USART_ReadBuffer(data, 5U);
+
+      length = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+
+      /* Only the FLASH provides a blank check */
+      if (((data[0] ^ data[1] ^ data[2] ^ data[3]) != data[4])
+          || (OPENBL_MEM_CheckRange(address, length) != SUCCESS) || (OPENBL_MEM_GetAddressArea(address) != FLASH_AREA))
+      {
+        OPENBL_USART_SendNack();
+      }
+      else
+      {
+        data[0] = ACK_BYTE;
+        data[1] = (OPENBL_MEM_BlankCheck(address, length) == SUCCESS) ? USART_BLANK : USART_NOT_BLANK;
+
+        OPENBL_USART_SendBuffer(data, 2U);
       }
     }
   }
 }
 
+/**
+ * @brief  This function is used to get the bootloader statistics since reset.
+ *         The device answers ACK, the number of counters minus one, then each counter on 4 bytes (MSB first):
+ *         - FLASH words programmed
+ *         - FLASH words equal to 0xFFFFFFFF skipped by the write path
+ *         - USART overrun, framing, noise and parity errors
+ *         - RX DMA restarts after a transfer error
+ *         - command opcodes not followed by their complement
+ *         - addresses and write frames received with a wrong checksum
+ *         - write frames retransmitted by the host
+ *         - FLASH sector erases that failed, the background ones fail after their command is answered
+ *         It then sends the number of commands that sent a NACK, and for each of them its opcode
+ *         followed by its number of NACK on 4 bytes (MSB first).
+ * @retval None.
+ */
+void OPENBL_USART_GetStatistics(void)
+{
+  OPENBL_USART_LinkStatisticsTypeDef link;
+  uint32_t counters[11];
+  uint32_t nacks;
+  uint32_t index;
+  uint32_t records;
+  uint32_t length = 0U;
+
+  OPENBL_FLASH_GetWriteStatistics(&counters[0], &counters[1]);
+  OPENBL_USART_GetLinkStatistics(&link);
+
+  counters[2] = link.OverrunErrors;
+  counters[3] = link.FramingErrors;
+  counters[4] = link.NoiseErrors;
+  counters[5] = link.ParityErrors;
+  counters[6] = link.DmaRestarts;
+  counters[7] = link.OpcodeErrors;
+  counters[8] = UsartChecksumErrors;
+  counters[9] = UsartRetransmits;
+  counters[10] = OPENBL_FLASH_GetEraseErrors();
+
+  USART_RAM_Buf[length++] = ACK_BYTE;
+  USART_RAM_Buf[length++] = (uint8_t)((sizeof(counters) / sizeof(counters[0])) - 1U);
+
+  for (index = 0U; index < (sizeof(counters) / sizeof(counters[0])); index++)
+  {
+    USART_RAM_Buf[length++] = (uint8_t)(counters[index] >> 24);
+    USART_RAM_Buf[length++] = (uint8_t)(counters[index] >> 16);
+    USART_RAM_Buf[length++] = (uint8_t)(counters[index] >> 8);
+    USART_RAM_Buf[length++] = (uint8_t)counters[index];
+  }
+
+  /* Number of records, filled once the commands are counted */
+  records = length++;
+  USART_RAM_Buf[records] = 0U;
+
+  for (index = 0U; index < OPENBL_COMMANDS_NUMBER; index++)
+  {
+    nacks = OPENBL_USART_GetNackCount((uint8_t)index);
+
+    if ((nacks != 0U) && (USART_RAM_Buf[records] < 0xFFU))
+    {
+      USART_RAM_Buf[records]++;
+      USART_RAM_Buf[length++] = (uint8_t)index;
+      USART_RAM_Buf[length++] = (uint8_t)(nacks >> 24);
+      USART_RAM_Buf[length++] = (uint8_t)(nacks >> 16);
+      USART_RAM_Buf[length++] = (uint8_t)(nacks >> 8);
+      USART_RAM_Buf[length++] = (uint8_t)nacks;
+    }
+  }
+
+  OPENBL_USART_SendBuffer(USART_RAM_Buf, length);
+}
+
+#if (OPENBL_PROFILING == 1U)
+/**
+ * @brief  This function is used to get the cycle counts recorded since reset.
+ *         The device answers ACK, the core clock on 4 bytes, the number of records minus one,
+ *         then for each record its type (0: command, 1: memory entry point), its id (opcode or
+ *         OPENBL_ProfileMemTypeDef value), the count, min and max on 4 bytes and the sum on 8 bytes,
+ *         all MSB first. A command record covers the handler with its link wait, not the opcode.
+ * @retval None.
+ */
+void OPENBL_USART_GetProfile(void)
+{
+  const OPENBL_ProfileTypeDef *p_profile = OPENBL_PROFILE_Get();
+  const OPENBL_ProfileEntryTypeDef *p_entry;
+  uint32_t words[USART_PROFILE_WORDS];
+  uint32_t record;
+  uint32_t index;
+  uint32_t length = 0U;
+
+  USART_RAM_Buf[length++] = ACK_BYTE;
+  USART_RAM_Buf[length++] = (uint8_t)(p_profile->CoreClock >> 24);
+  USART_RAM_Buf[length++] = (uint8_t)(p_profile->CoreClock >> 16);
+  USART_RAM_Buf[length++] = (uint8_t)(p_profile->CoreClock >> 8);
+  USART_RAM_Buf[length++] = (uint8_t)p_profile->CoreClock;
+  USART_RAM_Buf[length++] = (uint8_t)(p_profile->CmdNumber + OPENBL_PROFILE_MEM_NUMBER - 1U);
+
+  for (record = 0U; record < (p_profile->CmdNumber + OPENBL_PROFILE_MEM_NUMBER); record++)
+  {
+    if (record < p_profile->CmdNumber)
+    {
+      p_entry = &p_profile->Cmd[record];
+      USART_RAM_Buf[length++] = USART_PROFILE_COMMAND;
+      USART_RAM_Buf[length++] = p_profile->CmdOpcode[record];
+    }
+    else
+    {
+      p_entry = &p_profile->Mem[record - p_profile->CmdNumber];
+      USART_RAM_Buf[length++] = USART_PROFILE_MEMORY;
+      USART_RAM_Buf[length++] = (uint8_t)(record - p_profile->CmdNumber);
+    }
+
+    words[0] = p_entry->Count;
+    words[1] = p_entry->Min;
+    words[2] = p_entry->Max;
+    words[3] = (uint32_t)(p_entry->Sum >> 32);
+    words[4] = (uint32_t)p_entry->Sum;
+
+    for (index = 0U; index < USART_PROFILE_WORDS; index++)
+    {
+      USART_RAM_Buf[length++] = (uint8_t)(words[index] >> 24);
+      USART_RAM_Buf[length++] = (uint8_t)(words[index] >> 16);
+      USART_RAM_Buf[length++] = (uint8_t)(words[index] >> 8);
+      USART_RAM_Buf[length++] = (uint8_t)words[index];
+    }
+  }
+
+  OPENBL_USART_SendBuffer(USART_RAM_Buf, length);
+}
+#endif /* (OPENBL_PROFILING == 1U) */
+
 /**
  * @brief  This function is used to write in to device memory.
  * @retval None.
@@ -229,7 +860,7 @@ void OPENBL_USART_WriteMemory(void)
   /* Check memory protection then send adequate response */
   if (Common_GetProtectionStatus() != RESET)
   {
-    OPENBL_USART_SendByte(NACK_BYTE);
+    OPENBL_USART_SendNack();
   }
   else
   {
@@ -238,12 +869,14 @@ void OPENBL_USART_WriteMemory(void)
     /* Get the memory address */
     if (OPENBL_USART_GetAddress(&address) == NACK_BYTE)
     {
-      OPENBL_USART_SendByte(NACK_BYTE);
+      OPENBL_USART_SendNack();
     }
     else
     {
       OPENBL_USART_SendByte(ACK_BYTE);
 
+      OPENBL_USART_CheckRetransmit(address);
+
       /* Read number of bytes to be written and data */
       ramaddress = (uint8_t *)USART_RAM_Buf;
 
@@ -257,12 +890,11 @@ void OPENBL_USART_WriteMemory(void)
       tmpXOR = data;
 
       /* UART receive data and send to RAM Buffer */
+      OPENBL_USART_ReadBuffer(ramaddress, codesize);
+
       for (counter = codesize; counter != 0U ; counter--)
       {
-        data    = OPENBL_USART_ReadByte();
-        tmpXOR ^= data;
-
-        *(__IO uint8_t *)(ramaddress) = data;
+        tmpXOR ^= *ramaddress;
 
         ramaddress++;
       }
@@ -270,18 +902,78 @@ void OPENBL_USART_WriteMemory(void)
       /* Send NACk if Checksum is incorrect */
       if (OPENBL_USART_ReadByte() != tmpXOR)
       {
-        OPENBL_USART_SendByte(NACK_BYTE);
+        UsartChecksumErrors++;
+
+        OPENBL_USART_SendNack();
       }
       else
       {
-        /* Write data to memory */
-        OPENBL_MEM_Write(address, (uint8_t *)USART_RAM_Buf, codesize);
+        OPENBL_USART_WriteReceivedData(address, USART_RAM_Buf, codesize);
+      }
+    }
+  }
+}
 
-        /* Send last Acknowledge synchronization byte */
-        OPENBL_USART_SendByte(ACK_BYTE);
+/**
+ * @brief  This function is used to write in to device memory with frames of up to USART_RAM_BUFFER_SIZE bytes.
+ *         After the address phase the host sends the number of bytes minus one on 2 bytes (MSB first),
+ *         the data, then the CRC32 of the data on 4 bytes (MSB first) as computed by OPENBL_CRC_Calculate().
+ * @retval None.
+ */
+void OPENBL_USART_ExtendedWriteMemory(void)
+{
+  uint32_t address;
+  uint32_t codesize;
+  uint32_t crc;
+  uint8_t data[4];
+
+  /* Check memory protection then send adequate response */
+  if (Common_GetProtectionStatus() != RESET)
+  {
+    OPENBL_USART_SendNack();
+  }
+  else
+  {
+    OPENBL_USART_SendByte(ACK_BYTE);
+
+    /* Get the memory address */
+    if (OPENBL_USART_GetAddress(&address) == NACK_BYTE)
+    {
+      OPENBL_USART_SendNack();
+    }
+    else
+    {
+      OPENBL_USART_SendByte(ACK_BYTE);
 
-        /* Start post processing task if needed */
-        Common_StartPostProcessing(address);
+      OPENBL_USART_CheckRetransmit(address);
+
+      /* Read the number of bytes to be written: Max number of data = USART_RAM_BUFFER_SIZE */
+      OPENBL_USART_ReadBuffer(data, 2U);
+
+      codesize = (((uint32_t)data[0] << 8) | (uint32_t)data[1]) + 1U;
+
+      if (codesize > USART_RAM_BUFFER_SIZE)
+      {
+        OPENBL_USART_SendNack();
+      }
+      else
+      {
+        OPENBL_USART_ReadBuffer(USART_RAM_Buf, codesize);
+        OPENBL_USART_ReadBuffer(data, 4U);
+
+        crc = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+
+        /* Send NACK if the CRC is incorrect */
+        if (OPENBL_CRC_Calculate(USART_RAM_Buf, codesize) != crc)
+        {
+          UsartChecksumErrors++;
+
+          OPENBL_USART_SendNack();
+        }
+        else
+        {
+          OPENBL_USART_WriteReceivedData(address, USART_RAM_Buf, codesize);
+        }
       }
     }
   }
@@ -299,7 +991,7 @@ void OPENBL_USART_Go(void)
   /* Check memory protection then send adequate response */
   if (Common_GetProtectionStatus() != RESET)
   {
-    OPENBL_USART_SendByte(NACK_BYTE);
+    OPENBL_USART_SendNack();
   }
   else
   {
@@ -308,7 +1000,7 @@ void OPENBL_USART_Go(void)
     /* Get memory address */
     if (OPENBL_USART_GetAddress(&address) == NACK_BYTE)
     {
-      OPENBL_USART_SendByte(NACK_BYTE);
+      OPENBL_USART_SendNack();
     }
     else
     {
@@ -317,12 +1009,16 @@ void OPENBL_USART_Go(void)
 
       if (status == 0U)
       {
-        OPENBL_USART_SendByte(NACK_BYTE);
+        OPENBL_USART_SendNack();
       }
       else
       {
+        /* A reset during a sector erase would leave it half erased */
+        (void)OPENBL_FLASH_WaitForErase();
+
         /* If the jump address is valid then send ACK */
         OPENBL_USART_SendByte(ACK_BYTE);
+        OPENBL_USART_WaitTransmitComplete();
         /* we do a system reset here, otherwise the wathcdog wills till be active
         in the user program */
         NVIC_SystemReset();
@@ -341,14 +1037,16 @@ void OPENBL_USART_ReadoutProtect(void)
   /* Check memory protection then send adequate response */
   if (Common_GetProtectionStatus() != RESET)
   {
-    OPENBL_USART_SendByte(NACK_BYTE);
+    OPENBL_USART_SendNack();
   }
   else
   {
     OPENBL_USART_SendByte(ACK_BYTE);
 
     /* Enable the read protection */
+    OPENBL_Enable_BusyState_Flag();
     OPENBL_MEM_SetReadOutProtection(OPENBL_DEFAULT_MEM, ENABLE);
+    OPENBL_Disable_BusyState_Flag();
 
     OPENBL_USART_SendByte(ACK_BYTE);
 
@@ -369,6 +1067,7 @@ void OPENBL_USART_ReadoutUnprotect(void)
      all the RAM is erased, this causes the erase of the Open Bootloader RAM.
      This is why the last ACK is sent before the call of OPENBL_MEM_SetReadOutProtection */
   OPENBL_USART_SendByte(ACK_BYTE);
+  OPENBL_USART_WaitTransmitComplete();
 
   /* Disable the read protection */
   OPENBL_MEM_SetReadOutProtection(OPENBL_DEFAULT_MEM, DISABLE);
@@ -386,9 +1085,10 @@ void OPENBL_USART_EraseMemory(void)
   uint32_t xor;
   uint32_t counter;
   uint32_t numpage;
+  uint32_t size;
   uint16_t data;
   ErrorStatus error_value;
-  uint8_t status = ACK_BYTE;
+  uint8_t status = NACK_BYTE;
   uint8_t *ramaddress;
 
   ramaddress = (uint8_t *) USART_RAM_Buf;
@@ -396,7 +1096,7 @@ void OPENBL_USART_EraseMemory(void)
   /* Check if the memory is not protected */
   if (Common_GetProtectionStatus() != RESET)
   {
-    OPENBL_USART_SendByte(NACK_BYTE);
+    OPENBL_USART_SendNack();
   }
   else
   {
@@ -425,7 +1125,9 @@ void OPENBL_USART_EraseMemory(void)
           ramaddress[0] = (uint8_t)(data & 0x00FFU);
           ramaddress[1] = (uint8_t)((data & 0xFF00U) >> 8);
 
+          OPENBL_Enable_BusyState_Flag();
           error_value = OPENBL_MEM_MassErase(OPENBL_DEFAULT_MEM, (uint8_t *) USART_RAM_Buf, USART_RAM_BUFFER_SIZE);
+          OPENBL_Disable_BusyState_Flag();
 
           if (error_value == SUCCESS)
           {
@@ -436,6 +1138,43 @@ void OPENBL_USART_EraseMemory(void)
             status = NACK_BYTE;
           }
         }
+        else if (data == FLASH_AUTO_ERASE)
+        {
+          /* Nothing is erased now, each sector is erased by the first write that touches it */
+          OPENBL_FLASH_SetAutoErase(ENABLE);
+
+          status = ACK_BYTE;
+        }
+        else if (data == FLASH_APP_ERASE)
+        {
+          /* Only the user sectors up to the highest non-blank one are erased, the bootloader is kept */
+          OPENBL_Enable_BusyState_Flag();
+          error_value = OPENBL_FLASH_EraseApplication(0U);
+          OPENBL_Disable_BusyState_Flag();
+
+          status = (error_value == SUCCESS) ? ACK_BYTE : NACK_BYTE;
+        }
+        else if (data == FLASH_APP_ERASE_SIZE)
+        {
+          /* The application size follows on 4 bytes (MSB first) and their XOR checksum */
+          OPENBL_USART_ReadBuffer(ramaddress, 5U);
+
+          if ((ramaddress[0] ^ ramaddress[1] ^ ramaddress[2] ^ ramaddress[3]) != ramaddress[4])
+          {
+            status = NACK_BYTE;
+          }
+          else
+          {
+            size = ((uint32_t)ramaddress[0] << 24) | ((uint32_t)ramaddress[1] << 16) |
+                   ((uint32_t)ramaddress[2] << 8) | (uint32_t)ramaddress[3];
+
+            OPENBL_Enable_BusyState_Flag();
+            error_value = (size == 0U) ? SUCCESS : OPENBL_FLASH_EraseApplication(size);
+            OPENBL_Disable_BusyState_Flag();
+
+            status = (error_value == SUCCESS) ? ACK_BYTE : NACK_BYTE;
+          }
+        }
         else
         {
           /* This sub-command is not supported */
@@ -468,8 +1207,8 @@ void OPENBL_USART_EraseMemory(void)
         data |= (uint8_t)(OPENBL_USART_ReadByte() & 0x00FFU);
         xor  ^= ((uint32_t)data & 0x00FFU);
 
-        /* Only store data that fit in the buffer length */
-        if (counter < (USART_RAM_BUFFER_SIZE / 2U))
+        /* Only store the list if it fits entirely in the buffer, a longer one is refused below */
+        if (numpage < (USART_RAM_BUFFER_SIZE / 2U))
         {
           *ramaddress = (uint8_t)(data & 0x00FFU);
           ramaddress++;
@@ -484,23 +1223,29 @@ void OPENBL_USART_EraseMemory(void)
       }
 
       /* Check data integrity */
-      if (OPENBL_USART_ReadByte() != (uint8_t) xor)
+      if ((OPENBL_USART_ReadByte() != (uint8_t) xor) || (numpage >= (USART_RAM_BUFFER_SIZE / 2U)))
       {
         status = NACK_BYTE;
       }
       else
       {
+        OPENBL_Enable_BusyState_Flag();
         error_value = OPENBL_MEM_Erase(OPENBL_DEFAULT_MEM, (uint8_t *) USART_RAM_Buf, USART_RAM_BUFFER_SIZE);
+        OPENBL_Disable_BusyState_Flag();
 
-        /* Errors from memory erase are not managed, always return ACK */
-        if (error_value == SUCCESS)
-        {
-          status = ACK_BYTE;
-        }
+        /* A refused list or a failed erase is reported to the host */
+        status = (error_value == SUCCESS) ? ACK_BYTE : NACK_BYTE;
       }
     }
 
-    OPENBL_USART_SendByte(status);
+    if (status == NACK_BYTE)
+    {
+      OPENBL_USART_SendNack();
+    }
+    else
+    {
+      OPENBL_USART_SendByte(status);
+    }
   }
 }
 
@@ -520,7 +1265,7 @@ void OPENBL_USART_WriteProtect(void)
   /* Check if the memory is not protected */
   if (Common_GetProtectionStatus() != RESET)
   {
-    OPENBL_USART_SendByte(NACK_BYTE);
+    OPENBL_USART_SendNack();
   }
   else
   {
@@ -549,14 +1294,16 @@ void OPENBL_USART_WriteProtect(void)
     /* Check data integrity and send NACK if Checksum is incorrect */
     if (OPENBL_USART_ReadByte() != (uint8_t) xor)
     {
-      OPENBL_USART_SendByte(NACK_BYTE);
+      OPENBL_USART_SendNack();
     }
     else
     {
       ramaddress = (uint8_t *) USART_RAM_Buf;
 
       /* Enable the write protection */
+      OPENBL_Enable_BusyState_Flag();
       error_value = OPENBL_MEM_SetWriteProtection(ENABLE, OPENBL_DEFAULT_MEM, ramaddress, length);
+      OPENBL_Disable_BusyState_Flag();
 
       OPENBL_USART_SendByte(ACK_BYTE);
 
@@ -579,14 +1326,16 @@ void OPENBL_USART_WriteUnprotect(void)
   /* Check if the memory is not protected */
   if (Common_GetProtectionStatus() != RESET)
   {
-    OPENBL_USART_SendByte(NACK_BYTE);
+    OPENBL_USART_SendNack();
   }
   else
   {
     OPENBL_USART_SendByte(ACK_BYTE);
 
     /* Disable write protection */
+    OPENBL_Enable_BusyState_Flag();
     error_value = OPENBL_MEM_SetWriteProtection(DISABLE, OPENBL_DEFAULT_MEM, NULL, 0);
+    OPENBL_Disable_BusyState_Flag();
 
     OPENBL_USART_SendByte(ACK_BYTE);
 
@@ -597,6 +1346,167 @@ void OPENBL_USART_WriteUnprotect(void)
   }
 }
 
+/**
+ * @brief  This function is used to send a 32-bit value MSB first.
+ * @param  Word The value to be sent.
+ * @retval None.
+ */
+static void OPENBL_USART_SendWord(uint32_t Word)
+{
+  uint8_t data[4];
+
+  data[0] = (uint8_t)(Word >> 24);
+  data[1] = (uint8_t)(Word >> 16);
+  data[2] = (uint8_t)(Word >> 8);
+  data[3] = (uint8_t)Word;
+
+  OPENBL_USART_SendBuffer(data, 4U);
+}
+
+/**
+ * @brief  This function is used to count the write frames sent again by the host.
+ *         The frames of an image are written at increasing addresses, a frame for the address of the
+ *         previous one is the host retrying after a NACK, a lost ACK or a timeout.
+ * @param  Address The address of the received write frame.
+ * @retval None.
+ */
+static void OPENBL_USART_CheckRetransmit(uint32_t Address)
+{
+  if (Address == UsartLastWriteAddress)
+  {
+    UsartRetransmits++;
+  }
+
+  UsartLastWriteAddress = Address;
+}
+
+/**
+ * @brief  This function is used to write verified received data and acknowledge it.
+ *         The FLASH is read back once programmed, a NACK is sent instead of the ACK when the memory
+ *         reports a write error or the read back differs.
+ * @param  Address The address where the data will be written.
+ * @param  pData Pointer to the data to be written.
+ * @param  DataLength The number of bytes to be written.
+ * @retval None.
+ */
+static void OPENBL_USART_WriteReceivedData(uint32_t Address, uint8_t *pData, uint32_t DataLength)
+{
+  ErrorStatus status;
+
+  /* Only the start address is checked when it is received, the data must not cross the memory end */
+  if (OPENBL_MEM_CheckRange(Address, DataLength) != SUCCESS)
+  {
+    OPENBL_USART_SendNack();
+  }
+#if (OPENBL_PIPELINED_WRITE == 1U)
+  else if (OPENBL_MEM_GetAddressArea(Address) == FLASH_AREA)
+  {
+    OPENBL_USART_PipelinedWrite(Address, pData, DataLength);
+  }
+#endif /* (OPENBL_PIPELINED_WRITE == 1U) */
+  else
+  {
+    /* Write data to memory, the target sectors may still be under erase: no busy byte, one ACK or NACK */
+    status = OPENBL_MEM_Write(Address, pData, DataLength);
+
+    /* Flash is memory mapped, read back to detect a programming failure the error flags missed */
+    if ((status == SUCCESS) && (OPENBL_MEM_GetAddressArea(Address) == FLASH_AREA)
+        && (memcmp((void *)Address, pData, DataLength) != 0))
+    {
+      status = ERROR;
+    }
+
+    if (status != SUCCESS)
+    {
+      OPENBL_USART_SendNack();
+    }
+    else
+    {
+      /* Send last Acknowledge synchronization byte */
+      OPENBL_USART_SendByte(ACK_BYTE);
+      OPENBL_USART_WaitTransmitComplete();
+
+      /* Start post processing task if needed */
+      Common_StartPostProcessing(Address);
+    }
+  }
+}
+
+#if (OPENBL_PIPELINED_WRITE == 1U)
+/**
+ * @brief  This function is used to write a received flash frame with the acknowledge sent before programming.
+ *         The host can then send the next frame, which is stored by the RX DMA ring while this one is
+ *         programmed from USART_RAM_Buf, so the ring acts as the second buffer.
+ *         A programming failure cannot be reported for the current frame anymore, it is latched and
+ *         the next command, whatever it is, is answered by NACK (see OPENBL_USART_TakeWriteError()).
+ *         The host must send a command after the last frame and check its ACK, openbl.py sends Get Version.
+ * @param  Address The flash address where the data will be written.
+ * @param  pData Pointer to the received data.
+ * @param  DataLength The number of bytes to be written.
+ * @retval None.
+ */
+static void OPENBL_USART_PipelinedWrite(uint32_t Address, uint8_t *pData, uint32_t DataLength)
+{
+  OPENBL_USART_SendByte(ACK_BYTE);
+
+  /* Flash is memory mapped, read back to detect a programming failure the error flags missed */
+  if ((OPENBL_MEM_Write(Address, pData, DataLength) != SUCCESS)
+      || (memcmp((void *)Address, pData, DataLength) != 0))
+  {
+    UsartWriteError = SET;
+  }
+}
+#endif /* (OPENBL_PIPELINED_WRITE == 1U) */
+
+/**
+ * @brief  This function is used to change the USART baudrate.
+ *         The host sends the new baudrate on 4 bytes (MSB first) followed by their XOR checksum.
+ *         The device acknowledges at the current baudrate, switches, then waits for the host to send
+ *         a synchronization byte at the new baudrate and acknowledges it at the new baudrate.
+ *         If nothing valid is received within OPENBL_USART_SPEED_TIMEOUT the previous baudrate is restored.
+ * @retval None.
+ */
+void OPENBL_USART_Speed(void)
+{
+  uint8_t data[5];
+  uint8_t sync;
+  uint8_t xor;
+  uint32_t baudrate;
+  uint32_t previous_baudrate;
+
+  OPENBL_USART_SendByte(ACK_BYTE);
+
+  /* Get the baudrate and its checksum */
+  OPENBL_USART_ReadBuffer(data, 5U);
+
+  xor      = data[0] ^ data[1] ^ data[2] ^ data[3];
+  baudrate = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+
+  if ((data[4] != xor) || (OPENBL_USART_CheckBaudRate(baudrate) != SUCCESS))
+  {
+    OPENBL_USART_SendNack();
+  }
+  else
+  {
+    /* Acknowledge at the current baudrate */
+    OPENBL_USART_SendByte(ACK_BYTE);
+
+    previous_baudrate = OPENBL_USART_GetBaudRate();
+
+    (void)OPENBL_USART_SetBaudRate(baudrate);
+
+    /* Acknowledge the host synchronization at the new baudrate or fall back to the previous one */
+    if ((OPENBL_USART_ReadByteTimeout(&sync, OPENBL_USART_SPEED_TIMEOUT) == SUCCESS) && (sync == OPENBL_USART_SYNC_BYTE))
+    {
+      OPENBL_USART_SendByte(ACK_BYTE);
+    }
+    else
+    {
+      (void)OPENBL_USART_SetBaudRate(previous_baudrate);
+    }
+  }
+}
+
 /**
  * @brief  This function is used to get a valid address.
  * @retval Returns NACK status in case of error else returns ACK status.
@@ -618,6 +1528,8 @@ uint8_t OPENBL_USART_GetAddress(uint32_t *Address)
   if (OPENBL_USART_ReadByte() != xor)
   {
     status = NACK_BYTE;
+
+    UsartChecksumErrors++;
   }
   else
   {
@@ -658,7 +1570,7 @@ void OPENBL_USART_SpecialCommand(void)
   /* Get the command operation code */
   if (OPENBL_USART_GetSpecialCmdOpCode(&op_code, OPENBL_SPECIAL_CMD) == NACK_BYTE)
   {
-    OPENBL_USART_SendByte(NACK_BYTE);
+    OPENBL_USART_SendNack();
   }
   else
   {
@@ -685,7 +1597,7 @@ void OPENBL_USART_SpecialCommand(void)
 
     if (special_cmd->SizeBuffer1 > SPECIAL_CMD_SIZE_BUFFER1)
     {
-      OPENBL_USART_SendByte(NACK_BYTE);
+      OPENBL_USART_SendNack();
     }
     else
     {
@@ -703,7 +1615,7 @@ void OPENBL_USART_SpecialCommand(void)
       /* Check data integrity */
       if (OPENBL_USART_ReadByte() != xor)
       {
-        OPENBL_USART_SendByte(NACK_BYTE);
+        OPENBL_USART_SendNack();
       }
       else
       {
@@ -741,7 +1653,7 @@ void OPENBL_USART_ExtendedSpecialCommand(void)
   /* Get the command operation code */
   if (OPENBL_USART_GetSpecialCmdOpCode(&op_code, OPENBL_EXTENDED_SPECIAL_CMD) == NACK_BYTE)
   {
-    OPENBL_USART_SendByte(NACK_BYTE);
+    OPENBL_USART_SendNack();
   }
   else
   {
@@ -768,7 +1680,7 @@ void OPENBL_USART_ExtendedSpecialCommand(void)
 
     if (special_cmd->SizeBuffer1 > SPECIAL_CMD_SIZE_BUFFER1)
     {
-      OPENBL_USART_SendByte(NACK_BYTE);
+      OPENBL_USART_SendNack();
     }
     else
     {
@@ -786,7 +1698,7 @@ void OPENBL_USART_ExtendedSpecialCommand(void)
       /* Check data integrity */
       if (OPENBL_USART_ReadByte() != xor)
       {
-        OPENBL_USART_SendByte(NACK_BYTE);
+        OPENBL_USART_SendNack();
       }
       else
       {
@@ -807,7 +1719,7 @@ void OPENBL_USART_ExtendedSpecialCommand(void)
 
         if (special_cmd->SizeBuffer2 > SPECIAL_CMD_SIZE_BUFFER2)
         {
-          OPENBL_USART_SendByte(NACK_BYTE);
+          OPENBL_USART_SendNack();
         }
         else
         {
@@ -825,7 +1737,7 @@ void OPENBL_USART_ExtendedSpecialCommand(void)
           /* Check data integrity */
           if (OPENBL_USART_ReadByte() != xor)
           {
-            OPENBL_USART_SendByte(NACK_BYTE);
+            OPENBL_USART_SendNack();
           }
           else
           {
@@ -846,95 +1758,6 @@ void OPENBL_USART_ExtendedSpecialCommand(void)
 
 /* Private functions ---------------------------------------------------------*/
 
-/**
-  * @brief  This function is used to construct the command list table.
-  * @return Returns the number of supported commands.
-  */
-static uint8_t OPENBL_USART_ConstructCommandsTable(OPENBL_CommandsTypeDef *pUsartCmd)
-{
-  uint8_t i = 0;
-
-  if (pUsartCmd->GetCommand != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_GET_COMMAND;
-    i++;
-  }
-
-  if (pUsartCmd->GetVersion != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_GET_VERSION;
-    i++;
-  }
-
-  if (pUsartCmd->GetID != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_GET_ID;
-    i++;
-  }
-
-  if (pUsartCmd->ReadMemory != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_READ_MEMORY;
-    i++;
-  }
-
-  if (pUsartCmd->Go != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_GO;
-    i++;
-  }
-
-  if (pUsartCmd->WriteMemory != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_WRITE_MEMORY;
-    i++;
-  }
-
-  if (pUsartCmd->EraseMemory != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_EXT_ERASE_MEMORY;
-    i++;
-  }
-
-  if (pUsartCmd->WriteProtect != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_WRITE_PROTECT;
-    i++;
-  }
-
-  if (pUsartCmd->WriteUnprotect != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_WRITE_UNPROTECT;
-    i++;
-  }
-
-  if (pUsartCmd->ReadoutProtect != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_READ_PROTECT;
-    i++;
-  }
-
-  if (pUsartCmd->ReadoutUnprotect != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_READ_UNPROTECT;
-    i++;
-  }
-
-  if (pUsartCmd->SpecialCommand != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_SPECIAL_COMMAND;
-    i++;
-  }
-
-  if (pUsartCmd->ExtendedSpecialCommand != NULL)
-  {
-    a_OPENBL_USART_CommandsList[i] = CMD_EXTENDED_SPECIAL_COMMAND;
-    i++;
-  }
-
-  return (i);
-}
-
 /**
  * @brief  This function is used to get the operation code.
  * @param  OpCode Pointer to the operation code to be returned.
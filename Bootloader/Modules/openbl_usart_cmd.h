@@ -30,8 +30,10 @@
 /* Exported macro ------------------------------------------------------------*/
 /* Exported variables --------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
-OPENBL_CommandsTypeDef *OPENBL_USART_GetCommandsList(void);
-void OPENBL_USART_SetCommandsList(OPENBL_CommandsTypeDef *pUsartCmd);
+const OPENBL_CommandHandlerTypeDef *OPENBL_USART_GetCommandsList(void);
+#if (OPENBL_PIPELINED_WRITE == 1U)
+FlagStatus OPENBL_USART_TakeWriteError(void);
+#endif /* (OPENBL_PIPELINED_WRITE == 1U) */
 void OPENBL_USART_GetCommand(void);
 void OPENBL_USART_GetVersion(void);
 void OPENBL_USART_GetID(void);
@@ -43,7 +45,23 @@ void OPENBL_USART_ReadoutUnprotect(void);
 void OPENBL_USART_EraseMemory(void);
 void OPENBL_USART_WriteProtect(void);
 void OPENBL_USART_WriteUnprotect(void);
+void OPENBL_USART_Speed(void);
 void OPENBL_USART_SpecialCommand(void);
 void OPENBL_USART_ExtendedSpecialCommand(void);
+void OPENBL_USART_ExtendedWriteMemory(void);
+void OPENBL_USART_ExtendedReadMemory(void);
+void OPENBL_USART_Checksum(void);
+void OPENBL_USART_SectorsChecksum(void);
+#if (OPENBL_LZ4_WRITE == 1U)
+void OPENBL_USART_CompressedWriteMemory(void);
+#endif /* (OPENBL_LZ4_WRITE == 1U) */
+#if (OPENBL_DELTA_WRITE == 1U)
+void OPENBL_USART_DeltaWriteMemory(void);
+#endif /* (OPENBL_DELTA_WRITE == 1U) */
+void OPENBL_USART_BlankCheck(void);
+void OPENBL_USART_GetStatistics(void);
+#if (OPENBL_PROFILING == 1U)
+void OPENBL_USART_GetProfile(void);
+#endif /* (OPENBL_PROFILING == 1U) */
 
 #endif /* OPENBL_USART_CMD_H */
@@ -26,6 +26,9 @@ extern "C" {
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f4xx_ll_usart.h"
+#include "stm32f4xx_ll_dma.h"
+#include "stm32f4xx_ll_gpio.h"
+#include "stm32f4xx_ll_tim.h"
 
 #define MEMORIES_SUPPORTED                7U
 
@@ -35,11 +38,48 @@ extern "C" {
 #define USARTx_CLK_DISABLE()              __HAL_RCC_USART2_CLK_DISABLE()
 #define USARTx_GPIO_CLK_ENABLE()          __HAL_RCC_GPIOD_CLK_ENABLE()
 #define USARTx_DeInit()                   LL_USART_DeInit(USARTx)
+#define USARTx_IRQn                       USART2_IRQn   /* Only the reception error interrupts are used */
 
 #define USARTx_TX_PIN                     GPIO_PIN_2
 #define USARTx_TX_GPIO_PORT               GPIOA
 #define USARTx_RX_PIN                     GPIO_PIN_3
+#define USARTx_RX_GPIO_PORT               GPIOA
+#define USARTx_RX_AF                      LL_GPIO_AF_7
+#define USARTx_RX_AUTOBAUD_AF             LL_GPIO_AF_1    /* PA3 alternate function for TIM2_CH4, the RX pin must be one of 0 to 7 */
 
+#define USARTx_BAUDRATE                   115200U   /* Baudrate used at startup and after a failed speed change */
+#define USARTx_BAUDRATE_TOLERANCE         2U        /* Maximum accepted baudrate error in percent */
+
+#define USARTx_DMA                        DMA1
+#define USARTx_DMA_CLK_ENABLE()           __HAL_RCC_DMA1_CLK_ENABLE()
+
+#define USARTx_RX_DMA_STREAM              LL_DMA_STREAM_5
+#define USARTx_RX_DMA_CHANNEL             LL_DMA_CHANNEL_4
+#define USARTx_RX_DMA_CLEAR_FLAGS()       WRITE_REG(USARTx_DMA->HIFCR, DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | \
+                                                    DMA_HIFCR_CTEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5)
+#define USARTx_RX_RING_SIZE               8192U     /* Size of the circular DMA receive buffer, must be a power of 2 */
+
+#define USARTx_TX_DMA_STREAM              LL_DMA_STREAM_6
+#define USARTx_TX_DMA_CHANNEL             LL_DMA_CHANNEL_4
+#define USARTx_TX_DMA_CLEAR_FLAGS()       WRITE_REG(USARTx_DMA->HIFCR, DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | \
+                                                    DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6)
+
+/* The baudrate is measured on the host 0x7F sync byte by a timer input capture on the RX pin */
+#define USARTx_AUTOBAUD_TIM               TIM2
+#define USARTx_AUTOBAUD_TIM_CLK_ENABLE()  __HAL_RCC_TIM2_CLK_ENABLE()
+#define USARTx_AUTOBAUD_TIM_CLK_DISABLE() __HAL_RCC_TIM2_CLK_DISABLE()
+#define USARTx_AUTOBAUD_TIM_CHANNEL       LL_TIM_CHANNEL_CH4
+#define USARTx_AUTOBAUD_IS_CAPTURED()     LL_TIM_IsActiveFlag_CC4(USARTx_AUTOBAUD_TIM)
+#define USARTx_AUTOBAUD_GET_CAPTURE()     LL_TIM_IC_GetCaptureCH4(USARTx_AUTOBAUD_TIM)
+#define USARTx_AUTOBAUD_CLEAR_FLAGS()     WRITE_REG(USARTx_AUTOBAUD_TIM->SR, ~(TIM_SR_CC4IF | TIM_SR_CC4OF))
+#define USARTx_AUTOBAUD_TIMEOUT           20U             /* Maximum time in ms between the two falling edges of the sync byte */
+
+/* Busy bytes are sent by a timer interrupt running from RAM while a long FLASH operation is ongoing */
+#define USARTx_BUSY_TIM                   TIM6
+#define USARTx_BUSY_TIM_CLK_ENABLE()      __HAL_RCC_TIM6_CLK_ENABLE()
+#define USARTx_BUSY_TIM_CLK_DISABLE()     __HAL_RCC_TIM6_CLK_DISABLE()
+#define USARTx_BUSY_TIM_IRQn              TIM6_DAC_IRQn
+#define USARTx_BUSY_PERIOD                100U            /* Time in ms between two busy bytes */
 
 
 /* ------------------------- Definitions for FDCAN -------------------------- */
@@ -18,6 +18,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "openbl_core.h"
+#include "openbl_profile.h"
 #include <stdbool.h>
 
 /* Private typedef -----------------------------------------------------------*/
@@ -40,6 +41,10 @@ void OPENBL_Init(void)
 {
   uint32_t counter;
 
+#if (OPENBL_PROFILING == 1U)
+  OPENBL_PROFILE_Init();
+#endif /* (OPENBL_PROFILING == 1U) */
+
   for (counter = 0U; counter < NumberOfInterfaces; counter++)
   {
     if (a_InterfacesTable[counter].p_Ops->Init != NULL)
@@ -127,10 +132,12 @@ uint32_t OPENBL_InterfaceDetection(void)
 
 /**
   * @brief  This function is used to get the command opcode from the given interface and execute the right command.
+  *         The opcode indexes the handlers table of the interface, a missing handler is answered by a NACK.
   * @retval None.
   */
 void OPENBL_CommandProcess(void)
 {
+  OPENBL_CommandHandlerTypeDef handler = NULL;
   uint8_t command_opcode;
 
   /* Get the user command opcode */
@@ -138,309 +145,27 @@ void OPENBL_CommandProcess(void)
   {
     command_opcode = p_Interface->p_Ops->GetCommandOpcode();
 
-    switch (command_opcode)
+    if (p_Interface->p_Cmd != NULL)
     {
-      case CMD_GET_COMMAND:
-        if (p_Interface->p_Cmd->GetCommand != NULL)
-        {
-          p_Interface->p_Cmd->GetCommand();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_GET_VERSION:
-        if (p_Interface->p_Cmd->GetVersion != NULL)
-        {
-          p_Interface->p_Cmd->GetVersion();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_GET_ID:
-        if (p_Interface->p_Cmd->GetID != NULL)
-        {
-          p_Interface->p_Cmd->GetID();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_READ_MEMORY:
-        if (p_Interface->p_Cmd->ReadMemory != NULL)
-        {
-          p_Interface->p_Cmd->ReadMemory();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_WRITE_MEMORY:
-        if (p_Interface->p_Cmd->WriteMemory != NULL)
-        {
-          p_Interface->p_Cmd->WriteMemory();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_GO:
-        if (p_Interface->p_Cmd->Go != NULL)
-        {
-          p_Interface->p_Cmd->Go();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_READ_PROTECT:
-        if (p_Interface->p_Cmd->ReadoutProtect != NULL)
-        {
-          p_Interface->p_Cmd->ReadoutProtect();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_READ_UNPROTECT:
-        if (p_Interface->p_Cmd->ReadoutUnprotect != NULL)
-        {
-          p_Interface->p_Cmd->ReadoutUnprotect();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_EXT_ERASE_MEMORY:
-        if (p_Interface->p_Cmd->EraseMemory != NULL)
-        {
-          p_Interface->p_Cmd->EraseMemory();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_LEG_ERASE_MEMORY:
-        if (p_Interface->p_Cmd->EraseMemory != NULL)
-        {
-          p_Interface->p_Cmd->EraseMemory();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_WRITE_PROTECT:
-        if (p_Interface->p_Cmd->WriteProtect != NULL)
-        {
-          p_Interface->p_Cmd->WriteProtect();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_WRITE_UNPROTECT:
-        if (p_Interface->p_Cmd->WriteUnprotect != NULL)
-        {
-          p_Interface->p_Cmd->WriteUnprotect();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_NS_WRITE_MEMORY:
-        if (p_Interface->p_Cmd->NsWriteMemory != NULL)
-        {
-          p_Interface->p_Cmd->NsWriteMemory();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_NS_ERASE_MEMORY:
-        if (p_Interface->p_Cmd->NsEraseMemory != NULL)
-        {
-          p_Interface->p_Cmd->NsEraseMemory();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_NS_WRITE_PROTECT:
-        if (p_Interface->p_Cmd->NsWriteProtect != NULL)
-        {
-          p_Interface->p_Cmd->NsWriteProtect();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_NS_WRITE_UNPROTECT:
-        if (p_Interface->p_Cmd->NsWriteUnprotect != NULL)
-        {
-          p_Interface->p_Cmd->NsWriteUnprotect();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_NS_READ_PROTECT:
-        if (p_Interface->p_Cmd->NsReadoutProtect != NULL)
-        {
-          p_Interface->p_Cmd->NsReadoutProtect();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_NS_READ_UNPROTECT:
-        if (p_Interface->p_Cmd->NsReadoutUnprotect != NULL)
-        {
-          p_Interface->p_Cmd->NsReadoutUnprotect();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
-
-      case CMD_SPEED:
-        if (p_Interface->p_Cmd->Speed != NULL)
-        {
-          p_Interface->p_Cmd->Speed();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
+      handler = p_Interface->p_Cmd[command_opcode];
+    }
 
-      case CMD_SPECIAL_COMMAND:
-        if (p_Interface->p_Cmd->SpecialCommand != NULL)
-        {
-          p_Interface->p_Cmd->SpecialCommand();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
+    if (handler != NULL)
+    {
+      /* The time starts once the opcode is received, the wait for the next command is not counted */
+      OPENBL_PROFILE_BEGIN(start);
 
-      case CMD_EXTENDED_SPECIAL_COMMAND:
-        if (p_Interface->p_Cmd->ExtendedSpecialCommand != NULL)
-        {
-          p_Interface->p_Cmd->ExtendedSpecialCommand();
-        }
-        else
-        {
-          if (p_Interface->p_Ops->SendByte != NULL)
-          {
-            p_Interface->p_Ops->SendByte(NACK_BYTE);
-          }
-        }
-        break;
+      handler();
 
-      /* Unknown command opcode */
-      default:
-        if (p_Interface->p_Ops->SendByte != NULL)
-        {
-          p_Interface->p_Ops->SendByte(NACK_BYTE);
-        }
-        break;
+      OPENBL_PROFILE_END_CMD(command_opcode, start);
+    }
+    else
+    {
+      /* Unknown or unsupported command opcode */
+      if (p_Interface->p_Ops->SendByte != NULL)
+      {
+        p_Interface->p_Ops->SendByte(NACK_BYTE);
+      }
     }
   }
 }
@@ -33,6 +33,7 @@
 #define SYNC_BYTE                         0xA5U             /* synchronization byte */
 #define SPECIAL_CMD_SIZE_BUFFER1          128U              /* Special command received data buffer size */
 #define SPECIAL_CMD_SIZE_BUFFER2          1024U             /* Special command write data buffer size */
+#define OPENBL_COMMANDS_NUMBER            256U              /* Size of a command handlers table, one entry per opcode */
 
 /* ---------------------- Open Bootloader Commands ---------------------------*/
 #define CMD_GET_COMMAND                   0x00U             /* Get commands command */
@@ -57,6 +58,14 @@
 #define CMD_SPECIAL_COMMAND               0x50U             /* Special Read Protect */
 #define CMD_EXTENDED_SPECIAL_COMMAND      0x51U             /* Special write command */
 #define CMD_CHECKSUM                      0xA1U             /* Checksum command */
+#define CMD_EXT_WRITE_MEMORY              0x33U             /* Extended Write Memory command, 4 KB frames with CRC32 */
+#define CMD_SECTORS_CHECKSUM              0xA2U             /* Checksum of every FLASH sector command */
+#define CMD_COMPRESSED_WRITE_MEMORY       0x34U             /* Write Memory command with LZ4 compressed frames */
+#define CMD_DELTA_WRITE_MEMORY            0x36U             /* Write Memory command rebuilding the data from a patch */
+#define CMD_BLANK_CHECK                   0xA3U             /* Blank check command */
+#define CMD_GET_STATISTICS                0xA6U             /* Get statistics command */
+#define CMD_GET_PROFILE                   0xA7U             /* Get cycle counts command, only with OPENBL_PROFILING */
+#define CMD_EXT_READ_MEMORY               0x13U             /* Extended Read Memory command, 64 KB frames with CRC32 */
 
 /* Exported types ------------------------------------------------------------*/
 typedef struct
@@ -68,34 +77,13 @@ typedef struct
   void (*SendByte)(uint8_t Byte);
 } OPENBL_OpsTypeDef;
 
-typedef struct
-{
-  void (*GetCommand)(void);
-  void (*GetVersion)(void);
-  void (*GetID)(void);
-  void (*ReadMemory)(void);
-  void (*WriteMemory)(void);
-  void (*Go)(void);
-  void (*ReadoutProtect)(void);
-  void (*ReadoutUnprotect)(void);
-  void (*EraseMemory)(void);
-  void (*WriteProtect)(void);
-  void (*WriteUnprotect)(void);
-  void (*NsWriteMemory)(void);
-  void (*NsEraseMemory)(void);
-  void (*NsWriteProtect)(void);
-  void (*NsWriteUnprotect)(void);
-  void (*NsReadoutProtect)(void);
-  void (*NsReadoutUnprotect)(void);
-  void (*Speed)(void);
-  void (*SpecialCommand)(void);
-  void (*ExtendedSpecialCommand)(void);
-} OPENBL_CommandsTypeDef;
+/* Command handler, the handlers of an interface are stored in a table indexed by the command opcode */
+typedef void (*OPENBL_CommandHandlerTypeDef)(void);
 
 typedef struct
 {
   OPENBL_OpsTypeDef *p_Ops;
-  OPENBL_CommandsTypeDef *p_Cmd;
+  const OPENBL_CommandHandlerTypeDef *p_Cmd;    /* OPENBL_COMMANDS_NUMBER handlers, NULL for unsupported opcodes */
 } OPENBL_HandleTypeDef;
 
 typedef enum
@@ -70,6 +70,7 @@ extern "C" {
 #define EB_END_ADDRESS                    (EB_START_ADDRESS + EB_SIZE)  /* Engi bytes end address  */
 
 #define OPENBL_RAM_SIZE                   0x11800U  /* RAM used by the Open Bootloader 71680 Bytes */
+#define OPENBL_VECTORS_NUMBER             128U  /* Vector table entries copied to RAM, 16 + 97 used */
 
 #define OPENBL_DEFAULT_MEM                FLASH_START_ADDRESS  /* Default address used for erase and write/read protect commands */
 
@@ -88,9 +89,46 @@ extern "C" {
 #define FLASH_MASS_ERASE                  0xFFFF
 #define FLASH_BANK1_ERASE                 0xFFFE
 #define FLASH_BANK2_ERASE                 0xFFFD
+#define FLASH_AUTO_ERASE                  0xFFFC  /* Erase each user sector on the first write that touches it */
+#define FLASH_APP_ERASE                   0xFFFB  /* Erase the user sectors up to the highest non-blank one */
+#define FLASH_APP_ERASE_SIZE              0xFFFA  /* Erase the user sectors holding an application of the size sent by the host */
 
 #define INTERFACES_SUPPORTED              6U
 
+/* ------------------------- Protocol options ------------------------------- */
+/* The 0/1 options can be set on the compiler command line, e.g. -DOPENBL_PIPELINED_WRITE=1U */
+#if !defined(OPENBL_PIPELINED_WRITE)
+#define OPENBL_PIPELINED_WRITE            0U  /* 1: flash writes are acknowledged before programming, a failure is reported by refusing the next command, the host sends one after the last frame */
+#endif
+#if !defined(OPENBL_SKIP_ERASED_WORDS)
+#define OPENBL_SKIP_ERASED_WORDS          1U  /* 1: words equal to the erased value 0xFFFFFFFF are not programmed */
+#endif
+#if !defined(OPENBL_FLASH_PROGRAM_HAL)
+#define OPENBL_FLASH_PROGRAM_HAL          0U  /* 1: FLASH writes go through HAL_FLASH_Program(), to compare the write cycle counts with OPENBL_PROFILING */
+#endif
+#if !defined(OPENBL_BACKGROUND_ERASE)
+#define OPENBL_BACKGROUND_ERASE           1U  /* 1: sector erase is acknowledged once started and completed by the FLASH interrupt */
+#endif
+#if !defined(OPENBL_PROFILING)
+#define OPENBL_PROFILING                  0U  /* 1: cycle counts of the commands and memory accesses are recorded, compiled out when 0 */
+#endif
+#define OPENBL_PROFILE_CMD_SLOTS          24U  /* Number of different command opcodes recorded by the profiling */
+#if !defined(OPENBL_LZ4_WRITE)
+#define OPENBL_LZ4_WRITE                  0U  /* 1: LZ4 compressed Write Memory command, off to keep the bootloader in sector 0 */
+#endif
+#if !defined(OPENBL_DELTA_WRITE)
+#define OPENBL_DELTA_WRITE                0U  /* 1: delta Write Memory command, off to keep the bootloader in sector 0 */
+#endif
+
+/* ------------------------- Application image ------------------------------ */
+#if !defined(OPENBL_IMAGE_HEADER)
+#define OPENBL_IMAGE_HEADER               0U  /* 1: the application starts with a header validated by CRC, 0: boot if the first word is programmed, the images without header keep booting */
+#endif
+#define OPENBL_IMAGE_HEADER_SIZE          0x200U  /* Space reserved for the header, the vector table of the application follows it */
+#define OPENBL_IMAGE_MAGIC                0x4F424C49U  /* "OBLI", first word of a valid header */
+#define OPENBL_IMAGE_CACHE_BKP            17U  /* First of the 3 RTC backup registers caching the last validated header */
+#define OPENBL_IMAGE_CACHE_TAG            0x5A11DA7EU  /* Mixed with the cached header fields to detect uninitialised registers */
+
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 
@@ -0,0 +1,176 @@
+/**
+  ******************************************************************************
+  * @file    sim_cmsis.h
+  * @brief   Host replacement of the CMSIS GCC compiler layer (cmsis_gcc.h).
+  *          It is force-included in every firmware translation unit of the
+  *          simulation build: it defines the cmsis_gcc.h include guard, so the
+  *          Cortex-M inline assembly is never seen, and routes the core
+  *          intrinsics (PRIMASK, MSP, barriers, WFI...) to the simulated core.
+  ******************************************************************************
+  */
+
+#ifndef SIM_CMSIS_H
+#define SIM_CMSIS_H
+
+#define __CMSIS_GCC_H
+
+#include <stdint.h>
+
+/* Compiler specific defines -------------------------------------------------*/
+#ifndef __ASM
+#define __ASM                                  __asm
+#endif
+#ifndef __INLINE
+#define __INLINE                               inline
+#endif
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE                        static inline
+#endif
+#ifndef __STATIC_FORCEINLINE
+#define __STATIC_FORCEINLINE                   __attribute__((always_inline)) static inline
+#endif
+#ifndef __NO_RETURN
+#define __NO_RETURN                            __attribute__((__noreturn__))
+#endif
+#ifndef __USED
+#define __USED                                 __attribute__((used))
+#endif
+#ifndef __WEAK
+#define __WEAK                                 __attribute__((weak))
+#endif
+#ifndef __PACKED
+#define __PACKED                               __attribute__((packed, aligned(1)))
+#endif
+#ifndef __PACKED_STRUCT
+#define __PACKED_STRUCT                        struct __attribute__((packed, aligned(1)))
+#endif
+#ifndef __PACKED_UNION
+#define __PACKED_UNION                         union __attribute__((packed, aligned(1)))
+#endif
+#ifndef __UNALIGNED_UINT32
+#define __UNALIGNED_UINT32(x)                  (((struct __attribute__((packed)) { uint32_t v; } *)(x))->v)
+#endif
+#ifndef __UNALIGNED_UINT16_WRITE
+#define __UNALIGNED_UINT16_WRITE(addr, val)    (void)((((struct __attribute__((packed)) { uint16_t v; } *)(void *)(addr))->v) = (val))
+#endif
+#ifndef __UNALIGNED_UINT16_READ
+#define __UNALIGNED_UINT16_READ(addr)          (((const struct __attribute__((packed)) { uint16_t v; } *)(const void *)(addr))->v)
+#endif
+#ifndef __UNALIGNED_UINT32_WRITE
+#define __UNALIGNED_UINT32_WRITE(addr, val)    (void)((((struct __attribute__((packed)) { uint32_t v; } *)(void *)(addr))->v) = (val))
+#endif
+#ifndef __UNALIGNED_UINT32_READ
+#define __UNALIGNED_UINT32_READ(addr)          (((const struct __attribute__((packed)) { uint32_t v; } *)(const void *)(addr))->v)
+#endif
+#ifndef __ALIGNED
+#define __ALIGNED(x)                           __attribute__((aligned(x)))
+#endif
+#ifndef __RESTRICT
+#define __RESTRICT                             __restrict
+#endif
+#ifndef __COMPILER_BARRIER
+#define __COMPILER_BARRIER()                   __asm volatile("":::"memory")
+#endif
+
+/* Simulated core, see sim_cpu.c ---------------------------------------------*/
+void SIM_CPU_SetPrimask(uint32_t PriMask);
+uint32_t SIM_CPU_GetPrimask(void);
+void SIM_CPU_SetBasepri(uint32_t BasePri);
+uint32_t SIM_CPU_GetBasepri(void);
+void SIM_CPU_SetFaultmask(uint32_t FaultMask);
+uint32_t SIM_CPU_GetFaultmask(void);
+uint32_t SIM_CPU_GetIpsr(void);
+void SIM_CPU_SetMsp(uint32_t TopOfMainStack);
+uint32_t SIM_CPU_GetMsp(void);
+void SIM_CPU_Barrier(void);
+void SIM_CPU_WaitForInterrupt(void);
+void SIM_CPU_Breakpoint(uint32_t Value);
+
+/* Core register access ------------------------------------------------------*/
+__STATIC_FORCEINLINE void __enable_irq(void)                { SIM_CPU_SetPrimask(0U); }
+__STATIC_FORCEINLINE void __disable_irq(void)               { SIM_CPU_SetPrimask(1U); }
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK(void)           { return SIM_CPU_GetPrimask(); }
+__STATIC_FORCEINLINE void __set_PRIMASK(uint32_t priMask)   { SIM_CPU_SetPrimask(priMask); }
+__STATIC_FORCEINLINE void __enable_fault_irq(void)          { SIM_CPU_SetFaultmask(0U); }
+__STATIC_FORCEINLINE void __disable_fault_irq(void)         { SIM_CPU_SetFaultmask(1U); }
+__STATIC_FORCEINLINE uint32_t __get_FAULTMASK(void)         { return SIM_CPU_GetFaultmask(); }
+__STATIC_FORCEINLINE void __set_FAULTMASK(uint32_t mask)    { SIM_CPU_SetFaultmask(mask); }
+__STATIC_FORCEINLINE uint32_t __get_BASEPRI(void)           { return SIM_CPU_GetBasepri(); }
+__STATIC_FORCEINLINE void __set_BASEPRI(uint32_t basePri)   { SIM_CPU_SetBasepri(basePri); }
+__STATIC_FORCEINLINE void __set_BASEPRI_MAX(uint32_t basePri)
+{
+  uint32_t current = SIM_CPU_GetBasepri();
+
+  if ((basePri != 0U) && ((current == 0U) || (basePri < current)))
+  {
+    SIM_CPU_SetBasepri(basePri);
+  }
+}
+__STATIC_FORCEINLINE uint32_t __get_IPSR(void)              { return SIM_CPU_GetIpsr(); }
+__STATIC_FORCEINLINE uint32_t __get_APSR(void)              { return 0U; }
+__STATIC_FORCEINLINE uint32_t __get_xPSR(void)              { return SIM_CPU_GetIpsr() | (1UL << 24); }
+__STATIC_FORCEINLINE uint32_t __get_CONTROL(void)           { return 0U; }
+__STATIC_FORCEINLINE void __set_CONTROL(uint32_t control)   { (void)control; }
+__STATIC_FORCEINLINE uint32_t __get_MSP(void)               { return SIM_CPU_GetMsp(); }
+__STATIC_FORCEINLINE void __set_MSP(uint32_t topOfMainStack) { SIM_CPU_SetMsp(topOfMainStack); }
+__STATIC_FORCEINLINE uint32_t __get_PSP(void)               { return 0U; }
+__STATIC_FORCEINLINE void __set_PSP(uint32_t topOfProcStack) { (void)topOfProcStack; }
+__STATIC_FORCEINLINE uint32_t __get_FPSCR(void)             { return 0U; }
+__STATIC_FORCEINLINE void __set_FPSCR(uint32_t fpscr)       { (void)fpscr; }
+
+/* Instructions --------------------------------------------------------------*/
+#define __NOP()                                SIM_CPU_Barrier()
+#define __WFI()                                SIM_CPU_WaitForInterrupt()
+#define __WFE()                                SIM_CPU_WaitForInterrupt()
+#define __SEV()                                SIM_CPU_Barrier()
+#define __BKPT(value)                          SIM_CPU_Breakpoint(value)
+
+__STATIC_FORCEINLINE void __ISB(void)                       { SIM_CPU_Barrier(); }
+__STATIC_FORCEINLINE void __DSB(void)                       { SIM_CPU_Barrier(); }
+__STATIC_FORCEINLINE void __DMB(void)                       { SIM_CPU_Barrier(); }
+__STATIC_FORCEINLINE uint32_t __REV(uint32_t value)         { return __builtin_bswap32(value); }
+__STATIC_FORCEINLINE uint32_t __REV16(uint32_t value)
+{
+  return ((value & 0xFF00FF00UL) >> 8) | ((value & 0x00FF00FFUL) << 8);
+}
+__STATIC_FORCEINLINE int16_t __REVSH(int16_t value)         { return (int16_t)__builtin_bswap16((uint16_t)value); }
+__STATIC_FORCEINLINE uint32_t __ROR(uint32_t op1, uint32_t op2)
+{
+  op2 %= 32U;
+
+  return (op2 == 0U) ? op1 : ((op1 >> op2) | (op1 << (32U - op2)));
+}
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t value)
+{
+  uint32_t result = 0U;
+  uint32_t bit;
+
+  for (bit = 0U; bit < 32U; bit++)
+  {
+    result = (result << 1) | ((value >> bit) & 1U);
+  }
+
+  return result;
+}
+__STATIC_FORCEINLINE uint8_t __CLZ(uint32_t value)          { return (value == 0U) ? 32U : (uint8_t)__builtin_clz(value); }
+__STATIC_FORCEINLINE uint8_t __LDREXB(volatile uint8_t *addr)    { return *addr; }
+__STATIC_FORCEINLINE uint16_t __LDREXH(volatile uint16_t *addr)  { return *addr; }
+__STATIC_FORCEINLINE uint32_t __LDREXW(volatile uint32_t *addr)  { return *addr; }
+__STATIC_FORCEINLINE uint32_t __STREXB(uint8_t value, volatile uint8_t *addr)    { *addr = value; return 0U; }
+__STATIC_FORCEINLINE uint32_t __STREXH(uint16_t value, volatile uint16_t *addr)  { *addr = value; return 0U; }
+__STATIC_FORCEINLINE uint32_t __STREXW(uint32_t value, volatile uint32_t *addr)  { *addr = value; return 0U; }
+__STATIC_FORCEINLINE void __CLREX(void)                     { }
+__STATIC_FORCEINLINE int32_t __SSAT(int32_t val, uint32_t sat)
+{
+  int32_t max = (int32_t)((1UL << (sat - 1U)) - 1U);
+
+  return (val > max) ? max : ((val < (-max - 1)) ? (-max - 1) : val);
+}
+__STATIC_FORCEINLINE uint32_t __USAT(int32_t val, uint32_t sat)
+{
+  uint32_t max = (1UL << sat) - 1U;
+
+  return (val < 0) ? 0U : (((uint32_t)val > max) ? max : (uint32_t)val);
+}
+
+#endif /* SIM_CMSIS_H */
@@ -0,0 +1,235 @@
+/**
+  ******************************************************************************
+  * @file    sim.h
+  * @brief   Internal interface of the host simulation of the STM32F446 running
+  *          the OpenBootloader.
+  *
+  *          The firmware and the HAL are compiled for the host with the GCC
+  *          thread sanitizer instrumentation, every load, store, function entry
+  *          and exit of the firmware calls into sim_bus.c. The simulation runs
+  *          in the firmware thread only: the register models are updated from
+  *          these hooks, the time advances with them and the interrupts are
+  *          taken between two accesses, exactly like on the core.
+  *          The peripherals, the FLASH, the system memory, the SRAM and the
+  *          Cortex-M4 private peripherals are mapped at their STM32 addresses.
+  ******************************************************************************
+  */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+/* Time ----------------------------------------------------------------------*/
+typedef uint64_t SIM_TimeTypeDef;                       /* Picoseconds since power on */
+
+#define SIM_TIME_NEVER                UINT64_MAX
+#define SIM_PS_PER_S                  1000000000000ULL
+#define SIM_NS(x)                     ((SIM_TimeTypeDef)(x) * 1000ULL)
+#define SIM_US(x)                     ((SIM_TimeTypeDef)(x) * 1000000ULL)
+#define SIM_MS(x)                     ((SIM_TimeTypeDef)(x) * 1000000000ULL)
+
+/* Time of a number of cycles of a clock, rounded up */
+#define SIM_CYCLES(Cycles, Clock)     ((((SIM_TimeTypeDef)(Cycles) * SIM_PS_PER_S) + (Clock) - 1U) / (Clock))
+
+/* Memory map ----------------------------------------------------------------*/
+#define SIM_FLASH_BASE                0x08000000U
+#define SIM_FLASH_SIZE                0x00080000U
+#define SIM_SYSMEM_BASE               0x1FFF0000U
+#define SIM_SYSMEM_SIZE               0x00010000U
+#define SIM_OTP_BASE                  0x1FFF7800U
+#define SIM_OTP_SIZE                  528U
+#define SIM_OB_BASE                   0x1FFFC000U
+#define SIM_OB_SIZE                   16U
+#define SIM_SRAM_BASE                 0x20000000U
+#define SIM_SRAM_SIZE                 0x00020000U
+#define SIM_STACK_BASE                0x30000000U       /* Host stack of the firmware thread, DMA needs 32-bit addresses */
+#define SIM_STACK_SIZE                0x00800000U
+#define SIM_PERIPH_BASE               0x40000000U
+#define SIM_PERIPH_SIZE               0x00080000U
+#define SIM_BITBAND_BASE              0x42000000U
+#define SIM_BITBAND_SIZE              (SIM_PERIPH_SIZE * 32U)
+#define SIM_CORE_BASE                 0xE0000000U
+#define SIM_CORE_SIZE                 0x00100000U
+
+/* Exit status of the device process, see sim_main.c */
+#define SIM_EXIT_END                  0                 /* End of the scripted input */
+#define SIM_EXIT_ERROR                1
+#define SIM_EXIT_RESET                10                /* System reset, the device is booted again */
+#define SIM_EXIT_APP                  11                /* Jump to the application */
+#define SIM_EXIT_WATCHDOG             12                /* Independent watchdog reset, the device is booted again */
+
+/* Exception numbers */
+#define SIM_EXC_SYSTICK               15U
+#define SIM_EXC_IRQ0                  16U
+#define SIM_IRQ_NUMBER                96U
+
+/* Default cost of the instrumented operations in core clock cycles */
+#define SIM_CYCLES_ACCESS             2U
+#define SIM_CYCLES_CALL               4U
+
+/* Types ---------------------------------------------------------------------*/
+typedef enum
+{
+  SIM_RESET_POWER    = 0U,
+  SIM_RESET_SOFTWARE = 1U,
+  SIM_RESET_WATCHDOG = 2U,
+  SIM_RESET_PIN      = 3U
+} SIM_ResetTypeDef;
+
+typedef struct SIM_Timer
+{
+  SIM_TimeTypeDef When;                                 /* SIM_TIME_NEVER when stopped */
+  void (*Fire)(SIM_TimeTypeDef When);
+} SIM_TimerTypeDef;
+
+typedef struct
+{
+  uint32_t Base;
+  uint32_t Size;
+  void (*Read)(uint32_t Offset);                        /* Before a read of the word at Offset */
+  void (*Write)(uint32_t Offset, uint32_t Old);         /* After a write of the word at Offset, Old is its previous value */
+} SIM_DeviceTypeDef;
+
+typedef struct
+{
+  const char *State;                                    /* File keeping the FLASH, OTP and option bytes */
+  const char *Input;                                    /* Scripted host bytes, NULL for the PTY */
+  const char *Output;                                   /* Device bytes in scripted mode, NULL for none */
+  const char *Clock;                                    /* File exporting the simulated clock, NULL for none */
+  const char *Link;                                     /* Symbolic link created to the PTY */
+  uint32_t BaudRate;                                    /* Baudrate of the sync byte in scripted mode */
+  uint32_t CyclesAccess;
+  uint32_t CyclesCall;
+  SIM_TimeTypeDef MaxTime;                              /* Scripted mode limit, 0 for none */
+  int ExitOnApp;
+  int Verbose;
+} SIM_ConfigTypeDef;
+
+/* Counters exported in the clock file, little endian 64-bit words */
+typedef struct
+{
+  uint64_t Magic;
+  uint64_t Now;                                         /* Simulated time in ns, monotonic across resets */
+  uint64_t TxEnd;                                       /* End of the last byte sent by the device in ns */
+  uint64_t RxBytes;
+  uint64_t TxBytes;
+  uint64_t RxLineTime;                                  /* Time the host to device line has been busy in ns */
+  uint64_t TxLineTime;
+  uint64_t FlashBusyTime;                               /* Time the FLASH has been busy in ns */
+  uint64_t FlashPrograms;
+  uint64_t FlashErasedSectors;
+  uint64_t Boots;
+  uint64_t StallTime;                                   /* Time the core waited on the FLASH in ns */
+  uint64_t RxStart;                                     /* Start of the first host byte after an idle line in ns */
+} SIM_ClockTypeDef;
+
+/* State kept by the supervisor across the resets of the device */
+#define SIM_BACKUP_REGISTERS          20U
+
+typedef struct
+{
+  uint32_t ResetFlags;                                  /* Reset flags of RCC_CSR, cleared by RMVF */
+  uint32_t Backup[SIM_BACKUP_REGISTERS];                /* RTC backup registers */
+  uint64_t ScriptIndex;                                 /* Next byte of the scripted input */
+} SIM_PersistTypeDef;
+
+#define SIM_CLOCK_MAGIC               0x4B434F4C4D49534FULL  /* "OSIMLOCK" */
+
+/* Exported variables --------------------------------------------------------*/
+extern SIM_ConfigTypeDef SIM_Config;
+extern SIM_ClockTypeDef *SIM_Clock;
+extern SIM_TimeTypeDef SIM_Now;
+extern SIM_TimeTypeDef SIM_Next;
+extern SIM_TimeTypeDef SIM_Epoch;
+extern SIM_TimeTypeDef SIM_CostAccess;
+extern SIM_TimeTypeDef SIM_CostCall;
+extern uint64_t SIM_Steps;
+extern volatile int SIM_Stall;
+extern volatile int SIM_IrqCheck;
+extern volatile int SIM_Waiting;
+
+/* sim_main.c */
+void SIM_Log(const char *Format, ...) __attribute__((format(printf, 1, 2)));
+void SIM_Fatal(const char *Format, ...) __attribute__((format(printf, 1, 2), noreturn));
+void SIM_Exit(int Status) __attribute__((noreturn));
+void SIM_Reset(SIM_ResetTypeDef Cause) __attribute__((noreturn));
+SIM_PersistTypeDef *SIM_Persist(void);
+
+/* sim_cpu.c */
+void SIM_CPU_Start(SIM_ResetTypeDef Cause) __attribute__((noreturn));
+void SIM_CPU_Dispatch(void);
+void SIM_CPU_DefaultHandler(void);
+void SIM_CPU_UpdateClock(void);
+int SIM_CPU_IsRamCode(const void *Pc);
+void SIM_Timer_Start(SIM_TimerTypeDef *Timer, SIM_TimeTypeDef When);
+void SIM_Timer_Stop(SIM_TimerTypeDef *Timer);
+void SIM_RunTimers(void);
+void SIM_Idle(void);
+void SIM_IdlePoll(uint32_t Address, uint32_t Value);
+void SIM_NVIC_SetLine(uint32_t Irq, int (*Level)(void));
+void SIM_NVIC_Update(uint32_t Irq);
+void SIM_CORE_Reset(SIM_ResetTypeDef Cause);
+
+/* sim_bus.c */
+void SIM_BUS_Tick(const void *Pc);
+void SIM_BUS_Register(const SIM_DeviceTypeDef *Device);
+void SIM_BUS_Flush(void);
+void SIM_BUS_MapRegions(void);
+
+/* sim_flash.c */
+void SIM_FLASH_Open(const char *Path);
+void SIM_FLASH_Reset(void);
+void SIM_FLASH_Write(uint32_t Address, uint32_t Size, uint32_t Old);
+void SIM_FLASH_WaitIdle(void);
+int SIM_FLASH_IsBusy(void);
+void SIM_FLASH_WriteVectors(const uint32_t *pVectors, uint32_t Number);
+
+/* sim_io.c */
+void SIM_IO_Open(int Master, int Slave);
+int SIM_IO_Poll(int WaitMs);
+void SIM_IO_WaitHost(void);
+int SIM_IO_Take(uint8_t *pByte, uint32_t *pBaudRate);
+void SIM_IO_Send(uint8_t Byte);
+void SIM_IO_Flush(void);
+int SIM_IO_Exhausted(void);
+
+/* sim_usart.c */
+void SIM_USART_Reset(void);
+void SIM_USART_RxKick(void);
+uint32_t SIM_USART_ReadData(void);
+void SIM_USART_WriteData(uint32_t Data);
+int SIM_USART_RxBusy(void);
+int SIM_USART_TxIdle(void);
+int SIM_USART_DmaRequestRx(void);
+int SIM_USART_DmaRequestTx(void);
+uint32_t SIM_USART_GetBaudRate(void);
+uint32_t SIM_USART_GetListeningBaudRate(void);
+void SIM_USART_UpdateClock(void);
+
+/* sim_dma.c */
+void SIM_DMA_Reset(void);
+void SIM_DMA_Request(void);
+
+/* sim_tim.c */
+void SIM_TIM_Reset(uint32_t Instance);
+void SIM_TIM_Capture(SIM_TimeTypeDef When);
+void SIM_TIM_UpdateClock(void);
+
+/* sim_misc.c */
+void SIM_RCC_Reset(SIM_ResetTypeDef Cause);
+uint32_t SIM_RCC_GetHclk(void);
+uint32_t SIM_RCC_GetPclk1(void);
+uint32_t SIM_RCC_GetTimerClock(void);
+void SIM_PWR_Reset(void);
+void SIM_RTC_Reset(void);
+void SIM_IWDG_Reset(void);
+int SIM_IWDG_IsRunning(void);
+SIM_TimeTypeDef SIM_IWDG_GetExpiry(void);
+void SIM_CRC_Reset(void);
+void SIM_GPIO_Reset(void);
+uint32_t SIM_GPIO_RxRouting(void);
+
+#endif /* SIM_H */
@@ -0,0 +1,561 @@
+/**
+  ******************************************************************************
+  * @file    sim_bus.c
+  * @brief   Bus of the simulated device.
+  *
+  *          The firmware is compiled with -fsanitize=thread, GCC calls the
+  *          __tsan_* hooks below before each load and store, on entry and exit
+  *          of each function. They are provided here instead of the sanitizer
+  *          runtime:
+  *           - each hook accounts for the time of the operation and fires the
+  *             timers of the models which are due, then takes the pending
+  *             interrupts like the core does between two instructions,
+  *           - a read of a register lets its model refresh the register value
+  *             in memory before the load,
+  *           - a write is recorded and handed to the model with the previous
+  *             value of the register at the next hook, once the store is done,
+  *           - code out of the .RamFunc section waits while the FLASH is busy.
+  ******************************************************************************
+  */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "sim.h"
+
+/* Private types -------------------------------------------------------------*/
+typedef struct
+{
+  uint32_t Address;                 /* Address of the access, within one word */
+  uint32_t Size;                    /* Number of bytes written in this word */
+  uint32_t Old;                     /* Value of the word before the store */
+} SIM_PendingTypeDef;
+
+/* Private defines -----------------------------------------------------------*/
+#define SIM_PENDING_MAX               8U
+#define SIM_PERIPH_PAGE_SHIFT         10U
+#define SIM_CORE_PAGE_SHIFT           12U
+
+#define SIM_IN(Address, Base, Size)   (((uintptr_t)(Address) - (uintptr_t)(Base)) < (uintptr_t)(Size))
+
+/* Any address needing the bus: from the FLASH to the end of the private peripherals */
+#define SIM_IS_SPECIAL(Address)       SIM_IN((Address), SIM_FLASH_BASE, (uintptr_t)SIM_CORE_BASE + SIM_CORE_SIZE - SIM_FLASH_BASE)
+
+/* Private variables ---------------------------------------------------------*/
+static SIM_PendingTypeDef Pending[SIM_PENDING_MAX];
+static uint32_t PendingNumber = 0U;
+static const SIM_DeviceTypeDef *PeriphMap[SIM_PERIPH_SIZE >> SIM_PERIPH_PAGE_SHIFT];
+static const SIM_DeviceTypeDef *CoreMap[SIM_CORE_SIZE >> SIM_CORE_PAGE_SHIFT];
+
+/* Exported variables --------------------------------------------------------*/
+SIM_TimeTypeDef SIM_CostAccess = 0U;
+SIM_TimeTypeDef SIM_CostCall = 0U;
+
+/* Private functions ---------------------------------------------------------*/
+
+static const SIM_DeviceTypeDef *SIM_BUS_GetDevice(uintptr_t Address, uint32_t *pOffset)
+{
+  const SIM_DeviceTypeDef *device = NULL;
+
+  if (SIM_IN(Address, SIM_PERIPH_BASE, SIM_PERIPH_SIZE))
+  {
+    device = PeriphMap[(Address - SIM_PERIPH_BASE) >> SIM_PERIPH_PAGE_SHIFT];
+  }
+  else if (SIM_IN(Address, SIM_CORE_BASE, SIM_CORE_SIZE))
+  {
+    device = CoreMap[(Address - SIM_CORE_BASE) >> SIM_CORE_PAGE_SHIFT];
+  }
+
+  if ((device != NULL) && !SIM_IN(Address, device->Base, device->Size))
+  {
+    device = NULL;
+  }
+
+  if (device != NULL)
+  {
+    *pOffset = (uint32_t)(Address - device->Base) & ~3U;
+  }
+
+  return device;
+}
+
+/* Address of the register word and bit number aliased by a bit-band word */
+static uintptr_t SIM_BUS_BitBandTarget(uintptr_t Address, uint32_t *pBit)
+{
+  uint32_t offset = (uint32_t)(Address - SIM_BITBAND_BASE);
+
+  *pBit = (offset >> 2) & 31U;
+
+  return SIM_PERIPH_BASE + ((offset >> 5) & ~3U);
+}
+
+static void SIM_BUS_ReadWord(uintptr_t Address)
+{
+  const SIM_DeviceTypeDef *device;
+  uintptr_t target;
+  uint32_t offset;
+  uint32_t bit;
+
+  if (SIM_IN(Address, SIM_FLASH_BASE, SIM_FLASH_SIZE) || SIM_IN(Address, SIM_SYSMEM_BASE, SIM_SYSMEM_SIZE))
+  {
+    /* Any read of the FLASH waits for the end of the ongoing operation */
+    if (SIM_Stall != 0)
+    {
+      SIM_FLASH_WaitIdle();
+    }
+  }
+  else if (SIM_IN(Address, SIM_BITBAND_BASE, SIM_BITBAND_SIZE))
+  {
+    target = SIM_BUS_BitBandTarget(Address, &bit);
+    SIM_BUS_ReadWord(target);
+
+    *(volatile uint32_t *)(Address & ~(uintptr_t)3U) = (*(volatile uint32_t *)target >> bit) & 1U;
+  }
+  else
+  {
+    device = SIM_BUS_GetDevice(Address, &offset);
+
+    if ((device != NULL) && (device->Read != NULL))
+    {
+      device->Read(offset);
+    }
+  }
+}
+
+static void SIM_BUS_Read(const void *pAddress, uint32_t Size)
+{
+  uintptr_t address = (uintptr_t)pAddress;
+  uintptr_t last = address + Size - 1U;
+
+  if (SIM_IS_SPECIAL(address))
+  {
+    SIM_BUS_ReadWord(address & ~(uintptr_t)3U);
+
+    if ((last & ~(uintptr_t)3U) != (address & ~(uintptr_t)3U))
+    {
+      for (address = (address & ~(uintptr_t)3U) + 4U; address <= last; address += 4U)
+      {
+        SIM_BUS_ReadWord(address);
+      }
+    }
+  }
+}
+
+static void SIM_BUS_Record(uintptr_t Address, uint32_t Size)
+{
+  SIM_PendingTypeDef *pending;
+
+  if (PendingNumber == SIM_PENDING_MAX)
+  {
+    SIM_BUS_Flush();
+  }
+
+  pending          = &Pending[PendingNumber++];
+  pending->Address = (uint32_t)Address;
+  pending->Size    = Size;
+  pending->Old     = *(volatile uint32_t *)(Address & ~(uintptr_t)3U);
+}
+
+static void SIM_BUS_Write(void *pAddress, uint32_t Size)
+{
+  uintptr_t address = (uintptr_t)pAddress;
+  uintptr_t end = address + Size;
+  uintptr_t next;
+
+  if (SIM_IS_SPECIAL(address)
+      && !SIM_IN(address, SIM_SRAM_BASE, SIM_SRAM_SIZE)
+      && !SIM_IN(address, SIM_STACK_BASE, SIM_STACK_SIZE))
+  {
+    if ((SIM_Stall != 0) && (SIM_IN(address, SIM_FLASH_BASE, SIM_FLASH_SIZE) || SIM_IN(address, SIM_SYSMEM_BASE, SIM_SYSMEM_SIZE)))
+    {
+      SIM_FLASH_WaitIdle();
+    }
+
+    while (address < end)
+    {
+      next = (address & ~(uintptr_t)3U) + 4U;
+      next = (next < end) ? next : end;
+
+      SIM_BUS_Record(address, (uint32_t)(next - address));
+      address = next;
+    }
+  }
+}
+
+/* The bus operation of every hook: time, due timers, FLASH stall and interrupts */
+static inline __attribute__((always_inline)) void SIM_BUS_Step(SIM_TimeTypeDef Cost, const void *Pc)
+{
+  if (PendingNumber != 0U)
+  {
+    SIM_BUS_Flush();
+  }
+
+  SIM_Steps++;
+  SIM_Now += Cost;
+
+  if (SIM_Now >= SIM_Next)
+  {
+    SIM_RunTimers();
+  }
+
+  if ((SIM_Stall != 0) && (SIM_CPU_IsRamCode(Pc) == 0))
+  {
+    SIM_FLASH_WaitIdle();
+  }
+
+  if (SIM_IrqCheck != 0)
+  {
+    SIM_CPU_Dispatch();
+  }
+}
+
+#define SIM_PC()                      __builtin_return_address(0)
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Account for one bus access of the core outside of the instrumented code, as an intrinsic.
+  * @param  Pc Address in the code doing the access.
+  * @retval None.
+  */
+void SIM_BUS_Tick(const void *Pc)
+{
+  SIM_BUS_Step(SIM_CostAccess, Pc);
+  SIM_BUS_Flush();
+}
+
+/**
+  * @brief  Register the model of a block of registers.
+  *         The block must not share a 1 KB page (4 KB for the private peripherals) with another block.
+  * @param  Device The register block.
+  * @retval None.
+  */
+void SIM_BUS_Register(const SIM_DeviceTypeDef *Device)
+{
+  uintptr_t address;
+
+  for (address = Device->Base; address < ((uintptr_t)Device->Base + Device->Size); address += 4U)
+  {
+    if (SIM_IN(address, SIM_PERIPH_BASE, SIM_PERIPH_SIZE))
+    {
+      PeriphMap[(address - SIM_PERIPH_BASE) >> SIM_PERIPH_PAGE_SHIFT] = Device;
+    }
+    else if (SIM_IN(address, SIM_CORE_BASE, SIM_CORE_SIZE))
+    {
+      CoreMap[(address - SIM_CORE_BASE) >> SIM_CORE_PAGE_SHIFT] = Device;
+    }
+    else
+    {
+      SIM_Fatal("device at 0x%08x out of the peripheral regions", Device->Base);
+    }
+  }
+}
+
+/**
+  * @brief  Hand the recorded writes to the models, the stores have been done by now.
+  * @retval None.
+  */
+void SIM_BUS_Flush(void)
+{
+  const SIM_DeviceTypeDef *device;
+  SIM_PendingTypeDef pending;
+  volatile uint32_t *target;
+  uintptr_t address;
+  uint32_t offset;
+  uint32_t bit;
+  uint32_t old;
+  uint32_t index = 0U;
+
+  while (index < PendingNumber)
+  {
+    pending = Pending[index++];
+    address = pending.Address;
+
+    if (SIM_IN(address, SIM_FLASH_BASE, SIM_FLASH_SIZE) || SIM_IN(address, SIM_SYSMEM_BASE, SIM_SYSMEM_SIZE))
+    {
+      SIM_FLASH_Write(pending.Address, pending.Size, pending.Old);
+    }
+    else if (SIM_IN(address, SIM_BITBAND_BASE, SIM_BITBAND_SIZE))
+    {
+      /* Turn the write of the alias word into a write of one bit of the register */
+      target = (volatile uint32_t *)SIM_BUS_BitBandTarget(address, &bit);
+      old    = *target;
+
+      if ((*(volatile uint32_t *)(address & ~(uintptr_t)3U) & 1U) != 0U)
+      {
+        *target = old | (1UL << bit);
+      }
+      else
+      {
+        *target = old & ~(1UL << bit);
+      }
+
+      device = SIM_BUS_GetDevice((uintptr_t)target, &offset);
+
+      if ((device != NULL) && (device->Write != NULL))
+      {
+        device->Write(offset, old);
+      }
+    }
+    else
+    {
+      device = SIM_BUS_GetDevice(address, &offset);
+
+      if ((device != NULL) && (device->Write != NULL))
+      {
+        device->Write(offset, pending.Old);
+      }
+    }
+  }
+
+  /* Writes recorded by the models while flushing are kept */
+  if (index == PendingNumber)
+  {
+    PendingNumber = 0U;
+  }
+}
+
+/**
+  * @brief  Map the memory regions of the device at their addresses.
+  *         The FLASH and the system memory are mapped by SIM_FLASH_Open(). None of them is executable: the jump to an
+  *         application faults, see sim_cpu.c.
+  * @retval None.
+  */
+void SIM_BUS_MapRegions(void)
+{
+  static const struct
+  {
+    uint32_t Base;
+    uint32_t Size;
+  } regions[] =
+  {
+    { SIM_SRAM_BASE,    SIM_SRAM_SIZE    },
+    { SIM_STACK_BASE,   SIM_STACK_SIZE   },
+    { SIM_PERIPH_BASE,  SIM_PERIPH_SIZE  },
+    { SIM_BITBAND_BASE, SIM_BITBAND_SIZE },
+    { SIM_CORE_BASE,    SIM_CORE_SIZE    }
+  };
+  void *map;
+  size_t index;
+
+  for (index = 0U; index < (sizeof(regions) / sizeof(regions[0])); index++)
+  {
+    map = mmap((void *)(uintptr_t)regions[index].Base, regions[index].Size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE, -1, 0);
+
+    if (map != (void *)(uintptr_t)regions[index].Base)
+    {
+      SIM_Fatal("cannot map 0x%08x: %m", regions[index].Base);
+    }
+  }
+}
+
+/* Hooks called by the instrumented firmware -------------------------------*/
+
+void __tsan_init(void)
+{
+}
+
+void __tsan_func_entry(void *CallPc)
+{
+  (void)CallPc;
+  SIM_BUS_Step(SIM_CostCall, SIM_PC());
+}
+
+void __tsan_func_exit(void)
+{
+  SIM_BUS_Step(SIM_CostAccess, SIM_PC());
+}
+
+#define SIM_BUS_HOOKS(Size)                                                       \
+  void __tsan_read##Size(void *Address)                                           \
+  {                                                                               \
+    SIM_BUS_Step(SIM_CostAccess, SIM_PC());                                       \
+    SIM_BUS_Read(Address, Size);                                                  \
+  }                                                                               \
+  void __tsan_write##Size(void *Address)                                          \
+  {                                                                               \
+    SIM_BUS_Step(SIM_CostAccess, SIM_PC());                                       \
+    SIM_BUS_Write(Address, Size);                                                 \
+  }                                                                               \
+  void __tsan_unaligned_read##Size(void *Address)                                 \
+  {                                                                               \
+    SIM_BUS_Step(SIM_CostAccess, SIM_PC());                                       \
+    SIM_BUS_Read(Address, Size);                                                  \
+  }                                                                               \
+  void __tsan_unaligned_write##Size(void *Address)                                \
+  {                                                                               \
+    SIM_BUS_Step(SIM_CostAccess, SIM_PC());                                       \
+    SIM_BUS_Write(Address, Size);                                                 \
+  }                                                                               \
+  void __tsan_volatile_read##Size(void *Address)                                  \
+  {                                                                               \
+    SIM_BUS_Step(SIM_CostAccess, SIM_PC());                                       \
+    SIM_BUS_Read(Address, Size);                                                  \
+  }                                                                               \
+  void __tsan_volatile_write##Size(void *Address)                                 \
+  {                                                                               \
+    SIM_BUS_Step(SIM_CostAccess, SIM_PC());                                       \
+    SIM_BUS_Write(Address, Size);                                                 \
+  }                                                                               \
+  void __tsan_unaligned_volatile_read##Size(void *Address)                        \
+  {                                                                               \
+    SIM_BUS_Step(SIM_CostAccess, SIM_PC());                                       \
+    SIM_BUS_Read(Address, Size);                                                  \
+  }                                                                               \
+  void __tsan_unaligned_volatile_write##Size(void *Address)                       \
+  {                                                                               \
+    SIM_BUS_Step(SIM_CostAccess, SIM_PC());                                       \
+    SIM_BUS_Write(Address, Size);                                                 \
+  }
+
+SIM_BUS_HOOKS(1)
+SIM_BUS_HOOKS(2)
+SIM_BUS_HOOKS(4)
+SIM_BUS_HOOKS(8)
+SIM_BUS_HOOKS(16)
+
+void __tsan_read_range(void *Address, unsigned long Size)
+{
+  SIM_BUS_Step(SIM_CostAccess * ((Size + 3U) / 4U), SIM_PC());
+
+  if (Size != 0U)
+  {
+    SIM_BUS_Read(Address, (uint32_t)Size);
+  }
+}
+
+void __tsan_write_range(void *Address, unsigned long Size)
+{
+  SIM_BUS_Step(SIM_CostAccess * ((Size + 3U) / 4U), SIM_PC());
+
+  if (Size != 0U)
+  {
+    SIM_BUS_Write(Address, (uint32_t)Size);
+  }
+}
+
+/* C library functions called by the firmware ------------------------------*/
+/* They are not instrumented, the firmware objects are linked to these instead. As the C library of the
+   target they execute from FLASH. */
+
+static int SIM_BUS_RangeIsPlain(const void *pAddress, size_t Length)
+{
+  uintptr_t address = (uintptr_t)pAddress;
+
+  return (Length == 0U)
+         || ((address + Length) <= SIM_FLASH_BASE)
+         || (address >= ((uintptr_t)SIM_CORE_BASE + SIM_CORE_SIZE))
+         || (SIM_IN(address, SIM_SRAM_BASE, SIM_SRAM_SIZE) && SIM_IN(address + Length - 1U, SIM_SRAM_BASE, SIM_SRAM_SIZE))
+         || (SIM_IN(address, SIM_STACK_BASE, SIM_STACK_SIZE) && SIM_IN(address + Length - 1U, SIM_STACK_BASE, SIM_STACK_SIZE));
+}
+
+static int SIM_BUS_RangeIsFlash(const void *pAddress, size_t Length)
+{
+  uintptr_t address = (uintptr_t)pAddress;
+
+  return SIM_IN(address, SIM_FLASH_BASE, SIM_FLASH_SIZE) && SIM_IN(address + Length - 1U, SIM_FLASH_BASE, SIM_FLASH_SIZE);
+}
+
+void *SIM_memcpy(void *pDst, const void *pSrc, size_t Length)
+{
+  volatile uint8_t *dst = pDst;
+  const volatile uint8_t *src = pSrc;
+  size_t index;
+
+  SIM_BUS_Step(SIM_CostCall + (SIM_CostAccess * 2U * ((Length + 3U) / 4U)), NULL);
+
+  if (SIM_BUS_RangeIsPlain(pDst, Length)
+      && (SIM_BUS_RangeIsPlain(pSrc, Length) || SIM_BUS_RangeIsFlash(pSrc, Length)))
+  {
+    if ((SIM_Stall != 0) && SIM_BUS_RangeIsFlash(pSrc, Length))
+    {
+      SIM_FLASH_WaitIdle();
+    }
+
+    memcpy(pDst, pSrc, Length);
+  }
+  else
+  {
+    for (index = 0U; index < Length; index++)
+    {
+      SIM_BUS_Read((const void *)&src[index], 1U);
+      SIM_BUS_Write((void *)&dst[index], 1U);
+      dst[index] = src[index];
+      SIM_BUS_Flush();
+    }
+  }
+
+  return pDst;
+}
+
+void *SIM_memmove(void *pDst, const void *pSrc, size_t Length)
+{
+  uint8_t buffer[256];
+  size_t chunk;
+  size_t done = 0U;
+
+  if (SIM_BUS_RangeIsPlain(pDst, Length) && SIM_BUS_RangeIsPlain(pSrc, Length))
+  {
+    SIM_BUS_Step(SIM_CostCall + (SIM_CostAccess * 2U * ((Length + 3U) / 4U)), NULL);
+
+    return memmove(pDst, pSrc, Length);
+  }
+
+  /* Only used on the memories of the device without overlap in this firmware */
+  while (done < Length)
+  {
+    chunk = ((Length - done) > sizeof(buffer)) ? sizeof(buffer) : (Length - done);
+    SIM_memcpy(buffer, (const uint8_t *)pSrc + done, chunk);
+    SIM_memcpy((uint8_t *)pDst + done, buffer, chunk);
+    done += chunk;
+  }
+
+  return pDst;
+}
+
+void *SIM_memset(void *pDst, int Value, size_t Length)
+{
+  volatile uint8_t *dst = pDst;
+  size_t index;
+
+  SIM_BUS_Step(SIM_CostCall + (SIM_CostAccess * ((Length + 3U) / 4U)), NULL);
+
+  if (SIM_BUS_RangeIsPlain(pDst, Length))
+  {
+    memset(pDst, Value, Length);
+  }
+  else
+  {
+    for (index = 0U; index < Length; index++)
+    {
+      SIM_BUS_Write((void *)&dst[index], 1U);
+      dst[index] = (uint8_t)Value;
+      SIM_BUS_Flush();
+    }
+  }
+
+  return pDst;
+}
+
+int SIM_memcmp(const void *pLeft, const void *pRight, size_t Length)
+{
+  SIM_BUS_Step(SIM_CostCall + (SIM_CostAccess * 2U * ((Length + 3U) / 4U)), NULL);
+
+  if ((SIM_Stall != 0) && (!SIM_BUS_RangeIsPlain(pLeft, Length) || !SIM_BUS_RangeIsPlain(pRight, Length)))
+  {
+    SIM_FLASH_WaitIdle();
+  }
+
+  if (!SIM_BUS_RangeIsPlain(pLeft, Length) && !SIM_BUS_RangeIsFlash(pLeft, Length))
+  {
+    SIM_BUS_Read(pLeft, (uint32_t)Length);
+  }
+
+  if (!SIM_BUS_RangeIsPlain(pRight, Length) && !SIM_BUS_RangeIsFlash(pRight, Length))
+  {
+    SIM_BUS_Read(pRight, (uint32_t)Length);
+  }
+
+  return memcmp(pLeft, pRight, Length);
+}
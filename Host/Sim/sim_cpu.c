@@ -0,0 +1,1134 @@
+/**
+  ******************************************************************************
+  * @file    sim_cpu.c
+  * @brief   Cortex-M4 core of the simulated device: the firmware thread, the
+  *          exceptions, the timers of the models and the private peripherals
+  *          (NVIC, SCB, SysTick, DWT, DBGMCU).
+  *
+  *          The firmware runs in its own thread, its stack is mapped below 4 GB
+  *          as the firmware passes the address of local buffers to the DMA.
+  *          Exceptions are taken from the bus hooks: the handler is called as a
+  *          function on the stack of the interrupted code. The time only moves
+  *          forward with the hooks, except at idle points: when the firmware
+  *          polls a register which cannot change before the next event of the
+  *          models, the time jumps to that event.
+  ******************************************************************************
+  */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "sim.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define SIM_TIMERS_MAX                16U
+#define SIM_ACTIVE_MAX                32U
+#define SIM_POLL_REPEAT               32U       /* Unchanged polls before jumping to the next event */
+#define SIM_POLL_GAP                  1024U     /* Maximum number of hooks between two polls of a loop */
+#define SIM_POLL_REGISTERS            4U        /* Registers polled by one loop */
+#define SIM_THREAD_LEVEL              0x100U    /* Priority of the thread mode, below any exception */
+
+/* Offsets in the System Control Space page */
+#define SIM_SCS_SYST_CSR              0x010U
+#define SIM_SCS_SYST_RVR              0x014U
+#define SIM_SCS_SYST_CVR              0x018U
+#define SIM_SCS_SYST_CALIB            0x01CU
+#define SIM_SCS_NVIC_ISER             0x100U
+#define SIM_SCS_NVIC_ICER             0x180U
+#define SIM_SCS_NVIC_ISPR             0x200U
+#define SIM_SCS_NVIC_ICPR             0x280U
+#define SIM_SCS_NVIC_IABR             0x300U
+#define SIM_SCS_NVIC_IP               0x400U
+#define SIM_SCS_SCB_CPUID             0xD00U
+#define SIM_SCS_SCB_ICSR              0xD04U
+#define SIM_SCS_SCB_VTOR              0xD08U
+#define SIM_SCS_SCB_AIRCR             0xD0CU
+#define SIM_SCS_SCB_SHP               0xD18U
+#define SIM_SCS_NVIC_STIR             0xF00U
+
+#define SIM_IRQ_WORDS                 (SIM_IRQ_NUMBER / 32U)
+
+/* Private types -------------------------------------------------------------*/
+typedef struct
+{
+  uint32_t Exception;
+  uint32_t Priority;                /* Group priority of the exception */
+} SIM_ActiveTypeDef;
+
+/* Exported variables --------------------------------------------------------*/
+SIM_TimeTypeDef SIM_Now = 0U;
+SIM_TimeTypeDef SIM_Next = SIM_TIME_NEVER;
+SIM_TimeTypeDef SIM_Epoch = 0U;
+uint64_t SIM_Steps = 0U;
+volatile int SIM_Stall = 0;
+volatile int SIM_IrqCheck = 0;
+volatile int SIM_Waiting = 0;
+
+/* Private variables ---------------------------------------------------------*/
+static SIM_TimerTypeDef *Timers[SIM_TIMERS_MAX];
+static uint32_t TimersNumber = 0U;
+
+static uint32_t Primask = 0U;
+static uint32_t Basepri = 0U;
+static uint32_t Faultmask = 0U;
+static uint32_t Msp = 0U;
+static SIM_ActiveTypeDef Active[SIM_ACTIVE_MAX];
+static uint32_t ActiveNumber = 0U;
+
+static uint32_t NvicEnabled[SIM_IRQ_WORDS];
+static uint32_t NvicPending[SIM_IRQ_WORDS];
+static int (*NvicLine[SIM_IRQ_NUMBER])(void);
+static uint32_t SysTickPending = 0U;
+static uint32_t PriorityGroup = 0U;
+
+static uint32_t Hclk = 16000000U;
+
+/* SysTick: the counter reloaded at SysTickBase, counting the core clock or the core clock / 8 */
+static SIM_TimerTypeDef SysTickTimer;
+static SIM_TimeTypeDef SysTickBase = 0U;
+static uint32_t SysTickCountFlag = 0U;
+
+/* DWT cycle counter: DwtCycles at DwtBase */
+static SIM_TimeTypeDef DwtBase = 0U;
+static uint32_t DwtCycles = 0U;
+
+/* Idle detection: the last value read from the polled registers */
+static uint32_t PollAddress[SIM_POLL_REGISTERS];
+static uint32_t PollValue[SIM_POLL_REGISTERS];
+static uint32_t PollNext = 0U;
+static uint64_t PollStep = 0U;
+static uint32_t PollRepeat = 0U;
+
+extern uint8_t __sim_ramfunc_start[];
+extern uint8_t __sim_ramfunc_end[];
+
+/* Firmware entry points ------------------------------------------------------*/
+extern void SystemInit(void);
+extern int bl_main(void);
+
+void SIM_CPU_DefaultHandler(void);
+
+#define SIM_WEAK_HANDLER(Name)        extern void Name(void) __attribute__((weak))
+SIM_WEAK_HANDLER(NMI_Handler);
+SIM_WEAK_HANDLER(HardFault_Handler);
+SIM_WEAK_HANDLER(MemManage_Handler);
+SIM_WEAK_HANDLER(BusFault_Handler);
+SIM_WEAK_HANDLER(UsageFault_Handler);
+SIM_WEAK_HANDLER(SVC_Handler);
+SIM_WEAK_HANDLER(DebugMon_Handler);
+SIM_WEAK_HANDLER(PendSV_Handler);
+SIM_WEAK_HANDLER(SysTick_Handler);
+SIM_WEAK_HANDLER(FLASH_IRQHandler);
+SIM_WEAK_HANDLER(USART2_IRQHandler);
+SIM_WEAK_HANDLER(TIM6_DAC_IRQHandler);
+
+/* Private functions ---------------------------------------------------------*/
+
+static volatile uint32_t *SIM_CPU_Scs(uint32_t Offset)
+{
+  return (volatile uint32_t *)(uintptr_t)(0xE000E000U + Offset);
+}
+
+static uint32_t SIM_CPU_Elapsed(SIM_TimeTypeDef Base, uint32_t Clock)
+{
+  return (uint32_t)(((unsigned __int128)(SIM_Now - Base) * Clock) / SIM_PS_PER_S);
+}
+
+static uint32_t SIM_CPU_Group(uint32_t Priority)
+{
+  /* The F4 implements the 4 upper bits, the group field is above PRIGROUP */
+  return (Priority & 0xF0U) >> (PriorityGroup + 1U);
+}
+
+static uint32_t SIM_CPU_GetPriority(uint32_t Exception)
+{
+  uint32_t priority;
+
+  if (Exception == SIM_EXC_SYSTICK)
+  {
+    priority = *(volatile uint8_t *)(uintptr_t)(0xE000E000U + SIM_SCS_SCB_SHP + 11U);
+  }
+  else
+  {
+    priority = *(volatile uint8_t *)(uintptr_t)(0xE000E000U + SIM_SCS_NVIC_IP + (Exception - SIM_EXC_IRQ0));
+  }
+
+  return SIM_CPU_Group(priority);
+}
+
+static uint32_t SIM_CPU_ExecutionPriority(void)
+{
+  uint32_t level = SIM_THREAD_LEVEL;
+
+  if (ActiveNumber != 0U)
+  {
+    level = Active[ActiveNumber - 1U].Priority;
+  }
+
+  if ((Basepri != 0U) && (SIM_CPU_Group(Basepri) < level))
+  {
+    level = SIM_CPU_Group(Basepri);
+  }
+
+  if ((Primask != 0U) || (Faultmask != 0U))
+  {
+    level = 0U;
+  }
+
+  return level;
+}
+
+/* Highest priority pending exception, 0 if none */
+static uint32_t SIM_CPU_GetPendingException(uint32_t *pPriority)
+{
+  uint32_t exception = 0U;
+  uint32_t best = SIM_THREAD_LEVEL;
+  uint32_t priority;
+  uint32_t irq;
+  uint32_t word;
+
+  if (SysTickPending != 0U)
+  {
+    exception = SIM_EXC_SYSTICK;
+    best      = SIM_CPU_GetPriority(SIM_EXC_SYSTICK);
+  }
+
+  for (word = 0U; word < SIM_IRQ_WORDS; word++)
+  {
+    if ((NvicPending[word] & NvicEnabled[word]) != 0U)
+    {
+      for (irq = word * 32U; irq < ((word + 1U) * 32U); irq++)
+      {
+        if (((NvicPending[word] & NvicEnabled[word]) & (1UL << (irq & 31U))) != 0U)
+        {
+          priority = SIM_CPU_GetPriority(SIM_EXC_IRQ0 + irq);
+
+          if (priority < best)
+          {
+            best      = priority;
+            exception = SIM_EXC_IRQ0 + irq;
+          }
+        }
+      }
+    }
+  }
+
+  *pPriority = best;
+
+  return exception;
+}
+
+static void SIM_CPU_Take(uint32_t Exception, uint32_t Priority, uintptr_t Handler)
+{
+  uint32_t irq = Exception - SIM_EXC_IRQ0;
+
+  if (ActiveNumber == SIM_ACTIVE_MAX)
+  {
+    SIM_Fatal("exception nesting too deep");
+  }
+
+  if (Exception == SIM_EXC_SYSTICK)
+  {
+    SysTickPending = 0U;
+  }
+  else
+  {
+    NvicPending[irq / 32U] &= ~(1UL << (irq & 31U));
+  }
+
+  Active[ActiveNumber].Exception = Exception;
+  Active[ActiveNumber].Priority  = Priority;
+  ActiveNumber++;
+
+  /* Stacking and vector fetch */
+  SIM_Now += 12U * (SIM_CostAccess / SIM_CYCLES_ACCESS);
+
+  ((void (*)(void))Handler)();
+
+  SIM_BUS_Flush();
+  ActiveNumber--;
+
+  /* A level sensitive line still asserted pends the interrupt again */
+  if ((Exception >= SIM_EXC_IRQ0) && (NvicLine[irq] != NULL) && (NvicLine[irq]() != 0))
+  {
+    NvicPending[irq / 32U] |= (1UL << (irq & 31U));
+  }
+
+  SIM_Now += 10U * (SIM_CostAccess / SIM_CYCLES_ACCESS);
+}
+
+/* SysTick ---------------------------------------------------------------------*/
+
+static uint32_t SIM_SYSTICK_GetClock(void)
+{
+  return ((*SIM_CPU_Scs(SIM_SCS_SYST_CSR) & SysTick_CTRL_CLKSOURCE_Msk) != 0U) ? Hclk : (Hclk / 8U);
+}
+
+static SIM_TimeTypeDef SIM_SYSTICK_Period(void)
+{
+  return SIM_CYCLES((*SIM_CPU_Scs(SIM_SCS_SYST_RVR) & 0xFFFFFFU) + 1U, SIM_SYSTICK_GetClock());
+}
+
+static int SIM_SYSTICK_IsRunning(void)
+{
+  return ((*SIM_CPU_Scs(SIM_SCS_SYST_CSR) & SysTick_CTRL_ENABLE_Msk) != 0U)
+         && ((*SIM_CPU_Scs(SIM_SCS_SYST_RVR) & 0xFFFFFFU) != 0U);
+}
+
+static uint32_t SIM_SYSTICK_GetValue(void)
+{
+  uint32_t reload = *SIM_CPU_Scs(SIM_SCS_SYST_RVR) & 0xFFFFFFU;
+  uint32_t elapsed;
+
+  if (!SIM_SYSTICK_IsRunning())
+  {
+    return *SIM_CPU_Scs(SIM_SCS_SYST_CVR);
+  }
+
+  elapsed = SIM_CPU_Elapsed(SysTickBase, SIM_SYSTICK_GetClock()) % (reload + 1U);
+
+  return reload - elapsed;
+}
+
+/* Restart the counter from Value at the current time */
+static void SIM_SYSTICK_Rebase(uint32_t Value)
+{
+  uint32_t reload = *SIM_CPU_Scs(SIM_SCS_SYST_RVR) & 0xFFFFFFU;
+
+  if (!SIM_SYSTICK_IsRunning())
+  {
+    SIM_Timer_Stop(&SysTickTimer);
+  }
+  else
+  {
+    if ((Value == 0U) || (Value > reload))
+    {
+      Value = reload;
+    }
+
+    SysTickBase = SIM_Now - SIM_CYCLES(reload - Value, SIM_SYSTICK_GetClock());
+    SIM_Timer_Start(&SysTickTimer, SysTickBase + SIM_SYSTICK_Period());
+  }
+}
+
+static void SIM_SYSTICK_Fire(SIM_TimeTypeDef When)
+{
+  SysTickCountFlag = 1U;
+  SysTickBase      = When;
+
+  if ((*SIM_CPU_Scs(SIM_SCS_SYST_CSR) & SysTick_CTRL_TICKINT_Msk) != 0U)
+  {
+    SysTickPending = 1U;
+    SIM_IrqCheck   = 1;
+  }
+
+  SIM_Timer_Start(&SysTickTimer, When + SIM_SYSTICK_Period());
+
+  /* The host may have sent bytes meanwhile, the scripted input is only released at idle points */
+  if (SIM_Config.Input == NULL)
+  {
+    (void)SIM_IO_Poll(0);
+    SIM_USART_RxKick();
+  }
+}
+
+/* System Control Space --------------------------------------------------------*/
+
+static void SIM_SCS_Read(uint32_t Offset)
+{
+  volatile uint32_t *reg = SIM_CPU_Scs(Offset);
+  uint32_t word;
+
+  if (Offset == SIM_SCS_SYST_CSR)
+  {
+    *reg = (*reg & ~SysTick_CTRL_COUNTFLAG_Msk) | (SysTickCountFlag << SysTick_CTRL_COUNTFLAG_Pos);
+    SysTickCountFlag = 0U;
+  }
+  else if (Offset == SIM_SCS_SYST_CVR)
+  {
+    *reg = SIM_SYSTICK_GetValue();
+  }
+  else if ((Offset >= SIM_SCS_NVIC_ISER) && (Offset < (SIM_SCS_NVIC_IABR + 0x80U)))
+  {
+    word = ((Offset & 0x7FU) >> 2);
+
+    if (word < SIM_IRQ_WORDS)
+    {
+      switch (Offset & ~0x7FU)
+      {
+        case SIM_SCS_NVIC_ISER:
+        case SIM_SCS_NVIC_ICER:
+          *reg = NvicEnabled[word];
+          break;
+
+        case SIM_SCS_NVIC_ISPR:
+        case SIM_SCS_NVIC_ICPR:
+          *reg = NvicPending[word];
+          break;
+
+        default:
+          *reg = 0U;
+          break;
+      }
+    }
+  }
+  else if (Offset == SIM_SCS_SCB_ICSR)
+  {
+    *reg = (SysTickPending << SCB_ICSR_PENDSTSET_Pos) | SIM_CPU_GetIpsr();
+  }
+  else if (Offset == SIM_SCS_SCB_AIRCR)
+  {
+    *reg = 0xFA050000U | (PriorityGroup << SCB_AIRCR_PRIGROUP_Pos);
+  }
+  else
+  {
+    /* Plain registers */
+  }
+}
+
+static void SIM_SCS_Write(uint32_t Offset, uint32_t Old)
+{
+  volatile uint32_t *reg = SIM_CPU_Scs(Offset);
+  uint32_t value = *reg;
+  uint32_t word;
+
+  if (Offset == SIM_SCS_SYST_CSR)
+  {
+    *reg = value & (SysTick_CTRL_ENABLE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_CLKSOURCE_Msk);
+
+    if (((Old ^ value) & (SysTick_CTRL_ENABLE_Msk | SysTick_CTRL_CLKSOURCE_Msk)) != 0U)
+    {
+      if ((value & SysTick_CTRL_ENABLE_Msk) == 0U)
+      {
+        /* Keep the current value of the stopped counter */
+        *reg = Old;
+        *SIM_CPU_Scs(SIM_SCS_SYST_CVR) = SIM_SYSTICK_GetValue();
+        *reg = value & (SysTick_CTRL_ENABLE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_CLKSOURCE_Msk);
+      }
+
+      SIM_SYSTICK_Rebase(*SIM_CPU_Scs(SIM_SCS_SYST_CVR));
+    }
+  }
+  else if (Offset == SIM_SCS_SYST_RVR)
+  {
+    *reg = value & 0xFFFFFFU;
+
+    if ((Old == 0U) && SIM_SYSTICK_IsRunning())
+    {
+      SIM_SYSTICK_Rebase(0U);
+    }
+  }
+  else if (Offset == SIM_SCS_SYST_CVR)
+  {
+    /* Any write clears the counter, it is reloaded on the next clock */
+    *reg             = 0U;
+    SysTickCountFlag = 0U;
+    SIM_SYSTICK_Rebase(0U);
+  }
+  else if (Offset == SIM_SCS_SYST_CALIB)
+  {
+    *reg = Old;
+  }
+  else if ((Offset >= SIM_SCS_NVIC_ISER) && (Offset < (SIM_SCS_NVIC_IABR + 0x80U)))
+  {
+    word = ((Offset & 0x7FU) >> 2);
+
+    if (word < SIM_IRQ_WORDS)
+    {
+      switch (Offset & ~0x7FU)
+      {
+        case SIM_SCS_NVIC_ISER:
+          NvicEnabled[word] |= value;
+          *reg = NvicEnabled[word];
+          break;
+
+        case SIM_SCS_NVIC_ICER:
+          NvicEnabled[word] &= ~value;
+          *reg = NvicEnabled[word];
+          break;
+
+        case SIM_SCS_NVIC_ISPR:
+          NvicPending[word] |= value;
+          *reg = NvicPending[word];
+          break;
+
+        case SIM_SCS_NVIC_ICPR:
+          NvicPending[word] &= ~value;
+
+          /* Lines still asserted pend again at once */
+          for (uint32_t bit = 0U; bit < 32U; bit++)
+          {
+            if ((value & (1UL << bit)) != 0U)
+            {
+              SIM_NVIC_Update((word * 32U) + bit);
+            }
+          }
+
+          *reg = NvicPending[word];
+          break;
+
+        default:
+          *reg = Old;
+          break;
+      }
+    }
+
+    SIM_IrqCheck = 1;
+  }
+  else if ((Offset >= SIM_SCS_NVIC_IP) && (Offset < (SIM_SCS_NVIC_IP + SIM_IRQ_NUMBER)))
+  {
+    SIM_IrqCheck = 1;
+  }
+  else if (Offset == SIM_SCS_NVIC_STIR)
+  {
+    if ((value & 0x1FFU) < SIM_IRQ_NUMBER)
+    {
+      NvicPending[(value & 0x1FFU) / 32U] |= (1UL << (value & 31U));
+      SIM_IrqCheck = 1;
+    }
+  }
+  else if (Offset == SIM_SCS_SCB_CPUID)
+  {
+    *reg = Old;
+  }
+  else if (Offset == SIM_SCS_SCB_ICSR)
+  {
+    if ((value & SCB_ICSR_PENDSTSET_Msk) != 0U)
+    {
+      SysTickPending = 1U;
+      SIM_IrqCheck   = 1;
+    }
+
+    if ((value & SCB_ICSR_PENDSTCLR_Msk) != 0U)
+    {
+      SysTickPending = 0U;
+    }
+  }
+  else if (Offset == SIM_SCS_SCB_VTOR)
+  {
+    *reg = value & SCB_VTOR_TBLOFF_Msk;
+  }
+  else if (Offset == SIM_SCS_SCB_AIRCR)
+  {
+    if ((value >> 16) == 0x05FAU)
+    {
+      PriorityGroup = (value & SCB_AIRCR_PRIGROUP_Msk) >> SCB_AIRCR_PRIGROUP_Pos;
+
+      if ((value & SCB_AIRCR_SYSRESETREQ_Msk) != 0U)
+      {
+        SIM_Reset(SIM_RESET_SOFTWARE);
+      }
+    }
+
+    *reg = 0xFA050000U | (PriorityGroup << SCB_AIRCR_PRIGROUP_Pos);
+  }
+  else if ((Offset >= SIM_SCS_SCB_SHP) && (Offset < (SIM_SCS_SCB_SHP + 12U)))
+  {
+    SIM_IrqCheck = 1;
+  }
+  else
+  {
+    /* Plain registers */
+  }
+}
+
+static const SIM_DeviceTypeDef ScsDevice =
+{
+  0xE000E000U, 0x1000U, SIM_SCS_Read, SIM_SCS_Write
+};
+
+/* Data Watchpoint and Trace -----------------------------------------------------*/
+
+static void SIM_DWT_Read(uint32_t Offset)
+{
+  if ((Offset == 0x004U) && ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) != 0U))
+  {
+    DWT->CYCCNT = DwtCycles + SIM_CPU_Elapsed(DwtBase, Hclk);
+  }
+}
+
+static void SIM_DWT_Write(uint32_t Offset, uint32_t Old)
+{
+  if ((Offset == 0x000U) && (((Old ^ DWT->CTRL) & DWT_CTRL_CYCCNTENA_Msk) != 0U))
+  {
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0U)
+    {
+      /* Freeze the counter */
+      DWT->CYCCNT = DwtCycles + SIM_CPU_Elapsed(DwtBase, Hclk);
+    }
+
+    DwtCycles = DWT->CYCCNT;
+    DwtBase   = SIM_Now;
+  }
+  else if (Offset == 0x004U)
+  {
+    DwtCycles = DWT->CYCCNT;
+    DwtBase   = SIM_Now;
+  }
+  else
+  {
+    /* Plain registers */
+  }
+}
+
+static const SIM_DeviceTypeDef DwtDevice =
+{
+  0xE0001000U, 0x1000U, SIM_DWT_Read, SIM_DWT_Write
+};
+
+static const SIM_DeviceTypeDef DbgmcuDevice =
+{
+  0xE0042000U, 0x1000U, NULL, NULL
+};
+
+/* Firmware thread ------------------------------------------------------------*/
+
+static void SIM_CPU_Fault(int Signal, siginfo_t *Info, void *Context)
+{
+  ucontext_t *context = Context;
+  uintptr_t pc = (uintptr_t)context->uc_mcontext.gregs[REG_RIP];
+  uintptr_t address = (uintptr_t)Info->si_addr;
+
+  (void)Signal;
+
+  /* A jump to the FLASH or the SRAM is the start of an application, those regions are not executable */
+  if ((pc == address)
+      && ((((address - SIM_FLASH_BASE) < SIM_FLASH_SIZE)) || ((address - SIM_SRAM_BASE) < SIM_SRAM_SIZE)))
+  {
+    SIM_Log("application started at 0x%08x, VTOR 0x%08x, MSP 0x%08x",
+            (unsigned int)address, (unsigned int)SCB->VTOR, (unsigned int)Msp);
+    SIM_Exit(SIM_EXIT_APP);
+  }
+
+  /* Any other jump out of the firmware is an application with a corrupted vector table,
+     the device faults in it until a reset as it would on the board */
+  if ((pc == address) && (address < 0x100000000ULL))
+  {
+    SIM_Log("application entry 0x%08x is not executable", (unsigned int)address);
+    SIM_Exit(SIM_EXIT_APP);
+  }
+
+  SIM_Fatal("fault at 0x%lx accessing 0x%lx", (unsigned long)pc, (unsigned long)address);
+}
+
+static void *SIM_CPU_Thread(void *Argument)
+{
+  (void)Argument;
+
+  /* Reset_Handler, the data and bss sections of the host are initialised by the supervisor fork */
+  SystemInit();
+  bl_main();
+
+  SIM_Fatal("bl_main() returned");
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Reset the core and its private peripherals.
+  * @param  Cause The reset cause.
+  * @retval None.
+  */
+void SIM_CORE_Reset(SIM_ResetTypeDef Cause)
+{
+  (void)Cause;
+
+  memset((void *)(uintptr_t)SIM_CORE_BASE, 0, 0x1000U);
+  memset((void *)(uintptr_t)0xE000E000U, 0, 0x1000U);
+  memset((void *)(uintptr_t)0xE0042000U, 0, 0x1000U);
+
+  *SIM_CPU_Scs(SIM_SCS_SYST_CALIB) = 0x40000000U | 10499U;
+  *SIM_CPU_Scs(SIM_SCS_SCB_CPUID)  = 0x410FC241U;
+  *SIM_CPU_Scs(SIM_SCS_SCB_AIRCR)  = 0xFA050000U;
+
+  /* The FLASH is aliased at 0x00000000 after reset: the table is read from the FLASH */
+  *SIM_CPU_Scs(SIM_SCS_SCB_VTOR)   = SIM_FLASH_BASE;
+  DBGMCU->IDCODE                   = 0x10006421U;
+
+  memset(NvicEnabled, 0, sizeof(NvicEnabled));
+  memset(NvicPending, 0, sizeof(NvicPending));
+  memset(NvicLine, 0, sizeof(NvicLine));
+  SysTickPending   = 0U;
+  SysTickCountFlag = 0U;
+  PriorityGroup    = 0U;
+  Primask          = 0U;
+  Basepri          = 0U;
+  Faultmask        = 0U;
+  Msp              = SIM_SRAM_BASE + SIM_SRAM_SIZE;
+  ActiveNumber     = 0U;
+
+  SysTickTimer.When = SIM_TIME_NEVER;
+  SysTickTimer.Fire = SIM_SYSTICK_Fire;
+
+  SIM_BUS_Register(&ScsDevice);
+  SIM_BUS_Register(&DwtDevice);
+  SIM_BUS_Register(&DbgmcuDevice);
+}
+
+/**
+  * @brief  Boot the device: the firmware starts in its thread at SystemInit(), as from Reset_Handler.
+  *         The calling thread watches the firmware: a firmware spinning without any memory access, as
+  *         Error_Handler(), does not move the time anymore and ends the boot.
+  * @param  Cause The reset cause.
+  * @retval None.
+  */
+void SIM_CPU_Start(SIM_ResetTypeDef Cause)
+{
+  static const struct
+  {
+    uint32_t Exception;
+    void (*Handler)(void);
+  } vectors[] =
+  {
+    { 2U,  NMI_Handler },        { 3U,  HardFault_Handler }, { 4U,  MemManage_Handler },
+    { 5U,  BusFault_Handler },   { 6U,  UsageFault_Handler },
+    { 11U, SVC_Handler },        { 12U, DebugMon_Handler },  { 14U, PendSV_Handler },
+    { 15U, SysTick_Handler },    { SIM_EXC_IRQ0 + FLASH_IRQn, FLASH_IRQHandler },
+    { SIM_EXC_IRQ0 + USART2_IRQn, USART2_IRQHandler },
+    { SIM_EXC_IRQ0 + TIM6_DAC_IRQn, TIM6_DAC_IRQHandler }
+  };
+  uint32_t table[SIM_EXC_IRQ0 + SIM_IRQ_NUMBER];
+  struct sigaction action;
+  pthread_attr_t attributes;
+  pthread_t thread;
+  SIM_TimeTypeDef seen;
+  uint32_t index;
+  int stuck = 0;
+
+  for (index = 0U; index < (sizeof(table) / sizeof(table[0])); index++)
+  {
+    table[index] = (uint32_t)(uintptr_t)SIM_CPU_DefaultHandler;
+  }
+
+  table[0] = SIM_SRAM_BASE + SIM_SRAM_SIZE;
+  table[1] = (uint32_t)(uintptr_t)SIM_CPU_DefaultHandler;
+
+  for (index = 0U; index < (sizeof(vectors) / sizeof(vectors[0])); index++)
+  {
+    if (vectors[index].Handler != NULL)
+    {
+      table[vectors[index].Exception] = (uint32_t)(uintptr_t)vectors[index].Handler;
+    }
+  }
+
+  SIM_FLASH_WriteVectors(table, sizeof(table) / sizeof(table[0]));
+
+  SIM_Now   = SIM_Epoch;
+  SIM_Next  = SIM_TIME_NEVER;
+  SIM_Stall = 0;
+  SIM_CPU_UpdateClock();
+
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = SIM_CPU_Fault;
+  action.sa_flags     = SA_SIGINFO;
+  sigaction(SIGSEGV, &action, NULL);
+  sigaction(SIGBUS, &action, NULL);
+
+  pthread_attr_init(&attributes);
+  pthread_attr_setstack(&attributes, (void *)(uintptr_t)SIM_STACK_BASE, SIM_STACK_SIZE);
+
+  if (pthread_create(&thread, &attributes, SIM_CPU_Thread, NULL) != 0)
+  {
+    SIM_Fatal("cannot start the firmware thread");
+  }
+
+  SIM_Log("boot %llu, reset cause %u", (unsigned long long)SIM_Clock->Boots, (unsigned int)Cause);
+
+  /* Watchdog of the simulation */
+  for (;;)
+  {
+    seen = SIM_Now;
+    usleep(250000U);
+
+    if ((SIM_Now != seen) || (SIM_Waiting != 0))
+    {
+      stuck = 0;
+    }
+    else if (++stuck == 4)
+    {
+      if (SIM_IWDG_IsRunning())
+      {
+        SIM_Log("firmware stuck, reset by the independent watchdog");
+        SIM_Now = SIM_IWDG_GetExpiry();
+        SIM_Reset(SIM_RESET_WATCHDOG);
+      }
+
+      SIM_Fatal("firmware stuck without the independent watchdog running");
+    }
+  }
+}
+
+/**
+  * @brief  Take the pending exceptions which can preempt the running code, then the tail-chained ones.
+  *         While the FLASH is busy only the exceptions with their vector and their handler in RAM are taken:
+  *         the other ones stay pending until the end of the FLASH operation.
+  * @retval None.
+  */
+void SIM_CPU_Dispatch(void)
+{
+  uint32_t exception;
+  uint32_t priority;
+  uintptr_t handler;
+  uintptr_t table;
+
+  SIM_IrqCheck = 0;
+
+  for (;;)
+  {
+    exception = SIM_CPU_GetPendingException(&priority);
+
+    if ((exception == 0U) || (priority >= SIM_CPU_ExecutionPriority()))
+    {
+      break;
+    }
+
+    table   = SCB->VTOR;
+    handler = ((volatile uint32_t *)table)[exception];
+
+    if ((SIM_Stall != 0)
+        && ((((table - SIM_FLASH_BASE) < SIM_FLASH_SIZE)) || (SIM_CPU_IsRamCode((const void *)handler) == 0)))
+    {
+      /* Taken once the FLASH is idle again */
+      SIM_IrqCheck = 1;
+      break;
+    }
+
+    if ((handler == 0U) || (handler == 0xFFFFFFFFU))
+    {
+      SIM_Fatal("no handler for exception %u in the table at 0x%08x", (unsigned int)exception, (unsigned int)table);
+    }
+
+    SIM_CPU_Take(exception, priority, handler);
+  }
+}
+
+/**
+  * @brief  Called when an exception without handler is taken.
+  * @retval None.
+  */
+void SIM_CPU_DefaultHandler(void)
+{
+  SIM_Fatal("unexpected exception %u", (unsigned int)SIM_CPU_GetIpsr());
+}
+
+/**
+  * @brief  Recompute the clocks from the RCC registers, the time based models are rebased on the new clocks.
+  * @retval None.
+  */
+void SIM_CPU_UpdateClock(void)
+{
+  uint32_t hclk = SIM_RCC_GetHclk();
+  uint32_t systick;
+  uint32_t cycles;
+
+  if (hclk != Hclk)
+  {
+    systick = SIM_SYSTICK_GetValue();
+    cycles  = DwtCycles + SIM_CPU_Elapsed(DwtBase, Hclk);
+
+    Hclk = hclk;
+
+    if (SIM_SYSTICK_IsRunning())
+    {
+      SIM_SYSTICK_Rebase(systick);
+    }
+
+    DwtCycles = cycles;
+    DwtBase   = SIM_Now;
+  }
+
+  SIM_CostAccess = SIM_CYCLES(SIM_Config.CyclesAccess, Hclk);
+  SIM_CostCall   = SIM_CYCLES(SIM_Config.CyclesCall, Hclk);
+
+  SIM_TIM_UpdateClock();
+  SIM_USART_UpdateClock();
+}
+
+/**
+  * @brief  Check if code executes from RAM.
+  * @param  Pc Address in the code.
+  * @retval 1 if the address is in a __RAM_FUNC function.
+  */
+int SIM_CPU_IsRamCode(const void *Pc)
+{
+  return ((const uint8_t *)Pc >= __sim_ramfunc_start) && ((const uint8_t *)Pc < __sim_ramfunc_end);
+}
+
+/**
+  * @brief  Start or restart a timer of a model, it is registered on the first start.
+  * @param  Timer The timer.
+  * @param  When Time of the event.
+  * @retval None.
+  */
+void SIM_Timer_Start(SIM_TimerTypeDef *Timer, SIM_TimeTypeDef When)
+{
+  uint32_t index;
+
+  for (index = 0U; (index < TimersNumber) && (Timers[index] != Timer); index++)
+  {
+  }
+
+  if (index == TimersNumber)
+  {
+    if (TimersNumber == SIM_TIMERS_MAX)
+    {
+      SIM_Fatal("too many timers");
+    }
+
+    Timers[TimersNumber++] = Timer;
+  }
+
+  Timer->When = When;
+
+  if (When < SIM_Next)
+  {
+    SIM_Next = When;
+  }
+}
+
+/**
+  * @brief  Stop a timer.
+  * @param  Timer The timer.
+  * @retval None.
+  */
+void SIM_Timer_Stop(SIM_TimerTypeDef *Timer)
+{
+  Timer->When = SIM_TIME_NEVER;
+}
+
+/**
+  * @brief  Fire the timers which are due, in time order.
+  * @retval None.
+  */
+void SIM_RunTimers(void)
+{
+  SIM_TimerTypeDef *timer;
+  SIM_TimeTypeDef when;
+  uint32_t index;
+
+  for (;;)
+  {
+    timer    = NULL;
+    SIM_Next = SIM_TIME_NEVER;
+
+    for (index = 0U; index < TimersNumber; index++)
+    {
+      if (Timers[index]->When < SIM_Next)
+      {
+        SIM_Next = Timers[index]->When;
+        timer    = Timers[index];
+      }
+    }
+
+    if ((timer == NULL) || (timer->When > SIM_Now))
+    {
+      break;
+    }
+
+    when        = timer->When;
+    timer->When = SIM_TIME_NEVER;
+    timer->Fire(when);
+  }
+}
+
+/**
+  * @brief  Called when the firmware is idle: nothing can change before the next event of the models.
+  *         The device output is sent, the host input is polled and the time jumps to the next event.
+  * @retval None.
+  */
+void SIM_Idle(void)
+{
+  SIM_BUS_Flush();
+  SIM_IO_Flush();
+
+  if (SIM_USART_RxBusy() == 0)
+  {
+    /* Scripted input is released byte per byte while the firmware waits for it */
+    SIM_Waiting = 1;
+    SIM_IO_Poll(((SIM_Config.Input == NULL) && (SIM_Next > (SIM_Now + SIM_US(100)))) ? 1 : 0);
+    SIM_Waiting = 0;
+    SIM_USART_RxKick();
+  }
+
+  if ((SIM_Config.Input != NULL) && SIM_IO_Exhausted() && (SIM_USART_RxBusy() == 0)
+      && (SIM_USART_TxIdle() != 0) && (SIM_FLASH_IsBusy() == 0))
+  {
+    SIM_Log("end of the input at %.6f s", (double)SIM_Now / (double)SIM_PS_PER_S);
+    SIM_Exit(SIM_EXIT_END);
+  }
+
+  if ((SIM_Config.MaxTime != 0U) && (SIM_Now >= SIM_Config.MaxTime))
+  {
+    SIM_Log("time limit reached");
+    SIM_Exit(SIM_EXIT_END);
+  }
+
+  if (SIM_Next == SIM_TIME_NEVER)
+  {
+    /* Nothing will ever happen without the host */
+    if (SIM_Config.Input != NULL)
+    {
+      SIM_Fatal("firmware waiting without any event pending");
+    }
+
+    SIM_Waiting = 1;
+
+    while (SIM_IO_Poll(100) == 0)
+    {
+    }
+
+    SIM_Waiting = 0;
+    SIM_USART_RxKick();
+  }
+
+  if (SIM_Next > SIM_Now)
+  {
+    SIM_Now = SIM_Next;
+  }
+
+  SIM_RunTimers();
+  SIM_Clock->Now = SIM_Now / 1000U;
+}
+
+/**
+  * @brief  Called by the models on a read of a register which the firmware may poll.
+  *         Reads of a few registers returning the same values again and again in a short loop make an
+  *         idle point: the loop waits for an event, as the reception of a byte.
+  * @param  Address Address of the register.
+  * @param  Value Value of the register.
+  * @retval None.
+  */
+void SIM_IdlePoll(uint32_t Address, uint32_t Value)
+{
+  uint32_t index;
+
+  for (index = 0U; (index < SIM_POLL_REGISTERS) && (PollAddress[index] != Address); index++)
+  {
+  }
+
+  if ((index < SIM_POLL_REGISTERS) && (PollValue[index] == Value) && ((SIM_Steps - PollStep) < SIM_POLL_GAP))
+  {
+    if (++PollRepeat >= SIM_POLL_REPEAT)
+    {
+      PollRepeat = 0U;
+      SIM_Idle();
+    }
+  }
+  else
+  {
+    if (index == SIM_POLL_REGISTERS)
+    {
+      index    = PollNext;
+      PollNext = (PollNext + 1U) % SIM_POLL_REGISTERS;
+    }
+
+    PollAddress[index] = Address;
+    PollValue[index]   = Value;
+    PollRepeat         = 0U;
+  }
+
+  PollStep = SIM_Steps;
+}
+
+/**
+  * @brief  Declare the level of a peripheral interrupt line, it is sampled by SIM_NVIC_Update().
+  * @param  Irq The interrupt number.
+  * @param  Level Function returning the level of the line.
+  * @retval None.
+  */
+void SIM_NVIC_SetLine(uint32_t Irq, int (*Level)(void))
+{
+  NvicLine[Irq] = Level;
+}
+
+/**
+  * @brief  Sample an interrupt line after a change of the model state, an asserted line pends the interrupt.
+  * @param  Irq The interrupt number.
+  * @retval None.
+  */
+void SIM_NVIC_Update(uint32_t Irq)
+{
+  if ((NvicLine[Irq] != NULL) && (NvicLine[Irq]() != 0))
+  {
+    NvicPending[Irq / 32U] |= (1UL << (Irq & 31U));
+    SIM_IrqCheck = 1;
+  }
+}
+
+/* Core intrinsics, see sim_cmsis.h --------------------------------------------*/
+
+void SIM_CPU_SetPrimask(uint32_t PriMask)
+{
+  SIM_BUS_Flush();
+  Primask      = PriMask & 1U;
+  SIM_IrqCheck = 1;
+}
+
+uint32_t SIM_CPU_GetPrimask(void)
+{
+  return Primask;
+}
+
+void SIM_CPU_SetBasepri(uint32_t BasePri)
+{
+  SIM_BUS_Flush();
+  Basepri      = BasePri & 0xF0U;
+  SIM_IrqCheck = 1;
+}
+
+uint32_t SIM_CPU_GetBasepri(void)
+{
+  return Basepri;
+}
+
+void SIM_CPU_SetFaultmask(uint32_t FaultMask)
+{
+  SIM_BUS_Flush();
+  Faultmask    = FaultMask & 1U;
+  SIM_IrqCheck = 1;
+}
+
+uint32_t SIM_CPU_GetFaultmask(void)
+{
+  return Faultmask;
+}
+
+uint32_t SIM_CPU_GetIpsr(void)
+{
+  return (ActiveNumber != 0U) ? Active[ActiveNumber - 1U].Exception : 0U;
+}
+
+void SIM_CPU_SetMsp(uint32_t TopOfMainStack)
+{
+  /* The host stack is kept, the value is reported at the start of an application */
+  Msp = TopOfMainStack;
+}
+
+uint32_t SIM_CPU_GetMsp(void)
+{
+  return Msp;
+}
+
+void SIM_CPU_Barrier(void)
+{
+  SIM_BUS_Tick(__builtin_return_address(0));
+}
+
+void SIM_CPU_WaitForInterrupt(void)
+{
+  SIM_BUS_Tick(__builtin_return_address(0));
+
+  if (SIM_IrqCheck == 0)
+  {
+    SIM_Idle();
+  }
+}
+
+void SIM_CPU_Breakpoint(uint32_t Value)
+{
+  SIM_Fatal("breakpoint %u", (unsigned int)Value);
+}
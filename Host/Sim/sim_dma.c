@@ -0,0 +1,209 @@
+/**
+  ******************************************************************************
+  * @file    sim_dma.c
+  * @brief   DMA1 of the simulated device, the streams 5 and 6 serving the
+  *          USART2 reception and transmission on channel 4.
+  *
+  *          A request of the USART is served at once: the byte moves between
+  *          the data register and the memory in the same step. The memory
+  *          address is used as a host address, the firmware buffers are
+  *          mapped below 4 GB.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "sim.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define SIM_DMA_STREAM_RX             5U
+#define SIM_DMA_STREAM_TX             6U
+#define SIM_DMA_CHANNEL               4U
+#define SIM_DMA_OFFSET_HISR           0x04U
+#define SIM_DMA_OFFSET_HIFCR          0x0CU
+#define SIM_DMA_OFFSET_STREAM(x)      (0x10U + (0x18U * (x)))
+
+/* Flags of the streams 4 to 7 in HISR, bits of the first flag of each stream */
+#define SIM_DMA_FLAGS_SHIFT(x)        ((((x) - 4U) & 1U) * 6U + (((x) - 4U) >> 1) * 16U)
+#define SIM_DMA_FLAG_TE               (1UL << 3)
+#define SIM_DMA_FLAG_HT               (1UL << 4)
+#define SIM_DMA_FLAG_TC               (1UL << 5)
+
+/* Private types -------------------------------------------------------------*/
+typedef struct
+{
+  uint32_t Stream;
+  uint32_t Length;                  /* NDTR latched when the stream is enabled, reloaded in circular mode */
+  uint32_t Index;                   /* Memory offset of the next transfer */
+} SIM_DmaStreamTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static SIM_DmaStreamTypeDef Streams[2] =
+{
+  { SIM_DMA_STREAM_RX, 0U, 0U },
+  { SIM_DMA_STREAM_TX, 0U, 0U }
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+static DMA_Stream_TypeDef *SIM_DMA_GetStream(uint32_t Stream)
+{
+  return (DMA_Stream_TypeDef *)(uintptr_t)(DMA1_BASE + SIM_DMA_OFFSET_STREAM(Stream));
+}
+
+static void SIM_DMA_SetFlags(uint32_t Stream, uint32_t Flags)
+{
+  DMA1->HISR |= Flags << SIM_DMA_FLAGS_SHIFT(Stream);
+}
+
+/* Check the configuration of a stream being enabled, only the USART2 requests are connected */
+static int SIM_DMA_CheckConfig(uint32_t Stream)
+{
+  DMA_Stream_TypeDef *stream = SIM_DMA_GetStream(Stream);
+  uint32_t direction = (Stream == SIM_DMA_STREAM_RX) ? 0U : DMA_SxCR_DIR_0;
+
+  return ((((stream->CR & DMA_SxCR_CHSEL) >> DMA_SxCR_CHSEL_Pos) == SIM_DMA_CHANNEL)
+          && ((stream->CR & DMA_SxCR_DIR) == direction)
+          && ((stream->CR & (DMA_SxCR_PSIZE | DMA_SxCR_MSIZE)) == 0U)
+          && (stream->PAR == (USART2_BASE + 0x04U))
+          && (stream->NDTR != 0U));
+}
+
+static void SIM_DMA_Complete(SIM_DmaStreamTypeDef *Dma, DMA_Stream_TypeDef *Stream)
+{
+  Stream->NDTR--;
+  Dma->Index++;
+
+  if (Stream->NDTR == (Dma->Length / 2U))
+  {
+    SIM_DMA_SetFlags(Dma->Stream, SIM_DMA_FLAG_HT);
+  }
+
+  if (Stream->NDTR == 0U)
+  {
+    SIM_DMA_SetFlags(Dma->Stream, SIM_DMA_FLAG_TC);
+
+    if ((Stream->CR & DMA_SxCR_CIRC) != 0U)
+    {
+      Stream->NDTR = Dma->Length;
+      Dma->Index   = 0U;
+    }
+    else
+    {
+      Stream->CR &= ~DMA_SxCR_EN;
+    }
+  }
+}
+
+static void SIM_DMA_Read(uint32_t Offset)
+{
+  uint32_t stream;
+
+  for (stream = SIM_DMA_STREAM_RX; stream <= SIM_DMA_STREAM_TX; stream++)
+  {
+    if ((Offset == SIM_DMA_OFFSET_STREAM(stream)) || (Offset == (SIM_DMA_OFFSET_STREAM(stream) + 0x04U)))
+    {
+      /* The firmware polls the enable bit and the number of data to transfer */
+      SIM_IdlePoll(DMA1_BASE + Offset, *(volatile uint32_t *)(uintptr_t)(DMA1_BASE + Offset));
+    }
+  }
+}
+
+static void SIM_DMA_Write(uint32_t Offset, uint32_t Old)
+{
+  volatile uint32_t *reg = (volatile uint32_t *)(uintptr_t)(DMA1_BASE + Offset);
+  SIM_DmaStreamTypeDef *dma;
+  DMA_Stream_TypeDef *stream;
+  uint32_t index;
+
+  if (Offset == SIM_DMA_OFFSET_HIFCR)
+  {
+    DMA1->HISR &= ~*reg;
+    *reg        = 0U;
+  }
+  else if ((Offset == 0x08U) || (Offset == 0x00U) || (Offset == SIM_DMA_OFFSET_HISR))
+  {
+    /* LIFCR reads as 0, the status registers are read only */
+    *reg = (Offset == 0x08U) ? 0U : Old;
+  }
+  else
+  {
+    for (index = 0U; index < 2U; index++)
+    {
+      dma    = &Streams[index];
+      stream = SIM_DMA_GetStream(dma->Stream);
+
+      if (Offset == SIM_DMA_OFFSET_STREAM(dma->Stream))
+      {
+        if (((Old & DMA_SxCR_EN) == 0U) && ((stream->CR & DMA_SxCR_EN) != 0U))
+        {
+          if (SIM_DMA_CheckConfig(dma->Stream))
+          {
+            dma->Length = stream->NDTR;
+            dma->Index  = 0U;
+            SIM_DMA_Request();
+          }
+          else
+          {
+            SIM_Fatal("DMA1 stream %u enabled with an unsupported configuration", (unsigned int)dma->Stream);
+          }
+        }
+      }
+      else if (((Offset - SIM_DMA_OFFSET_STREAM(dma->Stream)) < 0x10U) && ((stream->CR & DMA_SxCR_EN) != 0U))
+      {
+        /* NDTR, PAR and M0AR are write protected while the stream is enabled */
+        *reg = Old;
+      }
+      else
+      {
+        /* Plain register */
+      }
+    }
+  }
+}
+
+static const SIM_DeviceTypeDef DmaDevice =
+{
+  DMA1_BASE, 0x400U, SIM_DMA_Read, SIM_DMA_Write
+};
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Reset the DMA controller.
+  * @retval None.
+  */
+void SIM_DMA_Reset(void)
+{
+  memset((void *)(uintptr_t)DMA1_BASE, 0, 0x400U);
+  Streams[0].Length = 0U;
+  Streams[0].Index  = 0U;
+  Streams[1].Length = 0U;
+  Streams[1].Index  = 0U;
+
+  SIM_BUS_Register(&DmaDevice);
+}
+
+/**
+  * @brief  Serve the pending requests of the USART on the enabled streams.
+  * @retval None.
+  */
+void SIM_DMA_Request(void)
+{
+  DMA_Stream_TypeDef *rx = SIM_DMA_GetStream(SIM_DMA_STREAM_RX);
+  DMA_Stream_TypeDef *tx = SIM_DMA_GetStream(SIM_DMA_STREAM_TX);
+  uint8_t data;
+
+  if (((rx->CR & DMA_SxCR_EN) != 0U) && SIM_USART_DmaRequestRx())
+  {
+    *(volatile uint8_t *)(uintptr_t)(rx->M0AR + Streams[0].Index) = (uint8_t)SIM_USART_ReadData();
+    SIM_DMA_Complete(&Streams[0], rx);
+  }
+
+  /* The write may request the next byte at once, the transfer is accounted before */
+  if (((tx->CR & DMA_SxCR_EN) != 0U) && SIM_USART_DmaRequestTx())
+  {
+    data = *(volatile uint8_t *)(uintptr_t)(tx->M0AR + Streams[1].Index);
+    SIM_DMA_Complete(&Streams[1], tx);
+    SIM_USART_WriteData(data);
+  }
+}
@@ -0,0 +1,587 @@
+/**
+  ******************************************************************************
+  * @file    sim_flash.c
+  * @brief   FLASH of the simulated device: the 512 KB single bank in 8 sectors,
+  *          the OTP area, the option bytes and the FLASH interface registers.
+  *
+  *          The FLASH, the system memory holding the OTP area and the option
+  *          bytes are kept in the state file, mapped at their addresses. The
+  *          erase and program operations take the typical times of the
+  *          STM32F446 datasheet; while the FLASH is busy, code running from the
+  *          FLASH is stalled (see sim_bus.c).
+  ******************************************************************************
+  */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sim.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define SIM_FLASH_SECTORS             8U
+#define SIM_FLASH_STATE_SIZE          (SIM_FLASH_SIZE + SIM_SYSMEM_SIZE)
+
+#define SIM_FLASH_KEY1                0x45670123U
+#define SIM_FLASH_KEY2                0xCDEF89ABU
+#define SIM_FLASH_OPT_KEY1            0x08192A3BU
+#define SIM_FLASH_OPT_KEY2            0x4C5D6E7FU
+
+#define SIM_FLASH_OTP_LOCK_BASE       0x1FFF7A00U
+#define SIM_FLASH_OPTCR_RESET         0x0FFFAAEDU
+
+#define SIM_FLASH_SR_ERRORS           (FLASH_SR_SOP | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | \
+                                       FLASH_SR_PGSERR | FLASH_SR_RDERR)
+
+/* Typical times of the STM32F446 datasheet */
+#define SIM_FLASH_TIME_PROGRAM        SIM_US(16)
+#define SIM_FLASH_TIME_ERASE_16K      SIM_MS(250)
+#define SIM_FLASH_TIME_ERASE_64K      SIM_MS(550)
+#define SIM_FLASH_TIME_ERASE_128K     SIM_MS(1000)
+#define SIM_FLASH_TIME_MASS_ERASE     SIM_MS(8000)
+#define SIM_FLASH_TIME_OPTION         SIM_MS(20)
+
+#define SIM_FLASH_REG(Offset)         (*(volatile uint32_t *)(uintptr_t)(FLASH_R_BASE + (Offset)))
+#define SIM_FLASH_OFFSET_KEYR         0x04U
+#define SIM_FLASH_OFFSET_OPTKEYR      0x08U
+#define SIM_FLASH_OFFSET_SR           0x0CU
+#define SIM_FLASH_OFFSET_CR           0x10U
+#define SIM_FLASH_OFFSET_OPTCR        0x14U
+
+/* Private types -------------------------------------------------------------*/
+typedef enum
+{
+  SIM_FLASH_IDLE    = 0U,
+  SIM_FLASH_PROGRAM = 1U,
+  SIM_FLASH_ERASE   = 2U,
+  SIM_FLASH_MASS    = 3U,
+  SIM_FLASH_OPTION  = 4U
+} SIM_FlashOperationTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static const uint32_t SectorSize[SIM_FLASH_SECTORS] =
+{
+  0x4000U, 0x4000U, 0x4000U, 0x4000U, 0x10000U, 0x20000U, 0x20000U, 0x20000U
+};
+
+static SIM_TimerTypeDef FlashTimer;
+static SIM_FlashOperationTypeDef Operation = SIM_FLASH_IDLE;
+static SIM_TimeTypeDef OperationStart = 0U;
+static uint32_t OperationSector = 0U;
+static uint32_t KeyStep = 0U;
+static uint32_t OptKeyStep = 0U;
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint8_t *SIM_FLASH_OptionBytes(void)
+{
+  return (uint8_t *)(uintptr_t)SIM_OB_BASE;
+}
+
+static uint32_t SIM_FLASH_SectorAddress(uint32_t Sector)
+{
+  uint32_t address = SIM_FLASH_BASE;
+  uint32_t index;
+
+  for (index = 0U; index < Sector; index++)
+  {
+    address += SectorSize[index];
+  }
+
+  return address;
+}
+
+static int SIM_FLASH_GetSector(uint32_t Address, uint32_t *pSector)
+{
+  uint32_t sector;
+
+  for (sector = 0U; sector < SIM_FLASH_SECTORS; sector++)
+  {
+    if ((Address - SIM_FLASH_SectorAddress(sector)) < SectorSize[sector])
+    {
+      *pSector = sector;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static int SIM_FLASH_IsWriteProtected(uint32_t Sector)
+{
+  /* nWRP bits of the active option bytes, 0 protects the sector */
+  return ((SIM_FLASH_OptionBytes()[8] >> Sector) & 1U) == 0U;
+}
+
+static int SIM_FLASH_Level(void)
+{
+  uint32_t cr = SIM_FLASH_REG(SIM_FLASH_OFFSET_CR);
+  uint32_t sr = SIM_FLASH_REG(SIM_FLASH_OFFSET_SR);
+
+  return (((cr & FLASH_CR_EOPIE) != 0U) && ((sr & FLASH_SR_EOP) != 0U))
+         || (((cr & FLASH_CR_ERRIE) != 0U) && ((sr & FLASH_SR_SOP) != 0U));
+}
+
+/* Report the errors of an operation, OPERR is set with the error interrupt enabled */
+static void SIM_FLASH_SetError(uint32_t Errors)
+{
+  if ((SIM_FLASH_REG(SIM_FLASH_OFFSET_CR) & FLASH_CR_ERRIE) != 0U)
+  {
+    Errors |= FLASH_SR_SOP;
+  }
+
+  SIM_FLASH_REG(SIM_FLASH_OFFSET_SR) |= Errors;
+  SIM_NVIC_Update(FLASH_IRQn);
+}
+
+static void SIM_FLASH_Start(SIM_FlashOperationTypeDef Kind, SIM_TimeTypeDef Duration)
+{
+  Operation      = Kind;
+  OperationStart = SIM_Now;
+  SIM_FLASH_REG(SIM_FLASH_OFFSET_SR) |= FLASH_SR_BSY;
+
+  /* Option bytes programming does not stall the FLASH reads */
+  SIM_Stall = (Kind != SIM_FLASH_OPTION) ? 1 : 0;
+
+  SIM_Timer_Start(&FlashTimer, SIM_Now + Duration);
+}
+
+static void SIM_FLASH_LoadOptions(void)
+{
+  const uint8_t *ob = SIM_FLASH_OptionBytes();
+
+  SIM_FLASH_REG(SIM_FLASH_OFFSET_OPTCR) = ((uint32_t)ob[0] & 0xFCU) | ((uint32_t)ob[1] << 8)
+                                          | ((uint32_t)ob[8] << 16) | (((uint32_t)ob[9] & 0x8FU) << 24)
+                                          | FLASH_OPTCR_OPTLOCK;
+}
+
+static void SIM_FLASH_StoreOptions(uint32_t Optcr)
+{
+  uint8_t *ob = SIM_FLASH_OptionBytes();
+
+  ob[0]  = (uint8_t)((Optcr & 0xFCU) | 0x03U);
+  ob[1]  = (uint8_t)(Optcr >> 8);
+  ob[8]  = (uint8_t)(Optcr >> 16);
+  ob[9]  = (uint8_t)(((Optcr >> 24) & 0x8FU) | 0x30U);
+  ob[2]  = (uint8_t)~ob[0];
+  ob[3]  = (uint8_t)~ob[1];
+  ob[10] = (uint8_t)~ob[8];
+  ob[11] = (uint8_t)~ob[9];
+  memcpy(&ob[4], &ob[0], 4U);
+  memcpy(&ob[12], &ob[8], 4U);
+
+  msync((void *)(uintptr_t)SIM_SYSMEM_BASE, SIM_SYSMEM_SIZE, MS_ASYNC);
+}
+
+static void SIM_FLASH_Fire(SIM_TimeTypeDef When)
+{
+  SIM_FlashOperationTypeDef kind = Operation;
+  uint32_t sector;
+
+  if (kind == SIM_FLASH_ERASE)
+  {
+    memset((void *)(uintptr_t)SIM_FLASH_SectorAddress(OperationSector), 0xFF, SectorSize[OperationSector]);
+    SIM_Clock->FlashErasedSectors++;
+  }
+  else if (kind == SIM_FLASH_MASS)
+  {
+    for (sector = 0U; sector < SIM_FLASH_SECTORS; sector++)
+    {
+      memset((void *)(uintptr_t)SIM_FLASH_SectorAddress(sector), 0xFF, SectorSize[sector]);
+    }
+
+    SIM_Clock->FlashErasedSectors += SIM_FLASH_SECTORS;
+  }
+  else if (kind == SIM_FLASH_OPTION)
+  {
+    SIM_FLASH_StoreOptions(SIM_FLASH_REG(SIM_FLASH_OFFSET_OPTCR) & ~FLASH_OPTCR_OPTSTRT);
+    SIM_FLASH_REG(SIM_FLASH_OFFSET_OPTCR) &= ~FLASH_OPTCR_OPTSTRT;
+  }
+  else
+  {
+    /* Programming, the data is already in place */
+  }
+
+  SIM_Clock->FlashBusyTime += (When - OperationStart) / 1000U;
+
+  Operation = SIM_FLASH_IDLE;
+  SIM_Stall = 0;
+  SIM_FLASH_REG(SIM_FLASH_OFFSET_SR) &= ~FLASH_SR_BSY;
+  SIM_FLASH_REG(SIM_FLASH_OFFSET_CR) &= ~FLASH_CR_STRT;
+
+  /* End of operation is only flagged with its interrupt enabled */
+  if ((SIM_FLASH_REG(SIM_FLASH_OFFSET_CR) & FLASH_CR_EOPIE) != 0U)
+  {
+    SIM_FLASH_REG(SIM_FLASH_OFFSET_SR) |= FLASH_SR_EOP;
+  }
+
+  SIM_NVIC_Update(FLASH_IRQn);
+
+  /* Interrupts held by the stall can be taken now */
+  SIM_IrqCheck = 1;
+}
+
+static void SIM_FLASH_StartErase(uint32_t Cr)
+{
+  uint32_t sector;
+
+  if ((Cr & FLASH_CR_MER) != 0U)
+  {
+    for (sector = 0U; sector < SIM_FLASH_SECTORS; sector++)
+    {
+      if (SIM_FLASH_IsWriteProtected(sector))
+      {
+        SIM_FLASH_SetError(FLASH_SR_WRPERR);
+        return;
+      }
+    }
+
+    SIM_FLASH_Start(SIM_FLASH_MASS, SIM_FLASH_TIME_MASS_ERASE);
+  }
+  else if ((Cr & FLASH_CR_SER) != 0U)
+  {
+    sector = (Cr & FLASH_CR_SNB) >> FLASH_CR_SNB_Pos;
+
+    if (sector >= SIM_FLASH_SECTORS)
+    {
+      SIM_FLASH_SetError(FLASH_SR_PGSERR);
+    }
+    else if (SIM_FLASH_IsWriteProtected(sector))
+    {
+      SIM_FLASH_SetError(FLASH_SR_WRPERR);
+    }
+    else
+    {
+      OperationSector = sector;
+      SIM_FLASH_Start(SIM_FLASH_ERASE, (SectorSize[sector] == 0x4000U) ? SIM_FLASH_TIME_ERASE_16K :
+                                       (SectorSize[sector] == 0x10000U) ? SIM_FLASH_TIME_ERASE_64K :
+                                       SIM_FLASH_TIME_ERASE_128K);
+    }
+  }
+  else
+  {
+    SIM_FLASH_SetError(FLASH_SR_PGSERR);
+  }
+}
+
+static void SIM_FLASH_Read(uint32_t Offset)
+{
+  if (Offset == SIM_FLASH_OFFSET_SR)
+  {
+    SIM_IdlePoll(FLASH_R_BASE + Offset, SIM_FLASH_REG(Offset));
+  }
+}
+
+static void SIM_FLASH_RegWrite(uint32_t Offset, uint32_t Old)
+{
+  volatile uint32_t *reg = &SIM_FLASH_REG(Offset);
+  uint32_t value = *reg;
+
+  switch (Offset)
+  {
+    case SIM_FLASH_OFFSET_KEYR:
+      if ((KeyStep == 0U) && (value == SIM_FLASH_KEY1))
+      {
+        KeyStep = 1U;
+      }
+      else if ((KeyStep == 1U) && (value == SIM_FLASH_KEY2))
+      {
+        SIM_FLASH_REG(SIM_FLASH_OFFSET_CR) &= ~FLASH_CR_LOCK;
+        KeyStep = 0U;
+      }
+      else
+      {
+        KeyStep = 0U;
+      }
+
+      *reg = 0U;
+      break;
+
+    case SIM_FLASH_OFFSET_OPTKEYR:
+      if ((OptKeyStep == 0U) && (value == SIM_FLASH_OPT_KEY1))
+      {
+        OptKeyStep = 1U;
+      }
+      else if ((OptKeyStep == 1U) && (value == SIM_FLASH_OPT_KEY2))
+      {
+        SIM_FLASH_REG(SIM_FLASH_OFFSET_OPTCR) &= ~FLASH_OPTCR_OPTLOCK;
+        OptKeyStep = 0U;
+      }
+      else
+      {
+        OptKeyStep = 0U;
+      }
+
+      *reg = 0U;
+      break;
+
+    case SIM_FLASH_OFFSET_SR:
+      /* Flags are cleared by writing 1, BSY is read only */
+      *reg = Old & ~(value & (FLASH_SR_EOP | SIM_FLASH_SR_ERRORS));
+      SIM_NVIC_Update(FLASH_IRQn);
+      break;
+
+    case SIM_FLASH_OFFSET_CR:
+      if ((Old & FLASH_CR_LOCK) != 0U)
+      {
+        *reg = Old;
+      }
+      else if (Operation != SIM_FLASH_IDLE)
+      {
+        /* The control register cannot be changed while busy, only LOCK can be set */
+        *reg = Old | (value & FLASH_CR_LOCK);
+      }
+      else
+      {
+        if (((value & FLASH_CR_STRT) != 0U) && ((Old & FLASH_CR_STRT) == 0U))
+        {
+          SIM_FLASH_StartErase(value);
+
+          if (Operation == SIM_FLASH_IDLE)
+          {
+            *reg = value & ~FLASH_CR_STRT;
+          }
+        }
+      }
+
+      SIM_NVIC_Update(FLASH_IRQn);
+      break;
+
+    case SIM_FLASH_OFFSET_OPTCR:
+      if ((Old & FLASH_OPTCR_OPTLOCK) != 0U)
+      {
+        *reg = Old;
+      }
+      else if (Operation != SIM_FLASH_IDLE)
+      {
+        *reg = Old;
+      }
+      else if (((value & FLASH_OPTCR_OPTSTRT) != 0U) && ((Old & FLASH_OPTCR_OPTSTRT) == 0U))
+      {
+        SIM_FLASH_Start(SIM_FLASH_OPTION, SIM_FLASH_TIME_OPTION);
+      }
+      else
+      {
+        /* New option values, loaded on OPTSTRT */
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+static const SIM_DeviceTypeDef FlashDevice =
+{
+  FLASH_R_BASE, 0x400U, SIM_FLASH_Read, SIM_FLASH_RegWrite
+};
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Map the FLASH and the system memory from the state file, a new file is the blank device.
+  * @param  Path Path of the state file.
+  * @retval None.
+  */
+void SIM_FLASH_Open(const char *Path)
+{
+  static const uint8_t optionBytes[SIM_OB_SIZE] =
+  {
+    0xEFU, 0xAAU, 0x10U, 0x55U, 0xEFU, 0xAAU, 0x10U, 0x55U,
+    0xFFU, 0x3FU, 0x00U, 0xC0U, 0xFFU, 0x3FU, 0x00U, 0xC0U
+  };
+  struct stat status;
+  void *map;
+  int created = 0;
+  int fd;
+
+  fd = open(Path, O_RDWR | O_CREAT, 0644);
+
+  if ((fd < 0) || (fstat(fd, &status) != 0))
+  {
+    SIM_Fatal("cannot open %s: %m", Path);
+  }
+
+  if (status.st_size != SIM_FLASH_STATE_SIZE)
+  {
+    if (ftruncate(fd, SIM_FLASH_STATE_SIZE) != 0)
+    {
+      SIM_Fatal("cannot size %s: %m", Path);
+    }
+
+    created = 1;
+  }
+
+  map = mmap((void *)(uintptr_t)SIM_FLASH_BASE, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+
+  if (map != (void *)(uintptr_t)SIM_FLASH_BASE)
+  {
+    SIM_Fatal("cannot map the FLASH: %m");
+  }
+
+  map = mmap((void *)(uintptr_t)SIM_SYSMEM_BASE, SIM_SYSMEM_SIZE, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED_NOREPLACE, fd, SIM_FLASH_SIZE);
+
+  if (map != (void *)(uintptr_t)SIM_SYSMEM_BASE)
+  {
+    SIM_Fatal("cannot map the system memory: %m");
+  }
+
+  close(fd);
+
+  if (created != 0)
+  {
+    memset((void *)(uintptr_t)SIM_FLASH_BASE, 0xFF, SIM_FLASH_SIZE);
+    memset((void *)(uintptr_t)SIM_SYSMEM_BASE, 0x00, SIM_SYSMEM_SIZE);
+    memset((void *)(uintptr_t)SIM_OTP_BASE, 0xFF, SIM_OTP_SIZE);
+    memcpy((void *)(uintptr_t)SIM_OB_BASE, optionBytes, sizeof(optionBytes));
+  }
+}
+
+/**
+  * @brief  Reset the FLASH interface, the option bytes are loaded in OPTCR.
+  * @retval None.
+  */
+void SIM_FLASH_Reset(void)
+{
+  memset((void *)(uintptr_t)FLASH_R_BASE, 0, 0x400U);
+  SIM_FLASH_REG(SIM_FLASH_OFFSET_CR) = FLASH_CR_LOCK;
+  SIM_FLASH_LoadOptions();
+
+  Operation  = SIM_FLASH_IDLE;
+  KeyStep    = 0U;
+  OptKeyStep = 0U;
+  SIM_Stall  = 0;
+
+  FlashTimer.When = SIM_TIME_NEVER;
+  FlashTimer.Fire = SIM_FLASH_Fire;
+
+  SIM_BUS_Register(&FlashDevice);
+  SIM_NVIC_SetLine(FLASH_IRQn, SIM_FLASH_Level);
+}
+
+/**
+  * @brief  Handle a store of the firmware to the FLASH or the system memory.
+  *         The store is done: the content is replaced by the programmed value, bits can only be cleared,
+  *         or restored when the programming is refused.
+  * @param  Address Address of the store.
+  * @param  Size Number of bytes stored in the word holding Address.
+  * @param  Old Value of the word before the store.
+  * @retval None.
+  */
+void SIM_FLASH_Write(uint32_t Address, uint32_t Size, uint32_t Old)
+{
+  volatile uint8_t *byte = (volatile uint8_t *)(uintptr_t)Address;
+  uint32_t cr = SIM_FLASH_REG(SIM_FLASH_OFFSET_CR);
+  uint32_t shift = (Address & 3U) * 8U;
+  uint32_t errors = 0U;
+  uint32_t sector = 0U;
+  uint32_t index;
+  uint8_t old;
+
+  if ((Address - SIM_FLASH_BASE) < SIM_FLASH_SIZE)
+  {
+    (void)SIM_FLASH_GetSector(Address, &sector);
+  }
+  else if (((Address - SIM_OTP_BASE) >= SIM_OTP_SIZE) || (((Address - SIM_OTP_BASE) < 0x200U)
+           && ((*(volatile uint8_t *)(uintptr_t)(SIM_FLASH_OTP_LOCK_BASE + ((Address - SIM_OTP_BASE) / 32U))) == 0x00U)))
+  {
+    /* Read only system memory, option bytes or locked OTP block */
+    errors = FLASH_SR_WRPERR;
+  }
+  else
+  {
+    /* OTP area */
+  }
+
+  if (errors != 0U)
+  {
+    /* Refused below */
+  }
+  else if (((cr & FLASH_CR_LOCK) != 0U) || ((cr & FLASH_CR_PG) == 0U) || (Operation != SIM_FLASH_IDLE))
+  {
+    errors = FLASH_SR_PGSERR;
+  }
+  else if (Size != (1UL << ((cr & FLASH_CR_PSIZE) >> FLASH_CR_PSIZE_Pos)))
+  {
+    errors = FLASH_SR_PGPERR;
+  }
+  else if ((Address & (Size - 1U)) != 0U)
+  {
+    errors = FLASH_SR_PGAERR;
+  }
+  else if (((Address - SIM_FLASH_BASE) < SIM_FLASH_SIZE) && SIM_FLASH_IsWriteProtected(sector))
+  {
+    errors = FLASH_SR_WRPERR;
+  }
+  else
+  {
+    /* Accepted */
+  }
+
+  for (index = 0U; index < Size; index++)
+  {
+    old = (uint8_t)(Old >> (shift + (index * 8U)));
+    byte[index] = (errors == 0U) ? (uint8_t)(old & byte[index]) : old;
+  }
+
+  if (errors != 0U)
+  {
+    SIM_FLASH_SetError(errors);
+  }
+  else
+  {
+    SIM_Clock->FlashPrograms++;
+    SIM_FLASH_Start(SIM_FLASH_PROGRAM, SIM_FLASH_TIME_PROGRAM);
+  }
+}
+
+/**
+  * @brief  Stall the core until the end of the FLASH operation.
+  *         The exceptions whose vector and handler are in RAM are still taken meanwhile.
+  * @retval None.
+  */
+void SIM_FLASH_WaitIdle(void)
+{
+  SIM_TimeTypeDef start = SIM_Now;
+
+  SIM_BUS_Flush();
+
+  while (SIM_Stall != 0)
+  {
+    SIM_CPU_Dispatch();
+
+    if ((SIM_Stall != 0) && (SIM_Next > SIM_Now))
+    {
+      SIM_Idle();
+    }
+    else
+    {
+      SIM_RunTimers();
+    }
+  }
+
+  SIM_Clock->StallTime += (SIM_Now - start) / 1000U;
+}
+
+/**
+  * @brief  Check if a FLASH operation is ongoing.
+  * @retval 1 if busy.
+  */
+int SIM_FLASH_IsBusy(void)
+{
+  return (Operation != SIM_FLASH_IDLE) ? 1 : 0;
+}
+
+/**
+  * @brief  Write the vector table of the firmware at the start of the FLASH, as the linker would.
+  * @param  pVectors The vector table.
+  * @param  Number The number of vectors.
+  * @retval None.
+  */
+void SIM_FLASH_WriteVectors(const uint32_t *pVectors, uint32_t Number)
+{
+  memcpy((void *)(uintptr_t)SIM_FLASH_BASE, pVectors, Number * sizeof(uint32_t));
+}
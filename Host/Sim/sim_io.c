@@ -0,0 +1,300 @@
+/**
+  ******************************************************************************
+  * @file    sim_io.c
+  * @brief   Host side of the serial line of the simulated device.
+  *
+  *          Interactive mode: the host tools open the slave side of a pseudo
+  *          terminal, the baudrate they set on it is the baudrate of their
+  *          bytes on the simulated line. The parity and the stop bits set on
+  *          the pseudo terminal are ignored, the host is 8E1 as the protocol.
+  *          Scripted mode: the host bytes are read from a file and released
+  *          one by one while the firmware waits, the device bytes are written
+  *          to a file.
+  ******************************************************************************
+  */
+
+#include <asm/ioctls.h>
+#include <asm/termbits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+/* The output delay masks of the terminal have the names of the device registers */
+#undef CR1
+#undef CR2
+#undef CR3
+
+#include "sim.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define SIM_IO_QUEUE_SIZE             65536U    /* A power of 2 */
+#define SIM_IO_OUTPUT_SIZE            4096U
+#define SIM_IO_TURNAROUND_MS          200       /* Wall time given to the host tools to answer the device */
+#define SIM_IO_BURST_MS               5         /* Wall time given to the host tools for the next byte of a request */
+
+/* Private variables ---------------------------------------------------------*/
+static int Master = -1;
+static int Slave = -1;
+static uint8_t Queue[SIM_IO_QUEUE_SIZE];          /* Bytes received from the host, not yet on the line */
+static uint32_t QueueHead = 0U;
+static uint32_t QueueTail = 0U;
+static uint8_t Output[SIM_IO_OUTPUT_SIZE];
+static uint32_t OutputLength = 0U;
+static int HostTurn = 0;                          /* The device has answered, the host is expected to go on */
+static int HostSending = 0;                       /* The host has sent bytes since the last answer of the device */
+
+static uint8_t *Script = NULL;
+static size_t ScriptLength = 0U;
+static FILE *ScriptOutput = NULL;
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint32_t SIM_IO_Queued(void)
+{
+  return QueueHead - QueueTail;
+}
+
+/* Baudrate set by the host on the pseudo terminal */
+static uint32_t SIM_IO_HostBaudRate(void)
+{
+  struct termios2 settings;
+  uint32_t baudrate = SIM_Config.BaudRate;
+
+  if ((ioctl(Slave, TCGETS2, &settings) == 0) && (settings.c_ospeed != 0U))
+  {
+    baudrate = settings.c_ospeed;
+  }
+
+  return baudrate;
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Set up the host side: the pseudo terminal, or the script files in scripted mode.
+  * @param  MasterFd Master side of the pseudo terminal, -1 in scripted mode.
+  * @param  SlaveFd Slave side kept open, the terminal settings of the host are read from it.
+  * @retval None.
+  */
+void SIM_IO_Open(int MasterFd, int SlaveFd)
+{
+  FILE *file;
+  long length;
+
+  Master = MasterFd;
+  Slave  = SlaveFd;
+
+  if (SIM_Config.Input != NULL)
+  {
+    file = fopen(SIM_Config.Input, "rb");
+
+    if ((file == NULL) || (fseek(file, 0, SEEK_END) != 0) || ((length = ftell(file)) < 0))
+    {
+      SIM_Fatal("cannot read %s: %m", SIM_Config.Input);
+    }
+
+    rewind(file);
+    Script       = malloc((size_t)length + 1U);
+    ScriptLength = fread(Script, 1U, (size_t)length, file);
+    fclose(file);
+
+    /* The script goes on after a reset of the device */
+    if (SIM_Persist()->ScriptIndex > ScriptLength)
+    {
+      SIM_Persist()->ScriptIndex = ScriptLength;
+    }
+
+    if (SIM_Config.Output != NULL)
+    {
+      ScriptOutput = fopen(SIM_Config.Output, "ab");
+
+      if (ScriptOutput == NULL)
+      {
+        SIM_Fatal("cannot write %s: %m", SIM_Config.Output);
+      }
+    }
+  }
+}
+
+/**
+  * @brief  Get the bytes sent by the host.
+  *         In scripted mode one byte is released when none is waiting.
+  * @param  WaitMs Time to wait for a byte in ms, 0 to return at once.
+  * @retval 1 if a byte is waiting.
+  */
+int SIM_IO_Poll(int WaitMs)
+{
+  struct pollfd descriptor;
+  uint8_t buffer[4096];
+  uint32_t room;
+  ssize_t length;
+  ssize_t index;
+
+  if (Script != NULL)
+  {
+    if ((SIM_IO_Queued() == 0U) && (SIM_Persist()->ScriptIndex < ScriptLength))
+    {
+      Queue[QueueHead++ & (SIM_IO_QUEUE_SIZE - 1U)] = Script[SIM_Persist()->ScriptIndex++];
+    }
+  }
+  else if (Master >= 0)
+  {
+    room = SIM_IO_QUEUE_SIZE - SIM_IO_Queued();
+
+    /* The simulated time does not run while the host tool reacts to an answer: its reply starts
+       on the line as soon as the answer has been sent, the timings do not depend on the host load */
+    if ((HostTurn != 0) && (SIM_USART_TxIdle() != 0))
+    {
+      HostTurn = 0;
+      WaitMs   = SIM_IO_TURNAROUND_MS;
+    }
+
+    descriptor.fd      = Master;
+    descriptor.events  = POLLIN;
+    descriptor.revents = 0;
+
+    if ((room != 0U) && (poll(&descriptor, 1U, (SIM_IO_Queued() == 0U) ? WaitMs : 0) > 0)
+        && ((descriptor.revents & POLLIN) != 0))
+    {
+      length = read(Master, buffer, (room < sizeof(buffer)) ? room : sizeof(buffer));
+      HostSending = (length > 0) ? 1 : HostSending;
+
+      for (index = 0; index < length; index++)
+      {
+        Queue[QueueHead++ & (SIM_IO_QUEUE_SIZE - 1U)] = buffer[index];
+      }
+    }
+  }
+  else
+  {
+    /* No host */
+  }
+
+  return (SIM_IO_Queued() != 0U) ? 1 : 0;
+}
+
+/**
+  * @brief  Called at the end of each host byte on the line.
+  *         A host tool writes a request at once, its bytes follow each other on the line even when the
+  *         host load delays them on the pseudo terminal: the time does not run until the next one. A host
+  *         which does not go on within SIM_IO_BURST_MS has sent its request, the time runs again.
+  * @retval None.
+  */
+void SIM_IO_WaitHost(void)
+{
+  if ((Master >= 0) && (HostSending != 0) && (SIM_IO_Queued() == 0U) && (SIM_IO_Poll(SIM_IO_BURST_MS) == 0))
+  {
+    HostSending = 0;
+  }
+}
+
+/**
+  * @brief  Take the next byte of the host to put it on the line.
+  * @param  pByte The byte.
+  * @param  pBaudRate Baudrate of the host for this byte.
+  * @retval 1 if a byte has been taken.
+  */
+int SIM_IO_Take(uint8_t *pByte, uint32_t *pBaudRate)
+{
+  uint32_t baudrate;
+
+  if (SIM_IO_Queued() == 0U)
+  {
+    return 0;
+  }
+
+  *pByte = Queue[QueueTail++ & (SIM_IO_QUEUE_SIZE - 1U)];
+
+  if (Script != NULL)
+  {
+    /* The scripted host follows the device once it has synchronised */
+    baudrate   = SIM_USART_GetListeningBaudRate();
+    *pBaudRate = (baudrate != 0U) ? baudrate : SIM_Config.BaudRate;
+  }
+  else
+  {
+    *pBaudRate = SIM_IO_HostBaudRate();
+  }
+
+  return 1;
+}
+
+/**
+  * @brief  Hand a byte sent by the device to the host, it is buffered until SIM_IO_Flush().
+  * @param  Byte The byte.
+  * @retval None.
+  */
+void SIM_IO_Send(uint8_t Byte)
+{
+  if (OutputLength == SIM_IO_OUTPUT_SIZE)
+  {
+    SIM_IO_Flush();
+  }
+
+  Output[OutputLength++] = Byte;
+}
+
+/**
+  * @brief  Write the buffered device bytes.
+  * @retval None.
+  */
+void SIM_IO_Flush(void)
+{
+  struct pollfd descriptor;
+  uint32_t done = 0U;
+  ssize_t length;
+
+  if (ScriptOutput != NULL)
+  {
+    (void)fwrite(Output, 1U, OutputLength, ScriptOutput);
+    (void)fflush(ScriptOutput);
+  }
+  else if (Master >= 0)
+  {
+    while (done < OutputLength)
+    {
+      length = write(Master, &Output[done], OutputLength - done);
+
+      if ((length < 0) && (errno == EAGAIN))
+      {
+        /* Nobody reads the line, the bytes are lost as on a disconnected serial line */
+        descriptor.fd      = Master;
+        descriptor.events  = POLLOUT;
+        descriptor.revents = 0;
+
+        if (poll(&descriptor, 1U, 100) <= 0)
+        {
+          break;
+        }
+      }
+      else if ((length < 0) && (errno != EINTR))
+      {
+        break;
+      }
+      else
+      {
+        done       += (length > 0) ? (uint32_t)length : 0U;
+        HostTurn    = 1;
+        HostSending = 0;
+      }
+    }
+  }
+  else
+  {
+    /* No host */
+  }
+
+  OutputLength = 0U;
+}
+
+/**
+  * @brief  Check if the scripted input has been sent completely.
+  * @retval 1 if the script is done.
+  */
+int SIM_IO_Exhausted(void)
+{
+  return (Script != NULL) && (SIM_Persist()->ScriptIndex == ScriptLength) && (SIM_IO_Queued() == 0U);
+}
@@ -0,0 +1,403 @@
+/**
+  ******************************************************************************
+  * @file    sim_main.c
+  * @brief   Supervisor of the host simulation of the OpenBootloader.
+  *
+  *          Each boot of the device runs in a new process forked from the
+  *          supervisor, so the firmware starts from its initial data as after
+  *          a reset. What survives a reset is kept by the supervisor: the
+  *          FLASH in the state file, the reset flags, the backup registers
+  *          and the serial line.
+  *
+  *          Usage: openbl_sim [options]
+  *            --state FILE      FLASH, OTP and option bytes (openbl_sim.state)
+  *            --link PATH       symbolic link to the pseudo terminal of the line
+  *            --input FILE      scripted mode: host bytes
+  *            --output FILE     scripted mode: device bytes
+  *            --baud RATE       baudrate of the scripted host before the sync (115200)
+  *            --clock FILE      file exporting the simulated time and counters
+  *            --exit-on-app     end when the application is started
+  *            --max-time S      end after this simulated time
+  *            -v                log the device events
+  *          SIGUSR1 resets the device as the reset pin.
+  ******************************************************************************
+  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+/* The output delay masks of the terminal have the names of the device registers */
+#undef CR1
+#undef CR2
+#undef CR3
+
+#include "sim.h"
+
+/* Exported variables --------------------------------------------------------*/
+SIM_ConfigTypeDef SIM_Config =
+{
+  "openbl_sim.state", NULL, NULL, NULL, NULL, 115200U, SIM_CYCLES_ACCESS, SIM_CYCLES_CALL, 0U, 0, 0
+};
+
+SIM_ClockTypeDef *SIM_Clock = NULL;
+
+/* Private variables ---------------------------------------------------------*/
+static SIM_PersistTypeDef *Persist = NULL;
+static volatile sig_atomic_t PinReset = 0;
+static pid_t Device = 0;
+
+/* Private functions ---------------------------------------------------------*/
+
+static void SIM_Usage(void)
+{
+  fprintf(stderr,
+          "usage: openbl_sim [--state FILE] [--link PATH] [--input FILE --output FILE] [--baud RATE]\n"
+          "                  [--clock FILE] [--exit-on-app] [--max-time SECONDS] [-v]\n");
+  exit(SIM_EXIT_ERROR);
+}
+
+static void *SIM_MapShared(const char *Path, size_t Size)
+{
+  void *map;
+  int fd = -1;
+
+  if (Path != NULL)
+  {
+    fd = open(Path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if ((fd < 0) || (ftruncate(fd, (off_t)Size) != 0))
+    {
+      SIM_Fatal("cannot create %s: %m", Path);
+    }
+  }
+
+  map = mmap(NULL, Size, PROT_READ | PROT_WRITE, (fd < 0) ? (MAP_SHARED | MAP_ANONYMOUS) : MAP_SHARED, fd, 0);
+
+  if (map == MAP_FAILED)
+  {
+    SIM_Fatal("cannot map the shared state: %m");
+  }
+
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+
+  return map;
+}
+
+/* Pseudo terminal of the line, raw as a serial port */
+static void SIM_OpenTerminal(int *pMaster, int *pSlave)
+{
+  struct termios settings;
+  const char *name;
+  int master;
+  int slave;
+
+  master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+  if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0) || ((name = ptsname(master)) == NULL))
+  {
+    SIM_Fatal("cannot open a pseudo terminal: %m");
+  }
+
+  slave = open(name, O_RDWR | O_NOCTTY);
+
+  if ((slave < 0) || (tcgetattr(slave, &settings) != 0))
+  {
+    SIM_Fatal("cannot open %s: %m", name);
+  }
+
+  cfmakeraw(&settings);
+  settings.c_cflag |= CLOCAL | CREAD | PARENB;
+  cfsetspeed(&settings, B115200);
+  (void)tcsetattr(slave, TCSANOW, &settings);
+
+  if (SIM_Config.Link != NULL)
+  {
+    (void)unlink(SIM_Config.Link);
+
+    if (symlink(name, SIM_Config.Link) != 0)
+    {
+      SIM_Fatal("cannot link %s: %m", SIM_Config.Link);
+    }
+  }
+
+  fprintf(stderr, "openbl_sim: serial line on %s\n", (SIM_Config.Link != NULL) ? SIM_Config.Link : name);
+
+  *pMaster = master;
+  *pSlave  = slave;
+}
+
+static void SIM_OnPinReset(int Signal)
+{
+  (void)Signal;
+  PinReset = 1;
+
+  if (Device > 0)
+  {
+    (void)kill(Device, SIGKILL);
+  }
+}
+
+/* One boot of the device, in the child process */
+static void SIM_Boot(SIM_ResetTypeDef Cause, int Master, int Slave)
+{
+  signal(SIGUSR1, SIG_DFL);
+
+  /* The device does not outlive the supervisor when the host tools kill it */
+  (void)prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+  if (getppid() == 1)
+  {
+    _exit(SIM_EXIT_ERROR);
+  }
+
+  SIM_BUS_MapRegions();
+  SIM_FLASH_Open(SIM_Config.State);
+  SIM_IO_Open(Master, Slave);
+
+  SIM_Epoch = SIM_Clock->Now * 1000U;
+  SIM_Now   = SIM_Epoch;
+  SIM_Clock->Boots++;
+
+  SIM_CORE_Reset(Cause);
+  SIM_RCC_Reset(Cause);
+  SIM_PWR_Reset();
+  SIM_RTC_Reset();
+  SIM_IWDG_Reset();
+  SIM_CRC_Reset();
+  SIM_GPIO_Reset();
+  SIM_FLASH_Reset();
+  SIM_DMA_Reset();
+  SIM_TIM_Reset(TIM2_BASE);
+  SIM_TIM_Reset(TIM6_BASE);
+  SIM_USART_Reset();
+
+  SIM_CPU_Start(Cause);
+}
+
+/* The application cannot run on the host: the line is drained until a reset of the device */
+static void SIM_RunApplication(int Master)
+{
+  uint8_t buffer[256];
+
+  fprintf(stderr, "openbl_sim: application running, SIGUSR1 resets the device\n");
+
+  while (PinReset == 0)
+  {
+    if ((Master < 0) || (read(Master, buffer, sizeof(buffer)) <= 0))
+    {
+      usleep(10000U);
+    }
+  }
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Log an event of the device, in verbose mode only.
+  * @param  Format The printf() format.
+  * @retval None.
+  */
+void SIM_Log(const char *Format, ...)
+{
+  va_list arguments;
+
+  if (SIM_Config.Verbose != 0)
+  {
+    va_start(arguments, Format);
+    fprintf(stderr, "[%12.6f] ", (double)SIM_Now / (double)SIM_PS_PER_S);
+    vfprintf(stderr, Format, arguments);
+    fputc('\n', stderr);
+    va_end(arguments);
+  }
+}
+
+/**
+  * @brief  Report an error of the simulation or of the firmware and end the boot.
+  * @param  Format The printf() format.
+  * @retval None.
+  */
+void SIM_Fatal(const char *Format, ...)
+{
+  va_list arguments;
+
+  va_start(arguments, Format);
+  fprintf(stderr, "openbl_sim: [%12.6f] error: ", (double)SIM_Now / (double)SIM_PS_PER_S);
+  vfprintf(stderr, Format, arguments);
+  fputc('\n', stderr);
+  va_end(arguments);
+
+  SIM_Exit(SIM_EXIT_ERROR);
+}
+
+/**
+  * @brief  End the boot: the device bytes are sent and the clock is published.
+  * @param  Status The exit status of the boot.
+  * @retval None.
+  */
+void SIM_Exit(int Status)
+{
+  SIM_IO_Flush();
+
+  if ((SIM_Clock != NULL) && ((SIM_Now / 1000U) > SIM_Clock->Now))
+  {
+    SIM_Clock->Now = SIM_Now / 1000U;
+  }
+
+  fflush(stderr);
+  _exit(Status);
+}
+
+/**
+  * @brief  Reset the device, it is booted again by the supervisor.
+  * @param  Cause The reset cause.
+  * @retval None.
+  */
+void SIM_Reset(SIM_ResetTypeDef Cause)
+{
+  SIM_Log("reset, cause %u", (unsigned int)Cause);
+
+  SIM_Exit((Cause == SIM_RESET_WATCHDOG) ? SIM_EXIT_WATCHDOG : SIM_EXIT_RESET);
+}
+
+/**
+  * @brief  Get the state kept across the resets.
+  * @retval The state.
+  */
+SIM_PersistTypeDef *SIM_Persist(void)
+{
+  return Persist;
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option options[] =
+  {
+    { "state",       required_argument, NULL, 's' },
+    { "link",        required_argument, NULL, 'l' },
+    { "input",       required_argument, NULL, 'i' },
+    { "output",      required_argument, NULL, 'o' },
+    { "baud",        required_argument, NULL, 'b' },
+    { "clock",       required_argument, NULL, 'c' },
+    { "exit-on-app", no_argument,       NULL, 'a' },
+    { "max-time",    required_argument, NULL, 't' },
+    { NULL,          0,                 NULL, 0   }
+  };
+  SIM_ResetTypeDef cause = SIM_RESET_POWER;
+  int master = -1;
+  int slave = -1;
+  int status;
+  int option;
+  FILE *file;
+
+  while ((option = getopt_long(argc, argv, "v", options, NULL)) != -1)
+  {
+    switch (option)
+    {
+      case 's': SIM_Config.State = optarg; break;
+      case 'l': SIM_Config.Link = optarg; break;
+      case 'i': SIM_Config.Input = optarg; break;
+      case 'o': SIM_Config.Output = optarg; break;
+      case 'b': SIM_Config.BaudRate = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'c': SIM_Config.Clock = optarg; break;
+      case 'a': SIM_Config.ExitOnApp = 1; break;
+      case 't': SIM_Config.MaxTime = (SIM_TimeTypeDef)(strtod(optarg, NULL) * (double)SIM_PS_PER_S); break;
+      case 'v': SIM_Config.Verbose = 1; break;
+      default: SIM_Usage(); break;
+    }
+  }
+
+  if ((optind != argc) || (SIM_Config.BaudRate == 0U))
+  {
+    SIM_Usage();
+  }
+
+  SIM_Clock        = SIM_MapShared(SIM_Config.Clock, sizeof(SIM_ClockTypeDef));
+  SIM_Clock->Magic = SIM_CLOCK_MAGIC;
+  Persist          = SIM_MapShared(NULL, sizeof(SIM_PersistTypeDef));
+
+  if (SIM_Config.Input == NULL)
+  {
+    SIM_OpenTerminal(&master, &slave);
+  }
+  else if (SIM_Config.Output != NULL)
+  {
+    file = fopen(SIM_Config.Output, "wb");
+
+    if (file == NULL)
+    {
+      SIM_Fatal("cannot create %s: %m", SIM_Config.Output);
+    }
+
+    fclose(file);
+  }
+
+  signal(SIGUSR1, SIM_OnPinReset);
+  signal(SIGPIPE, SIG_IGN);
+
+  for (;;)
+  {
+    fflush(stderr);
+    PinReset = 0;
+    Device   = fork();
+
+    if (Device < 0)
+    {
+      SIM_Fatal("cannot fork: %m");
+    }
+
+    if (Device == 0)
+    {
+      SIM_Boot(cause, master, slave);
+    }
+
+    while ((waitpid(Device, &status, 0) < 0) && (errno == EINTR))
+    {
+    }
+
+    Device = 0;
+
+    if (PinReset != 0)
+    {
+      cause = SIM_RESET_PIN;
+    }
+    else if (!WIFEXITED(status))
+    {
+      fprintf(stderr, "openbl_sim: device process killed by signal %d\n", WTERMSIG(status));
+      return SIM_EXIT_ERROR;
+    }
+    else if (WEXITSTATUS(status) == SIM_EXIT_RESET)
+    {
+      cause = SIM_RESET_SOFTWARE;
+    }
+    else if (WEXITSTATUS(status) == SIM_EXIT_WATCHDOG)
+    {
+      cause = SIM_RESET_WATCHDOG;
+    }
+    else if ((WEXITSTATUS(status) == SIM_EXIT_APP) && (SIM_Config.ExitOnApp == 0) && (SIM_Config.Input == NULL))
+    {
+      SIM_RunApplication(master);
+      cause = SIM_RESET_PIN;
+    }
+    else if (WEXITSTATUS(status) == SIM_EXIT_APP)
+    {
+      return SIM_EXIT_END;
+    }
+    else
+    {
+      return WEXITSTATUS(status);
+    }
+  }
+}
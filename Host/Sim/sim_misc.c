@@ -0,0 +1,490 @@
+/**
+  ******************************************************************************
+  * @file    sim_misc.c
+  * @brief   Small peripherals of the simulated device: RCC, PWR, RTC backup
+  *          registers, IWDG, CRC and GPIO.
+  *
+  *          The oscillators and the PLL are ready as soon as they are enabled.
+  *          The RTC backup registers and the reset flags survive the resets of
+  *          the device, they are kept by the supervisor.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "sim.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define SIM_HSI_VALUE                 16000000U
+#define SIM_HSE_VALUE                 8000000U
+#define SIM_LSI_VALUE                 32000U
+
+#define SIM_REG(Base, Offset)         (*(volatile uint32_t *)(uintptr_t)((Base) + (Offset)))
+
+#define SIM_RCC_OFFSET_CR             0x00U
+#define SIM_RCC_OFFSET_PLLCFGR        0x04U
+#define SIM_RCC_OFFSET_CFGR           0x08U
+#define SIM_RCC_OFFSET_AHB1RSTR       0x10U
+#define SIM_RCC_OFFSET_APB1RSTR       0x20U
+#define SIM_RCC_OFFSET_AHB1ENR        0x30U
+#define SIM_RCC_OFFSET_BDCR           0x70U
+#define SIM_RCC_OFFSET_CSR            0x74U
+
+#define SIM_RCC_CSR_FLAGS             0xFE000000U
+
+#define SIM_IWDG_OFFSET_KR            0x00U
+#define SIM_IWDG_OFFSET_PR            0x04U
+#define SIM_IWDG_OFFSET_RLR           0x08U
+#define SIM_IWDG_OFFSET_SR            0x0CU
+#define SIM_IWDG_OFFSET_WINR          0x10U
+
+#define SIM_RTC_OFFSET_BKP0R          0x50U
+
+/* Private variables ---------------------------------------------------------*/
+static SIM_TimerTypeDef IwdgTimer;
+static int IwdgRunning = 0;
+
+/* RCC -------------------------------------------------------------------------*/
+
+static uint32_t SIM_RCC_GetSysclk(void)
+{
+  uint32_t pllcfgr = SIM_REG(RCC_BASE, SIM_RCC_OFFSET_PLLCFGR);
+  uint32_t source;
+  uint32_t vco;
+  uint32_t clock;
+
+  source = ((pllcfgr & RCC_PLLCFGR_PLLSRC) != 0U) ? SIM_HSE_VALUE : SIM_HSI_VALUE;
+  vco    = (uint32_t)(((uint64_t)source * ((pllcfgr & RCC_PLLCFGR_PLLN) >> RCC_PLLCFGR_PLLN_Pos))
+                      / ((pllcfgr & RCC_PLLCFGR_PLLM) >> RCC_PLLCFGR_PLLM_Pos));
+
+  switch (SIM_REG(RCC_BASE, SIM_RCC_OFFSET_CFGR) & RCC_CFGR_SWS)
+  {
+    case RCC_CFGR_SWS_HSE:
+      clock = SIM_HSE_VALUE;
+      break;
+
+    case RCC_CFGR_SWS_PLL:
+      clock = vco / ((((pllcfgr & RCC_PLLCFGR_PLLP) >> RCC_PLLCFGR_PLLP_Pos) + 1U) * 2U);
+      break;
+
+    case RCC_CFGR_SWS_PLLR:
+      clock = vco / ((pllcfgr & RCC_PLLCFGR_PLLR) >> RCC_PLLCFGR_PLLR_Pos);
+      break;
+
+    default:
+      clock = SIM_HSI_VALUE;
+      break;
+  }
+
+  return clock;
+}
+
+/**
+  * @brief  Get the core clock from the RCC registers.
+  * @retval The HCLK frequency in Hz.
+  */
+uint32_t SIM_RCC_GetHclk(void)
+{
+  static const uint8_t shift[16] = { 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, 1U, 2U, 3U, 4U, 6U, 7U, 8U, 9U };
+
+  return SIM_RCC_GetSysclk() >> shift[(SIM_REG(RCC_BASE, SIM_RCC_OFFSET_CFGR) & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos];
+}
+
+/**
+  * @brief  Get the APB1 clock from the RCC registers.
+  * @retval The PCLK1 frequency in Hz.
+  */
+uint32_t SIM_RCC_GetPclk1(void)
+{
+  static const uint8_t shift[8] = { 0U, 0U, 0U, 0U, 1U, 2U, 3U, 4U };
+
+  return SIM_RCC_GetHclk() >> shift[(SIM_REG(RCC_BASE, SIM_RCC_OFFSET_CFGR) & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos];
+}
+
+/**
+  * @brief  Get the clock of the APB1 timers, twice PCLK1 when APB1 is divided.
+  * @retval The timer clock frequency in Hz.
+  */
+uint32_t SIM_RCC_GetTimerClock(void)
+{
+  uint32_t clock = SIM_RCC_GetPclk1();
+
+  if ((SIM_REG(RCC_BASE, SIM_RCC_OFFSET_CFGR) & RCC_CFGR_PPRE1) >= RCC_CFGR_PPRE1_DIV2)
+  {
+    clock *= 2U;
+  }
+
+  return clock;
+}
+
+static void SIM_RCC_Write(uint32_t Offset, uint32_t Old)
+{
+  volatile uint32_t *reg = &SIM_REG(RCC_BASE, Offset);
+  uint32_t value = *reg;
+  uint32_t reset;
+
+  switch (Offset)
+  {
+    case SIM_RCC_OFFSET_CR:
+      /* Ready flags follow the enable bits, the HSI is kept while it clocks the system */
+      value &= ~(RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY | RCC_CR_PLLI2SRDY | RCC_CR_PLLSAIRDY);
+      value |= (value & RCC_CR_HSION) << 1;
+      value |= (value & RCC_CR_HSEON) << 1;
+      value |= (value & RCC_CR_PLLON) << 1;
+      value |= (value & RCC_CR_PLLI2SON) << 1;
+      value |= (value & RCC_CR_PLLSAION) << 1;
+      *reg = value;
+      SIM_CPU_UpdateClock();
+      break;
+
+    case SIM_RCC_OFFSET_PLLCFGR:
+      SIM_CPU_UpdateClock();
+      break;
+
+    case SIM_RCC_OFFSET_CFGR:
+      *reg = (value & ~RCC_CFGR_SWS) | ((value & RCC_CFGR_SW) << 2);
+      SIM_CPU_UpdateClock();
+      break;
+
+    case SIM_RCC_OFFSET_AHB1RSTR:
+      reset = value & ~Old;
+
+      if ((reset & RCC_AHB1RSTR_GPIOARST) != 0U)
+      {
+        SIM_GPIO_Reset();
+      }
+
+      if ((reset & RCC_AHB1RSTR_CRCRST) != 0U)
+      {
+        SIM_CRC_Reset();
+      }
+
+      if ((reset & RCC_AHB1RSTR_DMA1RST) != 0U)
+      {
+        SIM_DMA_Reset();
+      }
+      break;
+
+    case SIM_RCC_OFFSET_APB1RSTR:
+      reset = value & ~Old;
+
+      if ((reset & RCC_APB1RSTR_TIM2RST) != 0U)
+      {
+        SIM_TIM_Reset(TIM2_BASE);
+      }
+
+      if ((reset & RCC_APB1RSTR_TIM6RST) != 0U)
+      {
+        SIM_TIM_Reset(TIM6_BASE);
+      }
+
+      if ((reset & RCC_APB1RSTR_USART2RST) != 0U)
+      {
+        SIM_USART_Reset();
+      }
+
+      if ((reset & RCC_APB1RSTR_PWRRST) != 0U)
+      {
+        SIM_PWR_Reset();
+      }
+      break;
+
+    case SIM_RCC_OFFSET_BDCR:
+      *reg = (value & ~RCC_BDCR_LSERDY) | ((value & RCC_BDCR_LSEON) << 1);
+      break;
+
+    case SIM_RCC_OFFSET_CSR:
+      *reg = (value & ~RCC_CSR_LSIRDY) | ((value & RCC_CSR_LSION) << 1);
+
+      if ((value & RCC_CSR_RMVF) != 0U)
+      {
+        SIM_Persist()->ResetFlags = 0U;
+        *reg &= ~(SIM_RCC_CSR_FLAGS | RCC_CSR_RMVF);
+      }
+      else
+      {
+        *reg = (*reg & ~SIM_RCC_CSR_FLAGS) | (Old & SIM_RCC_CSR_FLAGS);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+static const SIM_DeviceTypeDef RccDevice =
+{
+  RCC_BASE, 0x400U, NULL, SIM_RCC_Write
+};
+
+/**
+  * @brief  Reset the RCC, the reset flags of CSR accumulate until they are removed.
+  * @param  Cause The reset cause.
+  * @retval None.
+  */
+void SIM_RCC_Reset(SIM_ResetTypeDef Cause)
+{
+  SIM_PersistTypeDef *persist = SIM_Persist();
+
+  switch (Cause)
+  {
+    case SIM_RESET_SOFTWARE:
+      persist->ResetFlags |= RCC_CSR_SFTRSTF | RCC_CSR_PINRSTF;
+      break;
+
+    case SIM_RESET_WATCHDOG:
+      persist->ResetFlags |= RCC_CSR_IWDGRSTF | RCC_CSR_PINRSTF;
+      break;
+
+    case SIM_RESET_PIN:
+      persist->ResetFlags |= RCC_CSR_PINRSTF;
+      break;
+
+    default:
+      persist->ResetFlags = RCC_CSR_PORRSTF | RCC_CSR_PINRSTF | RCC_CSR_BORRSTF;
+      break;
+  }
+
+  memset((void *)(uintptr_t)RCC_BASE, 0, 0x400U);
+  SIM_REG(RCC_BASE, SIM_RCC_OFFSET_CR)      = 0x00000083U;
+  SIM_REG(RCC_BASE, SIM_RCC_OFFSET_PLLCFGR) = 0x24003010U;
+  SIM_REG(RCC_BASE, SIM_RCC_OFFSET_AHB1ENR) = 0x00100000U;
+  SIM_REG(RCC_BASE, SIM_RCC_OFFSET_CSR)     = persist->ResetFlags;
+
+  SIM_BUS_Register(&RccDevice);
+}
+
+/* PWR -------------------------------------------------------------------------*/
+
+static const SIM_DeviceTypeDef PwrDevice =
+{
+  PWR_BASE, 0x400U, NULL, NULL
+};
+
+/**
+  * @brief  Reset the PWR controller, the regulator is ready.
+  * @retval None.
+  */
+void SIM_PWR_Reset(void)
+{
+  memset((void *)(uintptr_t)PWR_BASE, 0, 0x400U);
+  PWR->CR  = 0x0000C000U;
+  PWR->CSR = PWR_CSR_VOSRDY;
+
+  SIM_BUS_Register(&PwrDevice);
+}
+
+/* RTC -------------------------------------------------------------------------*/
+
+static void SIM_RTC_Write(uint32_t Offset, uint32_t Old)
+{
+  volatile uint32_t *reg = &SIM_REG(RTC_BASE, Offset);
+  uint32_t index;
+
+  /* The backup domain is write protected until DBP is set */
+  if ((PWR->CR & PWR_CR_DBP) == 0U)
+  {
+    *reg = Old;
+  }
+  else if ((Offset >= SIM_RTC_OFFSET_BKP0R) && (Offset < (SIM_RTC_OFFSET_BKP0R + (SIM_BACKUP_REGISTERS * 4U))))
+  {
+    index = (Offset - SIM_RTC_OFFSET_BKP0R) / 4U;
+    SIM_Persist()->Backup[index] = *reg;
+  }
+  else
+  {
+    /* Plain registers */
+  }
+}
+
+static const SIM_DeviceTypeDef RtcDevice =
+{
+  RTC_BASE, 0x400U, NULL, SIM_RTC_Write
+};
+
+/**
+  * @brief  Reset the RTC registers, the backup registers keep their content.
+  * @retval None.
+  */
+void SIM_RTC_Reset(void)
+{
+  memset((void *)(uintptr_t)RTC_BASE, 0, 0x400U);
+  memcpy((void *)(uintptr_t)(RTC_BASE + SIM_RTC_OFFSET_BKP0R), SIM_Persist()->Backup,
+         sizeof(SIM_Persist()->Backup));
+
+  SIM_BUS_Register(&RtcDevice);
+}
+
+/* IWDG ------------------------------------------------------------------------*/
+
+static SIM_TimeTypeDef SIM_IWDG_GetTimeout(void)
+{
+  uint32_t prescaler = SIM_REG(IWDG_BASE, SIM_IWDG_OFFSET_PR) & 7U;
+  uint32_t reload = SIM_REG(IWDG_BASE, SIM_IWDG_OFFSET_RLR) & 0xFFFU;
+
+  if (prescaler > 6U)
+  {
+    prescaler = 6U;
+  }
+
+  return SIM_CYCLES((uint64_t)(reload + 1U) * (4UL << prescaler), SIM_LSI_VALUE);
+}
+
+static void SIM_IWDG_Fire(SIM_TimeTypeDef When)
+{
+  (void)When;
+
+  SIM_Log("independent watchdog reset");
+  SIM_Reset(SIM_RESET_WATCHDOG);
+}
+
+static void SIM_IWDG_Write(uint32_t Offset, uint32_t Old)
+{
+  uint32_t value = SIM_REG(IWDG_BASE, Offset);
+
+  (void)Old;
+
+  if (Offset == SIM_IWDG_OFFSET_KR)
+  {
+    if (value == 0xCCCCU)
+    {
+      IwdgRunning = 1;
+      SIM_Timer_Start(&IwdgTimer, SIM_Now + SIM_IWDG_GetTimeout());
+    }
+    else if ((value == 0xAAAAU) && (IwdgRunning != 0))
+    {
+      SIM_Timer_Start(&IwdgTimer, SIM_Now + SIM_IWDG_GetTimeout());
+    }
+    else
+    {
+      /* 0x5555 gives access to PR and RLR, the access is not checked */
+    }
+
+    SIM_REG(IWDG_BASE, Offset) = 0U;
+  }
+}
+
+static const SIM_DeviceTypeDef IwdgDevice =
+{
+  IWDG_BASE, 0x400U, NULL, SIM_IWDG_Write
+};
+
+/**
+  * @brief  Reset the independent watchdog, it is stopped.
+  * @retval None.
+  */
+void SIM_IWDG_Reset(void)
+{
+  memset((void *)(uintptr_t)IWDG_BASE, 0, 0x400U);
+  SIM_REG(IWDG_BASE, SIM_IWDG_OFFSET_RLR)  = 0xFFFU;
+  SIM_REG(IWDG_BASE, SIM_IWDG_OFFSET_WINR) = 0xFFFU;
+
+  IwdgRunning    = 0;
+  IwdgTimer.When = SIM_TIME_NEVER;
+  IwdgTimer.Fire = SIM_IWDG_Fire;
+
+  SIM_BUS_Register(&IwdgDevice);
+}
+
+/**
+  * @brief  Check if the independent watchdog has been started.
+  * @retval 1 if running.
+  */
+int SIM_IWDG_IsRunning(void)
+{
+  return IwdgRunning;
+}
+
+/**
+  * @brief  Get the time of the watchdog reset if it is not refreshed anymore.
+  * @retval The expiry time.
+  */
+SIM_TimeTypeDef SIM_IWDG_GetExpiry(void)
+{
+  return IwdgTimer.When;
+}
+
+/* CRC -------------------------------------------------------------------------*/
+
+static void SIM_CRC_Write(uint32_t Offset, uint32_t Old)
+{
+  uint32_t crc;
+  uint32_t bit;
+
+  if (Offset == 0x00U)
+  {
+    /* CRC-32 polynomial 0x04C11DB7 on the 32-bit word, MSB first */
+    crc = Old ^ CRC->DR;
+
+    for (bit = 0U; bit < 32U; bit++)
+    {
+      crc = ((crc & 0x80000000U) != 0U) ? ((crc << 1) ^ 0x04C11DB7U) : (crc << 1);
+    }
+
+    CRC->DR = crc;
+  }
+  else if (Offset == 0x08U)
+  {
+    if ((CRC->CR & CRC_CR_RESET) != 0U)
+    {
+      CRC->DR = 0xFFFFFFFFU;
+    }
+
+    CRC->CR = 0U;
+  }
+  else
+  {
+    CRC->IDR &= 0xFFU;
+  }
+}
+
+static const SIM_DeviceTypeDef CrcDevice =
+{
+  CRC_BASE, 0x400U, NULL, SIM_CRC_Write
+};
+
+/**
+  * @brief  Reset the CRC unit.
+  * @retval None.
+  */
+void SIM_CRC_Reset(void)
+{
+  memset((void *)(uintptr_t)CRC_BASE, 0, 0x400U);
+  CRC->DR = 0xFFFFFFFFU;
+
+  SIM_BUS_Register(&CrcDevice);
+}
+
+/* GPIO ------------------------------------------------------------------------*/
+
+/**
+  * @brief  Reset the GPIO ports to their reset configuration, the debug pins are in alternate function.
+  * @retval None.
+  */
+void SIM_GPIO_Reset(void)
+{
+  memset((void *)(uintptr_t)GPIOA_BASE, 0, 0x400U);
+  GPIOA->MODER   = 0xA8000000U;
+  GPIOA->OSPEEDR = 0x0C000000U;
+  GPIOA->PUPDR   = 0x64000000U;
+
+  memset((void *)(uintptr_t)GPIOB_BASE, 0, 0x400U);
+  GPIOB->MODER   = 0x00000280U;
+  GPIOB->OSPEEDR = 0x000000C0U;
+  GPIOB->PUPDR   = 0x00000100U;
+}
+
+/**
+  * @brief  Get the peripheral receiving the PA3 pin, the host to device line.
+  * @retval The alternate function number, 0 when the pin is not in alternate function mode.
+  */
+uint32_t SIM_GPIO_RxRouting(void)
+{
+  uint32_t routing = 0U;
+
+  if (((GPIOA->MODER >> (3U * 2U)) & 3U) == 2U)
+  {
+    routing = (GPIOA->AFR[0] >> (3U * 4U)) & 0xFU;
+  }
+
+  return routing;
+}
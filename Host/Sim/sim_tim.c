@@ -0,0 +1,315 @@
+/**
+  ******************************************************************************
+  * @file    sim_tim.c
+  * @brief   TIM2 and TIM6 of the simulated device.
+  *
+  *          Up-counting time base with prescaler, auto-reload and update
+  *          event, and the input capture of TIM2 channel 4 fed with the
+  *          falling edges of the host to device line when PA3 is on AF1.
+  *          The counter is computed from the time, it is not stepped.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "sim.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define SIM_TIM_NUMBER                2U
+
+/* Private types -------------------------------------------------------------*/
+typedef struct
+{
+  TIM_TypeDef *Instance;
+  uint32_t Irq;                     /* Update interrupt, 0 for none */
+  uint32_t Mask;                    /* Counter mask, 16 or 32 bits */
+  uint32_t Prescaler;               /* Active prescaler, PSC is preloaded */
+  uint32_t Clock;                   /* Counter input clock */
+  uint32_t Base;                    /* Counter value at BaseTime */
+  SIM_TimeTypeDef BaseTime;
+  SIM_TimerTypeDef Update;
+} SIM_TimTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static int SIM_TIM6_Level(void);
+static void SIM_TIM_Fire2(SIM_TimeTypeDef When);
+static void SIM_TIM_Fire6(SIM_TimeTypeDef When);
+
+static SIM_TimTypeDef Tims[SIM_TIM_NUMBER] =
+{
+  { TIM2, 0U, 0xFFFFFFFFU, 0U, 0U, 0U, 0U, { SIM_TIME_NEVER, SIM_TIM_Fire2 } },
+  { TIM6, TIM6_DAC_IRQn, 0xFFFFU, 0U, 0U, 0U, 0U, { SIM_TIME_NEVER, SIM_TIM_Fire6 } }
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+static SIM_TimTypeDef *SIM_TIM_Get(uint32_t Instance)
+{
+  return (Instance == TIM2_BASE) ? &Tims[0] : &Tims[1];
+}
+
+static int SIM_TIM_IsRunning(const SIM_TimTypeDef *Tim)
+{
+  return (Tim->Instance->CR1 & TIM_CR1_CEN) != 0U;
+}
+
+/* Time of one counter tick */
+static SIM_TimeTypeDef SIM_TIM_Ticks(const SIM_TimTypeDef *Tim, uint64_t Ticks)
+{
+  return SIM_CYCLES(Ticks * (Tim->Prescaler + 1U), Tim->Clock);
+}
+
+static uint64_t SIM_TIM_Elapsed(const SIM_TimTypeDef *Tim, SIM_TimeTypeDef When)
+{
+  return (uint64_t)(((unsigned __int128)(When - Tim->BaseTime) * Tim->Clock) / SIM_PS_PER_S) / (Tim->Prescaler + 1U);
+}
+
+static uint32_t SIM_TIM_Period(const SIM_TimTypeDef *Tim)
+{
+  return Tim->Instance->ARR & Tim->Mask;
+}
+
+static uint32_t SIM_TIM_Counter(const SIM_TimTypeDef *Tim, SIM_TimeTypeDef When)
+{
+  uint64_t count;
+
+  if (!SIM_TIM_IsRunning(Tim) || (When < Tim->BaseTime))
+  {
+    return Tim->Base;
+  }
+
+  count = Tim->Base + SIM_TIM_Elapsed(Tim, When);
+
+  return (uint32_t)(count % ((uint64_t)SIM_TIM_Period(Tim) + 1U));
+}
+
+/* Restart the counter from Count at the current time and schedule the next update event */
+static void SIM_TIM_Rebase(SIM_TimTypeDef *Tim, uint32_t Count)
+{
+  Tim->Base     = Count;
+  Tim->BaseTime = SIM_Now;
+
+  if (SIM_TIM_IsRunning(Tim) && (Tim->Clock != 0U) && (Count <= SIM_TIM_Period(Tim)))
+  {
+    SIM_Timer_Start(&Tim->Update, SIM_Now + SIM_TIM_Ticks(Tim, (uint64_t)SIM_TIM_Period(Tim) + 1U - Count));
+  }
+  else
+  {
+    SIM_Timer_Stop(&Tim->Update);
+  }
+}
+
+static void SIM_TIM_UpdateEvent(SIM_TimTypeDef *Tim)
+{
+  Tim->Prescaler    = Tim->Instance->PSC & 0xFFFFU;
+  Tim->Instance->SR |= TIM_SR_UIF;
+
+  if (Tim->Irq != 0U)
+  {
+    SIM_NVIC_Update(Tim->Irq);
+  }
+}
+
+static void SIM_TIM_Fire(SIM_TimTypeDef *Tim, SIM_TimeTypeDef When)
+{
+  /* Overflow: the counter restarts from 0 at the overflow time */
+  SIM_TIM_UpdateEvent(Tim);
+
+  Tim->Base     = 0U;
+  Tim->BaseTime = When;
+  SIM_Timer_Start(&Tim->Update, When + SIM_TIM_Ticks(Tim, (uint64_t)SIM_TIM_Period(Tim) + 1U));
+}
+
+static void SIM_TIM_Fire2(SIM_TimeTypeDef When)
+{
+  SIM_TIM_Fire(&Tims[0], When);
+}
+
+static void SIM_TIM_Fire6(SIM_TimeTypeDef When)
+{
+  SIM_TIM_Fire(&Tims[1], When);
+}
+
+static int SIM_TIM6_Level(void)
+{
+  return ((TIM6->DIER & TIM_DIER_UIE) != 0U) && ((TIM6->SR & TIM_SR_UIF) != 0U);
+}
+
+static void SIM_TIM_Read(SIM_TimTypeDef *Tim, uint32_t Offset)
+{
+  switch (Offset)
+  {
+    case 0x10U:
+      SIM_IdlePoll((uint32_t)(uintptr_t)&Tim->Instance->SR, Tim->Instance->SR);
+      break;
+
+    case 0x24U:
+      Tim->Instance->CNT = SIM_TIM_Counter(Tim, SIM_Now);
+      break;
+
+    case 0x40U:
+      /* Reading the captured value clears the capture flag */
+      Tim->Instance->SR &= ~TIM_SR_CC4IF;
+      break;
+
+    default:
+      break;
+  }
+}
+
+static void SIM_TIM_Write(SIM_TimTypeDef *Tim, uint32_t Offset, uint32_t Old)
+{
+  TIM_TypeDef *tim = Tim->Instance;
+  uint32_t value;
+
+  switch (Offset)
+  {
+    case 0x00U:
+      value = tim->CR1;
+
+      if (((Old ^ value) & TIM_CR1_CEN) != 0U)
+      {
+        /* Counter value of the stopping or starting counter */
+        tim->CR1 = Old;
+        value    = SIM_TIM_Counter(Tim, SIM_Now);
+        tim->CR1 = tim->CR1 ^ TIM_CR1_CEN;
+        SIM_TIM_Rebase(Tim, value);
+      }
+      break;
+
+    case 0x10U:
+      /* Flags are cleared by writing 0 */
+      tim->SR = Old & tim->SR;
+      break;
+
+    case 0x14U:
+      if ((tim->EGR & TIM_EGR_UG) != 0U)
+      {
+        SIM_TIM_UpdateEvent(Tim);
+        SIM_TIM_Rebase(Tim, 0U);
+      }
+
+      tim->EGR = 0U;
+      break;
+
+    case 0x24U:
+      SIM_TIM_Rebase(Tim, tim->CNT & Tim->Mask);
+      break;
+
+    case 0x2CU:
+      /* ARR is not preloaded, the update is rescheduled */
+      SIM_TIM_Rebase(Tim, SIM_TIM_Counter(Tim, SIM_Now));
+      break;
+
+    case 0x40U:
+      /* CCR4 is read only in input mode */
+      if ((tim->CCMR2 & TIM_CCMR2_CC4S) != 0U)
+      {
+        tim->CCR4 = Old;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  if (Tim->Irq != 0U)
+  {
+    SIM_NVIC_Update(Tim->Irq);
+  }
+}
+
+static void SIM_TIM2_Read(uint32_t Offset)
+{
+  SIM_TIM_Read(&Tims[0], Offset);
+}
+
+static void SIM_TIM2_Write(uint32_t Offset, uint32_t Old)
+{
+  SIM_TIM_Write(&Tims[0], Offset, Old);
+}
+
+static void SIM_TIM6_Read(uint32_t Offset)
+{
+  SIM_TIM_Read(&Tims[1], Offset);
+}
+
+static void SIM_TIM6_Write(uint32_t Offset, uint32_t Old)
+{
+  SIM_TIM_Write(&Tims[1], Offset, Old);
+}
+
+static const SIM_DeviceTypeDef TimDevices[SIM_TIM_NUMBER] =
+{
+  { TIM2_BASE, 0x400U, SIM_TIM2_Read, SIM_TIM2_Write },
+  { TIM6_BASE, 0x400U, SIM_TIM6_Read, SIM_TIM6_Write }
+};
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Reset a timer.
+  * @param  Instance Base address of the timer.
+  * @retval None.
+  */
+void SIM_TIM_Reset(uint32_t Instance)
+{
+  SIM_TimTypeDef *tim = SIM_TIM_Get(Instance);
+
+  memset((void *)(uintptr_t)Instance, 0, 0x400U);
+  tim->Instance->ARR = tim->Mask;
+  tim->Prescaler     = 0U;
+  tim->Base          = 0U;
+  tim->BaseTime      = SIM_Now;
+  tim->Clock         = SIM_RCC_GetTimerClock();
+  SIM_Timer_Stop(&tim->Update);
+
+  SIM_BUS_Register(&TimDevices[(Instance == TIM2_BASE) ? 0U : 1U]);
+
+  if (tim->Irq != 0U)
+  {
+    SIM_NVIC_SetLine(tim->Irq, SIM_TIM6_Level);
+  }
+}
+
+/**
+  * @brief  Rebase the running counters on a new timer clock.
+  * @retval None.
+  */
+void SIM_TIM_UpdateClock(void)
+{
+  uint32_t clock = SIM_RCC_GetTimerClock();
+  uint32_t count;
+  uint32_t index;
+
+  for (index = 0U; index < SIM_TIM_NUMBER; index++)
+  {
+    if (Tims[index].Clock != clock)
+    {
+      count              = SIM_TIM_Counter(&Tims[index], SIM_Now);
+      Tims[index].Clock  = clock;
+      SIM_TIM_Rebase(&Tims[index], count);
+    }
+  }
+}
+
+/**
+  * @brief  Falling edge on TI4 of TIM2, captured when channel 4 is an enabled input on the falling edge.
+  * @param  When Time of the edge.
+  * @retval None.
+  */
+void SIM_TIM_Capture(SIM_TimeTypeDef When)
+{
+  TIM_TypeDef *tim = TIM2;
+
+  if ((((tim->CCMR2 & TIM_CCMR2_CC4S) >> TIM_CCMR2_CC4S_Pos) == 1U)
+      && ((tim->CCER & TIM_CCER_CC4E) != 0U) && ((tim->CCER & TIM_CCER_CC4P) != 0U))
+  {
+    if ((tim->SR & TIM_SR_CC4IF) != 0U)
+    {
+      tim->SR |= TIM_SR_CC4OF;
+    }
+
+    tim->CCR4 = SIM_TIM_Counter(&Tims[0], When);
+    tim->SR  |= TIM_SR_CC4IF;
+  }
+}
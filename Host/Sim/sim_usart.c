@@ -0,0 +1,551 @@
+/**
+  ******************************************************************************
+  * @file    sim_usart.c
+  * @brief   USART2 of the simulated device and the serial line to the host.
+  *
+  *          The host to device line is modelled bit by bit: the bytes of the
+  *          host are sent back to back as 8E1 frames at the baudrate of the
+  *          host, whatever the configuration of the device. The falling edges
+  *          of the line feed the TIM2 input capture while PA3 is on AF1, or
+  *          start the reception of a frame by the USART while PA3 is on AF7.
+  *          The USART samples the line in the middle of its own bit times: a
+  *          baudrate mismatch gives framing, parity or shifted bytes as on
+  *          the target.
+  *          The device to host line is modelled at the byte level: a byte is
+  *          handed to the host at the end of its stop bit.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "sim.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define SIM_USART_HOST_BITS           11U       /* Start, 8 data, even parity, stop */
+#define SIM_USART_HISTORY             8U        /* Host frames kept to sample the line, a power of 2 */
+#define SIM_USART_RX_AF               7U
+#define SIM_USART_TIM_AF              1U
+
+#define SIM_USART_SR_ERRORS           (USART_SR_PE | USART_SR_FE | USART_SR_NE | USART_SR_ORE | USART_SR_IDLE)
+
+/* Private types -------------------------------------------------------------*/
+typedef struct
+{
+  SIM_TimeTypeDef Start;
+  SIM_TimeTypeDef Bit;              /* Bit time of the host */
+  uint32_t Bits;                    /* Line levels, bit 0 is the start bit */
+} SIM_FrameTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static SIM_FrameTypeDef History[SIM_USART_HISTORY];
+static uint32_t HistoryCount = 0U;                  /* Host frames started since reset */
+static uint32_t EdgeIndex = 0U;                     /* Next bit of the current host frame checked for an edge */
+static int LineBusy = 0;                            /* A host frame is on the line */
+static int Receiving = 0;                           /* The USART is receiving a frame */
+static SIM_TimeTypeDef RxFrameStart = 0U;           /* Falling edge of the start bit of the received frame */
+static SIM_TimeTypeDef RxFrameBit = 0U;             /* Bit time of the USART for the received frame */
+static uint32_t RxFrameBits = 0U;
+static int SrRead = 0;                              /* First half of the error flags clear sequence done */
+static uint32_t Rdr = 0U;
+static uint32_t Tdr = 0U;                           /* Byte in the shift register */
+static uint32_t TdrNext = 0U;                       /* Byte waiting in the data register */
+static int TdrFull = 0;
+static int Shifting = 0;
+
+static void SIM_USART_LineEnd(SIM_TimeTypeDef When);
+static void SIM_USART_Edge(SIM_TimeTypeDef When);
+static void SIM_USART_RxEnd(SIM_TimeTypeDef When);
+static void SIM_USART_TxEnd(SIM_TimeTypeDef When);
+
+static SIM_TimerTypeDef LineTimer = { SIM_TIME_NEVER, SIM_USART_LineEnd };
+static SIM_TimerTypeDef EdgeTimer = { SIM_TIME_NEVER, SIM_USART_Edge };
+static SIM_TimerTypeDef RxTimer = { SIM_TIME_NEVER, SIM_USART_RxEnd };
+static SIM_TimerTypeDef TxTimer = { SIM_TIME_NEVER, SIM_USART_TxEnd };
+
+/* Private functions ---------------------------------------------------------*/
+
+static const SIM_FrameTypeDef *SIM_USART_Current(void)
+{
+  return &History[(HistoryCount - 1U) & (SIM_USART_HISTORY - 1U)];
+}
+
+/* Bits of a frame of the USART: start, data with the parity bit, stop bits */
+static uint32_t SIM_USART_FrameBits(void)
+{
+  uint32_t bits = ((USART2->CR1 & USART_CR1_M) != 0U) ? 11U : 10U;
+
+  if ((USART2->CR2 & USART_CR2_STOP) == USART_CR2_STOP_1)
+  {
+    bits++;
+  }
+
+  return bits;
+}
+
+/* Level of the host to device line at a given time */
+static uint32_t SIM_USART_Level(SIM_TimeTypeDef When)
+{
+  const SIM_FrameTypeDef *frame;
+  uint32_t count = (HistoryCount < SIM_USART_HISTORY) ? HistoryCount : SIM_USART_HISTORY;
+  uint32_t index;
+  uint64_t bit;
+
+  for (index = 1U; index <= count; index++)
+  {
+    frame = &History[(HistoryCount - index) & (SIM_USART_HISTORY - 1U)];
+
+    if (When >= frame->Start)
+    {
+      bit = (When - frame->Start) / frame->Bit;
+
+      return (bit < SIM_USART_HOST_BITS) ? ((frame->Bits >> bit) & 1U) : 1U;
+    }
+  }
+
+  return 1U;
+}
+
+static int SIM_USART_IsListening(void)
+{
+  return ((USART2->CR1 & (USART_CR1_UE | USART_CR1_RE)) == (USART_CR1_UE | USART_CR1_RE))
+         && (SIM_GPIO_RxRouting() == SIM_USART_RX_AF) && (SIM_USART_GetBaudRate() != 0U);
+}
+
+static int SIM_USART_Level38(void)
+{
+  uint32_t sr = USART2->SR;
+  uint32_t cr1 = USART2->CR1;
+  uint32_t cr3 = USART2->CR3;
+
+  return (((cr1 & USART_CR1_PEIE) != 0U) && ((sr & USART_SR_PE) != 0U))
+         || (((cr1 & USART_CR1_TXEIE) != 0U) && ((sr & USART_SR_TXE) != 0U))
+         || (((cr1 & USART_CR1_TCIE) != 0U) && ((sr & USART_SR_TC) != 0U))
+         || (((cr1 & USART_CR1_RXNEIE) != 0U) && ((sr & (USART_SR_RXNE | USART_SR_ORE)) != 0U))
+         || (((cr3 & USART_CR3_EIE) != 0U) && ((cr3 & USART_CR3_DMAR) != 0U)
+             && ((sr & (USART_SR_FE | USART_SR_ORE | USART_SR_NE)) != 0U));
+}
+
+static void SIM_USART_Changed(void)
+{
+  SIM_NVIC_Update(USART2_IRQn);
+  SIM_DMA_Request();
+}
+
+/* Start the next host frame if the host has sent a byte */
+static void SIM_USART_LineStart(SIM_TimeTypeDef When)
+{
+  SIM_FrameTypeDef *frame;
+  uint32_t baudrate;
+  uint32_t parity;
+  uint8_t byte;
+
+  if (SIM_IO_Take(&byte, &baudrate) != 0)
+  {
+    parity = (uint32_t)__builtin_parity(byte);
+
+    /* First byte after an idle line, the start of a host request */
+    if ((HistoryCount == 0U)
+        || (When > (SIM_USART_Current()->Start + (SIM_USART_HOST_BITS * SIM_USART_Current()->Bit))))
+    {
+      SIM_Clock->RxStart = When / 1000U;
+    }
+
+    frame        = &History[HistoryCount & (SIM_USART_HISTORY - 1U)];
+    frame->Start = When;
+    frame->Bit   = SIM_CYCLES(1U, baudrate);
+    frame->Bits  = ((uint32_t)byte << 1) | (parity << 9) | (1UL << 10);
+    HistoryCount++;
+
+    LineBusy  = 1;
+    EdgeIndex = 0U;
+    SIM_Timer_Start(&EdgeTimer, When);
+    SIM_Timer_Start(&LineTimer, When + (SIM_USART_HOST_BITS * frame->Bit));
+  }
+}
+
+/* End of the stop bit of a host frame, the next byte follows at once */
+static void SIM_USART_LineEnd(SIM_TimeTypeDef When)
+{
+  const SIM_FrameTypeDef *frame = SIM_USART_Current();
+
+  LineBusy = 0;
+  SIM_Clock->RxBytes++;
+  SIM_Clock->RxLineTime += (SIM_USART_HOST_BITS * frame->Bit) / 1000U;
+
+  if (SIM_Config.Input == NULL)
+  {
+    (void)SIM_IO_Poll(0);
+    SIM_IO_WaitHost();
+  }
+
+  SIM_USART_LineStart(When);
+}
+
+/* Falling edges of the current host frame */
+static void SIM_USART_Edge(SIM_TimeTypeDef When)
+{
+  const SIM_FrameTypeDef *frame = SIM_USART_Current();
+  uint32_t previous;
+  uint32_t bit;
+
+  (void)When;
+
+  for (bit = EdgeIndex; bit < SIM_USART_HOST_BITS; bit++)
+  {
+    previous = (bit == 0U) ? 1U : ((frame->Bits >> (bit - 1U)) & 1U);
+
+    if ((previous == 1U) && (((frame->Bits >> bit) & 1U) == 0U))
+    {
+      break;
+    }
+  }
+
+  if (bit == SIM_USART_HOST_BITS)
+  {
+    return;
+  }
+
+  if (frame->Start + (bit * frame->Bit) > SIM_Now)
+  {
+    EdgeIndex = bit;
+    SIM_Timer_Start(&EdgeTimer, frame->Start + (bit * frame->Bit));
+    return;
+  }
+
+  When      = frame->Start + (bit * frame->Bit);
+  EdgeIndex = bit + 1U;
+
+  if (SIM_GPIO_RxRouting() == SIM_USART_TIM_AF)
+  {
+    SIM_TIM_Capture(When);
+  }
+  else if ((Receiving == 0) && SIM_USART_IsListening())
+  {
+    /* Start bit detected by the USART, the frame is sampled at its own baudrate */
+    Receiving    = 1;
+    RxFrameStart = When;
+    RxFrameBit   = SIM_CYCLES(1U, SIM_USART_GetBaudRate());
+    RxFrameBits  = SIM_USART_FrameBits();
+    SIM_Timer_Start(&RxTimer, When + ((2U * RxFrameBits - 1U) * RxFrameBit) / 2U);
+  }
+  else
+  {
+    /* Edge ignored */
+  }
+
+  /* Next edge of the frame */
+  SIM_USART_Edge(SIM_Now);
+}
+
+/* Middle of the first stop bit of a frame received by the USART */
+static void SIM_USART_RxEnd(SIM_TimeTypeDef When)
+{
+  uint32_t dataBits = ((USART2->CR1 & USART_CR1_M) != 0U) ? 9U : 8U;
+  uint32_t data = 0U;
+  uint32_t flags = 0U;
+  uint32_t bit;
+
+  (void)When;
+  Receiving = 0;
+
+  if ((USART2->CR1 & (USART_CR1_UE | USART_CR1_RE)) != (USART_CR1_UE | USART_CR1_RE))
+  {
+    return;
+  }
+
+  if (SIM_USART_Level(RxFrameStart + (RxFrameBit / 2U)) != 0U)
+  {
+    /* False start bit */
+    USART2->SR |= USART_SR_NE;
+    SIM_USART_Changed();
+    return;
+  }
+
+  for (bit = 0U; bit < dataBits; bit++)
+  {
+    data |= SIM_USART_Level(RxFrameStart + ((2U * (bit + 1U) + 1U) * RxFrameBit) / 2U) << bit;
+  }
+
+  if (((USART2->CR1 & USART_CR1_PCE) != 0U) && ((uint32_t)__builtin_parity(data) != (((USART2->CR1 & USART_CR1_PS) != 0U) ? 1U : 0U)))
+  {
+    flags |= USART_SR_PE;
+  }
+
+  if (SIM_USART_Level(RxFrameStart + ((2U * (dataBits + 1U) + 1U) * RxFrameBit) / 2U) == 0U)
+  {
+    flags |= USART_SR_FE;
+  }
+
+  if ((USART2->SR & USART_SR_RXNE) != 0U)
+  {
+    /* The previous byte has not been read, this one is lost */
+    USART2->SR |= USART_SR_ORE;
+  }
+  else
+  {
+    Rdr         = data;
+    USART2->SR |= flags | USART_SR_RXNE;
+  }
+
+  SIM_USART_Changed();
+}
+
+static void SIM_USART_TxLoad(uint32_t Data)
+{
+  Shifting = 1;
+  Tdr      = Data;
+  SIM_Timer_Start(&TxTimer, SIM_Now + (SIM_USART_FrameBits() * SIM_CYCLES(1U, SIM_USART_GetBaudRate())));
+}
+
+/* End of the stop bit of a byte sent by the device */
+static void SIM_USART_TxEnd(SIM_TimeTypeDef When)
+{
+  uint32_t mask = 0xFFU;
+  uint32_t baudrate = SIM_USART_GetBaudRate();
+
+  if (((USART2->CR1 & USART_CR1_PCE) != 0U) && ((USART2->CR1 & USART_CR1_M) == 0U))
+  {
+    mask = 0x7FU;
+  }
+
+  SIM_IO_Send((uint8_t)(Tdr & mask));
+  SIM_Clock->TxBytes++;
+  SIM_Clock->TxEnd = When / 1000U;
+
+  if (baudrate != 0U)
+  {
+    SIM_Clock->TxLineTime += (SIM_USART_FrameBits() * SIM_CYCLES(1U, baudrate)) / 1000U;
+  }
+
+  Shifting = 0;
+
+  if (TdrFull != 0)
+  {
+    TdrFull     = 0;
+    USART2->SR |= USART_SR_TXE;
+    SIM_USART_TxLoad(TdrNext);
+  }
+  else
+  {
+    USART2->SR |= USART_SR_TC;
+  }
+
+  SIM_USART_Changed();
+}
+
+static void SIM_USART_Read(uint32_t Offset)
+{
+  if (Offset == 0x00U)
+  {
+    SrRead = 1;
+    SIM_IdlePoll(USART2_BASE, USART2->SR);
+  }
+  else if (Offset == 0x04U)
+  {
+    USART2->DR = SIM_USART_ReadData();
+  }
+  else
+  {
+    /* Plain register */
+  }
+}
+
+static void SIM_USART_Write(uint32_t Offset, uint32_t Old)
+{
+  uint32_t value = *(volatile uint32_t *)(uintptr_t)(USART2_BASE + Offset);
+
+  switch (Offset)
+  {
+    case 0x00U:
+      /* RXNE and TC are cleared by writing 0, the other flags are read only */
+      USART2->SR = Old & (value | ~(USART_SR_RXNE | USART_SR_TC));
+      break;
+
+    case 0x04U:
+      SIM_USART_WriteData(value);
+      break;
+
+    case 0x0CU:
+      if (((value & USART_CR1_UE) == 0U) && ((Old & USART_CR1_UE) != 0U))
+      {
+        /* Disabling the USART stops the ongoing transfers */
+        Receiving = 0;
+        Shifting  = 0;
+        TdrFull   = 0;
+        SIM_Timer_Stop(&RxTimer);
+        SIM_Timer_Stop(&TxTimer);
+        USART2->SR |= USART_SR_TXE | USART_SR_TC;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  SIM_USART_Changed();
+}
+
+static const SIM_DeviceTypeDef UsartDevice =
+{
+  USART2_BASE, 0x400U, SIM_USART_Read, SIM_USART_Write
+};
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Reset the USART, the line to the host keeps going.
+  * @retval None.
+  */
+void SIM_USART_Reset(void)
+{
+  memset((void *)(uintptr_t)USART2_BASE, 0, 0x400U);
+  USART2->SR = USART_SR_TXE | USART_SR_TC;
+
+  Receiving = 0;
+  SrRead    = 0;
+  Rdr       = 0U;
+  Tdr       = 0U;
+  TdrFull   = 0;
+  Shifting  = 0;
+  SIM_Timer_Stop(&RxTimer);
+  SIM_Timer_Stop(&TxTimer);
+
+  SIM_BUS_Register(&UsartDevice);
+  SIM_NVIC_SetLine(USART2_IRQn, SIM_USART_Level38);
+}
+
+/**
+  * @brief  Start sending the bytes of the host if the line is idle.
+  * @retval None.
+  */
+void SIM_USART_RxKick(void)
+{
+  if (LineBusy == 0)
+  {
+    SIM_USART_LineStart(SIM_Now);
+  }
+}
+
+/**
+  * @brief  Read the data register, by the core or the DMA.
+  *         A read following a read of the status register clears the error flags.
+  * @retval The received data.
+  */
+uint32_t SIM_USART_ReadData(void)
+{
+  if (SrRead != 0)
+  {
+    SrRead      = 0;
+    USART2->SR &= ~SIM_USART_SR_ERRORS;
+  }
+
+  USART2->SR &= ~USART_SR_RXNE;
+  SIM_NVIC_Update(USART2_IRQn);
+
+  return Rdr;
+}
+
+/**
+  * @brief  Write the data register, by the core or the DMA.
+  * @param  Data The data to send.
+  * @retval None.
+  */
+void SIM_USART_WriteData(uint32_t Data)
+{
+  if (((USART2->CR1 & (USART_CR1_UE | USART_CR1_TE)) != (USART_CR1_UE | USART_CR1_TE)) || (SIM_USART_GetBaudRate() == 0U))
+  {
+    SIM_Log("USART2 written while the transmitter is disabled, 0x%02x dropped", (unsigned int)Data);
+    return;
+  }
+
+  USART2->SR &= ~USART_SR_TC;
+
+  if (Shifting == 0)
+  {
+    SIM_USART_TxLoad(Data & 0x1FFU);
+  }
+  else
+  {
+    /* Overwrites the pending byte if the data register was not empty */
+    TdrNext     = Data & 0x1FFU;
+    TdrFull     = 1;
+    USART2->SR &= ~USART_SR_TXE;
+  }
+
+  SIM_USART_Changed();
+}
+
+/**
+  * @brief  Check if a host frame is on the line.
+  * @retval 1 if busy.
+  */
+int SIM_USART_RxBusy(void)
+{
+  return LineBusy;
+}
+
+/**
+  * @brief  Check if the device has sent everything.
+  * @retval 1 if idle.
+  */
+int SIM_USART_TxIdle(void)
+{
+  return (Shifting == 0) && (TdrFull == 0);
+}
+
+/**
+  * @brief  Check if the RX DMA request is asserted.
+  * @retval 1 if asserted.
+  */
+int SIM_USART_DmaRequestRx(void)
+{
+  return ((USART2->CR3 & USART_CR3_DMAR) != 0U) && ((USART2->SR & USART_SR_RXNE) != 0U);
+}
+
+/**
+  * @brief  Check if the TX DMA request is asserted.
+  * @retval 1 if asserted.
+  */
+int SIM_USART_DmaRequestTx(void)
+{
+  return ((USART2->CR3 & USART_CR3_DMAT) != 0U) && ((USART2->SR & USART_SR_TXE) != 0U)
+         && ((USART2->CR1 & (USART_CR1_UE | USART_CR1_TE)) == (USART_CR1_UE | USART_CR1_TE));
+}
+
+/**
+  * @brief  Get the baudrate of the USART from BRR and the current PCLK1.
+  * @retval The baudrate, 0 if the USART is disabled or BRR is not set.
+  */
+uint32_t SIM_USART_GetBaudRate(void)
+{
+  uint32_t brr = USART2->BRR & 0xFFFFU;
+  uint32_t divider = brr;
+
+  if ((USART2->CR1 & USART_CR1_OVER8) != 0U)
+  {
+    divider = ((brr >> 4) * 8U) + (brr & 0x7U);
+  }
+
+  if (((USART2->CR1 & USART_CR1_UE) == 0U) || (divider == 0U))
+  {
+    return 0U;
+  }
+
+  return SIM_RCC_GetPclk1() / divider;
+}
+
+/**
+  * @brief  Baudrate of the USART, used by the host in scripted mode.
+  * @retval The baudrate while the USART receives, 0 else.
+  */
+uint32_t SIM_USART_GetListeningBaudRate(void)
+{
+  return SIM_USART_IsListening() ? SIM_USART_GetBaudRate() : 0U;
+}
+
+/**
+  * @brief  Called on a change of PCLK1, the frames in progress keep their timing.
+  * @retval None.
+  */
+void SIM_USART_UpdateClock(void)
+{
+}
@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file    fuzz.h
+  * @brief   Entry points of the fuzz harnesses of Tests/.
+  *
+  *          A harness defines LLVMFuzzerTestOneInput() as a libFuzzer target
+  *          does, and FUZZ_Seed() for the valid inputs the standalone driver
+  *          fuzz_main.c starts from. The driver mutates them without coverage
+  *          feedback, the sanitizers and the checks of the harness are the
+  *          oracle. Built with clang -fsanitize=fuzzer instead of the driver,
+  *          the same harness runs under libFuzzer and FUZZ_Seed() is unused.
+  ******************************************************************************
+  */
+
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Exported macros -----------------------------------------------------------*/
+#define FUZZ_CHECK(condition)                                                   \
+  do                                                                            \
+  {                                                                             \
+    if (!(condition))                                                           \
+    {                                                                           \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      abort();                                                                  \
+    }                                                                           \
+  } while (0)
+
+/* Exported functions --------------------------------------------------------*/
+int LLVMFuzzerTestOneInput(const uint8_t *pData, size_t Size);
+size_t FUZZ_Seed(uint32_t Index, uint8_t *pData, size_t Capacity);
+
+#endif /* FUZZ_H */
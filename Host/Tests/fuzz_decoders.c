@@ -0,0 +1,244 @@
+/**
+  ******************************************************************************
+  * @file    fuzz_decoders.c
+  * @brief   Fuzz harness of the parsers of host data outside of the command
+  *          handlers: OPENBL_LZ4_DecompressBlock(), OPENBL_DELTA_Apply() and
+  *          OPENBL_MEM_CheckRange().
+  *
+  *          Input: a selector byte, then
+  *            0: destination capacity (2 bytes, MSB first) and an LZ4 block
+  *            1: destination capacity (2 bytes, MSB first) and a patch
+  *            2: pairs of address and length (4 bytes each, MSB first)
+  *          The destination is allocated to its exact capacity and the FLASH
+  *          the patches copy from is mapped at its device address, so any
+  *          access out of them is caught by the address sanitizer.
+  ******************************************************************************
+  */
+
+#include "openbl_lz4.c"
+#include "openbl_delta.c"
+#include "openbl_mem.c"
+#include "fuzz.h"
+#include "test.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define FUZZ_TARGET_LZ4               0U
+#define FUZZ_TARGET_DELTA             1U
+#define FUZZ_TARGET_RANGE             2U
+#define FUZZ_TARGETS                  3U
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t FUZZ_Read(uint32_t Address);
+
+/* Private variables ---------------------------------------------------------*/
+/* Memories of OpenBootloader_Init(), only their ranges matter here */
+static OPENBL_MemoryTypeDef Memories[] =
+{
+  { FLASH_START_ADDRESS, FLASH_END_ADDRESS, FLASH_BL_SIZE, FLASH_AREA, FUZZ_Read, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+  { RAM_START_ADDRESS + OPENBL_RAM_SIZE, RAM_END_ADDRESS, RAM_SIZE, RAM_AREA, FUZZ_Read, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+  { OB_START_ADDRESS, OB_END_ADDRESS, OB_SIZE, OB_AREA, FUZZ_Read, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+  { OTP_START_ADDRESS, OTP_END_ADDRESS, OTP_BL_SIZE, OTP_AREA, FUZZ_Read, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+  { ICP_START_ADDRESS, ICP_END_ADDRESS, ICP_SIZE, ICP_AREA, FUZZ_Read, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+  { ICP2_START_ADDRESS, ICP2_END_ADDRESS, ICP2_SIZE, ICP_AREA, FUZZ_Read, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+  { ICP3_START_ADDRESS, ICP3_END_ADDRESS, ICP3_SIZE, ICP_AREA, FUZZ_Read, NULL, NULL, NULL, NULL, NULL, NULL, NULL }
+};
+
+static const uint8_t Lz4Seed[] =
+{
+  0x1FU, 'a', 0x01U, 0x00U, 0x10U, 0x42U, 'O', 'p', 'e', 'n', 0x05U, 0x00U, 0x30U, 'B', 'L', '!'
+};
+
+static const uint8_t DeltaSeed[] =
+{
+  DELTA_OP_COPY, 0x08U, 0x00U, 0x40U, 0x00U, 0x00U, 0xFFU,
+  DELTA_OP_INSERT, 0x00U, 0x02U, 'a', 'b', 'c',
+  DELTA_OP_COPY, 0x08U, 0x07U, 0xFFU, 0x00U, 0x00U, 0xFFU
+};
+
+static const uint8_t RangeSeed[] =
+{
+  0x08U, 0x00U, 0x00U, 0x00U, 0x00U, 0x08U, 0x00U, 0x00U,
+  0x08U, 0x07U, 0xFFU, 0xFFU, 0x00U, 0x00U, 0x00U, 0x02U,
+  0x20U, 0x01U, 0x18U, 0x00U, 0x00U, 0x00U, 0xE8U, 0x00U,
+  0x1FU, 0xFFU, 0xC0U, 0x00U, 0xFFU, 0xFFU, 0xFFU, 0xFFU
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint8_t FUZZ_Read(uint32_t Address)
+{
+  return *(uint8_t *)(uintptr_t)Address;
+}
+
+static uint32_t FUZZ_Read32(const uint8_t *pData)
+{
+  return ((uint32_t)pData[0] << 24) | ((uint32_t)pData[1] << 16) | ((uint32_t)pData[2] << 8) | (uint32_t)pData[3];
+}
+
+static void FUZZ_Init(void)
+{
+  static int initialized = 0;
+  uint32_t index;
+
+  if (initialized == 0)
+  {
+    initialized = 1;
+    TEST_MapPeripherals();
+    TEST_MapMemories();
+
+    for (index = 0U; index < FLASH_BL_SIZE; index++)
+    {
+      *(uint8_t *)(uintptr_t)(FLASH_START_ADDRESS + index) = (uint8_t)((index * 2654435761U) >> 24);
+    }
+
+    for (index = 0U; index < (sizeof(Memories) / sizeof(Memories[0])); index++)
+    {
+      FUZZ_CHECK(OPENBL_MEM_RegisterMemory(&Memories[index]) == SUCCESS);
+    }
+  }
+}
+
+static void FUZZ_Lz4(uint8_t *pBlock, uint32_t Length, uint32_t Capacity)
+{
+  uint8_t *out = malloc((Capacity != 0U) ? Capacity : 1U);
+  uint32_t length = 0xFFFFFFFFU;
+
+  (void)OPENBL_LZ4_DecompressBlock(pBlock, Length, out, Capacity, &length);
+  FUZZ_CHECK(length <= Capacity);
+
+  free(out);
+}
+
+/* A successful patch only copies from the user FLASH and fills the output exactly */
+static void FUZZ_Delta(uint8_t *pPatch, uint32_t Length, uint32_t Capacity)
+{
+  uint8_t *out = malloc((Capacity != 0U) ? Capacity : 1U);
+  uint32_t length = 0xFFFFFFFFU;
+  uint32_t rebuilt = 0U;
+  uint32_t address;
+  uint32_t size;
+  uint32_t index = 0U;
+
+  if (OPENBL_DELTA_Apply(pPatch, Length, out, Capacity, &length) == SUCCESS)
+  {
+    while (index < Length)
+    {
+      if (pPatch[index] == DELTA_OP_COPY)
+      {
+        address = FUZZ_Read32(&pPatch[index + 1U]);
+        size    = (((uint32_t)pPatch[index + 5U] << 8) | (uint32_t)pPatch[index + 6U]) + 1U;
+        FUZZ_CHECK((address >= USERPROG_START_ADDRESS) && (size <= (FLASH_END_ADDRESS - address)));
+        FUZZ_CHECK(memcmp(&out[rebuilt], (uint8_t *)(uintptr_t)address, size) == 0);
+        index += 7U;
+      }
+      else
+      {
+        size   = (((uint32_t)pPatch[index + 1U] << 8) | (uint32_t)pPatch[index + 2U]) + 1U;
+        FUZZ_CHECK(memcmp(&out[rebuilt], &pPatch[index + 3U], size) == 0);
+        index += 3U + size;
+      }
+
+      rebuilt += size;
+    }
+
+    FUZZ_CHECK(rebuilt == length);
+  }
+
+  FUZZ_CHECK(length <= Capacity);
+
+  free(out);
+}
+
+/* The range is valid if it is not empty and lies in the readable memory of its start address */
+static void FUZZ_Range(uint32_t Address, uint32_t Length)
+{
+  const OPENBL_MemoryTypeDef *memory = NULL;
+  uint32_t index;
+  ErrorStatus expected = ERROR;
+
+  for (index = 0U; (index < (sizeof(Memories) / sizeof(Memories[0]))) && (memory == NULL); index++)
+  {
+    if ((Address >= Memories[index].StartAddress) && (Address < Memories[index].EndAddress))
+    {
+      memory = &Memories[index];
+    }
+  }
+
+  if ((memory != NULL) && (memory->Read != NULL) && (Length != 0U)
+      && (((uint64_t)Address + Length) <= memory->EndAddress))
+  {
+    expected = SUCCESS;
+  }
+
+  FUZZ_CHECK(OPENBL_MEM_CheckRange(Address, Length) == expected);
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+int LLVMFuzzerTestOneInput(const uint8_t *pData, size_t Size)
+{
+  uint8_t *data;
+  uint32_t capacity;
+  uint32_t index;
+
+  FUZZ_Init();
+
+  if (Size < 3U)
+  {
+    return 0;
+  }
+
+  /* A copy of the exact size, reads past the input are caught too */
+  data     = malloc(Size);
+  memcpy(data, pData, Size);
+  capacity = ((uint32_t)data[1] << 8) | (uint32_t)data[2];
+
+  switch (data[0] % FUZZ_TARGETS)
+  {
+    case FUZZ_TARGET_LZ4:
+      FUZZ_Lz4(&data[3], (uint32_t)(Size - 3U), capacity);
+      break;
+
+    case FUZZ_TARGET_DELTA:
+      FUZZ_Delta(&data[3], (uint32_t)(Size - 3U), capacity);
+      break;
+
+    default:
+      for (index = 1U; (index + 8U) <= Size; index += 8U)
+      {
+        FUZZ_Range(FUZZ_Read32(&data[index]), FUZZ_Read32(&data[index + 4U]));
+      }
+      break;
+  }
+
+  free(data);
+
+  return 0;
+}
+
+size_t FUZZ_Seed(uint32_t Index, uint8_t *pData, size_t Capacity)
+{
+  const uint8_t *seed;
+  size_t size;
+
+  switch (Index)
+  {
+    case FUZZ_TARGET_LZ4:   seed = Lz4Seed;   size = sizeof(Lz4Seed);   break;
+    case FUZZ_TARGET_DELTA: seed = DeltaSeed; size = sizeof(DeltaSeed); break;
+    case FUZZ_TARGET_RANGE: seed = RangeSeed; size = sizeof(RangeSeed); break;
+    default:                return 0U;
+  }
+
+  if ((size + 3U) > Capacity)
+  {
+    return 0U;
+  }
+
+  /* The range target has no capacity, its pairs start after the selector */
+  pData[0] = (uint8_t)Index;
+  pData[1] = 0x02U;
+  pData[2] = 0x00U;
+  memcpy(&pData[(Index == FUZZ_TARGET_RANGE) ? 1U : 3U], seed, size);
+
+  return size + ((Index == FUZZ_TARGET_RANGE) ? 1U : 3U);
+}
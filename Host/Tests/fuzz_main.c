@@ -0,0 +1,348 @@
+/**
+  ******************************************************************************
+  * @file    fuzz_main.c
+  * @brief   Standalone driver of the fuzz harnesses, for the hosts without
+  *          libFuzzer. It takes a subset of the libFuzzer options:
+  *
+  *          Usage: fuzz_xxx [-runs=N] [-seed=S] [-max_len=N] [-artifact_prefix=P] [FILE|DIR...]
+  *            -runs             mutated inputs to run after the seeds (100000)
+  *            -seed             seed of the mutations (1)
+  *            -max_len          maximum length of a mutated input (16384)
+  *            -artifact_prefix  prefix of the file saving the input of a crash
+  *          The seeds of the harness and the given files are run first, they
+  *          are then mutated. -runs=0 replays a saved crash input.
+  ******************************************************************************
+  */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sanitizer/common_interface_defs.h>
+#include "fuzz.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define FUZZ_POOL_SIZE                256U
+#define FUZZ_MAX_LENGTH               16384U
+#define FUZZ_MAX_MUTATIONS            4U
+
+/* Private types -------------------------------------------------------------*/
+typedef struct
+{
+  uint8_t *pData;
+  size_t Size;
+} FUZZ_InputTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static FUZZ_InputTypeDef Pool[FUZZ_POOL_SIZE];
+static uint32_t PoolSize = 0U;
+static uint32_t PoolSeeds = 0U;                         /* The first entries are never replaced */
+static uint64_t Random = 1U;
+static size_t MaxLength = FUZZ_MAX_LENGTH;
+static const char *ArtifactPrefix = "";
+static const char *Name = "fuzz";
+static const uint8_t *Current = NULL;
+static size_t CurrentSize = 0U;
+
+/* Values found at the boundaries of the lengths, addresses and opcodes of the protocol */
+static const uint32_t Interesting[] =
+{
+  0x00000000U, 0x00000001U, 0x0000007FU, 0x00000080U, 0x000000FFU, 0x00000100U, 0x00000FFFU, 0x00001000U,
+  0x00003FFFU, 0x00004000U, 0x0000FFFFU, 0x08000000U, 0x08004000U, 0x0807FFFFU, 0x08080000U, 0x1FFF7800U,
+  0x1FFFC000U, 0x20000000U, 0x20011800U, 0x2001FFFFU, 0x20020000U, 0x7FFFFFFFU, 0x80000000U, 0xFFFFFFFFU
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint32_t FUZZ_Random(uint32_t Max)
+{
+  Random ^= Random << 13;
+  Random ^= Random >> 7;
+  Random ^= Random << 17;
+
+  return (Max == 0U) ? 0U : (uint32_t)(Random % Max);
+}
+
+/* Death callback of the sanitizers: the input is kept to be replayed */
+static void FUZZ_SaveCrash(void)
+{
+  char path[512];
+  FILE *file;
+
+  if (Current == NULL)
+  {
+    return;
+  }
+
+  snprintf(path, sizeof(path), "%scrash-%s", ArtifactPrefix, Name);
+  file = fopen(path, "wb");
+
+  if (file != NULL)
+  {
+    (void)fwrite(Current, 1U, CurrentSize, file);
+    fclose(file);
+    fprintf(stderr, "%s: input of %zu bytes saved to %s\n", Name, CurrentSize, path);
+  }
+}
+
+static void FUZZ_Run(const uint8_t *pData, size_t Size)
+{
+  Current     = pData;
+  CurrentSize = Size;
+  (void)LLVMFuzzerTestOneInput(pData, Size);
+  Current     = NULL;
+}
+
+static void FUZZ_AddToPool(const uint8_t *pData, size_t Size)
+{
+  uint32_t index = PoolSize;
+
+  if (PoolSize == FUZZ_POOL_SIZE)
+  {
+    if (PoolSeeds == FUZZ_POOL_SIZE)
+    {
+      return;
+    }
+
+    index = PoolSeeds + FUZZ_Random(FUZZ_POOL_SIZE - PoolSeeds);
+    free(Pool[index].pData);
+  }
+  else
+  {
+    PoolSize++;
+  }
+
+  Pool[index].pData = malloc((Size != 0U) ? Size : 1U);
+  Pool[index].Size  = Size;
+  memcpy(Pool[index].pData, pData, Size);
+}
+
+static void FUZZ_RunFile(const char *Path)
+{
+  uint8_t *data;
+  long size;
+  FILE *file = fopen(Path, "rb");
+
+  if ((file == NULL) || (fseek(file, 0, SEEK_END) != 0) || ((size = ftell(file)) < 0))
+  {
+    fprintf(stderr, "%s: cannot read %s\n", Name, Path);
+    exit(EXIT_FAILURE);
+  }
+
+  rewind(file);
+  data = malloc((size_t)size + 1U);
+  size = (long)fread(data, 1U, (size_t)size, file);
+  fclose(file);
+
+  FUZZ_Run(data, (size_t)size);
+  FUZZ_AddToPool(data, (size_t)size);
+  free(data);
+}
+
+static void FUZZ_RunPath(const char *Path)
+{
+  struct dirent *entry;
+  struct stat status;
+  char path[1024];
+  DIR *directory;
+
+  if ((stat(Path, &status) == 0) && S_ISDIR(status.st_mode))
+  {
+    directory = opendir(Path);
+
+    while ((directory != NULL) && ((entry = readdir(directory)) != NULL))
+    {
+      if (entry->d_name[0] != '.')
+      {
+        snprintf(path, sizeof(path), "%s/%s", Path, entry->d_name);
+        FUZZ_RunFile(path);
+      }
+    }
+
+    if (directory != NULL)
+    {
+      closedir(directory);
+    }
+  }
+  else
+  {
+    FUZZ_RunFile(Path);
+  }
+}
+
+/* One mutation of the input, its size stays within MaxLength */
+static size_t FUZZ_Mutate(uint8_t *pData, size_t Size)
+{
+  const FUZZ_InputTypeDef *other;
+  uint32_t value;
+  size_t position = FUZZ_Random((uint32_t)Size);
+  size_t length;
+  size_t index;
+
+  switch (FUZZ_Random(8U))
+  {
+    case 0U:
+      if (Size != 0U)
+      {
+        pData[position] ^= (uint8_t)(1U << FUZZ_Random(8U));
+      }
+      break;
+
+    case 1U:
+      if (Size != 0U)
+      {
+        pData[position] = (uint8_t)FUZZ_Random(256U);
+      }
+      break;
+
+    case 2U:
+      /* A 1, 2 or 4 bytes field, MSB first as the protocol */
+      value  = Interesting[FUZZ_Random(sizeof(Interesting) / sizeof(Interesting[0]))];
+      value += FUZZ_Random(3U) - 1U;
+      length = 1U << FUZZ_Random(3U);
+
+      for (index = 0U; (index < length) && ((position + index) < Size); index++)
+      {
+        pData[position + index] = (uint8_t)(value >> (8U * (length - 1U - index)));
+      }
+      break;
+
+    case 3U:
+      /* Insert random bytes */
+      length = 1U + FUZZ_Random(16U);
+
+      if ((Size + length) <= MaxLength)
+      {
+        memmove(&pData[position + length], &pData[position], Size - position);
+
+        for (index = 0U; index < length; index++)
+        {
+          pData[position + index] = (uint8_t)FUZZ_Random(256U);
+        }
+
+        Size += length;
+      }
+      break;
+
+    case 4U:
+      /* Erase bytes */
+      length = 1U + FUZZ_Random(16U);
+      length = ((position + length) <= Size) ? length : (Size - position);
+      memmove(&pData[position], &pData[position + length], Size - position - length);
+      Size -= length;
+      break;
+
+    case 5U:
+      /* Copy a part of the input over another */
+      if (Size != 0U)
+      {
+        index  = FUZZ_Random((uint32_t)Size);
+        length = 1U + FUZZ_Random((uint32_t)(Size - ((index > position) ? index : position)));
+        memmove(&pData[position], &pData[index], length);
+      }
+      break;
+
+    case 6U:
+      /* Append a part of another input: the commands of the seeds are chained */
+      other  = &Pool[FUZZ_Random(PoolSize)];
+      index  = FUZZ_Random((uint32_t)other->Size);
+      length = other->Size - index;
+      length = ((Size + length) <= MaxLength) ? length : (MaxLength - Size);
+      memcpy(&pData[Size], &other->pData[index], length);
+      Size += length;
+      break;
+
+    default:
+      /* Truncate */
+      Size = position;
+      break;
+  }
+
+  return Size;
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+  uint8_t *data;
+  const FUZZ_InputTypeDef *input;
+  unsigned long runs = 100000UL;
+  unsigned long run;
+  uint32_t index;
+  uint32_t mutations;
+  size_t size;
+  int argument;
+
+  Name = strrchr(argv[0], '/');
+  Name = (Name != NULL) ? (Name + 1) : argv[0];
+
+  for (argument = 1; (argument < argc) && (argv[argument][0] == '-'); argument++)
+  {
+    if (strncmp(argv[argument], "-runs=", 6U) == 0)
+    {
+      runs = strtoul(&argv[argument][6], NULL, 0);
+    }
+    else if (strncmp(argv[argument], "-seed=", 6U) == 0)
+    {
+      Random = strtoull(&argv[argument][6], NULL, 0) | 1U;
+    }
+    else if (strncmp(argv[argument], "-max_len=", 9U) == 0)
+    {
+      MaxLength = strtoul(&argv[argument][9], NULL, 0);
+    }
+    else if (strncmp(argv[argument], "-artifact_prefix=", 17U) == 0)
+    {
+      ArtifactPrefix = &argv[argument][17];
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [-runs=N] [-seed=S] [-max_len=N] [-artifact_prefix=P] [FILE|DIR...]\n", Name);
+      return EXIT_FAILURE;
+    }
+  }
+
+  __sanitizer_set_death_callback(FUZZ_SaveCrash);
+  data = malloc(MaxLength + 1U);
+
+  /* The seeds of the harness, then the given inputs */
+  for (index = 0U; (size = FUZZ_Seed(index, data, MaxLength)) != 0U; index++)
+  {
+    FUZZ_Run(data, size);
+    FUZZ_AddToPool(data, size);
+  }
+
+  for (; argument < argc; argument++)
+  {
+    FUZZ_RunPath(argv[argument]);
+  }
+
+  PoolSeeds = PoolSize;
+
+  for (run = 0UL; (run < runs) && (PoolSize != 0U); run++)
+  {
+    input = &Pool[FUZZ_Random(PoolSize)];
+    size  = (input->Size <= MaxLength) ? input->Size : MaxLength;
+    memcpy(data, input->pData, size);
+
+    for (mutations = 1U + FUZZ_Random(FUZZ_MAX_MUTATIONS); mutations != 0U; mutations--)
+    {
+      size = FUZZ_Mutate(data, size);
+    }
+
+    FUZZ_Run(data, size);
+
+    /* Without coverage, some mutants are kept at random to reach deeper states */
+    if (FUZZ_Random(16U) == 0U)
+    {
+      FUZZ_AddToPool(data, size);
+    }
+  }
+
+  printf("%s: %u seeds and %lu mutated inputs, no failure\n", Name, (unsigned int)PoolSeeds, run);
+
+  free(data);
+
+  return EXIT_SUCCESS;
+}
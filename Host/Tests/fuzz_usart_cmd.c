@@ -0,0 +1,801 @@
+/**
+  ******************************************************************************
+  * @file    fuzz_usart_cmd.c
+  * @brief   Fuzz harness of the USART command handlers of openbl_usart_cmd.c
+  *          and of the memory layer openbl_mem.c, driven by OPENBL_CommandProcess().
+  *
+  *          The input is the byte stream of the host. The harness plays the
+  *          USART interface, OPENBL_USART_ReadByte() taking the next input byte,
+  *          and the FLASH interface over FLASH, system memory and RAM mapped at
+  *          their device addresses. The RAM interface is the firmware one.
+  *          A session ends when the input is exhausted or the device resets.
+  *          Every write, erase or blank check reaching a memory must lie in it,
+  *          the memory layer is expected to have refused the others.
+  *          The FLASH and the RAM are reset for each input, the statistics of
+  *          the command module are kept as on a device that is never reset.
+  ******************************************************************************
+  */
+
+#include <setjmp.h>
+#include "main.h"
+
+/* The harness plays the reset and the debug unit, their registers are in the range of the address sanitizer */
+#undef NVIC_SystemReset
+#define NVIC_SystemReset()            FUZZ_SystemReset()
+#undef DBGMCU
+#define DBGMCU                        (&FUZZ_Dbgmcu)
+
+static void FUZZ_SystemReset(void);
+static DBGMCU_TypeDef FUZZ_Dbgmcu = { 0x10006421U, 0U, 0U, 0U };
+
+#include "openbl_core.c"
+#include "openbl_mem.c"
+#include "openbl_lz4.c"
+#include "openbl_delta.c"
+#include "openbl_usart_cmd.c"
+#include "ram_interface.c"
+#include "fuzz.h"
+#include "test.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define FUZZ_SECTORS                  8U
+#define FUZZ_USER_SECTOR              1U        /* First sector of the application, at USERPROG_START_ADDRESS */
+#define FUZZ_CRC_POLYNOMIAL           0x04C11DB7U
+#define FUZZ_CRC_INIT                 0xFFFFFFFFU
+#define FUZZ_SEED_SIZE                8192U
+
+/* Private types -------------------------------------------------------------*/
+typedef struct
+{
+  uint8_t *pData;
+  size_t Size;
+} FUZZ_BufferTypeDef;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t FUZZ_OB_Read(uint32_t Address);
+static ErrorStatus FUZZ_OB_Write(uint32_t Address, uint8_t *pData, uint32_t DataLength);
+static uint8_t FUZZ_OTP_Read(uint32_t Address);
+static ErrorStatus FUZZ_OTP_Write(uint32_t Address, uint8_t *pData, uint32_t DataLength);
+static uint8_t FUZZ_ICP_Read(uint32_t Address);
+
+/* Exported variables --------------------------------------------------------*/
+/* Memories of the FLASH, option bytes, OTP and system memory interfaces */
+OPENBL_MemoryTypeDef FLASH_Descriptor =
+{
+  FLASH_START_ADDRESS, FLASH_END_ADDRESS, FLASH_BL_SIZE, FLASH_AREA, OPENBL_FLASH_Read, OPENBL_FLASH_Write,
+  OPENBL_FLASH_SetReadOutProtectionLevel, OPENBL_FLASH_SetWriteProtection, OPENBL_FLASH_JumpToAddress, NULL,
+  OPENBL_FLASH_Erase, OPENBL_FLASH_BlankCheck
+};
+
+OPENBL_MemoryTypeDef OB_Descriptor =
+{
+  OB_START_ADDRESS, OB_END_ADDRESS, OB_SIZE, OB_AREA, FUZZ_OB_Read, FUZZ_OB_Write, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+OPENBL_MemoryTypeDef OTP_Descriptor =
+{
+  OTP_START_ADDRESS, OTP_END_ADDRESS, OTP_BL_SIZE, OTP_AREA, FUZZ_OTP_Read, FUZZ_OTP_Write, NULL, NULL, NULL, NULL,
+  NULL, NULL
+};
+
+OPENBL_MemoryTypeDef ICP1_Descriptor =
+{
+  ICP_START_ADDRESS, ICP_END_ADDRESS, ICP_SIZE, ICP_AREA, FUZZ_ICP_Read, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+OPENBL_MemoryTypeDef ICP2_Descriptor =
+{
+  ICP2_START_ADDRESS, ICP2_END_ADDRESS, ICP2_SIZE, ICP_AREA, FUZZ_ICP_Read, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+OPENBL_MemoryTypeDef ICP3_Descriptor =
+{
+  ICP3_START_ADDRESS, ICP3_END_ADDRESS, ICP3_SIZE, ICP_AREA, FUZZ_ICP_Read, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+/* Private variables ---------------------------------------------------------*/
+static const uint32_t SectorSizes[FUZZ_SECTORS] =
+{
+  0x4000U, 0x4000U, 0x4000U, 0x4000U, 0x10000U, 0x20000U, 0x20000U, 0x20000U
+};
+
+static const uint8_t *Input = NULL;
+static size_t InputSize = 0U;
+static size_t InputIndex = 0U;
+static jmp_buf SessionEnd;
+static uint32_t Crc = FUZZ_CRC_INIT;
+static uint32_t BaudRate = 115200U;
+static uint32_t ProgrammedWords = 0U;
+
+static OPENBL_OpsTypeDef FuzzOps;
+static OPENBL_HandleTypeDef FuzzHandle;
+
+/* Private functions ---------------------------------------------------------*/
+
+/* The access of an interface must lie in its memory */
+static void FUZZ_CheckAccess(const OPENBL_MemoryTypeDef *pMemory, uint32_t Address, uint32_t Length)
+{
+  FUZZ_CHECK((Address >= pMemory->StartAddress) && (Address < pMemory->EndAddress));
+  FUZZ_CHECK(Length <= (pMemory->EndAddress - Address));
+}
+
+static void FUZZ_SystemReset(void)
+{
+  longjmp(SessionEnd, 1);
+}
+
+static uint8_t FUZZ_GetCommandOpcode(void)
+{
+  uint8_t opcode = OPENBL_USART_ReadByte();
+
+  return ((opcode ^ OPENBL_USART_ReadByte()) == 0xFFU) ? opcode : ERROR_COMMAND;
+}
+
+static uint8_t FUZZ_Detection(void)
+{
+  return 1U;
+}
+
+static void FUZZ_EraseSector(uint32_t Sector)
+{
+  uint32_t address;
+  uint32_t size;
+
+  (void)OPENBL_FLASH_GetSectorInfo(Sector, &address, &size);
+  memset((void *)(uintptr_t)address, 0xFF, size);
+}
+
+static uint8_t FUZZ_OB_Read(uint32_t Address)
+{
+  FUZZ_CheckAccess(&OB_Descriptor, Address, 1U);
+
+  return *(uint8_t *)(uintptr_t)Address;
+}
+
+static ErrorStatus FUZZ_OB_Write(uint32_t Address, uint8_t *pData, uint32_t DataLength)
+{
+  FUZZ_CheckAccess(&OB_Descriptor, Address, DataLength);
+  memcpy((void *)(uintptr_t)Address, pData, DataLength);
+
+  return SUCCESS;
+}
+
+static uint8_t FUZZ_OTP_Read(uint32_t Address)
+{
+  FUZZ_CheckAccess(&OTP_Descriptor, Address, 1U);
+
+  return *(uint8_t *)(uintptr_t)Address;
+}
+
+/* OTP bits are only cleared */
+static ErrorStatus FUZZ_OTP_Write(uint32_t Address, uint8_t *pData, uint32_t DataLength)
+{
+  uint32_t index;
+
+  FUZZ_CheckAccess(&OTP_Descriptor, Address, DataLength);
+
+  for (index = 0U; index < DataLength; index++)
+  {
+    *(uint8_t *)(uintptr_t)(Address + index) &= pData[index];
+  }
+
+  return SUCCESS;
+}
+
+static uint8_t FUZZ_ICP_Read(uint32_t Address)
+{
+  FUZZ_CHECK(((Address >= ICP_START_ADDRESS) && (Address < ICP_END_ADDRESS))
+             || ((Address >= ICP2_START_ADDRESS) && (Address < ICP2_END_ADDRESS)));
+
+  return *(uint8_t *)(uintptr_t)Address;
+}
+
+/* Host byte stream builders of the seeds */
+static void FUZZ_Append(FUZZ_BufferTypeDef *pBuffer, const uint8_t *pData, size_t Length)
+{
+  memcpy(&pBuffer->pData[pBuffer->Size], pData, Length);
+  pBuffer->Size += Length;
+}
+
+static void FUZZ_AppendByte(FUZZ_BufferTypeDef *pBuffer, uint8_t Byte)
+{
+  FUZZ_Append(pBuffer, &Byte, 1U);
+}
+
+static void FUZZ_AppendCommand(FUZZ_BufferTypeDef *pBuffer, uint8_t Opcode)
+{
+  FUZZ_AppendByte(pBuffer, Opcode);
+  FUZZ_AppendByte(pBuffer, (uint8_t)~Opcode);
+}
+
+/* A 4 bytes value MSB first and, if Checksum, the XOR of its bytes */
+static void FUZZ_AppendWord(FUZZ_BufferTypeDef *pBuffer, uint32_t Word, int Checksum)
+{
+  FUZZ_AppendByte(pBuffer, (uint8_t)(Word >> 24));
+  FUZZ_AppendByte(pBuffer, (uint8_t)(Word >> 16));
+  FUZZ_AppendByte(pBuffer, (uint8_t)(Word >> 8));
+  FUZZ_AppendByte(pBuffer, (uint8_t)Word);
+
+  if (Checksum != 0)
+  {
+    FUZZ_AppendByte(pBuffer, (uint8_t)((Word >> 24) ^ (Word >> 16) ^ (Word >> 8) ^ Word));
+  }
+}
+
+static void FUZZ_AppendCrc(FUZZ_BufferTypeDef *pBuffer, uint8_t *pData, uint32_t Length)
+{
+  FUZZ_AppendWord(pBuffer, OPENBL_CRC_Calculate(pData, Length), 0);
+}
+
+/* One session per seed, each command with valid fields */
+static void FUZZ_BuildSeed(uint32_t Index, FUZZ_BufferTypeDef *pBuffer)
+{
+  /* 36 bytes 0xA5: a literal, a match of 30 bytes and the 5 final literals */
+  static const uint8_t lz4[] = { 0x1FU, 0xA5U, 0x01U, 0x00U, 0x0BU, 0x50U, 0xA5U, 0xA5U, 0xA5U, 0xA5U, 0xA5U };
+  uint8_t data[256];
+  uint8_t patch[16];
+  uint32_t index;
+
+  for (index = 0U; index < sizeof(data); index++)
+  {
+    data[index] = (uint8_t)(index * 7U);
+  }
+
+  switch (Index)
+  {
+    case 0U:
+      FUZZ_AppendCommand(pBuffer, CMD_GET_COMMAND);
+      FUZZ_AppendCommand(pBuffer, CMD_GET_VERSION);
+      FUZZ_AppendCommand(pBuffer, CMD_GET_ID);
+      FUZZ_AppendCommand(pBuffer, CMD_GET_STATISTICS);
+      FUZZ_AppendCommand(pBuffer, CMD_SPEED);
+      FUZZ_AppendWord(pBuffer, 2000000U, 1);
+      FUZZ_AppendByte(pBuffer, OPENBL_USART_SYNC_BYTE);
+      break;
+
+    case 1U:
+      /* Legacy write and read of the user RAM and of the FLASH */
+      FUZZ_AppendCommand(pBuffer, CMD_WRITE_MEMORY);
+      FUZZ_AppendWord(pBuffer, RAM_START_ADDRESS + OPENBL_RAM_SIZE, 1);
+      FUZZ_AppendByte(pBuffer, 0x0FU);
+      FUZZ_Append(pBuffer, data, 16U);
+      FUZZ_AppendByte(pBuffer, (uint8_t)(0x0FU ^ 0x00U ^ 0x07U ^ 0x0EU ^ 0x15U ^ 0x1CU ^ 0x23U ^ 0x2AU ^ 0x31U
+                                         ^ 0x38U ^ 0x3FU ^ 0x46U ^ 0x4DU ^ 0x54U ^ 0x5BU ^ 0x62U ^ 0x69U));
+      /* The last bytes of the RAM, from an unaligned address */
+      FUZZ_AppendCommand(pBuffer, CMD_WRITE_MEMORY);
+      FUZZ_AppendWord(pBuffer, RAM_END_ADDRESS - 3U, 1);
+      FUZZ_AppendByte(pBuffer, 0x02U);
+      FUZZ_Append(pBuffer, data, 3U);
+      FUZZ_AppendByte(pBuffer, (uint8_t)(0x02U ^ 0x00U ^ 0x07U ^ 0x0EU));
+      FUZZ_AppendCommand(pBuffer, CMD_READ_MEMORY);
+      FUZZ_AppendWord(pBuffer, FLASH_START_ADDRESS, 1);
+      FUZZ_AppendByte(pBuffer, 0xFFU);
+      FUZZ_AppendByte(pBuffer, 0x00U);
+      FUZZ_AppendCommand(pBuffer, CMD_READ_MEMORY);
+      FUZZ_AppendWord(pBuffer, OTP_START_ADDRESS, 1);
+      FUZZ_AppendByte(pBuffer, 0x0FU);
+      FUZZ_AppendByte(pBuffer, 0xF0U);
+      break;
+
+    case 2U:
+      /* Erase the application then write and check it */
+      FUZZ_AppendCommand(pBuffer, CMD_EXT_ERASE_MEMORY);
+      FUZZ_AppendByte(pBuffer, 0xFFU);
+      FUZZ_AppendByte(pBuffer, 0xFAU);
+      FUZZ_AppendByte(pBuffer, 0x05U);
+      FUZZ_AppendWord(pBuffer, 0x8000U, 1);
+      FUZZ_AppendCommand(pBuffer, CMD_EXT_WRITE_MEMORY);
+      FUZZ_AppendWord(pBuffer, USERPROG_START_ADDRESS, 1);
+      FUZZ_AppendByte(pBuffer, 0x00U);
+      FUZZ_AppendByte(pBuffer, 0xFFU);
+      FUZZ_Append(pBuffer, data, 256U);
+      FUZZ_AppendCrc(pBuffer, data, 256U);
+      FUZZ_AppendCommand(pBuffer, CMD_CHECKSUM);
+      FUZZ_AppendWord(pBuffer, USERPROG_START_ADDRESS, 1);
+      FUZZ_AppendWord(pBuffer, 256U, 1);
+      FUZZ_AppendCommand(pBuffer, CMD_BLANK_CHECK);
+      FUZZ_AppendWord(pBuffer, USERPROG_START_ADDRESS + 256U, 1);
+      FUZZ_AppendWord(pBuffer, 0x3F00U, 1);
+      FUZZ_AppendCommand(pBuffer, CMD_EXT_READ_MEMORY);
+      FUZZ_AppendWord(pBuffer, USERPROG_START_ADDRESS, 1);
+      FUZZ_AppendByte(pBuffer, 0x1FU);
+      FUZZ_AppendByte(pBuffer, 0xFFU);
+      FUZZ_AppendByte(pBuffer, 0x01U);
+      FUZZ_AppendByte(pBuffer, 0x1FU ^ 0xFFU ^ 0x01U);
+      FUZZ_AppendCommand(pBuffer, CMD_SECTORS_CHECKSUM);
+      break;
+
+    case 3U:
+      /* Erase of a sector list, then compressed and delta writes */
+      FUZZ_AppendCommand(pBuffer, CMD_EXT_ERASE_MEMORY);
+      FUZZ_AppendByte(pBuffer, 0x00U);
+      FUZZ_AppendByte(pBuffer, 0x01U);
+      FUZZ_AppendByte(pBuffer, 0x00U);
+      FUZZ_AppendByte(pBuffer, 0x01U);
+      FUZZ_AppendByte(pBuffer, 0x00U);
+      FUZZ_AppendByte(pBuffer, 0x02U);
+      FUZZ_AppendByte(pBuffer, 0x01U ^ 0x01U ^ 0x02U);
+      FUZZ_AppendCommand(pBuffer, CMD_COMPRESSED_WRITE_MEMORY);
+      FUZZ_AppendWord(pBuffer, USERPROG_START_ADDRESS, 1);
+      FUZZ_AppendByte(pBuffer, 0x00U);
+      FUZZ_AppendByte(pBuffer, sizeof(lz4) - 1U);
+      FUZZ_AppendByte(pBuffer, 0x00U);
+      FUZZ_AppendByte(pBuffer, 0x23U);
+      FUZZ_AppendByte(pBuffer, (uint8_t)((sizeof(lz4) - 1U) ^ 0x23U));
+      FUZZ_Append(pBuffer, lz4, sizeof(lz4));
+      memset(data, 0xA5, 36U);
+      FUZZ_AppendCrc(pBuffer, data, 36U);
+      patch[0] = DELTA_OP_COPY;
+      patch[1] = 0x08U;
+      patch[2] = 0x00U;
+      patch[3] = 0x40U;
+      patch[4] = 0x00U;
+      patch[5] = 0x00U;
+      patch[6] = 0x1FU;
+      patch[7] = DELTA_OP_INSERT;
+      patch[8] = 0x00U;
+      patch[9] = 0x03U;
+      memcpy(&patch[10], "OBL!", 4U);
+      memcpy(&data[32], "OBL!", 4U);
+      FUZZ_AppendCommand(pBuffer, CMD_DELTA_WRITE_MEMORY);
+      FUZZ_AppendWord(pBuffer, USERPROG_START_ADDRESS + 0x100U, 1);
+      FUZZ_AppendByte(pBuffer, 0x00U);
+      FUZZ_AppendByte(pBuffer, 13U);
+      FUZZ_AppendByte(pBuffer, 0x00U);
+      FUZZ_AppendByte(pBuffer, 35U);
+      FUZZ_AppendByte(pBuffer, 0x00U);
+      FUZZ_AppendByte(pBuffer, 13U ^ 35U);
+      FUZZ_Append(pBuffer, patch, 14U);
+      FUZZ_AppendCrc(pBuffer, data, 36U);
+      break;
+
+    case 4U:
+      /* Protections, automatic erase, then Go */
+      FUZZ_AppendCommand(pBuffer, CMD_WRITE_PROTECT);
+      FUZZ_AppendByte(pBuffer, 0x01U);
+      FUZZ_AppendByte(pBuffer, 0x01U);
+      FUZZ_AppendByte(pBuffer, 0x02U);
+      FUZZ_AppendByte(pBuffer, 0x01U ^ 0x01U ^ 0x02U);
+      FUZZ_AppendCommand(pBuffer, CMD_WRITE_UNPROTECT);
+      FUZZ_AppendCommand(pBuffer, CMD_EXT_ERASE_MEMORY);
+      FUZZ_AppendByte(pBuffer, 0xFFU);
+      FUZZ_AppendByte(pBuffer, 0xFCU);
+      FUZZ_AppendByte(pBuffer, 0x03U);
+      FUZZ_AppendCommand(pBuffer, CMD_EXT_ERASE_MEMORY);
+      FUZZ_AppendByte(pBuffer, 0xFFU);
+      FUZZ_AppendByte(pBuffer, 0xFBU);
+      FUZZ_AppendByte(pBuffer, 0x04U);
+      FUZZ_AppendCommand(pBuffer, CMD_GO);
+      FUZZ_AppendWord(pBuffer, USERPROG_START_ADDRESS, 1);
+      break;
+
+    case 5U:
+      /* The special commands are not enabled, they are refused */
+      FUZZ_AppendCommand(pBuffer, CMD_SPECIAL_COMMAND);
+      FUZZ_AppendCommand(pBuffer, CMD_READ_UNPROTECT);
+      break;
+
+    case 6U:
+      FUZZ_AppendCommand(pBuffer, CMD_READ_PROTECT);
+      break;
+
+    default:
+      break;
+  }
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/* USART interface, the host bytes are the input ------------------------------*/
+uint8_t OPENBL_USART_ReadByte(void)
+{
+  if (InputIndex == InputSize)
+  {
+    longjmp(SessionEnd, 1);
+  }
+
+  return Input[InputIndex++];
+}
+
+ErrorStatus OPENBL_USART_ReadByteTimeout(uint8_t *pByte, uint32_t Timeout)
+{
+  (void)Timeout;
+
+  if (InputIndex == InputSize)
+  {
+    return ERROR;
+  }
+
+  *pByte = Input[InputIndex++];
+
+  return SUCCESS;
+}
+
+void OPENBL_USART_ReadBuffer(uint8_t *pData, uint32_t Length)
+{
+  while (Length-- != 0U)
+  {
+    *pData++ = OPENBL_USART_ReadByte();
+  }
+}
+
+void OPENBL_USART_SendByte(uint8_t Byte)
+{
+  (void)Byte;
+}
+
+void OPENBL_USART_SendNack(void)
+{
+  OPENBL_USART_SendByte(NACK_BYTE);
+}
+
+void OPENBL_USART_SendBuffer(uint8_t *pData, uint32_t Length)
+{
+  volatile uint8_t sum = 0U;
+
+  /* The bytes are read as the TX DMA does */
+  while (Length-- != 0U)
+  {
+    sum += *pData++;
+  }
+}
+
+void OPENBL_USART_WaitTransmitComplete(void)
+{
+}
+
+ErrorStatus OPENBL_USART_CheckBaudRate(uint32_t Rate)
+{
+  return ((Rate >= 1200U) && (Rate <= 5250000U)) ? SUCCESS : ERROR;
+}
+
+ErrorStatus OPENBL_USART_SetBaudRate(uint32_t Rate)
+{
+  BaudRate = Rate;
+
+  return SUCCESS;
+}
+
+uint32_t OPENBL_USART_GetBaudRate(void)
+{
+  return BaudRate;
+}
+
+uint32_t OPENBL_USART_GetRxCount(void)
+{
+  return (uint32_t)(InputSize - InputIndex);
+}
+
+void OPENBL_USART_GetLinkStatistics(OPENBL_USART_LinkStatisticsTypeDef *pStatistics)
+{
+  memset(pStatistics, 0, sizeof(*pStatistics));
+}
+
+uint32_t OPENBL_USART_GetNackCount(uint8_t Opcode)
+{
+  return Opcode;
+}
+
+void OPENBL_USART_SpecialCommandProcess(OPENBL_SpecialCmdTypeDef *SpecialCmd)
+{
+  (void)SpecialCmd;
+}
+
+/* FLASH interface -----------------------------------------------------------*/
+uint8_t OPENBL_FLASH_Read(uint32_t Address)
+{
+  FUZZ_CheckAccess(&FLASH_Descriptor, Address, 1U);
+
+  return *(uint8_t *)(uintptr_t)Address;
+}
+
+/* FLASH bits are only cleared by programming */
+ErrorStatus OPENBL_FLASH_Write(uint32_t Address, uint8_t *Data, uint32_t DataLength)
+{
+  uint32_t index;
+
+  FUZZ_CheckAccess(&FLASH_Descriptor, Address, DataLength);
+
+  for (index = 0U; index < DataLength; index++)
+  {
+    *(uint8_t *)(uintptr_t)(Address + index) &= Data[index];
+  }
+
+  ProgrammedWords += (DataLength + 3U) / 4U;
+
+  return SUCCESS;
+}
+
+void OPENBL_FLASH_SetReadOutProtectionLevel(uint32_t Level)
+{
+  /* The option bytes are launched, the device resets */
+  (void)Level;
+  FUZZ_SystemReset();
+}
+
+ErrorStatus OPENBL_FLASH_SetWriteProtection(FunctionalState State, uint8_t *ListOfPages, uint32_t Length)
+{
+  FUZZ_CHECK((State == DISABLE) || (Length <= USART_RAM_BUFFER_SIZE));
+  FUZZ_CHECK((State == DISABLE) || (ListOfPages != NULL));
+
+  return SUCCESS;
+}
+
+void OPENBL_FLASH_JumpToAddress(uint32_t Address)
+{
+  FUZZ_CheckAccess(&FLASH_Descriptor, Address, 8U);
+  FUZZ_SystemReset();
+}
+
+/* Number of sectors (2 bytes, LSB first) then the sectors, 2 bytes each */
+ErrorStatus OPENBL_FLASH_Erase(uint8_t *p_Data, uint32_t DataLength)
+{
+  uint32_t count = (uint32_t)p_Data[0] | ((uint32_t)p_Data[1] << 8);
+  uint32_t sector;
+  uint32_t index;
+
+  FUZZ_CHECK((2U + (2U * count)) <= DataLength);
+
+  for (index = 0U; index < count; index++)
+  {
+    sector = (uint32_t)p_Data[2U + (2U * index)] | ((uint32_t)p_Data[3U + (2U * index)] << 8);
+
+    if (sector >= FUZZ_SECTORS)
+    {
+      return ERROR;
+    }
+
+    FUZZ_EraseSector(sector);
+  }
+
+  return SUCCESS;
+}
+
+ErrorStatus OPENBL_FLASH_BlankCheck(uint32_t Address, uint32_t Length)
+{
+  uint32_t index;
+
+  FUZZ_CheckAccess(&FLASH_Descriptor, Address, Length);
+
+  for (index = 0U; index < Length; index++)
+  {
+    if (*(uint8_t *)(uintptr_t)(Address + index) != 0xFFU)
+    {
+      return ERROR;
+    }
+  }
+
+  return SUCCESS;
+}
+
+uint32_t OPENBL_FLASH_GetSectorsNumber(void)
+{
+  return FUZZ_SECTORS;
+}
+
+ErrorStatus OPENBL_FLASH_GetSectorInfo(uint32_t Sector, uint32_t *pAddress, uint32_t *pSize)
+{
+  uint32_t address = FLASH_START_ADDRESS;
+  uint32_t index;
+
+  if (Sector >= FUZZ_SECTORS)
+  {
+    return ERROR;
+  }
+
+  for (index = 0U; index < Sector; index++)
+  {
+    address += SectorSizes[index];
+  }
+
+  *pAddress = address;
+  *pSize    = SectorSizes[Sector];
+
+  return SUCCESS;
+}
+
+ErrorStatus OPENBL_FLASH_GetSectorFromAddress(uint32_t Address, uint32_t *pSector)
+{
+  uint32_t address = FLASH_START_ADDRESS;
+  uint32_t sector;
+
+  for (sector = 0U; sector < FUZZ_SECTORS; sector++)
+  {
+    if ((Address >= address) && (Address < (address + SectorSizes[sector])))
+    {
+      *pSector = sector;
+
+      return SUCCESS;
+    }
+
+    address += SectorSizes[sector];
+  }
+
+  return ERROR;
+}
+
+ErrorStatus OPENBL_FLASH_EraseSector(uint32_t Sector)
+{
+  FUZZ_CHECK(Sector < FUZZ_SECTORS);
+  FUZZ_EraseSector(Sector);
+
+  return SUCCESS;
+}
+
+/* The user sectors holding Size bytes, or all of them if Size is 0 */
+ErrorStatus OPENBL_FLASH_EraseApplication(uint32_t Size)
+{
+  uint32_t sector;
+  uint32_t erased = 0U;
+
+  if (Size > (FLASH_END_ADDRESS - USERPROG_START_ADDRESS))
+  {
+    return ERROR;
+  }
+
+  for (sector = FUZZ_USER_SECTOR; (sector < FUZZ_SECTORS) && ((Size == 0U) || (erased < Size)); sector++)
+  {
+    FUZZ_EraseSector(sector);
+    erased += SectorSizes[sector];
+  }
+
+  return SUCCESS;
+}
+
+ErrorStatus OPENBL_FLASH_WaitForErase(void)
+{
+  return SUCCESS;
+}
+
+void OPENBL_FLASH_SetAutoErase(FunctionalState State)
+{
+  (void)State;
+}
+
+void OPENBL_FLASH_GetWriteStatistics(uint32_t *pProgrammedWords, uint32_t *pSkippedWords)
+{
+  *pProgrammedWords = ProgrammedWords;
+  *pSkippedWords    = 0U;
+}
+
+uint32_t OPENBL_FLASH_GetEraseErrors(void)
+{
+  return 0U;
+}
+
+void OPENBL_Enable_BusyState_Flag(void)
+{
+}
+
+void OPENBL_Disable_BusyState_Flag(void)
+{
+}
+
+/* CRC interface, CRC-32/MPEG-2 of little endian words padded with 0xFF as the CRC unit ---*/
+void OPENBL_CRC_Reset(void)
+{
+  Crc = FUZZ_CRC_INIT;
+}
+
+uint32_t OPENBL_CRC_Accumulate(uint8_t *pData, uint32_t Length)
+{
+  uint32_t word;
+  uint32_t index;
+  uint32_t bit;
+
+  for (index = 0U; index < Length; index += 4U)
+  {
+    word = 0xFFFFFFFFU;
+
+    for (bit = 0U; (bit < 4U) && ((index + bit) < Length); bit++)
+    {
+      word &= ~((uint32_t)0xFFU << (bit * 8U));
+      word |= (uint32_t)pData[index + bit] << (bit * 8U);
+    }
+
+    Crc ^= word;
+
+    for (bit = 0U; bit < 32U; bit++)
+    {
+      Crc = ((Crc & 0x80000000U) != 0U) ? ((Crc << 1) ^ FUZZ_CRC_POLYNOMIAL) : (Crc << 1);
+    }
+  }
+
+  return Crc;
+}
+
+uint32_t OPENBL_CRC_Calculate(uint8_t *pData, uint32_t Length)
+{
+  OPENBL_CRC_Reset();
+
+  return OPENBL_CRC_Accumulate(pData, Length);
+}
+
+/* Common interface ----------------------------------------------------------*/
+FlagStatus Common_GetProtectionStatus(void)
+{
+  return RESET;
+}
+
+void Common_StartPostProcessing(uint32_t Address)
+{
+  (void)Address;
+}
+
+void Common_EnableIrq(void)
+{
+}
+
+void Common_SetMsp(uint32_t TopOfMainStack)
+{
+  (void)TopOfMainStack;
+}
+
+void OpenBootloader_DeInit(void)
+{
+}
+
+/* Harness -------------------------------------------------------------------*/
+int LLVMFuzzerTestOneInput(const uint8_t *pData, size_t Size)
+{
+  static int initialized = 0;
+
+  if (initialized == 0)
+  {
+    initialized = 1;
+    TEST_MapPeripherals();
+    TEST_MapMemories();
+
+    FuzzOps.Detection        = FUZZ_Detection;
+    FuzzOps.GetCommandOpcode = FUZZ_GetCommandOpcode;
+    FuzzOps.SendByte         = OPENBL_USART_SendByte;
+    FuzzHandle.p_Ops         = &FuzzOps;
+    FuzzHandle.p_Cmd         = OPENBL_USART_GetCommandsList();
+
+    FUZZ_CHECK(OPENBL_RegisterInterface(&FuzzHandle) == SUCCESS);
+    FUZZ_CHECK(OPENBL_MEM_RegisterMemory(&FLASH_Descriptor) == SUCCESS);
+    FUZZ_CHECK(OPENBL_MEM_RegisterMemory(&RAM_Descriptor) == SUCCESS);
+    FUZZ_CHECK(OPENBL_MEM_RegisterMemory(&OB_Descriptor) == SUCCESS);
+    FUZZ_CHECK(OPENBL_MEM_RegisterMemory(&OTP_Descriptor) == SUCCESS);
+    FUZZ_CHECK(OPENBL_MEM_RegisterMemory(&ICP1_Descriptor) == SUCCESS);
+    FUZZ_CHECK(OPENBL_MEM_RegisterMemory(&ICP2_Descriptor) == SUCCESS);
+    FUZZ_CHECK(OPENBL_MEM_RegisterMemory(&ICP3_Descriptor) == SUCCESS);
+    FUZZ_CHECK(OPENBL_InterfaceDetection() == 1U);
+  }
+
+  /* A device with the bootloader only, out of reset */
+  memset((void *)(uintptr_t)FLASH_START_ADDRESS, 0xFF, FLASH_BL_SIZE);
+  memset((void *)(uintptr_t)RAM_START_ADDRESS, 0, RAM_SIZE);
+  BaudRate = 115200U;
+
+  Input      = pData;
+  InputSize  = Size;
+  InputIndex = 0U;
+
+  if (setjmp(SessionEnd) == 0)
+  {
+    for (;;)
+    {
+      OPENBL_CommandProcess();
+    }
+  }
+
+  return 0;
+}
+
+size_t FUZZ_Seed(uint32_t Index, uint8_t *pData, size_t Capacity)
+{
+  static uint8_t seed[FUZZ_SEED_SIZE];
+  FUZZ_BufferTypeDef buffer = { seed, 0U };
+
+  FUZZ_BuildSeed(Index, &buffer);
+
+  if (buffer.Size > Capacity)
+  {
+    return 0U;
+  }
+
+  memcpy(pData, seed, buffer.Size);
+
+  return buffer.Size;
+}
@@ -0,0 +1,59 @@
+/**
+  ******************************************************************************
+  * @file    test.h
+  * @brief   Minimal framework of the host unit tests.
+  *
+  *          A test is a program including the firmware module under test, so
+  *          its private functions and variables are reachable, and linking
+  *          test_hal.c for the few HAL functions the module calls. The
+  *          peripheral and NVIC registers are plain memory mapped at their
+  *          device addresses, the test plays the hardware by writing them,
+  *          from TEST_WaitHook while the module waits.
+  ******************************************************************************
+  */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Exported macros -----------------------------------------------------------*/
+#define TEST_CHECK(condition)                                                   \
+  do                                                                            \
+  {                                                                             \
+    TEST_Checks++;                                                              \
+    if (!(condition))                                                           \
+    {                                                                           \
+      TEST_Failures++;                                                          \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+    }                                                                           \
+  } while (0)
+
+#define TEST_CHECK_EQUAL(actual, expected)                                      \
+  do                                                                            \
+  {                                                                             \
+    unsigned long long test_actual   = (unsigned long long)(actual);            \
+    unsigned long long test_expected = (unsigned long long)(expected);          \
+    TEST_Checks++;                                                              \
+    if (test_actual != test_expected)                                           \
+    {                                                                           \
+      TEST_Failures++;                                                          \
+      fprintf(stderr, "%s:%d: %s is 0x%llx (%llu), expected 0x%llx (%llu)\n", __FILE__, __LINE__, \
+              #actual, test_actual, test_actual, test_expected, test_expected); \
+    }                                                                           \
+  } while (0)
+
+/* Exported variables --------------------------------------------------------*/
+extern unsigned int TEST_Checks;
+extern unsigned int TEST_Failures;
+extern uint32_t TEST_Pclk1;                             /* Returned by HAL_RCC_GetPCLK1Freq() */
+extern uint32_t TEST_Tick;                              /* Returned by HAL_GetTick(), advanced by each call */
+extern void (*TEST_WaitHook)(void);                     /* Called by OPENBL_IWDG_Refresh(), in the wait loops */
+
+/* Exported functions --------------------------------------------------------*/
+void TEST_MapPeripherals(void);
+void TEST_MapMemories(void);
+int TEST_Report(const char *Name);
+
+#endif /* TEST_H */
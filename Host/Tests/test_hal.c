@@ -0,0 +1,147 @@
+/**
+  ******************************************************************************
+  * @file    test_hal.c
+  * @brief   HAL and core functions called by the modules under test.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "main.h"
+#include "openbootloader_conf.h"
+#include "test.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_PERIPH_SIZE              0x80000U  /* APB1, APB2 and AHB1 */
+#define TEST_SCS_BASE                 0xE000E000U
+#define TEST_SCS_SIZE                 0x1000U
+#define TEST_SYSTEM_BASE              ICP_START_ADDRESS   /* System memory, OTP and option bytes */
+#define TEST_SYSTEM_SIZE              0x10000U
+
+/* Exported variables --------------------------------------------------------*/
+unsigned int TEST_Checks = 0U;
+unsigned int TEST_Failures = 0U;
+uint32_t TEST_Pclk1 = 42000000U;
+uint32_t TEST_Tick = 0U;
+void (*TEST_WaitHook)(void) = NULL;
+
+volatile uint32_t Flash_BusyState = 0U;
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t Primask = 0U;
+static uint32_t Basepri = 0U;
+static uint32_t Faultmask = 0U;
+static uint32_t Msp = 0U;
+
+/* Private functions ---------------------------------------------------------*/
+
+static void TEST_Map(uint32_t Base, uint32_t Size)
+{
+  if (mmap((void *)(uintptr_t)Base, Size, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) == MAP_FAILED)
+  {
+    perror("test: cannot map the registers");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Map the peripheral and NVIC registers at their device addresses, reset to 0.
+  * @retval None.
+  */
+void TEST_MapPeripherals(void)
+{
+  TEST_Map(PERIPH_BASE, TEST_PERIPH_SIZE);
+
+  /* The address sanitizer reserves this range, the tests using the NVIC are built without it */
+#if !defined(__SANITIZE_ADDRESS__)
+  TEST_Map(TEST_SCS_BASE, TEST_SCS_SIZE);
+#endif /* !defined(__SANITIZE_ADDRESS__) */
+}
+
+/**
+  * @brief  Map the FLASH, the system memory and the RAM at their device addresses, reset to 0.
+  * @retval None.
+  */
+void TEST_MapMemories(void)
+{
+  TEST_Map(FLASH_START_ADDRESS, FLASH_BL_SIZE);
+  TEST_Map(TEST_SYSTEM_BASE, TEST_SYSTEM_SIZE);
+  TEST_Map(RAM_START_ADDRESS, RAM_SIZE);
+}
+
+/**
+  * @brief  Print the result of a test program.
+  * @param  Name The name of the test.
+  * @retval The exit status of the test program.
+  */
+int TEST_Report(const char *Name)
+{
+  printf("%s: %u checks, %u failed\n", Name, TEST_Checks, TEST_Failures);
+
+  return (TEST_Failures == 0U) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+uint32_t HAL_GetTick(void)
+{
+  return TEST_Tick++;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+  return TEST_Pclk1;
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+  (void)huart;
+
+  return HAL_OK;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+  (void)IRQn;
+  (void)PreemptPriority;
+  (void)SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+  (void)IRQn;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+  (void)IRQn;
+}
+
+void Error_Handler(void)
+{
+  fprintf(stderr, "test: Error_Handler() called\n");
+  abort();
+}
+
+void OPENBL_IWDG_Refresh(void)
+{
+  if (TEST_WaitHook != NULL)
+  {
+    TEST_WaitHook();
+  }
+}
+
+/* Core intrinsics of sim_cmsis.h */
+void SIM_CPU_SetPrimask(uint32_t PriMask)     { Primask = PriMask; }
+uint32_t SIM_CPU_GetPrimask(void)             { return Primask; }
+void SIM_CPU_SetBasepri(uint32_t BasePri)     { Basepri = BasePri; }
+uint32_t SIM_CPU_GetBasepri(void)             { return Basepri; }
+void SIM_CPU_SetFaultmask(uint32_t FaultMask) { Faultmask = FaultMask; }
+uint32_t SIM_CPU_GetFaultmask(void)           { return Faultmask; }
+uint32_t SIM_CPU_GetIpsr(void)                { return 0U; }
+void SIM_CPU_SetMsp(uint32_t TopOfMainStack)  { Msp = TopOfMainStack; }
+uint32_t SIM_CPU_GetMsp(void)                 { return Msp; }
+void SIM_CPU_Barrier(void)                    { }
+void SIM_CPU_WaitForInterrupt(void)           { }
+void SIM_CPU_Breakpoint(uint32_t Value)       { (void)Value; abort(); }
@@ -0,0 +1,444 @@
+/**
+  ******************************************************************************
+  * @file    test_lz4.c
+  * @brief   Host test and benchmark of the LZ4 block decoder of openbl_lz4.c.
+  *
+  *          Images are cut in frames as the host does for the compressed write
+  *          command, compressed by the reference compressor below, decoded
+  *          and compared: blink.bin of the example and larger synthetic
+  *          images. The malformed blocks must be rejected without a write
+  *          outside of the destination, which is allocated to its exact size
+  *          so that the address sanitizer catches any overrun. The decoding
+  *          speeds are those of the host in this sanitized build, they are
+  *          to be compared with each other only.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "openbl_lz4.c"
+#include "test.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_EXAMPLE                  "../example/blink.bin"
+#define TEST_FRAME_SIZE               16384U    /* USART_STAGE_BUFFER_SIZE of openbl_usart_cmd.c */
+#define TEST_CODE_SIZE                4096U     /* USART_RAM_BUFFER_SIZE of openbl_usart_cmd.c */
+#define TEST_MIN_FRAME_SIZE           2048U     /* Fits the reception buffer even if it does not compress */
+#define TEST_CODE_CAPACITY            (TEST_FRAME_SIZE + (TEST_FRAME_SIZE / 255U) + 16U)
+#define TEST_HASH_BITS                12U
+#define TEST_MAX_OFFSET               65535U
+#define TEST_LAST_LITERALS            5U        /* A block ends with at least 5 literals */
+#define TEST_MATCH_LIMIT              12U       /* and its last match starts 12 bytes before the end */
+#define TEST_BENCH_BYTES              (32U * 1024U * 1024U)
+#define TEST_IMAGE_SIZE               (480U * 1024U)
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t Random = 0x2545F491U;
+
+/* Block made by the lz4 command line tool (lz4 -l) from the text below */
+static const char ReferenceText[] =
+  "Open Bootloader, Open Bootloader, Open Bootloader: LZ4 block of the compressed write command.\n";
+
+static const uint8_t ReferenceBlock[] =
+{
+  0xFFU, 0x02U, 0x4FU, 0x70U, 0x65U, 0x6EU, 0x20U, 0x42U, 0x6FU, 0x6FU, 0x74U, 0x6CU,
+  0x6FU, 0x61U, 0x64U, 0x65U, 0x72U, 0x2CU, 0x20U, 0x11U, 0x00U, 0x0DU, 0xF0U, 0x1EU,
+  0x3AU, 0x20U, 0x4CU, 0x5AU, 0x34U, 0x20U, 0x62U, 0x6CU, 0x6FU, 0x63U, 0x6BU, 0x20U,
+  0x6FU, 0x66U, 0x20U, 0x74U, 0x68U, 0x65U, 0x20U, 0x63U, 0x6FU, 0x6DU, 0x70U, 0x72U,
+  0x65U, 0x73U, 0x73U, 0x65U, 0x64U, 0x20U, 0x77U, 0x72U, 0x69U, 0x74U, 0x65U, 0x20U,
+  0x63U, 0x6FU, 0x6DU, 0x6DU, 0x61U, 0x6EU, 0x64U, 0x2EU, 0x0AU
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint32_t TEST_Random(uint32_t Max)
+{
+  Random ^= Random << 13;
+  Random ^= Random >> 17;
+  Random ^= Random << 5;
+
+  return Random % Max;
+}
+
+static uint32_t TEST_Read32(const uint8_t *pData)
+{
+  return (uint32_t)pData[0] | ((uint32_t)pData[1] << 8) | ((uint32_t)pData[2] << 16) | ((uint32_t)pData[3] << 24);
+}
+
+static double TEST_Seconds(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (double)now.tv_sec + ((double)now.tv_nsec / 1e9);
+}
+
+/* Extra bytes of a length of 15 or more */
+static uint32_t TEST_WriteLength(uint8_t *pDst, uint32_t Out, uint32_t Length)
+{
+  Length -= LZ4_LENGTH_EXTENDED;
+
+  while (Length >= 0xFFU)
+  {
+    pDst[Out++] = 0xFFU;
+    Length     -= 0xFFU;
+  }
+
+  pDst[Out++] = (uint8_t)Length;
+
+  return Out;
+}
+
+/* One sequence: literals then a match, no match for the last sequence (Length 0) */
+static uint32_t TEST_WriteSequence(uint8_t *pDst, uint32_t Out, const uint8_t *pLiterals, uint32_t Literals,
+                                   uint32_t Offset, uint32_t Length)
+{
+  uint32_t match = (Length != 0U) ? (Length - LZ4_MIN_MATCH) : 0U;
+  uint32_t token = Out++;
+
+  pDst[token] = (uint8_t)((((Literals < LZ4_LENGTH_EXTENDED) ? Literals : LZ4_LENGTH_EXTENDED) << 4)
+                          | ((match < LZ4_LENGTH_EXTENDED) ? match : LZ4_LENGTH_EXTENDED));
+
+  if (Literals >= LZ4_LENGTH_EXTENDED)
+  {
+    Out = TEST_WriteLength(pDst, Out, Literals);
+  }
+
+  memcpy(&pDst[Out], pLiterals, Literals);
+  Out += Literals;
+
+  if (Length != 0U)
+  {
+    pDst[Out++] = (uint8_t)Offset;
+    pDst[Out++] = (uint8_t)(Offset >> 8);
+
+    if (match >= LZ4_LENGTH_EXTENDED)
+    {
+      Out = TEST_WriteLength(pDst, Out, match);
+    }
+  }
+
+  return Out;
+}
+
+/* Greedy compressor of the host tools, one independent block following the end rules of the format */
+static uint32_t TEST_Compress(const uint8_t *pSrc, uint32_t Length, uint8_t *pDst)
+{
+  static uint32_t table[1U << TEST_HASH_BITS];          /* Last position + 1 of each hashed word */
+  uint32_t limit = (Length > TEST_MATCH_LIMIT) ? (Length - TEST_MATCH_LIMIT) : 0U;
+  uint32_t anchor = 0U;
+  uint32_t position = 0U;
+  uint32_t out = 0U;
+  uint32_t candidate;
+  uint32_t length;
+  uint32_t word;
+  uint32_t hash;
+
+  memset(table, 0, sizeof(table));
+
+  while (position < limit)
+  {
+    word      = TEST_Read32(&pSrc[position]);
+    hash      = (word * 2654435761U) >> (32U - TEST_HASH_BITS);
+    candidate = table[hash];
+    table[hash] = position + 1U;
+
+    if ((candidate != 0U) && ((position - (candidate - 1U)) <= TEST_MAX_OFFSET)
+        && (TEST_Read32(&pSrc[candidate - 1U]) == word))
+    {
+      candidate--;
+      length = LZ4_MIN_MATCH;
+
+      while (((position + length) < (Length - TEST_LAST_LITERALS))
+             && (pSrc[candidate + length] == pSrc[position + length]))
+      {
+        length++;
+      }
+
+      out       = TEST_WriteSequence(pDst, out, &pSrc[anchor], position - anchor, position - candidate, length);
+      position += length;
+      anchor    = position;
+    }
+    else
+    {
+      position++;
+    }
+  }
+
+  return TEST_WriteSequence(pDst, out, &pSrc[anchor], Length - anchor, 0U, 0U);
+}
+
+/* Decode into a destination of exactly Capacity bytes */
+static ErrorStatus TEST_Decode(const uint8_t *pBlock, uint32_t Length, uint8_t **ppOut, uint32_t Capacity,
+                               uint32_t *pOutLength)
+{
+  uint8_t *block = malloc((Length != 0U) ? Length : 1U);
+  ErrorStatus status;
+
+  memcpy(block, pBlock, Length);
+  *ppOut = malloc((Capacity != 0U) ? Capacity : 1U);
+  status = OPENBL_LZ4_DecompressBlock(block, Length, *ppOut, Capacity, pOutLength);
+  free(block);
+
+  return status;
+}
+
+static void TEST_Malformed(const uint8_t *pBlock, uint32_t Length, uint32_t Capacity, uint32_t Written)
+{
+  uint32_t length = 0xFFFFFFFFU;
+  uint8_t *out;
+
+  TEST_CHECK_EQUAL(TEST_Decode(pBlock, Length, &out, Capacity, &length), ERROR);
+  TEST_CHECK_EQUAL(length, Written);
+  free(out);
+}
+
+/* The block made by the reference encoder decodes to its text */
+static void TEST_Reference(void)
+{
+  uint32_t length = 0U;
+  uint8_t *out;
+
+  TEST_CHECK_EQUAL(TEST_Decode(ReferenceBlock, sizeof(ReferenceBlock), &out, sizeof(ReferenceText) - 1U, &length),
+                   SUCCESS);
+  TEST_CHECK_EQUAL(length, sizeof(ReferenceText) - 1U);
+  TEST_CHECK(memcmp(out, ReferenceText, sizeof(ReferenceText) - 1U) == 0);
+  free(out);
+
+  /* One byte short of room for the last literals */
+  TEST_Malformed(ReferenceBlock, sizeof(ReferenceBlock), sizeof(ReferenceText) - 2U, 49U);
+}
+
+static void TEST_MalformedBlocks(void)
+{
+  static const uint8_t literals[] = { 0x50U, 'a', 'b', 'c' };
+  static const uint8_t extended[] = { 0xF0U, 0xFFU };
+  static const uint8_t offset_zero[] = { 0x14U, 'a', 0x00U, 0x00U, 0x00U };
+  static const uint8_t offset_before[] = { 0x14U, 'a', 0x02U, 0x00U, 0x00U };
+  static const uint8_t offset_first[] = { 0x04U, 0x01U, 0x00U, 0x00U };
+  static const uint8_t offset_half[] = { 0x14U, 'a', 0x01U };
+  static const uint8_t match_extended[] = { 0x1FU, 'a', 0x01U, 0x00U };
+  static const uint8_t run[] = { 0x1FU, 'a', 0x01U, 0x00U, 0x10U, 0x00U };
+  uint32_t length = 0U;
+  uint8_t *out;
+  uint32_t index;
+
+  TEST_Malformed(literals, 0U, 16U, 0U);
+
+  /* Truncated literal run, nothing is copied */
+  TEST_Malformed(literals, sizeof(literals), 16U, 0U);
+  TEST_Malformed(extended, 1U, 512U, 0U);
+  TEST_Malformed(extended, sizeof(extended), 512U, 0U);
+
+  /* Offset 0, offsets before the start of the output */
+  TEST_Malformed(offset_zero, sizeof(offset_zero), 16U, 1U);
+  TEST_Malformed(offset_before, sizeof(offset_before), 16U, 1U);
+  TEST_Malformed(offset_first, sizeof(offset_first), 16U, 0U);
+
+  /* Block ending inside the offset or the match length */
+  TEST_Malformed(offset_half, sizeof(offset_half), 16U, 1U);
+  TEST_Malformed(match_extended, sizeof(match_extended), 64U, 1U);
+
+  /* Literals and match longer than the destination */
+  TEST_Malformed(literals + 1, 1U, 0U, 0U);
+  TEST_Malformed(run, sizeof(run), 35U, 1U);
+
+  /* The overlapping match repeats its last byte: 1 literal + 4 + 15 + 16 */
+  TEST_CHECK_EQUAL(TEST_Decode(run, sizeof(run), &out, 36U, &length), SUCCESS);
+  TEST_CHECK_EQUAL(length, 36U);
+
+  for (index = 0U; index < 36U; index++)
+  {
+    TEST_CHECK_EQUAL(out[index], 'a');
+  }
+
+  free(out);
+}
+
+/* Every truncation of a valid block is rejected, or ends between two sequences with a shorter output */
+static void TEST_Truncated(const uint8_t *pData, uint32_t Length, const uint8_t *pBlock, uint32_t Code)
+{
+  uint32_t truncated;
+  uint32_t length;
+  uint32_t accepted = 0U;
+  uint8_t *out;
+
+  for (truncated = 0U; truncated < Code; truncated++)
+  {
+    if (TEST_Decode(pBlock, truncated, &out, Length, &length) == SUCCESS)
+    {
+      accepted++;
+      TEST_CHECK(length < Length);
+      TEST_CHECK(memcmp(out, pData, length) == 0);
+    }
+
+    free(out);
+  }
+
+  TEST_CHECK(accepted < Code);
+}
+
+/* Frames of the compressed write command, each as long as its block fits the reception buffer:
+   round trip, ratio and decoding speed */
+static void TEST_Image(const char *Name, const uint8_t *pData, uint32_t Length, int Truncate)
+{
+  uint32_t capacity = (Length / TEST_MIN_FRAME_SIZE) + 1U;
+  uint8_t **blocks = calloc(capacity, sizeof(uint8_t *));
+  uint32_t *codes = calloc(capacity, sizeof(uint32_t));
+  uint8_t *out;
+  uint32_t frames = 0U;
+  uint32_t offset = 0U;
+  uint32_t compressed = 0U;
+  uint32_t decoded = 0U;
+  uint32_t frame;
+  uint32_t size;
+  uint32_t length;
+  double start;
+  double seconds;
+
+  while (offset < Length)
+  {
+    size           = ((Length - offset) < TEST_FRAME_SIZE) ? (Length - offset) : TEST_FRAME_SIZE;
+    blocks[frames] = malloc(TEST_CODE_CAPACITY);
+    codes[frames]  = TEST_Compress(&pData[offset], size, blocks[frames]);
+
+    while (codes[frames] > TEST_CODE_SIZE)
+    {
+      size          /= 2U;
+      codes[frames]  = TEST_Compress(&pData[offset], size, blocks[frames]);
+    }
+
+    TEST_CHECK(size >= TEST_MIN_FRAME_SIZE);
+    TEST_CHECK_EQUAL(TEST_Decode(blocks[frames], codes[frames], &out, size, &length), SUCCESS);
+    TEST_CHECK_EQUAL(length, size);
+    TEST_CHECK(memcmp(out, &pData[offset], size) == 0);
+    free(out);
+
+    if (Truncate != 0)
+    {
+      TEST_Truncated(&pData[offset], size, blocks[frames], codes[frames]);
+    }
+
+    compressed += codes[frames];
+    offset     += size;
+    frames++;
+  }
+
+  out   = malloc(TEST_FRAME_SIZE);
+  start = TEST_Seconds();
+
+  while (decoded < TEST_BENCH_BYTES)
+  {
+    for (frame = 0U; frame < frames; frame++)
+    {
+      (void)OPENBL_LZ4_DecompressBlock(blocks[frame], codes[frame], out, TEST_FRAME_SIZE, &length);
+      decoded += length;
+    }
+  }
+
+  seconds = TEST_Seconds() - start;
+
+  printf("test_lz4: %-14s %7u -> %7u bytes (%5.1f %%) in %3u frames, decoded at %.0f MB/s\n",
+         Name, (unsigned int)Length, (unsigned int)compressed, (100.0 * compressed) / Length,
+         (unsigned int)frames, decoded / seconds / 1e6);
+
+  for (frame = 0U; frame < frames; frame++)
+  {
+    free(blocks[frame]);
+  }
+
+  free(out);
+  free(codes);
+  free(blocks);
+}
+
+/* Thumb-2 like code: frequent instructions, registers and literal pools */
+static void TEST_Code(uint8_t *pData, uint32_t Length)
+{
+  static const uint16_t opcodes[] =
+  {
+    0x4770U, 0xB580U, 0xBD80U, 0x4618U, 0x6813U, 0x601AU, 0x2300U, 0xF04FU,
+    0xE7FEU, 0x4B02U, 0x681BU, 0x3301U, 0xD1FBU, 0xF7FFU, 0x46BDU, 0xB082U
+  };
+  uint32_t index = 0U;
+  uint16_t opcode;
+
+  while ((index + 4U) <= Length)
+  {
+    if (TEST_Random(16U) == 0U)
+    {
+      /* Literal pool entry: a peripheral or RAM address */
+      pData[index++] = (uint8_t)TEST_Random(256U);
+      pData[index++] = (uint8_t)TEST_Random(4U);
+      pData[index++] = 0x00U;
+      pData[index++] = (TEST_Random(2U) != 0U) ? 0x40U : 0x20U;
+    }
+    else
+    {
+      /* Some of them with other registers or immediates */
+      opcode         = opcodes[TEST_Random(sizeof(opcodes) / sizeof(opcodes[0]))];
+      opcode        ^= (TEST_Random(4U) == 0U) ? (uint16_t)TEST_Random(256U) : 0U;
+      pData[index++] = (uint8_t)opcode;
+      pData[index++] = (uint8_t)(opcode >> 8);
+    }
+  }
+
+  memset(&pData[index], 0xFF, Length - index);
+}
+
+static void TEST_Images(void)
+{
+  uint8_t *image = malloc(TEST_IMAGE_SIZE);
+  uint8_t *blink = malloc(TEST_FRAME_SIZE);
+  uint32_t length;
+  uint32_t index;
+  FILE *file;
+
+  file = fopen(TEST_EXAMPLE, "rb");
+  TEST_CHECK(file != NULL);
+
+  if (file != NULL)
+  {
+    length = (uint32_t)fread(blink, 1U, TEST_FRAME_SIZE, file);
+    fclose(file);
+
+    TEST_CHECK(length > 0U);
+    TEST_Image("blink.bin", blink, length, 1);
+  }
+
+  /* Application of 480 KB: code, constant data that does not compress, erased gaps */
+  TEST_Code(image, 256U * 1024U);
+
+  for (index = 256U * 1024U; index < (320U * 1024U); index++)
+  {
+    image[index] = (uint8_t)TEST_Random(256U);
+  }
+
+  memset(&image[320U * 1024U], 0xFF, 32U * 1024U);
+  TEST_Code(&image[352U * 1024U], TEST_IMAGE_SIZE - (352U * 1024U));
+  TEST_Image("image 480 KB", image, TEST_IMAGE_SIZE, 0);
+
+  TEST_Code(image, 64U * 1024U);
+  TEST_Image("code 64 KB", image, 64U * 1024U, 1);
+
+  for (index = 0U; index < (64U * 1024U); index++)
+  {
+    image[index] = (uint8_t)TEST_Random(256U);
+  }
+
+  TEST_Image("random 64 KB", image, 64U * 1024U, 0);
+
+  free(blink);
+  free(image);
+}
+
+int main(void)
+{
+  TEST_Reference();
+  TEST_MalformedBlocks();
+  TEST_Images();
+
+  return TEST_Report("test_lz4");
+}
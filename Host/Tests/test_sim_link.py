@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Simulation test of the reception path: 512 KB sent at 2 Mbaud, nothing lost.
+
+The whole user FLASH (496 KB) is programmed with extended write frames and
+16 KB are written to the SRAM, so 512 KB of frames go through the RX DMA ring.
+Both are checked by CRC and the link statistics of the device must show no
+reception error, no DMA restart, no bad checksum, no retransmitted frame and
+no NACK.
+
+  test_sim_link.py build/openbl_sim
+"""
+
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Tools"))
+import openbl  # noqa: E402
+
+BAUDRATE = 2000000
+FLASH_IMAGE_SIZE = 0x08080000 - openbl.USER_ADDRESS
+SRAM_ADDRESS = 0x20011800        # after the OPENBL_RAM_SIZE bytes used by the bootloader
+SRAM_SIZE = 16 * 1024
+
+
+class Simulation:
+    """openbl_sim on a pseudo terminal, with a blank FLASH."""
+
+    def __init__(self, program, directory):
+        self.link = os.path.join(directory, "line")
+        self.clock = os.path.join(directory, "clock")
+        self.process = subprocess.Popen([program, "--state", os.path.join(directory, "flash.state"),
+                                         "--link", self.link, "--clock", self.clock],
+                                        stderr=subprocess.DEVNULL)
+        for _ in range(100):
+            if os.path.exists(self.link) and os.path.exists(self.clock):
+                return
+            time.sleep(0.05)
+        self.stop()
+        raise RuntimeError("openbl_sim did not start")
+
+    def stop(self):
+        self.process.kill()
+        self.process.wait()
+
+
+def main():
+    program = sys.argv[1] if len(sys.argv) > 1 else "build/openbl_sim"
+    generator = random.Random(0x0B1)
+    image = bytes(generator.getrandbits(8) for _ in range(FLASH_IMAGE_SIZE))
+    sram = bytes(generator.getrandbits(8) for _ in range(SRAM_SIZE))
+    failures = []
+
+    with tempfile.TemporaryDirectory() as directory:
+        simulation = Simulation(program, directory)
+        try:
+            tool = openbl.OpenBL(simulation.link, 115200, simulation.clock)
+            tool.connect()
+            start = tool.clock.read()["tx_end"]
+            tool.speed(BAUDRATE)
+            tool.erase_application(len(image))
+            tool.write_memory(openbl.USER_ADDRESS, image)
+            tool.write_memory(SRAM_ADDRESS, sram)
+
+            if tool.checksum(openbl.USER_ADDRESS, len(image)) != openbl.crc32_mpeg2(image):
+                failures.append("FLASH image differs")
+            if tool.checksum(SRAM_ADDRESS, len(sram)) != openbl.crc32_mpeg2(sram):
+                failures.append("SRAM data differs")
+
+            counters, nacks = tool.statistics()
+            clock = tool.clock.read()
+            tool.close()
+        finally:
+            simulation.stop()
+
+    names = ("overrun errors", "framing errors", "noise errors", "parity errors", "DMA restarts",
+             "opcode errors", "checksum errors", "retransmits")
+    for name, value in zip(names, counters[2:]):
+        if value != 0:
+            failures.append("%s: %d" % (name, value))
+    if nacks:
+        failures.append("NACK sent: %s" % nacks)
+    if clock["rx_bytes"] < len(image) + len(sram):
+        failures.append("only %d bytes received" % clock["rx_bytes"])
+
+    print("test_sim_link: %d bytes at %d baud in %.3f s simulated, %s" % (
+        clock["rx_bytes"], BAUDRATE, (clock["tx_end"] - start) / 1e9, "; ".join(failures) or "no drop"))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
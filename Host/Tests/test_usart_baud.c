@@ -0,0 +1,148 @@
+/**
+  ******************************************************************************
+  * @file    test_usart_baud.c
+  * @brief   Host test of the baudrate computations of usart_interface.c:
+  *          BRR and oversampling of a requested baudrate, its rejection beyond
+  *          USARTx_BAUDRATE_TOLERANCE, and the baudrate measured on the sync byte.
+  ******************************************************************************
+  */
+
+#include "usart_interface.c"
+#include "test.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_PCLK1                    42000000U  /* 84 MHz HCLK, APB1 divided by 2 */
+#define TEST_TIMER_CLOCK              84000000U  /* APB1 timers at twice PCLK1 */
+
+/* Private functions ---------------------------------------------------------*/
+
+static void TEST_Brr(uint32_t BaudRate, uint32_t Brr, uint32_t OverSampling)
+{
+  uint32_t brr = 0U;
+  uint32_t oversampling = 0U;
+
+  TEST_CHECK_EQUAL(OPENBL_USART_ComputeBrr(BaudRate, &brr, &oversampling), SUCCESS);
+  TEST_CHECK_EQUAL(brr, Brr);
+  TEST_CHECK_EQUAL(oversampling, OverSampling);
+}
+
+static void TEST_Rejected(uint32_t BaudRate)
+{
+  uint32_t brr = 0U;
+  uint32_t oversampling = 0U;
+
+  TEST_CHECK_EQUAL(OPENBL_USART_ComputeBrr(BaudRate, &brr, &oversampling), ERROR);
+  TEST_CHECK_EQUAL(OPENBL_USART_CheckBaudRate(BaudRate), ERROR);
+}
+
+/* Standard rates with OVER16, USARTDIV = PCLK1 / baudrate rounded to the nearest 1/16 */
+static void TEST_Oversampling16(void)
+{
+  TEST_Brr(9600U, 4375U, LL_USART_OVERSAMPLING_16);
+  TEST_Brr(115200U, 365U, LL_USART_OVERSAMPLING_16);
+  TEST_Brr(921600U, 46U, LL_USART_OVERSAMPLING_16);
+  TEST_Brr(2000000U, 21U, LL_USART_OVERSAMPLING_16);
+
+  /* Lowest rate, the divider fills the 16 bits of BRR */
+  TEST_Brr(641U, 0xFFF3U, LL_USART_OVERSAMPLING_16);
+  TEST_Rejected(640U);
+}
+
+/* OVER16 down to a divider of 16, OVER8 from 15 down to 8 with the fraction on 3 bits */
+static void TEST_OversamplingBoundary(void)
+{
+  TEST_Brr(TEST_PCLK1 / 16U, 16U, LL_USART_OVERSAMPLING_16);
+  TEST_Brr(TEST_PCLK1 / 15U, 0x17U, LL_USART_OVERSAMPLING_8);
+  TEST_Brr(3000000U, 0x16U, LL_USART_OVERSAMPLING_8);
+  TEST_Brr(TEST_PCLK1 / 13U, 0x15U, LL_USART_OVERSAMPLING_8);
+  TEST_Brr(TEST_PCLK1 / 10U, 0x12U, LL_USART_OVERSAMPLING_8);
+
+  /* 5.25 Mbaud is the maximum at PCLK1 = 42 MHz */
+  TEST_Brr(5250000U, 0x10U, LL_USART_OVERSAMPLING_8);
+  TEST_Rejected(6000000U);
+  TEST_Rejected(10500000U);
+}
+
+/* A rate whose nearest divider is more than 2 % away is refused */
+static void TEST_Tolerance(void)
+{
+  /* Divider 10 gives 4.2 Mbaud: accepted from 4.2M / 1.02 to 4.2M / 0.98 */
+  TEST_Brr(4117648U, 0x12U, LL_USART_OVERSAMPLING_8);
+  TEST_Rejected(4117647U);
+  TEST_Brr(4285714U, 0x12U, LL_USART_OVERSAMPLING_8);
+  TEST_Rejected(4285715U);
+
+  /* Divider 9 gives 4.667 Mbaud, 3.7 % above 4.5 Mbaud */
+  TEST_Rejected(4500000U);
+
+  TEST_Rejected(0U);
+  TEST_CHECK_EQUAL(OPENBL_USART_CheckBaudRate(115200U), SUCCESS);
+}
+
+/* The BRR follows the actual PCLK1, here the 16 MHz of the HSI before the PLL is started */
+static void TEST_Pclk(void)
+{
+  TEST_Pclk1 = 16000000U;
+  TEST_Brr(115200U, 139U, LL_USART_OVERSAMPLING_16);
+  TEST_Brr(2000000U, 0x10U, LL_USART_OVERSAMPLING_8);
+  TEST_Rejected(2100000U);
+  TEST_Pclk1 = TEST_PCLK1;
+}
+
+/* The two falling edges of 0x7F are 8 bit times apart */
+static void TEST_AutoBaud(void)
+{
+  static const uint32_t rates[] = { 1200U, 9600U, 57600U, 115200U, 230400U, 460800U, 921600U, 1000000U };
+  uint32_t index;
+  uint32_t ticks;
+  int32_t jitter;
+  uint32_t baudrate;
+
+  TEST_CHECK_EQUAL(OPENBL_USART_AutoBaud_ComputeBaudRate(0U, TEST_TIMER_CLOCK), 0U);
+  TEST_CHECK_EQUAL(OPENBL_USART_AutoBaud_ComputeBaudRate(5833U, TEST_TIMER_CLOCK), 115207U);
+  TEST_CHECK_EQUAL(OPENBL_USART_AutoBaud_ComputeBaudRate(128U, TEST_TIMER_CLOCK), 5250000U);
+
+  /* Rounded to the nearest: 8 * 1 / 3 = 2.67 */
+  TEST_CHECK_EQUAL(OPENBL_USART_AutoBaud_ComputeBaudRate(3U, 1U), 3U);
+
+  /* No overflow with a 180 MHz timer and a 1200 baud frame */
+  TEST_CHECK_EQUAL(OPENBL_USART_AutoBaud_ComputeBaudRate(1200000U, 180000000U), 1200U);
+
+  /* A capture off by one tick still gives a rate the USART can be set to */
+  for (index = 0U; index < (sizeof(rates) / sizeof(rates[0])); index++)
+  {
+    for (jitter = -1; jitter <= 1; jitter++)
+    {
+      ticks    = (uint32_t)((int32_t)((8ULL * TEST_TIMER_CLOCK) / rates[index]) + jitter);
+      baudrate = OPENBL_USART_AutoBaud_ComputeBaudRate(ticks, TEST_TIMER_CLOCK);
+
+      TEST_CHECK(((baudrate * 100ULL) >= (rates[index] * 99ULL)) && ((baudrate * 100ULL) <= (rates[index] * 101ULL)));
+      TEST_CHECK_EQUAL(OPENBL_USART_CheckBaudRate(baudrate), SUCCESS);
+    }
+  }
+}
+
+/* The timer clock is twice PCLK1 when APB1 is divided */
+static void TEST_TimerClock(void)
+{
+  RCC->CFGR = RCC_HCLK_DIV2;
+  TEST_CHECK_EQUAL(OPENBL_USART_AutoBaud_GetTimerClock(), TEST_TIMER_CLOCK);
+
+  RCC->CFGR = RCC_HCLK_DIV1;
+  TEST_CHECK_EQUAL(OPENBL_USART_AutoBaud_GetTimerClock(), TEST_PCLK1);
+}
+
+int main(void)
+{
+  TEST_MapPeripherals();
+  TEST_Pclk1 = TEST_PCLK1;
+
+  TEST_Oversampling16();
+  TEST_OversamplingBoundary();
+  TEST_Tolerance();
+  TEST_Pclk();
+  TEST_AutoBaud();
+  TEST_TimerClock();
+
+  return TEST_Report("test_usart_baud");
+}
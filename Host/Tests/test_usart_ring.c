@@ -0,0 +1,262 @@
+/**
+  ******************************************************************************
+  * @file    test_usart_ring.c
+  * @brief   Host test of the USART reception ring of usart_interface.c.
+  *
+  *          The test plays the RX DMA stream: while the module waits for data,
+  *          bytes are written at the ring position given by NDTR, which counts
+  *          down and reloads in circular mode. The bytes read back through
+  *          OPENBL_USART_ReadByte() and OPENBL_USART_ReadBuffer() must be the
+  *          received stream, across many wrap-arounds of the ring and after a
+  *          restart of a stream disabled by a transfer error.
+  ******************************************************************************
+  */
+
+#include "usart_interface.c"
+#include "test.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_STREAM_SIZE              ((5U * USARTx_RX_RING_SIZE) + 77U)
+#define TEST_RX_STREAM                DMA1_Stream5
+#define TEST_USART_IRQ_BIT            (1UL << ((uint32_t)USART2_IRQn & 0x1FU))
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t Stream[TEST_STREAM_SIZE];                /* Bytes sent by the host */
+static uint8_t Received[TEST_STREAM_SIZE];
+static uint32_t Sent = 0U;
+static uint32_t BurstMax = 1U;                          /* Bytes delivered per wait, at most */
+static uint32_t Random = 0x12345678U;
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint32_t TEST_Random(uint32_t Max)
+{
+  Random ^= Random << 13;
+  Random ^= Random >> 17;
+  Random ^= Random << 5;
+
+  return (Random % Max) + 1U;
+}
+
+/* One byte transferred by the RX stream from the data register to the ring */
+static void TEST_DmaTransfer(uint8_t Byte)
+{
+  uint8_t *ring = (uint8_t *)(uintptr_t)TEST_RX_STREAM->M0AR;
+
+  ring[USARTx_RX_RING_SIZE - TEST_RX_STREAM->NDTR] = Byte;
+
+  if (--TEST_RX_STREAM->NDTR == 0U)
+  {
+    TEST_RX_STREAM->NDTR = USARTx_RX_RING_SIZE;
+  }
+}
+
+/* Bursts of the host while the module waits, never more than the ring can hold */
+static void TEST_DeliverBurst(void)
+{
+  uint32_t room;
+  uint32_t burst;
+
+  if (((TEST_RX_STREAM->CR & DMA_SxCR_EN) == 0U) || (Sent == TEST_STREAM_SIZE))
+  {
+    return;
+  }
+
+  room  = (USARTx_RX_RING_SIZE - 1U) - OPENBL_USART_GetRxCount();
+  burst = TEST_Random(BurstMax);
+
+  if (burst > room)
+  {
+    burst = room;
+  }
+
+  if (burst > (TEST_STREAM_SIZE - Sent))
+  {
+    burst = TEST_STREAM_SIZE - Sent;
+  }
+
+  while (burst-- != 0U)
+  {
+    TEST_DmaTransfer(Stream[Sent++]);
+  }
+}
+
+/* Read the whole stream with a mix of single bytes and blocks */
+static void TEST_ReadStream(uint32_t Burst, uint32_t BlockMax)
+{
+  uint32_t done = 0U;
+  uint32_t length;
+
+  Sent          = 0U;
+  BurstMax      = Burst;
+  TEST_WaitHook = TEST_DeliverBurst;
+
+  memset(Received, 0, sizeof(Received));
+
+  while (done < TEST_STREAM_SIZE)
+  {
+    if (TEST_Random(4U) == 1U)
+    {
+      Received[done++] = OPENBL_USART_ReadByte();
+    }
+    else
+    {
+      length = TEST_Random(BlockMax);
+      length = (length > (TEST_STREAM_SIZE - done)) ? (TEST_STREAM_SIZE - done) : length;
+
+      OPENBL_USART_ReadBuffer(&Received[done], length);
+      done += length;
+    }
+  }
+
+  TEST_WaitHook = NULL;
+
+  TEST_CHECK_EQUAL(Sent, TEST_STREAM_SIZE);
+  TEST_CHECK(memcmp(Received, Stream, TEST_STREAM_SIZE) == 0);
+  TEST_CHECK_EQUAL(OPENBL_USART_GetRxCount(), 0U);
+}
+
+static void TEST_StartRx(void)
+{
+  OPENBL_USART_DMA_StartRx();
+
+  TEST_CHECK((TEST_RX_STREAM->CR & DMA_SxCR_EN) != 0U);
+  TEST_CHECK((TEST_RX_STREAM->CR & DMA_SxCR_CIRC) != 0U);
+  TEST_CHECK((TEST_RX_STREAM->CR & DMA_SxCR_MINC) != 0U);
+  TEST_CHECK_EQUAL(TEST_RX_STREAM->CR & DMA_SxCR_DIR, 0U);
+  TEST_CHECK_EQUAL(TEST_RX_STREAM->CR & DMA_SxCR_CHSEL, LL_DMA_CHANNEL_4);
+  TEST_CHECK_EQUAL(TEST_RX_STREAM->PAR, (uint32_t)(uintptr_t)&USART2->DR);
+  TEST_CHECK_EQUAL(TEST_RX_STREAM->M0AR, (uint32_t)(uintptr_t)UsartRxRing);
+  TEST_CHECK_EQUAL(TEST_RX_STREAM->NDTR, USARTx_RX_RING_SIZE);
+  TEST_CHECK((USART2->CR3 & USART_CR3_DMAR) != 0U);
+  TEST_CHECK_EQUAL(OPENBL_USART_GetRxCount(), 0U);
+}
+
+/* Bytes of every burst size, read by blocks smaller and larger than the ring */
+static void TEST_WrapAround(void)
+{
+  TEST_ReadStream(1U, 1U);
+  TEST_ReadStream(7U, 300U);
+  TEST_ReadStream(3000U, 6000U);
+  TEST_ReadStream(USARTx_RX_RING_SIZE - 1U, 2U * USARTx_RX_RING_SIZE);
+  TEST_ReadStream(USARTx_RX_RING_SIZE - 1U, 1U);
+}
+
+/* The ring full to the last byte before the tail is read in full */
+static void TEST_FullRing(void)
+{
+  uint32_t index;
+
+  for (index = 0U; index < (USARTx_RX_RING_SIZE - 1U); index++)
+  {
+    TEST_DmaTransfer(Stream[index]);
+  }
+
+  TEST_CHECK_EQUAL(OPENBL_USART_GetRxCount(), USARTx_RX_RING_SIZE - 1U);
+
+  OPENBL_USART_ReadBuffer(Received, USARTx_RX_RING_SIZE - 1U);
+  TEST_CHECK(memcmp(Received, Stream, USARTx_RX_RING_SIZE - 1U) == 0);
+  TEST_CHECK_EQUAL(OPENBL_USART_GetRxCount(), 0U);
+}
+
+/* Restart after a transfer error, pending bytes are read before the stream is restarted */
+static void TEST_DmaRestart(void)
+{
+  uint32_t restarts = UsartStatistics.DmaRestarts;
+  uint8_t data[3];
+
+  TEST_DmaTransfer(0xA5U);
+  TEST_DmaTransfer(0x5AU);
+
+  /* Transfer error: the stream is disabled by hardware */
+  TEST_RX_STREAM->CR &= ~DMA_SxCR_EN;
+  DMA1->HISR         |= DMA_HISR_TEIF5;
+  DMA1->HIFCR         = 0U;
+
+  TEST_CHECK_EQUAL(OPENBL_USART_ReadByte(), 0xA5U);
+  TEST_CHECK_EQUAL(OPENBL_USART_ReadByte(), 0x5AU);
+  TEST_CHECK_EQUAL(UsartStatistics.DmaRestarts, restarts);
+
+  /* Waiting for more restarts the stream on an empty ring, the next bytes land at its start */
+  Stream[0]     = 0x11U;
+  Stream[1]     = 0x22U;
+  Stream[2]     = 0x33U;
+  Sent          = TEST_STREAM_SIZE - 3U;
+  BurstMax      = 1U;
+  TEST_WaitHook = NULL;
+
+  TEST_CHECK_EQUAL(OPENBL_USART_GetRxCount(), 0U);
+  OPENBL_USART_CheckErrors();
+  TEST_CHECK_EQUAL(UsartStatistics.DmaRestarts, restarts + 1U);
+  TEST_CHECK((TEST_RX_STREAM->CR & DMA_SxCR_EN) != 0U);
+  TEST_CHECK_EQUAL(TEST_RX_STREAM->NDTR, USARTx_RX_RING_SIZE);
+  TEST_CHECK_EQUAL(UsartRxTail, 0U);
+  TEST_CHECK((DMA1->HIFCR & DMA_HIFCR_CTEIF5) != 0U);
+
+  TEST_DmaTransfer(0x11U);
+  TEST_DmaTransfer(0x22U);
+  TEST_DmaTransfer(0x33U);
+
+  OPENBL_USART_ReadBuffer(data, 3U);
+  TEST_CHECK_EQUAL(data[0], 0x11U);
+  TEST_CHECK_EQUAL(data[2], 0x33U);
+  TEST_CHECK_EQUAL(UsartRxRing[0], 0x11U);
+
+  /* A stream found disabled while ReadByte() waits is restarted and the wait goes on */
+  TEST_RX_STREAM->CR &= ~DMA_SxCR_EN;
+  Sent                = TEST_STREAM_SIZE - 1U;
+  Stream[TEST_STREAM_SIZE - 1U] = 0x44U;
+  TEST_WaitHook       = TEST_DeliverBurst;
+
+  TEST_CHECK_EQUAL(OPENBL_USART_ReadByte(), 0x44U);
+  TEST_CHECK_EQUAL(UsartStatistics.DmaRestarts, restarts + 2U);
+  TEST_WaitHook = NULL;
+}
+
+/* The error interrupt masked by the IRQ handler is unmasked once the error flags are cleared */
+static void TEST_ErrorInterrupt(void)
+{
+  NVIC->ISER[1] = 0U;
+  USART2->SR    = USART_SR_ORE | USART_SR_RXNE;
+  OPENBL_USART_CheckErrors();
+  TEST_CHECK_EQUAL(NVIC->ISER[1] & TEST_USART_IRQ_BIT, 0U);
+
+  USART2->SR = USART_SR_RXNE | USART_SR_TC;
+  OPENBL_USART_CheckErrors();
+  TEST_CHECK((NVIC->ISER[1] & TEST_USART_IRQ_BIT) != 0U);
+  TEST_CHECK((NVIC->ICPR[1] & TEST_USART_IRQ_BIT) != 0U);
+}
+
+static void TEST_Timeout(void)
+{
+  uint8_t data = 0U;
+  uint32_t tickstart = TEST_Tick;
+
+  TEST_CHECK_EQUAL(OPENBL_USART_ReadByteTimeout(&data, 50U), ERROR);
+  TEST_CHECK(TEST_Tick - tickstart > 50U);
+
+  TEST_DmaTransfer(0x7FU);
+  TEST_CHECK_EQUAL(OPENBL_USART_ReadByteTimeout(&data, 50U), SUCCESS);
+  TEST_CHECK_EQUAL(data, 0x7FU);
+}
+
+int main(void)
+{
+  uint32_t index;
+
+  TEST_MapPeripherals();
+
+  for (index = 0U; index < TEST_STREAM_SIZE; index++)
+  {
+    Stream[index] = (uint8_t)TEST_Random(256U);
+  }
+
+  TEST_StartRx();
+  TEST_WrapAround();
+  TEST_FullRing();
+  TEST_DmaRestart();
+  TEST_ErrorInterrupt();
+  TEST_Timeout();
+
+  return TEST_Report("test_usart_ring");
+}
@@ -0,0 +1,271 @@
+#!/usr/bin/env python3
+"""Programming throughput benchmark of the bootloader on the simulation.
+
+For each image the device (build/openbl_sim) is programmed with the full flow
+of openbl.py: connect, speed, erase, write, verify and go. As for an update,
+its FLASH already holds a previous image of the same size; it is written by an
+unmeasured session before, without its first word so the device stays in the
+bootloader. --blank starts from an erased FLASH instead. All timings are
+simulated time read from the clock file of the simulation, so they only
+depend on the firmware and the simulated hardware, not on the host.
+
+The images are example/blink.bin, then blink.bin repeated up to 16, 64, 128,
+256 and 480 KB. For each flow the results are:
+  bytes_per_s    image size over the time from the sync byte to the Go answer
+  overhead_pct   part of that time not spent sending the image bits at the
+                 baudrate: framing, answers, turnarounds and FLASH waits
+  phases         time of each step of the flow
+  line, flash    time the line was busy in each direction and the FLASH busy
+  commands       latency statistics and histogram of each command opcode,
+                 from the first bit of the command to the last bit of the answer
+
+The JSON is written with sorted keys and fixed histogram buckets so two runs
+can be diffed. --compare prints the change against an earlier result, with the
+write step and FLASH busy times of both, and fails when the throughput of a
+flow drops by more than --threshold percent.
+
+--streamed sends each write frame without waiting for the ACKs of its opcode
+and address. make bench-pipelined runs it on the strict build and on a build
+with OPENBL_PIPELINED_WRITE and compares them: the line and FLASH busy times
+are the same, the write step of the pipelined build shrinks by the FLASH time
+overlapping the reception of the next frame.
+
+  bench.py --sim build/openbl_sim --output build/bench.json
+  bench.py --sim build/openbl_sim --compare build/bench.json --threshold 2
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import openbl  # noqa: E402
+
+BLINK = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "example", "blink.bin")
+SIZES_KB = (16, 64, 128, 256, 480)
+CONNECT_BAUDRATE = 115200
+BITS_PER_BYTE = 11                                  # start, 8 data bits, even parity, stop
+
+# Upper bounds of the latency histogram buckets in us, powers of 2 from 64 us to 32 s
+BUCKETS_US = [1 << shift for shift in range(6, 26)]
+
+
+class Simulation:
+    """openbl_sim on a pseudo terminal, its FLASH kept in the directory across the runs."""
+
+    def __init__(self, program, directory):
+        self.link = os.path.join(directory, "line")
+        self.clock = os.path.join(directory, "clock")
+        self.process = subprocess.Popen([program, "--state", os.path.join(directory, "flash.state"),
+                                         "--link", self.link, "--clock", self.clock],
+                                        stderr=subprocess.DEVNULL)
+        for _ in range(100):
+            if os.path.exists(self.link) and os.path.exists(self.clock):
+                return
+            time.sleep(0.05)
+        self.stop()
+        raise RuntimeError("openbl_sim did not start")
+
+    def stop(self):
+        self.process.kill()
+        self.process.wait()
+        for path in (self.link, self.clock):
+            if os.path.lexists(path):
+                os.remove(path)
+
+
+def images():
+    """(name, data) of the benchmarked images, blink.bin repeated to the larger sizes."""
+    with open(BLINK, "rb") as file:
+        blink = file.read()
+    yield "blink.bin", blink
+    for size in SIZES_KB:
+        yield "%dk" % size, (blink * (size * 1024 // len(blink) + 1))[:size * 1024]
+
+
+def histogram(values):
+    """[upper bound in us, count] of the non empty buckets, the last bound is null for the overflow."""
+    counts = [0] * (len(BUCKETS_US) + 1)
+    for value in values:
+        microseconds = value * 1e6
+        index = 0
+        while index < len(BUCKETS_US) and microseconds > BUCKETS_US[index]:
+            index += 1
+        counts[index] += 1
+    bounds = BUCKETS_US + [None]
+    return [[bound, count] for bound, count in zip(bounds, counts) if count]
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def command_statistics(latencies):
+    statistics = {}
+    for opcode in sorted({opcode for opcode, _ in latencies}):
+        values = [latency for code, latency in latencies if code == opcode]
+        statistics["0x%02X" % opcode] = {
+            "count": len(values),
+            "min_ms": round(1e3 * min(values), 3),
+            "mean_ms": round(1e3 * sum(values) / len(values), 3),
+            "p50_ms": round(1e3 * percentile(values, 0.50), 3),
+            "p99_ms": round(1e3 * percentile(values, 0.99), 3),
+            "max_ms": round(1e3 * max(values), 3),
+            "histogram_us": histogram(values),
+        }
+    return statistics
+
+
+def preload(program, directory, image, baudrate):
+    """Leave a previous image in the FLASH of the device, the first word erased."""
+    previous = bytes(byte ^ 0x5A for byte in image)
+    simulation = Simulation(program, directory)
+    try:
+        tool = openbl.OpenBL(simulation.link, CONNECT_BAUDRATE)
+        tool.connect()
+        if baudrate != CONNECT_BAUDRATE:
+            tool.speed(baudrate)
+        tool.write_memory(openbl.USER_ADDRESS + 4, previous[4:])
+        tool.close()
+    finally:
+        simulation.stop()
+
+
+def run_flow(program, name, image, baudrate, extended, streamed, blank):
+    """Program the image on the device, the result of the flow as a dictionary."""
+    with tempfile.TemporaryDirectory() as directory:
+        if not blank:
+            preload(program, directory, image, baudrate)
+        simulation = Simulation(program, directory)
+        try:
+            tool = openbl.OpenBL(simulation.link, CONNECT_BAUDRATE, simulation.clock)
+            tool.connect()
+            start = tool.clock.read()
+            phases = {"connect": (start["tx_end"] - start["rx_start"]) / 1e9}
+            marks = [start]
+
+            def phase(name, step):
+                step()
+                marks.append(tool.clock.read())
+                phases[name] = (marks[-1]["tx_end"] - marks[-2]["tx_end"]) / 1e9
+
+            if baudrate != CONNECT_BAUDRATE:
+                phase("speed", lambda: tool.speed(baudrate))
+            phase("erase", lambda: tool.erase_application(len(image)))
+            phase("write", lambda: tool.write_memory(openbl.USER_ADDRESS, image, extended, streamed))
+            phase("verify", lambda: tool.verify(openbl.USER_ADDRESS, image))
+            phase("go", lambda: tool.go(openbl.USER_ADDRESS))
+            latencies = tool.latencies
+            tool.close()
+        finally:
+            simulation.stop()
+
+    end = marks[-1]
+    elapsed = (end["tx_end"] - start["rx_start"]) / 1e9
+    payload = len(image) * BITS_PER_BYTE / baudrate
+
+    def delta(field):
+        return end[field] - start[field]
+
+    return {
+        "image": name,
+        "size": len(image),
+        "time_s": round(elapsed, 6),
+        "bytes_per_s": round(len(image) / elapsed),
+        "overhead_pct": round(100.0 * (elapsed - payload) / elapsed, 2),
+        "phases_s": {key: round(value, 6) for key, value in phases.items()},
+        "line": {
+            "host_bytes": delta("rx_bytes"),
+            "device_bytes": delta("tx_bytes"),
+            "host_busy_s": round(delta("rx_line_time") / 1e9, 6),
+            "device_busy_s": round(delta("tx_line_time") / 1e9, 6),
+        },
+        "flash": {
+            "busy_s": round(delta("flash_busy_time") / 1e9, 6),
+            "programs": delta("flash_programs"),
+            "erased_sectors": delta("flash_erased_sectors"),
+        },
+        "commands": command_statistics(latencies),
+    }
+
+
+def compare(base, result, threshold):
+    """Print the change of each flow against the base result, True if none regressed beyond the threshold."""
+    flows = {flow["image"]: flow for flow in base["flows"]}
+    passed = True
+    print("%-10s %12s %12s %8s %10s %10s %10s %10s %10s %10s" % (
+        "image", "base B/s", "B/s", "change", "base ovh", "overhead",
+        "base wr s", "write s", "base fl s", "flash s"))
+    for flow in result["flows"]:
+        old = flows.get(flow["image"])
+        if old is None:
+            print("%-10s %12s %12d %8s" % (flow["image"], "-", flow["bytes_per_s"], "new"))
+            continue
+        change = 100.0 * (flow["bytes_per_s"] - old["bytes_per_s"]) / old["bytes_per_s"]
+        regressed = change < -threshold
+        passed = passed and not regressed
+        print("%-10s %12d %12d %+7.2f%% %9.2f%% %9.2f%% %10.6f %10.6f %10.6f %10.6f%s" % (
+            flow["image"], old["bytes_per_s"], flow["bytes_per_s"], change, old["overhead_pct"],
+            flow["overhead_pct"], old["phases_s"]["write"], flow["phases_s"]["write"],
+            old["flash"]["busy_s"], flow["flash"]["busy_s"], "  REGRESSION" if regressed else ""))
+    return passed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--sim", default="build/openbl_sim", help="simulation program")
+    parser.add_argument("--speed", type=int, default=2000000, help="baudrate set by the Speed command")
+    parser.add_argument("--standard", action="store_true", help="write with the standard 256 bytes command")
+    parser.add_argument("--streamed", action="store_true", help="send each write frame without waiting for the ACKs")
+    parser.add_argument("--blank", action="store_true", help="program a blank device, without previous image")
+    parser.add_argument("--output", help="JSON result file, else the standard output")
+    parser.add_argument("--compare", help="JSON result of an earlier run")
+    parser.add_argument("--threshold", type=float, default=1.0, help="throughput drop in percent failing --compare")
+    args = parser.parse_args()
+
+    result = {
+        "config": {
+            "connect_baudrate": CONNECT_BAUDRATE,
+            "baudrate": args.speed,
+            "write_command": "0x%02X" % (openbl.CMD_WRITE if args.standard else openbl.CMD_EXT_WRITE),
+            "frame_bytes": 256 if args.standard else openbl.EXT_WRITE_SIZE,
+            "previous_image": not args.blank,
+            "streamed": args.streamed,
+        },
+        "flows": [],
+    }
+
+    try:
+        for name, image in images():
+            flow = run_flow(args.sim, name, image, args.speed, not args.standard, args.streamed, args.blank)
+            result["flows"].append(flow)
+            print("bench: %-10s %7d bytes in %9.6f s, %7d bytes/s, overhead %5.2f %%" % (
+                name, flow["size"], flow["time_s"], flow["bytes_per_s"], flow["overhead_pct"]), file=sys.stderr)
+    except openbl.ProtocolError as error:
+        print("bench: %s" % error, file=sys.stderr)
+        return 1
+
+    text = json.dumps(result, indent=1, sort_keys=True) + "\n"
+    if args.output:
+        with open(args.output, "w") as file:
+            file.write(text)
+    elif not args.compare:
+        sys.stdout.write(text)
+
+    if args.compare:
+        with open(args.compare) as file:
+            base = json.load(file)
+        if base["config"] != result["config"]:
+            print("bench: the configurations differ: %s" % base["config"], file=sys.stderr)
+        if not compare(base, result, args.threshold):
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
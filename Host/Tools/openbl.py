@@ -0,0 +1,447 @@
+#!/usr/bin/env python3
+"""Host tool of the OpenBootloader USART protocol.
+
+Talks to a board or to the simulation (build/openbl_sim) over a serial port,
+8 data bits, even parity, 1 stop bit. Any baudrate is set with termios2, so
+the rates of the Speed command that are not standard work too.
+
+With --clock, the clock file exported by the simulation, each command reports
+its latency in simulated time, from the first bit of the command on the line
+to the last bit of the answer: it does not depend on the host load.
+
+  openbl.py --port /tmp/openbl info
+  openbl.py --port /tmp/openbl --clock clk.bin flash example/blink.bin --speed 2000000
+"""
+
+import argparse
+import fcntl
+import os
+import select
+import struct
+import sys
+import termios
+import time
+
+ACK = 0x79
+NACK = 0x1F
+BUSY = 0x76
+SYNC = 0x7F
+
+CMD_GET = 0x00
+CMD_GET_VERSION = 0x01
+CMD_GET_ID = 0x02
+CMD_SPEED = 0x03
+CMD_READ = 0x11
+CMD_GO = 0x21
+CMD_WRITE = 0x31
+CMD_EXT_WRITE = 0x33
+CMD_EXT_ERASE = 0x44
+CMD_CHECKSUM = 0xA1
+CMD_STATISTICS = 0xA6
+
+FLASH_BASE = 0x08000000
+USER_ADDRESS = 0x08004000
+FLASH_APP_ERASE = 0xFFFB
+FLASH_APP_ERASE_SIZE = 0xFFFA
+EXT_WRITE_SIZE = 4096
+
+# termios2, to set any baudrate (asm-generic/termbits.h and ioctls.h)
+TCGETS2 = 0x802C542A
+TCSETS2 = 0x402C542B
+BOTHER = 0o010000
+CBAUD = 0o010017
+TERMIOS2 = "4I B 19s 2I"
+
+# SIM_ClockTypeDef of Host/Sim/sim.h
+CLOCK_FIELDS = ("magic", "now", "tx_end", "rx_bytes", "tx_bytes", "rx_line_time", "tx_line_time",
+                "flash_busy_time", "flash_programs", "flash_erased_sectors", "boots", "stall_time", "rx_start")
+CLOCK_MAGIC = 0x4B434F4C4D49534F
+
+
+class ProtocolError(Exception):
+    pass
+
+
+def _crc32_mpeg2_table():
+    table = []
+    for index in range(256):
+        crc = index << 24
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x04C11DB7) & 0xFFFFFFFF if crc & 0x80000000 else (crc << 1) & 0xFFFFFFFF
+        table.append(crc)
+    return table
+
+
+CRC32_MPEG2_TABLE = _crc32_mpeg2_table()
+
+
+def crc32_mpeg2(data):
+    """CRC of OPENBL_CRC_Calculate(): CRC-32/MPEG-2 on little endian words, the last one padded with 0xFF."""
+    data = bytes(data)
+    if len(data) % 4:
+        data += b"\xff" * (4 - len(data) % 4)
+    # The words are fed MSB first: the bytes of each word in reverse order
+    swapped = bytearray(len(data))
+    for index in range(4):
+        swapped[index::4] = data[3 - index::4]
+    crc = 0xFFFFFFFF
+    table = CRC32_MPEG2_TABLE
+    for byte in swapped:
+        crc = ((crc << 8) & 0xFFFFFFFF) ^ table[(crc >> 24) ^ byte]
+    return crc
+
+
+def xor(data):
+    value = 0
+    for byte in data:
+        value ^= byte
+    return value
+
+
+class SimClock:
+    """Counters of the simulation, read from its clock file."""
+
+    def __init__(self, path):
+        self.path = path
+
+    def read(self):
+        with open(self.path, "rb") as file:
+            values = struct.unpack("<%dQ" % len(CLOCK_FIELDS), file.read(8 * len(CLOCK_FIELDS)))
+        clock = dict(zip(CLOCK_FIELDS, values))
+        if clock["magic"] != CLOCK_MAGIC:
+            raise ProtocolError("%s is not a clock file of openbl_sim" % self.path)
+        return clock
+
+
+class SerialPort:
+    def __init__(self, path, baudrate):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        attributes = termios.tcgetattr(self.fd)
+        attributes[0] = 0                                              # iflag
+        attributes[1] = 0                                              # oflag
+        attributes[2] = termios.CS8 | termios.PARENB | termios.CREAD | termios.CLOCAL
+        attributes[3] = 0                                              # lflag
+        attributes[4] = attributes[5] = termios.B115200                # replaced by set_baudrate()
+        termios.tcsetattr(self.fd, termios.TCSANOW, attributes)
+        self.set_baudrate(baudrate)
+
+    def set_baudrate(self, baudrate):
+        buffer = bytearray(struct.calcsize(TERMIOS2))
+        fcntl.ioctl(self.fd, TCGETS2, buffer)
+        iflag, oflag, cflag, lflag, line, cc, _, _ = struct.unpack(TERMIOS2, buffer)
+        cflag = (cflag & ~CBAUD) | BOTHER
+        fcntl.ioctl(self.fd, TCSETS2, struct.pack(TERMIOS2, iflag, oflag, cflag, lflag, line, cc, baudrate, baudrate))
+        self.baudrate = baudrate
+
+    def write(self, data):
+        data = bytes(data)
+        while data:
+            data = data[os.write(self.fd, data):]
+
+    def read(self, length, timeout):
+        data = b""
+        end = time.monotonic() + timeout
+        while len(data) < length:
+            remaining = end - time.monotonic()
+            if remaining <= 0 or not select.select([self.fd], [], [], remaining)[0]:
+                raise ProtocolError("timeout, %d of %d bytes received" % (len(data), length))
+            data += os.read(self.fd, length - len(data))
+        return data
+
+    def flush_input(self):
+        termios.tcflush(self.fd, termios.TCIFLUSH)
+
+    def close(self):
+        os.close(self.fd)
+
+
+class OpenBL:
+    """Commands of the bootloader; latencies holds (opcode, simulated seconds) when a clock is given."""
+
+    def __init__(self, port, baudrate=115200, clock=None, timeout=5.0):
+        self.port = SerialPort(port, baudrate)
+        self.clock = SimClock(clock) if clock else None
+        self.timeout = timeout
+        self.latencies = []
+        self._start = None
+
+    def close(self):
+        self.port.close()
+
+    # Link --------------------------------------------------------------------
+
+    def _wait_ack(self, what, timeout=None):
+        """Read the answer, the busy bytes sent during the FLASH operations are skipped."""
+        end = time.monotonic() + (timeout or self.timeout)
+        while True:
+            byte = self.port.read(1, max(end - time.monotonic(), 0.001))[0]
+            if byte == ACK:
+                return
+            if byte == NACK:
+                raise ProtocolError("%s: NACK" % what)
+            if byte != BUSY:
+                raise ProtocolError("%s: unexpected byte 0x%02X" % (what, byte))
+
+    def _command(self, opcode):
+        self.port.write((opcode, opcode ^ 0xFF))
+        self._wait_command(opcode)
+
+    def _wait_command(self, opcode):
+        self._wait_ack("command 0x%02X" % opcode)
+        if self.clock:
+            self._start = self.clock.read()["rx_start"]
+
+    def _done(self, opcode):
+        if self.clock and self._start is not None:
+            self.latencies.append((opcode, (self.clock.read()["tx_end"] - self._start) / 1e9))
+        self._start = None
+
+    @staticmethod
+    def _address_field(address):
+        data = struct.pack(">I", address)
+        return data + bytes((xor(data),))
+
+    def _address(self, address):
+        self.port.write(self._address_field(address))
+        self._wait_ack("address 0x%08X" % address)
+
+    def connect(self, attempts=10):
+        """Send the synchronization byte, the device measures the baudrate on it."""
+        for _ in range(attempts):
+            self.port.flush_input()
+            self.port.write((SYNC,))
+            try:
+                answer = self.port.read(1, 0.1)[0]
+            except ProtocolError:
+                continue
+            # A device already synchronized refuses the sync byte as an opcode
+            if answer in (ACK, NACK):
+                self.port.flush_input()
+                return
+        raise ProtocolError("no answer to the synchronization")
+
+    # Commands ----------------------------------------------------------------
+
+    def get(self):
+        self._command(CMD_GET)
+        length = self.port.read(1, self.timeout)[0]
+        data = self.port.read(length + 1, self.timeout)
+        self._wait_ack("get")
+        self._done(CMD_GET)
+        return data[0], list(data[1:])
+
+    def get_id(self):
+        self._command(CMD_GET_ID)
+        length = self.port.read(1, self.timeout)[0]
+        data = self.port.read(length + 1, self.timeout)
+        self._wait_ack("get id")
+        self._done(CMD_GET_ID)
+        return int.from_bytes(data, "big")
+
+    def speed(self, baudrate):
+        """Switch the link to a new baudrate, the device answers the sync byte at the new rate."""
+        self._command(CMD_SPEED)
+        data = struct.pack(">I", baudrate)
+        self.port.write(data + bytes((xor(data),)))
+        self._wait_ack("speed %d" % baudrate)
+        self.port.set_baudrate(baudrate)
+        self.port.write((SYNC,))
+        self._wait_ack("sync at %d" % baudrate, 2.0)
+        self._done(CMD_SPEED)
+
+    def read_memory(self, address, length):
+        data = b""
+        while len(data) < length:
+            size = min(256, length - len(data))
+            self._command(CMD_READ)
+            self._address(address + len(data))
+            self.port.write((size - 1, (size - 1) ^ 0xFF))
+            self._wait_ack("read length")
+            data += self.port.read(size, self.timeout)
+            self._done(CMD_READ)
+        return data
+
+    def write_memory(self, address, data, extended=True, streamed=False):
+        """Write with the extended write command (4 KB frames, CRC32) or the standard one (256 bytes).
+
+        streamed sends the opcode, the address and the frame at once and reads their ACKs afterwards, so
+        a device built with OPENBL_PIPELINED_WRITE receives a frame while it programs the previous one.
+        After a NACK the device takes the rest of the frame for commands, connect again before retrying.
+        The write ends with flush(), the ACK of the last frame does not tell that it is programmed.
+        The first frame is written last: without OPENBL_IMAGE_HEADER the bootloader starts any image
+        whose first word is programmed, an interrupted write then leaves it erased and does not boot.
+        """
+        frame = EXT_WRITE_SIZE if extended else 256
+        opcode = CMD_EXT_WRITE if extended else CMD_WRITE
+        offsets = list(range(0, len(data), frame))
+        for offset in offsets[1:] + offsets[:1]:
+            chunk = bytes(data[offset:offset + frame])
+            if len(chunk) % 4:
+                chunk += b"\xff" * (4 - len(chunk) % 4)
+            # The frame is ready before the command, the device does not wait for the host
+            if extended:
+                payload = struct.pack(">H", len(chunk) - 1) + chunk + struct.pack(">I", crc32_mpeg2(chunk))
+            else:
+                payload = bytes((len(chunk) - 1,)) + chunk + bytes(((len(chunk) - 1) ^ xor(chunk),))
+            if streamed:
+                self.port.write(bytes((opcode, opcode ^ 0xFF)) + self._address_field(address + offset) + payload)
+                self._wait_command(opcode)
+                self._wait_ack("address 0x%08X" % (address + offset))
+            else:
+                self._command(opcode)
+                self._address(address + offset)
+                self.port.write(payload)
+            self._wait_ack("write at 0x%08X" % (address + offset))
+            self._done(opcode)
+        self.flush()
+
+    def flush(self):
+        """Check that the last write frame is programmed.
+
+        A device built with OPENBL_PIPELINED_WRITE acknowledges a frame before programming it and reports
+        a failure by refusing the next command, whatever it is. The Get Version command sent here is that
+        next command: it is refused when the last frame failed. Any host of the pipelined build must send
+        a command after its last write frame and check its ACK.
+        """
+        self.port.write((CMD_GET_VERSION, CMD_GET_VERSION ^ 0xFF))
+        try:
+            self._wait_command(CMD_GET_VERSION)
+        except ProtocolError as error:
+            raise ProtocolError("write: programming failed after the ACK (%s)" % error)
+        self.port.read(3, self.timeout)
+        self._wait_ack("get version")
+        self._done(CMD_GET_VERSION)
+
+    def erase_sectors(self, sectors):
+        self._command(CMD_EXT_ERASE)
+        data = struct.pack(">H", len(sectors) - 1) + b"".join(struct.pack(">H", s) for s in sectors)
+        self.port.write(data + bytes((xor(data),)))
+        self._wait_ack("erase", 30.0)
+        self._done(CMD_EXT_ERASE)
+
+    def erase_application(self, size=None):
+        """Erase the user sectors holding an application of this size, or up to the last programmed one."""
+        self._command(CMD_EXT_ERASE)
+        data = struct.pack(">H", FLASH_APP_ERASE if size is None else FLASH_APP_ERASE_SIZE)
+        data += bytes((xor(data),))
+        if size is not None:
+            size_data = struct.pack(">I", size)
+            data += size_data + bytes((xor(size_data),))
+        self.port.write(data)
+        self._wait_ack("erase application", 30.0)
+        self._done(CMD_EXT_ERASE)
+
+    def checksum(self, address, length):
+        self._command(CMD_CHECKSUM)
+        self._address(address)
+        data = struct.pack(">I", length)
+        self.port.write(data + bytes((xor(data),)))
+        self._wait_ack("checksum", 10.0)
+        crc = struct.unpack(">I", self.port.read(4, self.timeout))[0]
+        self._done(CMD_CHECKSUM)
+        return crc
+
+    def verify(self, address, data):
+        if len(data) % 4:
+            data = bytes(data) + b"\xff" * (4 - len(data) % 4)
+        expected = crc32_mpeg2(data)
+        if self.checksum(address, len(data)) != expected:
+            raise ProtocolError("verify: the memory differs from the image")
+
+    def go(self, address):
+        self._command(CMD_GO)
+        self._address(address)
+        self._done(CMD_GO)
+
+    def statistics(self):
+        self._command(CMD_STATISTICS)
+        number = self.port.read(1, self.timeout)[0] + 1
+        counters = struct.unpack(">%dI" % number, self.port.read(4 * number, self.timeout))
+        records = self.port.read(1, self.timeout)[0]
+        nacks = {}
+        for _ in range(records):
+            opcode, count = struct.unpack(">BI", self.port.read(5, self.timeout))
+            nacks[opcode] = count
+        self._done(CMD_STATISTICS)
+        return counters, nacks
+
+
+def report(tool, clock_before, started, size):
+    """Print the wall time, and the simulated time and the link usage when the clock is known."""
+    print("wall time      %.3f s" % (time.monotonic() - started))
+    if not tool.clock:
+        return
+    clock = tool.clock.read()
+    elapsed = (clock["tx_end"] - clock_before["tx_end"]) / 1e9
+    line = (clock["rx_line_time"] - clock_before["rx_line_time"] + clock["tx_line_time"] - clock_before["tx_line_time"]) / 1e9
+    print("simulated time %.6f s" % elapsed)
+    if size and elapsed > 0:
+        print("throughput     %.0f bytes/s" % (size / elapsed))
+    print("line busy      %.6f s (%.1f %%)" % (line, 100.0 * line / elapsed if elapsed > 0 else 0.0))
+    print("flash busy     %.6f s, %d sectors erased" % (
+        (clock["flash_busy_time"] - clock_before["flash_busy_time"]) / 1e9,
+        clock["flash_erased_sectors"] - clock_before["flash_erased_sectors"]))
+    for opcode in sorted({opcode for opcode, _ in tool.latencies}):
+        values = [latency for code, latency in tool.latencies if code == opcode]
+        print("command 0x%02X   %5d x, mean %.3f ms, max %.3f ms" % (
+            opcode, len(values), 1e3 * sum(values) / len(values), 1e3 * max(values)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", required=True, help="serial port, or the --link of openbl_sim")
+    parser.add_argument("--baud", type=int, default=115200, help="baudrate of the synchronization")
+    parser.add_argument("--clock", help="clock file of openbl_sim, to report the simulated timings")
+    parser.add_argument("--speed", type=int, help="switch to this baudrate after the synchronization")
+    parser.add_argument("--address", type=lambda text: int(text, 0), default=USER_ADDRESS)
+    parser.add_argument("--standard", action="store_true", help="write with the standard 256 bytes command")
+    parser.add_argument("--streamed", action="store_true", help="send each write frame without waiting for the ACKs")
+    parser.add_argument("command", choices=("info", "erase", "write", "verify", "go", "flash", "stats"))
+    parser.add_argument("file", nargs="?", help="binary image")
+    args = parser.parse_args()
+
+    image = b""
+    if args.command in ("write", "verify", "flash"):
+        if not args.file:
+            parser.error("%s needs an image" % args.command)
+        with open(args.file, "rb") as file:
+            image = file.read()
+
+    tool = OpenBL(args.port, args.baud, args.clock)
+    started = time.monotonic()
+    try:
+        tool.connect()
+        clock_before = tool.clock.read() if tool.clock else None
+        if args.speed:
+            tool.speed(args.speed)
+        if args.command == "info":
+            version, commands = tool.get()
+            print("version        %d.%d" % (version >> 4, version & 0xF))
+            print("commands       %s" % " ".join("%02X" % c for c in commands))
+            print("device id      0x%03X" % tool.get_id())
+        elif args.command == "erase":
+            tool.erase_application(len(image) if image else None)
+        elif args.command == "stats":
+            counters, nacks = tool.statistics()
+            print("counters       %s" % " ".join(str(c) for c in counters))
+            print("nacks          %s" % " ".join("%02X:%d" % item for item in sorted(nacks.items())))
+        if args.command in ("flash",):
+            tool.erase_application(len(image))
+        if args.command in ("write", "flash"):
+            tool.write_memory(args.address, image, not args.standard, args.streamed)
+        if args.command in ("verify", "flash"):
+            tool.verify(args.address, image)
+        if args.command in ("go", "flash"):
+            tool.go(args.address)
+        if clock_before is not None or args.command != "info":
+            report(tool, clock_before, started, len(image))
+    except ProtocolError as error:
+        print("openbl: %s" % error, file=sys.stderr)
+        return 1
+    finally:
+        tool.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())